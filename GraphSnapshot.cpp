@@ -0,0 +1,152 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "GraphSnapshot.h"
+
+#include "GraphVisitor.h"
+
+namespace media_graph {
+namespace {
+    // Copies a property value into a ReadOnlyProperty of the same type.
+    // Structs are not copied: their type is only known at compile time, so
+    // beginStruct() keeps its default and fails, and the property is skipped.
+    class PropertyCopier : public TypeConstVisitor {
+    public:
+        PropertyCopier(const std::string& name) : name_(name) {}
+
+        virtual bool process(const int& value) { return copy(value); }
+        virtual bool process(const int64_t& value) { return copy(value); }
+        virtual bool process(const bool& value) { return copy(value); }
+        virtual bool process(const float& value) { return copy(value); }
+        virtual bool process(const double& value) { return copy(value); }
+        virtual bool process(const std::string& value) { return copy(value); }
+
+        virtual bool processArray(const int* values, size_t count) {
+            return copy(std::vector<int>(values, values + count));
+        }
+        virtual bool processArray(const int64_t* values, size_t count) {
+            return copy(std::vector<int64_t>(values, values + count));
+        }
+        virtual bool processArray(const float* values, size_t count) {
+            return copy(std::vector<float>(values, values + count));
+        }
+        virtual bool processArray(const double* values, size_t count) {
+            return copy(std::vector<double>(values, values + count));
+        }
+
+        std::unique_ptr<const NamedProperty> release() { return std::move(copy_); }
+
+    private:
+        template <class T> bool copy(const T& value) {
+            copy_.reset(new ReadOnlyProperty<T>(name_, value));
+            return true;
+        }
+
+        const std::string& name_;
+        std::unique_ptr<const NamedProperty> copy_;
+    };
+}  // namespace
+
+class SnapshotBuilder : public GraphVisitor {
+public:
+    SnapshotBuilder(GraphSnapshot* snapshot) : snapshot_(snapshot) {}
+
+protected:
+    virtual void onStream(std::shared_ptr<NodeBase> node, NamedStream* stream) override {
+        copyAtOnce(node, stream, 0, stream, stream->countersLock());
+    }
+
+    virtual void onPin(std::shared_ptr<NodeBase> node, NamedPin* pin) override {
+        copyAtOnce(node, 0, pin, pin, pin->countersLock());
+    }
+
+    virtual void onProperty(std::shared_ptr<NodeBase> node, NamedStream* stream, NamedPin* pin,
+                            NamedProperty* prop) override {
+        // Stream and pin properties are copied by onStream() and onPin().
+        if (stream || pin) { return; }
+
+        GraphSnapshot::Entry entry;
+        if (copy(node, 0, 0, prop, &entry)) { snapshot_->entries_.push_back(std::move(entry)); }
+    }
+
+private:
+    bool copy(const std::shared_ptr<NodeBase>& node, NamedStream* stream, NamedPin* pin,
+              NamedProperty* prop, GraphSnapshot::Entry* entry) {
+        PropertyCopier copier(prop->name());
+        if (!prop->apply(&copier)) { return false; }
+
+        if (node) { entry->node = node->name(); }
+        if (stream) { entry->stream = stream->streamName(); }
+        if (pin) { entry->pin = pin->name(); }
+        entry->property = copier.release();
+        return true;
+    }
+
+    // Copies all the properties of <list> in a single seqlock read section,
+    // starting over if a writer changed its counters meanwhile.
+    void copyAtOnce(const std::shared_ptr<NodeBase>& node, NamedStream* stream, NamedPin* pin,
+                    PropertyList* list, const SeqLock& lock) {
+        std::vector<GraphSnapshot::Entry> entries;
+        uint64_t begin;
+        do {
+            entries.clear();
+            begin = lock.readBegin();
+            for (int i = 0; i < list->numProperty(); ++i) {
+                GraphSnapshot::Entry entry;
+                if (copy(node, stream, pin, list->property(i), &entry)) {
+                    entries.push_back(std::move(entry));
+                }
+            }
+        } while (lock.readRetry(begin));
+
+        for (GraphSnapshot::Entry& entry : entries) {
+            snapshot_->entries_.push_back(std::move(entry));
+        }
+    }
+
+    GraphSnapshot* snapshot_;
+};
+
+std::shared_ptr<const GraphSnapshot> GraphSnapshot::take(Graph* graph) {
+    std::shared_ptr<GraphSnapshot> snapshot(new GraphSnapshot());
+    snapshot->time_ = Timestamp::now();
+    SnapshotBuilder(snapshot.get()).visit(graph);
+    return snapshot;
+}
+
+const NamedProperty* GraphSnapshot::find(const std::string& node, const std::string& stream,
+                                         const std::string& pin,
+                                         const std::string& name) const {
+    for (const Entry& entry : entries_) {
+        if (entry.property->name() == name && entry.node == node && entry.stream == stream &&
+            entry.pin == pin) {
+            return entry.property.get();
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace media_graph
@@ -0,0 +1,100 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_GRAPH_SNAPSHOT_H
+#define MEDIAGRAPH_GRAPH_SNAPSHOT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "property.h"
+#include "timestamp.h"
+
+namespace media_graph {
+
+/*! The values of all the properties of a graph, its nodes, streams and pins,
+ *  read in a single pass. A snapshot is immutable and can be shared freely
+ *  between monitoring threads.
+ *
+ *  Taking a snapshot never takes stream locks, so the data path is not
+ *  slowed down. The properties of each stream, and of each pin, are copied
+ *  at a single instant: writers update related counters in a seqlock write
+ *  section, and the copy starts over if it overlapped one. Different streams
+ *  and pins are copied one after the other. The node list is copied under
+ *  the graph lock, so a snapshot always describes a consistent set of nodes.
+ *
+ *  Struct properties, declared with MEDIAGRAPH_FIELDS, are not part of
+ *  snapshots: use NamedProperty::ValueToString() on the live property.
+ *
+ *  Example:
+ *  \code
+ *  std::shared_ptr<const GraphSnapshot> snapshot = GraphSnapshot::take(&graph);
+ *  const NamedProperty* queued = snapshot->find("camera", "out", "", "NumItemsInQueue");
+ *  \endcode
+ */
+class GraphSnapshot {
+public:
+    struct Entry {
+        //! Empty for graph properties.
+        std::string node;
+
+        //! Set for stream properties only.
+        std::string stream;
+
+        //! Set for pin properties only.
+        std::string pin;
+
+        //! A read only copy of the property, with its name, type and value.
+        std::unique_ptr<const NamedProperty> property;
+    };
+
+    static std::shared_ptr<const GraphSnapshot> take(Graph* graph);
+
+    //! When the snapshot was taken.
+    Timestamp time() const { return time_; }
+
+    int size() const { return int(entries_.size()); }
+    const Entry& entry(int index) const { return entries_[index]; }
+
+    //! Returns the property <name>, or null. Empty <node> looks for graph properties.
+    const NamedProperty* find(const std::string& node, const std::string& stream,
+                              const std::string& pin, const std::string& name) const;
+
+private:
+    GraphSnapshot() {}
+    GraphSnapshot(const GraphSnapshot&) = delete;
+
+    Timestamp time_;
+    std::vector<Entry> entries_;
+
+    friend class SnapshotBuilder;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_GRAPH_SNAPSHOT_H
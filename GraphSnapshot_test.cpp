@@ -0,0 +1,139 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "GraphSnapshot.h"
+
+#include "graph.h"
+#include "node.h"
+#include "stream.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+namespace {
+    class SourceNode : public NodeBase {
+    public:
+        SourceNode() : output("out", this, NEVER_BLOCK_DROP_OLDEST, 4) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        Stream<int> output;
+    };
+
+    class SinkNode : public NodeBase {
+    public:
+        SinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<int> input;
+    };
+
+    int64_t intValue(const NamedProperty* property) {
+        EXPECT_TRUE(property != nullptr);
+        if (!property) { return -1; }
+        return std::stoll(property->ValueToString());
+    }
+
+    TEST(GraphSnapshotTest, CopiesAllProperties) {
+        Graph graph;
+        std::shared_ptr<SourceNode> source = graph.newNode<SourceNode>("source");
+        std::shared_ptr<SinkNode> sink = graph.newNode<SinkNode>("sink");
+        ASSERT_TRUE(graph.connect("source", "out", "sink", "in"));
+        ASSERT_TRUE(graph.start());
+
+        source->output.update(Timestamp::microSecondsSince1970(1), 1);
+        source->output.update(Timestamp::microSecondsSince1970(2), 2);
+
+        std::shared_ptr<const GraphSnapshot> snapshot = GraphSnapshot::take(&graph);
+        EXPECT_EQ("1", snapshot->find("", "", "", "started")->ValueToString());
+        EXPECT_EQ(2, intValue(snapshot->find("source", "out", "", "NumItemsInQueue")));
+        EXPECT_EQ(2, intValue(snapshot->find("source", "out", "", "NumUpdates")));
+        EXPECT_EQ(1, intValue(snapshot->find("sink", "", "in", "Decimation")));
+        EXPECT_EQ(nullptr, snapshot->find("source", "", "", "NumItemsInQueue"));
+
+        // The snapshot does not follow the graph.
+        source->output.update(Timestamp::microSecondsSince1970(3), 3);
+        EXPECT_EQ(2, intValue(snapshot->find("source", "out", "", "NumItemsInQueue")));
+        EXPECT_EQ(3, source->output.numItemsInQueue());
+
+        const NamedProperty* queued = snapshot->find("source", "out", "", "NumItemsInQueue");
+        EXPECT_FALSE(queued->isWritable());
+        EXPECT_EQ(typeId<int>(), queued->typeId());
+        graph.stop();
+    }
+
+    TEST(GraphSnapshotTest, RunsConcurrentlyWithTheDataPath) {
+        Graph graph;
+        std::shared_ptr<SourceNode> source = graph.newNode<SourceNode>("source");
+        std::shared_ptr<SinkNode> sink = graph.newNode<SinkNode>("sink");
+        ASSERT_TRUE(graph.connect("source", "out", "sink", "in"));
+        ASSERT_TRUE(graph.start());
+
+        source->output.update(Timestamp::microSecondsSince1970(1), 1);
+        const int64_t entry_bytes = source->output.bytesInQueue();
+        ASSERT_LT(0, entry_bytes);
+
+        std::atomic<bool> done(false);
+        std::thread producer([&]() {
+            for (int i = 2; i <= 2000; ++i) {
+                source->output.update(Timestamp::microSecondsSince1970(i), i);
+            }
+            done = true;
+        });
+
+        int num_snapshots = 0;
+        do {
+            std::shared_ptr<const GraphSnapshot> snapshot = GraphSnapshot::take(&graph);
+            const int64_t queued =
+                intValue(snapshot->find("source", "out", "", "NumItemsInQueue"));
+            EXPECT_GE(queued, 0);
+            EXPECT_LE(queued, 4);
+
+            // Both counters are copied at the same instant.
+            EXPECT_EQ(queued * entry_bytes,
+                      intValue(snapshot->find("source", "out", "", "BytesInQueue")));
+            EXPECT_LE(queued, intValue(snapshot->find("source", "out", "", "NumUpdates")));
+            ++num_snapshots;
+        } while (!done);
+        producer.join();
+        EXPECT_GT(num_snapshots, 0);
+        EXPECT_EQ(2000, source->output.getNumUpdateCalls());
+        graph.stop();
+    }
+
+}  // namespace
+}  // namespace media_graph
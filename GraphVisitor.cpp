@@ -30,8 +30,8 @@ namespace media_graph {
 void GraphVisitor::visit(Graph* graph) {
     for (int i = 0; i < graph->numProperty(); i++) { onProperty(0, 0, 0, graph->property(i)); }
 
-    for (int i = 0; i < graph->numNodes(); i++) {
-        std::shared_ptr<NodeBase> node = graph->node(i);
+    // Iterate over a copy: nodes might be added or removed meanwhile.
+    for (const std::shared_ptr<NodeBase>& node : graph->nodes()) {
         onNode(node);
 
         for (int j = 0; j < node->numProperty(); j++) { onProperty(node, 0, 0, node->property(j)); }
@@ -80,7 +80,9 @@ namespace {
                                 NamedProperty* prop) override {
             if (node == 0) {
                 // test on graph property
-                EXPECT_EQ("started", prop->name());
+                EXPECT_TRUE(prop->name() == "started" || prop->name() == "MemoryBudget" ||
+                            prop->name() == "BytesHeld" || prop->name() == "BatchMode")
+                    << prop->name();
             } else {
                 EXPECT_EQ("node prop int", node->name());
                 // test property name
@@ -0,0 +1,228 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "PropertyRecorder.h"
+
+#include <chrono>
+
+#include "GraphVisitor.h"
+
+namespace media_graph {
+namespace {
+    // Reads a numeric property as a double. Fails on strings.
+    class ToDouble : public TypeConstVisitor {
+    public:
+        ToDouble() : value(0) {}
+
+        virtual bool process(const int& v) { return set(v); }
+        virtual bool process(const int64_t& v) { return set(double(v)); }
+        virtual bool process(const bool& v) { return set(v ? 1 : 0); }
+        virtual bool process(const float& v) { return set(v); }
+        virtual bool process(const double& v) { return set(v); }
+        virtual bool process(const std::string& /*v*/) { return false; }
+
+        double value;
+
+    private:
+        bool set(double v) {
+            value = v;
+            return true;
+        }
+    };
+
+    class GraphRecorder : public GraphVisitor {
+    public:
+        GraphRecorder(PropertyRecorder* recorder) : recorder_(recorder), num_recorded_(0) {}
+
+        int numRecorded() const { return num_recorded_; }
+
+    protected:
+        virtual void onProperty(std::shared_ptr<NodeBase> node, NamedStream* stream, NamedPin* pin,
+                                NamedProperty* prop) override {
+            std::string key;
+            if (node) { key = node->name() + "/"; }
+            if (stream) { key += "stream/" + stream->streamName() + "/"; }
+            if (pin) { key += "pin/" + pin->name() + "/"; }
+            if (recorder_->record(key + prop->name(), prop, node)) { ++num_recorded_; }
+        }
+
+    private:
+        PropertyRecorder* recorder_;
+        int num_recorded_;
+    };
+}  // namespace
+
+PropertyRecorder::PropertyRecorder(Duration period, int capacity)
+    : period_(period), capacity_(capacity > 0 ? capacity : 1), must_quit_(false) {}
+
+PropertyRecorder::~PropertyRecorder() { stop(); }
+
+bool PropertyRecorder::record(const std::string& key, NamedProperty* property,
+                              std::shared_ptr<NodeBase> owner) {
+    ToDouble reader;
+    if (!property || !property->apply(&reader)) { return false; }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (series_.count(key)) { return false; }
+    series_[key] = std::make_shared<Series>(property, std::move(owner), capacity_);
+    return true;
+}
+
+int PropertyRecorder::recordGraph(Graph* graph) {
+    GraphRecorder recorder(this);
+    recorder.visit(graph);
+    return recorder.numRecorded();
+}
+
+void PropertyRecorder::forget(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    series_.erase(key);
+}
+
+void PropertyRecorder::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    series_.clear();
+}
+
+std::vector<std::string> PropertyRecorder::keys() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> result;
+    for (const auto& it : series_) { result.push_back(it.first); }
+    return result;
+}
+
+void PropertyRecorder::sample(Timestamp time) {
+    // Get methods might be slow or lock: call them on a copy of the list.
+    std::vector<std::shared_ptr<Series>> series;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        series.reserve(series_.size());
+        for (const auto& it : series_) { series.push_back(it.second); }
+    }
+
+    std::vector<double> values(series.size());
+    std::vector<bool> valid(series.size());
+    for (size_t i = 0; i < series.size(); ++i) {
+        ToDouble reader;
+        valid[i] = series[i]->property->apply(&reader);
+        values[i] = reader.value;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < series.size(); ++i) {
+        if (!valid[i]) { continue; }
+        Series* s = series[i].get();
+        const Sample sample = {time, values[i]};
+        if (s->size < capacity_) {
+            s->samples.push_back(sample);
+        } else {
+            s->samples[s->next] = sample;
+        }
+        s->next = (s->next + 1) % capacity_;
+        if (s->size < capacity_) { ++s->size; }
+    }
+}
+
+std::vector<PropertyRecorder::Sample> PropertyRecorder::query(const std::string& key,
+                                                              Duration span,
+                                                              Duration resolution) const {
+    std::vector<Sample> samples;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = series_.find(key);
+        if (it == series_.end()) { return samples; }
+
+        const Series& series = *it->second;
+        if (series.size == 0) { return samples; }
+
+        // Newest sample defines "now", so that queries work on stopped recorders.
+        const int newest = (series.next + capacity_ - 1) % capacity_;
+        const Timestamp start = series.samples[newest].time - span;
+        for (int i = 0; i < series.size; ++i) {
+            const Sample& sample = series.samples[(series.next + capacity_ - series.size + i) %
+                                                  capacity_];
+            if (sample.time >= start) { samples.push_back(sample); }
+        }
+    }
+
+    if (resolution <= period_ || samples.empty()) { return samples; }
+
+    // Average samples over consecutive intervals of <resolution>.
+    std::vector<Sample> downsampled;
+    Timestamp bucket_start = samples.front().time;
+    double sum = 0;
+    int count = 0;
+    for (const Sample& sample : samples) {
+        if (sample.time - bucket_start >= resolution) {
+            downsampled.push_back(Sample{bucket_start, sum / count});
+            bucket_start = sample.time;
+            sum = 0;
+            count = 0;
+        }
+        sum += sample.value;
+        ++count;
+    }
+    downsampled.push_back(Sample{bucket_start, sum / count});
+    return downsampled;
+}
+
+bool PropertyRecorder::start() {
+    if (isRunning()) { return true; }
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        must_quit_ = false;
+    }
+    return thread_.start(threadEntryPoint, this);
+}
+
+void PropertyRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        must_quit_ = true;
+    }
+    stop_event_.notify_all();
+    thread_.waitForTermination();
+}
+
+void PropertyRecorder::threadEntryPoint(void* ptr) {
+    static_cast<PropertyRecorder*>(ptr)->threadMain();
+}
+
+void PropertyRecorder::threadMain() {
+    // Sample on a fixed grid: a slow sample does not shift the next ones.
+    auto next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!must_quit_) {
+        lock.unlock();
+        sample();
+        lock.lock();
+
+        next += std::chrono::microseconds(period_.microSeconds());
+        stop_event_.wait_until(lock, next, [this] { return must_quit_; });
+    }
+}
+
+}  // namespace media_graph
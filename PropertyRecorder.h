@@ -0,0 +1,156 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_PROPERTY_RECORDER_H
+#define MEDIAGRAPH_PROPERTY_RECORDER_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "property.h"
+#include "thread_primitives.h"
+#include "timestamp.h"
+
+namespace media_graph {
+
+/*! Samples numeric properties at a fixed rate, keeping their recent history
+ *  in fixed size ring buffers: memory does not grow with time.
+ *
+ *  A single background thread samples all the recorded properties. It only
+ *  calls property get methods, which do not block nodes, and calls them
+ *  without holding any lock of the recorder: get methods are free to query
+ *  it.
+ *
+ *  Properties are identified by a key following the HTTP server paths:
+ *  "<name>" for graph properties, "<node>/<name>" for node properties,
+ *  "<node>/stream/<stream>/<name>" and "<node>/pin/<pin>/<name>" for stream
+ *  and pin properties.
+ *
+ *  Example:
+ *  \code
+ *  PropertyRecorder recorder(Duration::milliSeconds(100), 6000);  // 10 minutes.
+ *  recorder.recordGraph(&graph);
+ *  recorder.start();
+ *  ...
+ *  // Last 5 minutes, one averaged sample per 10 seconds.
+ *  std::vector<PropertyRecorder::Sample> trend = recorder.query(
+ *      "camera/stream/out/NumItemsInQueue", Duration::seconds(300), Duration::seconds(10));
+ *  \endcode
+ */
+class PropertyRecorder {
+public:
+    struct Sample {
+        Timestamp time;
+        double value;
+    };
+
+    //! Samples every <period>, keeping <capacity> samples per property.
+    PropertyRecorder(Duration period, int capacity);
+    ~PropertyRecorder();
+
+    /*! Records <property> under <key>. Returns false if the property is not
+     *  numeric or if <key> is already recorded. The recorder keeps <owner>
+     *  alive, so that nodes removed from the graph can still be sampled.
+     *  Without an owner, the property must outlive the recorder, or be
+     *  removed with forget() while the recorder is stopped.
+     */
+    bool record(const std::string& key, NamedProperty* property,
+                std::shared_ptr<NodeBase> owner = nullptr);
+
+    /*! Records all the numeric properties of the graph, its nodes, streams
+     *  and pins. Returns the number of recorded properties. Node, stream
+     *  and pin properties are owned by their node; the graph must outlive
+     *  the recorder, or the recorder has to be cleared first.
+     */
+    int recordGraph(Graph* graph);
+
+    //! Stops recording <key> and frees its history. A sample being taken
+    //! might still read the property.
+    void forget(const std::string& key);
+
+    //! Stops recording all properties.
+    void clear();
+
+    std::vector<std::string> keys() const;
+
+    /*! Returns the samples of the last <span>, oldest first. With a
+     *  <resolution> larger than the sampling period, samples are averaged
+     *  over consecutive intervals of <resolution>.
+     */
+    std::vector<Sample> query(const std::string& key, Duration span,
+                              Duration resolution = Duration()) const;
+
+    //! Reads all the recorded properties once. Called by the sampling thread.
+    void sample(Timestamp time = Timestamp::now());
+
+    bool start();
+    void stop();
+    bool isRunning() const { return thread_.isRunning(); }
+
+    Duration period() const { return period_; }
+    int capacity() const { return capacity_; }
+
+private:
+    // A fixed size ring of samples. property and owner never change, the
+    // samples are protected by mutex_.
+    struct Series {
+        Series(NamedProperty* property, std::shared_ptr<NodeBase> owner, int capacity)
+            : property(property), owner(std::move(owner)), next(0), size(0) {
+            samples.reserve(capacity);
+        }
+
+        NamedProperty* const property;
+        const std::shared_ptr<NodeBase> owner;
+        std::vector<Sample> samples;
+        int next;
+        int size;
+    };
+
+    static void threadEntryPoint(void* ptr);
+    void threadMain();
+
+    const Duration period_;
+    const int capacity_;
+
+    // Protects series_ and their samples. Only held to copy series out,
+    // values in, or samples out: never while calling get methods.
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<Series>> series_;
+
+    Thread thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_event_;
+    bool must_quit_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_PROPERTY_RECORDER_H
@@ -0,0 +1,178 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "PropertyRecorder.h"
+
+#include "graph.h"
+#include "node.h"
+#include "stream.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+namespace {
+    class SourceNode : public NodeBase {
+    public:
+        SourceNode() : output("out", this, NEVER_BLOCK_DROP_OLDEST, 4), label("label", "x") {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        virtual int numProperty() const { return 1 + PropertyList::numProperty(); }
+        virtual NamedProperty* property(int id) {
+            return id == 0 ? &label : PropertyList::property(id - 1);
+        }
+
+        Stream<int> output;
+        Property<std::string> label;
+    };
+
+    // Counts the recorded keys when read.
+    class NumKeys : public PropertyInterface<int> {
+    public:
+        NumKeys(PropertyRecorder* recorder)
+            : PropertyInterface<int>("numKeys"), recorder_(recorder) {}
+
+        virtual int get() const { return int(recorder_->keys().size()); }
+        virtual bool set(const int& /*value*/) { return false; }
+
+    private:
+        PropertyRecorder* recorder_;
+    };
+
+    Timestamp at(double seconds) {
+        return Timestamp::microSecondsSince1970(int64_t(seconds * 1e6));
+    }
+
+    TEST(PropertyRecorderTest, KeepsAFixedNumberOfSamples) {
+        Property<int> value("value", 0);
+        PropertyRecorder recorder(Duration::seconds(1), 3);
+        EXPECT_TRUE(recorder.record("value", &value));
+        EXPECT_FALSE(recorder.record("value", &value));
+
+        for (int i = 0; i < 5; ++i) {
+            value = i;
+            recorder.sample(at(i));
+        }
+
+        std::vector<PropertyRecorder::Sample> samples =
+            recorder.query("value", Duration::seconds(100));
+        ASSERT_EQ(3, int(samples.size()));
+        EXPECT_EQ(2, samples[0].value);
+        EXPECT_EQ(4, samples[2].value);
+        EXPECT_EQ(at(4), samples[2].time);
+
+        // Only the last second.
+        EXPECT_EQ(2, int(recorder.query("value", Duration::seconds(1)).size()));
+        EXPECT_TRUE(recorder.query("unknown", Duration::seconds(1)).empty());
+    }
+
+    TEST(PropertyRecorderTest, Downsamples) {
+        Property<double> value("value", 0);
+        PropertyRecorder recorder(Duration::seconds(1), 100);
+        recorder.record("value", &value);
+
+        for (int i = 0; i < 10; ++i) {
+            value = i;
+            recorder.sample(at(i));
+        }
+
+        std::vector<PropertyRecorder::Sample> samples =
+            recorder.query("value", Duration::seconds(100), Duration::seconds(5));
+        ASSERT_EQ(2, int(samples.size()));
+        EXPECT_DOUBLE_EQ(2, samples[0].value);
+        EXPECT_DOUBLE_EQ(7, samples[1].value);
+        EXPECT_EQ(at(5), samples[1].time);
+    }
+
+    TEST(PropertyRecorderTest, RecordsNumericGraphProperties) {
+        Graph graph;
+        std::shared_ptr<SourceNode> source = graph.newNode<SourceNode>("source");
+
+        PropertyRecorder recorder(Duration::milliSeconds(10), 100);
+        EXPECT_LT(0, recorder.recordGraph(&graph));
+
+        const std::vector<std::string> keys = recorder.keys();
+        EXPECT_NE(keys.end(), std::find(keys.begin(), keys.end(), "started"));
+        EXPECT_NE(keys.end(),
+                  std::find(keys.begin(), keys.end(), "source/stream/out/NumItemsInQueue"));
+
+        // Strings are not recorded.
+        EXPECT_EQ(keys.end(), std::find(keys.begin(), keys.end(), "source/label"));
+
+        ASSERT_TRUE(recorder.start());
+        source->output.update(Timestamp::microSecondsSince1970(1), 1);
+        Duration::milliSeconds(50).sleep();
+        recorder.stop();
+
+        std::vector<PropertyRecorder::Sample> samples =
+            recorder.query("source/stream/out/NumUpdates", Duration::seconds(10));
+        ASSERT_FALSE(samples.empty());
+        EXPECT_EQ(1, samples.back().value);
+    }
+
+    TEST(PropertyRecorderTest, GetMethodsRunWithoutTheLock) {
+        PropertyRecorder recorder(Duration::seconds(1), 10);
+        NumKeys num_keys(&recorder);
+        ASSERT_TRUE(recorder.record("numKeys", &num_keys));
+
+        // Would deadlock if sample() held the recorder lock.
+        recorder.sample(at(0));
+        std::vector<PropertyRecorder::Sample> samples =
+            recorder.query("numKeys", Duration::seconds(10));
+        ASSERT_EQ(1, int(samples.size()));
+        EXPECT_EQ(1, samples[0].value);
+    }
+
+    TEST(PropertyRecorderTest, KeepsRemovedNodesAlive) {
+        Graph graph;
+        std::weak_ptr<SourceNode> weak = graph.newNode<SourceNode>("source");
+        weak.lock()->output.update(Timestamp::microSecondsSince1970(1), 1);
+
+        PropertyRecorder recorder(Duration::seconds(1), 10);
+        recorder.recordGraph(&graph);
+
+        graph.removeNode("source");
+        EXPECT_FALSE(weak.expired());
+        recorder.sample(at(0));
+        std::vector<PropertyRecorder::Sample> samples =
+            recorder.query("source/stream/out/NumUpdates", Duration::seconds(10));
+        ASSERT_EQ(1, int(samples.size()));
+        EXPECT_EQ(1, samples[0].value);
+
+        recorder.forget("source/stream/out/NumUpdates");
+        EXPECT_FALSE(weak.expired());
+        recorder.clear();
+        EXPECT_TRUE(weak.expired());
+    }
+
+}  // namespace
+}  // namespace media_graph
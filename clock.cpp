@@ -0,0 +1,172 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "clock.h"
+
+#include <assert.h>
+
+namespace {
+thread_local Clock* current_clock = nullptr;
+thread_local std::atomic<int64_t>* idle_meter = nullptr;
+}  // namespace
+
+Clock* Clock::current() { return current_clock; }
+
+Clock* Clock::setCurrent(Clock* clock) {
+    Clock* previous = current_clock;
+    current_clock = clock;
+    return previous;
+}
+
+void Clock::setIdleMeter(std::atomic<int64_t>* nanoseconds) { idle_meter = nanoseconds; }
+
+std::atomic<int64_t>* Clock::idleMeter() { return idle_meter; }
+
+Timestamp Timestamp::now() {
+    const Clock* clock = current_clock;
+    return clock ? clock->now() : systemNow();
+}
+
+void Duration::sleep() const {
+    IdleTimer idle;
+    if (Clock* clock = current_clock) {
+        clock->sleepUntil(clock->now() + *this);
+    } else {
+        systemSleep();
+    }
+}
+
+void Timestamp::sleepUntil(Timestamp deadline, Duration spin) {
+    IdleTimer idle;
+    if (Clock* clock = current_clock) {
+        clock->sleepUntil(deadline);
+    } else {
+        systemSleepUntil(deadline, spin);
+    }
+}
+
+VirtualClock::VirtualClock(Timestamp start)
+    : now_ns_(start.nanoSecondsSince1970()), num_busy_(0) {}
+
+void VirtualClock::sleepUntil(Timestamp deadline) {
+    const int64_t deadline_ns = deadline.nanoSecondsSince1970();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (deadline_ns <= now_ns_) { return; }
+
+    deadlines_.emplace(deadline_ns, nullptr);
+    --num_busy_;
+    advanceIfIdle();
+    // wakeUntil() counts us busy again when passing the deadline.
+    advanced_.wait(lock, [this, deadline_ns] { return deadline_ns <= now_ns_; });
+}
+
+void VirtualClock::addThread() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_busy_;
+}
+
+void VirtualClock::removeThread() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --num_busy_;
+    advanceIfIdle();
+}
+
+void VirtualClock::idle() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --num_busy_;
+    advanceIfIdle();
+}
+
+void VirtualClock::busy(int num_threads) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_busy_ += num_threads;
+}
+
+bool VirtualClock::idleUntil(Wait* wait) {
+    const int64_t deadline_ns = wait->deadline.nanoSecondsSince1970();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait->state == Wait::WAITING) {
+        // Already reached: the thread stays busy.
+        if (deadline_ns <= now_ns_) {
+            wait->state = Wait::TIMED_OUT;
+            return false;
+        }
+
+        deadlines_.emplace(deadline_ns, wait);
+        --num_busy_;
+        advanceIfIdle();
+        // wake() or wakeUntil() count us busy again.
+        advanced_.wait(lock, [wait] { return wait->state != Wait::WAITING; });
+    }
+    return wait->state == Wait::NOTIFIED;
+}
+
+void VirtualClock::wake(Wait* wait) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (wait->state != Wait::WAITING) { return; }
+    wait->state = Wait::NOTIFIED;
+
+    auto range = deadlines_.equal_range(wait->deadline.nanoSecondsSince1970());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == wait) {
+            deadlines_.erase(it);
+            ++num_busy_;
+            advanced_.notify_all();
+            return;
+        }
+    }
+    // Not blocked yet: idleUntil() returns at once, and the thread stays busy.
+}
+
+void VirtualClock::advanceTo(Timestamp time) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeUntil(time.nanoSecondsSince1970());
+}
+
+int VirtualClock::numBusyThreads() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_busy_;
+}
+
+int VirtualClock::numSleepingThreads() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return int(deadlines_.size());
+}
+
+void VirtualClock::advanceIfIdle() {
+    assert(num_busy_ >= 0);
+    if (num_busy_ <= 0 && !deadlines_.empty()) { wakeUntil(deadlines_.begin()->first); }
+}
+
+void VirtualClock::wakeUntil(int64_t time_ns) {
+    if (time_ns > now_ns_) { now_ns_.store(time_ns, std::memory_order_release); }
+    while (!deadlines_.empty() && deadlines_.begin()->first <= now_ns_) {
+        if (Wait* wait = deadlines_.begin()->second) { wait->state = Wait::TIMED_OUT; }
+        deadlines_.erase(deadlines_.begin());
+        ++num_busy_;
+    }
+    advanced_.notify_all();
+}
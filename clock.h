@@ -0,0 +1,321 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef BASE_CLOCK_H
+#define BASE_CLOCK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <map>
+#include <vector>
+
+#include "timestamp.h"
+
+/*! A source of time for the threads of a graph. \see Graph::setClock
+ *
+ *  Threads without a clock, the default, use the system time. A thread
+ *  running on a clock gets its time from Timestamp::now(), and waits with
+ *  Duration::sleep(), which both follow the clock.
+ *
+ *  Threads running on a clock report when they block waiting for other
+ *  threads (idle) and when they resume (busy). A VirtualClock uses this to
+ *  jump to the next deadline as soon as all its threads are blocked.
+ */
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    virtual Timestamp now() const = 0;
+
+    //! Blocks the calling thread until now() reaches <deadline>.
+    virtual void sleepUntil(Timestamp deadline) = 0;
+
+    //! Like sleepUntil(), releasing <lock> while sleeping.
+    void sleepUntil(Timestamp deadline, std::unique_lock<std::mutex>* lock) {
+        lock->unlock();
+        sleepUntil(deadline);
+        lock->lock();
+    }
+
+    //! A thread starts running on this clock. It counts as busy.
+    virtual void addThread() {}
+    //! A busy thread stops running on this clock.
+    virtual void removeThread() {}
+
+    //! The calling thread blocks until another thread wakes it.
+    virtual void idle() {}
+    //! <num_threads> idle threads are woken up.
+    virtual void busy(int /*num_threads*/ = 1) {}
+
+    //! A thread blocked in idleUntil(). Its state is protected by the clock.
+    struct Wait {
+        enum State { WAITING, NOTIFIED, TIMED_OUT };
+
+        explicit Wait(Timestamp deadline) : deadline(deadline), state(WAITING) {}
+
+        const Timestamp deadline;
+        State state;
+    };
+
+    /*! Blocks the calling thread, idle, until now() reaches <wait>'s deadline
+     *  or another thread calls wake(<wait>). The thread is busy again when
+     *  it returns. Returns false on timeout.
+     */
+    virtual bool idleUntil(Wait* wait) = 0;
+
+    /*! Counts the thread blocked in idleUntil(<wait>) busy, and wakes it. If
+     *  the thread did not block yet, idleUntil() returns at once. Does
+     *  nothing if <wait> already timed out.
+     */
+    virtual void wake(Wait* wait) = 0;
+
+    //! The clock of the calling thread, or null for the system time.
+    static Clock* current();
+
+    //! Sets the clock of the calling thread. Returns the previous one.
+    static Clock* setCurrent(Clock* clock);
+
+    /*! Adds to <*nanoseconds> the system time the calling thread spends
+     *  blocked, as measured by IdleTimer. Null stops measuring.
+     */
+    static void setIdleMeter(std::atomic<int64_t>* nanoseconds);
+    static std::atomic<int64_t>* idleMeter();
+};
+
+/*! Measures the system time spent in its scope, for the idle meter of the
+ *  calling thread. Does nothing if the thread has no meter.
+ *  \see Clock::setIdleMeter
+ */
+class IdleTimer {
+public:
+    IdleTimer() : meter_(Clock::idleMeter()) {
+        if (meter_) { begin_ = Timestamp::systemNow(); }
+    }
+    ~IdleTimer() {
+        if (meter_) { *meter_ += (Timestamp::systemNow() - begin_).nanoSeconds(); }
+    }
+
+private:
+    IdleTimer(const IdleTimer&) = delete;
+    IdleTimer& operator=(const IdleTimer&) = delete;
+
+    std::atomic<int64_t>* meter_;
+    Timestamp begin_;
+};
+
+/*! Runs the calling thread on <clock> for the lifetime of the scope. A null
+ *  clock means the system time.
+ */
+class ClockScope {
+public:
+    explicit ClockScope(Clock* clock) : clock_(clock), previous_(Clock::setCurrent(clock)) {
+        if (clock_) { clock_->addThread(); }
+    }
+    ~ClockScope() {
+        if (clock_) { clock_->removeThread(); }
+        Clock::setCurrent(previous_);
+    }
+
+private:
+    ClockScope(const ClockScope&) = delete;
+    ClockScope& operator=(const ClockScope&) = delete;
+
+    Clock* clock_;
+    Clock* previous_;
+};
+
+/*! Simulated time, for offline processing.
+ *
+ *  Time only moves when all the threads running on the clock are blocked:
+ *  it then jumps to the earliest deadline of the sleeping threads. Graphs
+ *  processing recorded data thus run as fast as they can, and their
+ *  results do not depend on the speed of the machine.
+ *
+ *  Threads blocked elsewhere than in Duration::sleep(), Clock::sleepUntil()
+ *  or a ClockCondition count as busy: time does not move while they wait.
+ */
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(Timestamp start = Timestamp());
+
+    virtual Timestamp now() const override {
+        return Timestamp::nanoSecondsSince1970(now_ns_.load(std::memory_order_acquire));
+    }
+    virtual void sleepUntil(Timestamp deadline) override;
+    using Clock::sleepUntil;
+
+    virtual void addThread() override;
+    virtual void removeThread() override;
+    virtual void idle() override;
+    virtual void busy(int num_threads = 1) override;
+    virtual bool idleUntil(Wait* wait) override;
+    virtual void wake(Wait* wait) override;
+
+    //! Moves time forward to <time>, waking the threads sleeping until then.
+    //! Lets a thread outside of the clock drive it. Never moves backwards.
+    void advanceTo(Timestamp time);
+
+    //! Threads running on the clock, and not blocked.
+    int numBusyThreads() const;
+
+    //! Threads sleeping until a deadline.
+    int numSleepingThreads() const;
+
+private:
+    // Moves time to the earliest deadline if no thread is busy.
+    void advanceIfIdle();
+    // Wakes the threads sleeping until <time_ns> or before. mutex_ is held.
+    void wakeUntil(int64_t time_ns);
+
+    mutable std::mutex mutex_;
+    // Notified when time moves, and when a Wait is woken.
+    std::condition_variable advanced_;
+    std::atomic<int64_t> now_ns_;
+    // Deadlines of the sleeping threads: a Wait, or null for sleepUntil().
+    std::multimap<int64_t, Wait*> deadlines_;
+    int num_busy_;
+};
+
+/*! A condition variable that reports waiting threads to their clock as
+ *  idle, so that a VirtualClock knows when all the threads are blocked.
+ *  Without a clock, it behaves as a std::condition_variable.
+ *
+ *  The mutex must be held while notifying. Notifying marks the waiting
+ *  threads as busy at once, before they actually wake up: otherwise, the
+ *  clock could see all the threads blocked in between, and move time while
+ *  there is work to do. Threads waiting for a deadline block in the clock,
+ *  which wakes them either on notification or on the deadline.
+ */
+class ClockCondition {
+public:
+    ClockCondition() : clock_(nullptr), num_waiting_(0), epoch_(0) {}
+
+    void wait(std::unique_lock<std::mutex>& lock) {
+        IdleTimer idle;
+        Clock* clock = Clock::current();
+        if (!clock) {
+            condition_.wait(lock);
+            return;
+        }
+        clock_ = clock;
+        const uint64_t epoch = epoch_;
+        ++num_waiting_;
+        clock->idle();
+        condition_.wait(lock);
+        if (epoch == epoch_) {
+            // Woken spuriously: nobody counted us busy.
+            --num_waiting_;
+            clock->busy();
+        }
+    }
+
+    template <typename Predicate> void wait(std::unique_lock<std::mutex>& lock, Predicate ready) {
+        while (!ready()) { wait(lock); }
+    }
+
+    //! Waits for up to <duration> of system time. The thread stays busy.
+    template <typename Rep, typename Period>
+    void waitFor(std::unique_lock<std::mutex>& lock,
+                 const std::chrono::duration<Rep, Period>& duration) {
+        IdleTimer idle;
+        condition_.wait_for(lock, duration);
+    }
+
+    template <typename Rep, typename Period, typename Predicate>
+    bool waitFor(std::unique_lock<std::mutex>& lock,
+                 const std::chrono::duration<Rep, Period>& duration, Predicate ready) {
+        IdleTimer idle;
+        return condition_.wait_for(lock, duration, ready);
+    }
+
+    /*! Waits until notified, or until Timestamp::now() reaches <deadline>.
+     *  Returns false on timeout. Unlike waitFor(), the thread is idle: a
+     *  VirtualClock can jump to <deadline> if nothing else happens.
+     */
+    bool waitUntil(std::unique_lock<std::mutex>& lock, Timestamp deadline) {
+        IdleTimer idle;
+        Clock* clock = Clock::current();
+        if (!clock) {
+            const Duration remaining = deadline - Timestamp::systemNow();
+            if (!(Duration() < remaining)) { return false; }
+            return condition_.wait_for(lock, std::chrono::nanoseconds(remaining.nanoSeconds())) ==
+                   std::cv_status::no_timeout;
+        }
+        if (!(clock->now() < deadline)) { return false; }
+
+        // Registered while locked, so that notifyAll() finds it even if it
+        // runs before idleUntil() blocks.
+        clock_ = clock;
+        Clock::Wait wait(deadline);
+        timed_waits_.push_back(&wait);
+        lock.unlock();
+        const bool notified = clock->idleUntil(&wait);
+        lock.lock();
+
+        // On timeout, nobody removed us.
+        for (auto it = timed_waits_.begin(); it != timed_waits_.end(); ++it) {
+            if (*it == &wait) {
+                timed_waits_.erase(it);
+                break;
+            }
+        }
+        return notified;
+    }
+
+    void notifyAll() {
+        if (num_waiting_ > 0) {
+            clock_->busy(num_waiting_);
+            num_waiting_ = 0;
+            ++epoch_;
+        }
+        for (Clock::Wait* wait : timed_waits_) { clock_->wake(wait); }
+        timed_waits_.clear();
+        condition_.notify_all();
+    }
+
+    //! Wakes all the threads waiting on a clock: they have all been counted
+    //! busy, and will go back to waiting if there is nothing for them.
+    void notifyOne() {
+        if (num_waiting_ > 0 || !timed_waits_.empty()) {
+            notifyAll();
+        } else {
+            condition_.notify_one();
+        }
+    }
+
+private:
+    std::condition_variable condition_;
+    Clock* clock_;
+    int num_waiting_;
+    uint64_t epoch_;
+    // Threads blocked in the clock by waitUntil().
+    std::vector<Clock::Wait*> timed_waits_;
+};
+
+#endif  // BASE_CLOCK_H
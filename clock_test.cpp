@@ -0,0 +1,304 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <vector>
+
+#include "clock.h"
+#include "thread_primitives.h"
+#include "timestamp.h"
+
+namespace {
+
+Timestamp hours(int h) { return Timestamp::microSecondsSince1970(int64_t(h) * 3600 * 1000000); }
+
+struct Sleeper {
+    VirtualClock* clock;
+    Timestamp deadline;
+    std::mutex* mutex;
+    std::vector<Timestamp>* woken;
+};
+
+// Runs on the clock, as a node thread does. The caller already counted it.
+void sleepOnClock(void* ptr) {
+    Sleeper* sleeper = static_cast<Sleeper*>(ptr);
+    Clock::setCurrent(sleeper->clock);
+    (sleeper->deadline - Timestamp::now()).sleep();
+    {
+        std::lock_guard<std::mutex> lock(*sleeper->mutex);
+        sleeper->woken->push_back(Timestamp::now());
+    }
+    sleeper->clock->removeThread();
+    Clock::setCurrent(nullptr);
+}
+
+}  // namespace
+
+TEST(ClockTest, SystemTimeWithoutClock) {
+    EXPECT_EQ(nullptr, Clock::current());
+    Duration difference = Timestamp::now() - Timestamp::systemNow();
+    EXPECT_NEAR(0.0, difference.seconds(), 1e-3);
+}
+
+TEST(ClockTest, ScopeSetsTheThreadClock) {
+    VirtualClock clock(hours(1));
+    {
+        ClockScope scope(&clock);
+        EXPECT_EQ(&clock, Clock::current());
+        EXPECT_EQ(hours(1), Timestamp::now());
+        EXPECT_EQ(1, clock.numBusyThreads());
+    }
+    EXPECT_EQ(nullptr, Clock::current());
+    EXPECT_EQ(0, clock.numBusyThreads());
+}
+
+TEST(ClockTest, SleepingAloneJumpsToTheDeadline) {
+    VirtualClock clock;
+    Timestamp start = Timestamp::systemNow();
+    {
+        ClockScope scope(&clock);
+        Duration::seconds(3600).sleep();
+        EXPECT_EQ(hours(1), Timestamp::now());
+    }
+    EXPECT_LT((Timestamp::systemNow() - start).seconds(), 1.0);
+}
+
+TEST(ClockTest, WakesSleepersInDeadlineOrder) {
+    VirtualClock clock;
+    std::mutex mutex;
+    std::vector<Timestamp> woken;
+    Sleeper late = {&clock, hours(2), &mutex, &woken};
+    Sleeper early = {&clock, hours(1), &mutex, &woken};
+
+    // Time does not move before both threads sleep.
+    clock.addThread();
+    clock.addThread();
+    Thread late_thread;
+    Thread early_thread;
+    ASSERT_TRUE(late_thread.start(sleepOnClock, &late));
+    ASSERT_TRUE(early_thread.start(sleepOnClock, &early));
+    late_thread.waitForTermination();
+    early_thread.waitForTermination();
+
+    ASSERT_EQ(2u, woken.size());
+    EXPECT_EQ(hours(1), woken[0]);
+    EXPECT_EQ(hours(2), woken[1]);
+    EXPECT_EQ(0, clock.numBusyThreads());
+}
+
+TEST(ClockTest, AdvanceToDrivesTime) {
+    VirtualClock clock;
+    std::mutex mutex;
+    std::vector<Timestamp> woken;
+    Sleeper sleeper = {&clock, hours(2), &mutex, &woken};
+
+    // The test thread counts as busy: time only moves with advanceTo().
+    clock.addThread();
+    clock.addThread();
+    Thread thread;
+    ASSERT_TRUE(thread.start(sleepOnClock, &sleeper));
+    while (clock.numSleepingThreads() == 0) { Duration::milliSeconds(1).sleep(); }
+
+    clock.advanceTo(hours(1));
+    EXPECT_EQ(hours(1), clock.now());
+    EXPECT_EQ(1, clock.numSleepingThreads());
+
+    clock.advanceTo(hours(3));
+    thread.waitForTermination();
+    ASSERT_EQ(1u, woken.size());
+    EXPECT_EQ(hours(3), woken[0]);
+
+    // Never goes back.
+    clock.advanceTo(hours(1));
+    EXPECT_EQ(hours(3), clock.now());
+    clock.removeThread();
+}
+
+TEST(ClockTest, ConditionWaitsAreIdle) {
+    VirtualClock clock;
+    std::mutex mutex;
+    ClockCondition condition;
+    bool ready = false;
+
+    struct Waiter {
+        VirtualClock* clock;
+        std::mutex* mutex;
+        ClockCondition* condition;
+        bool* ready;
+    } waiter = {&clock, &mutex, &condition, &ready};
+
+    clock.addThread();
+    Thread thread;
+    ASSERT_TRUE(thread.start(
+            [](void* ptr) {
+                Waiter* waiter = static_cast<Waiter*>(ptr);
+                Clock::setCurrent(waiter->clock);
+                {
+                    std::unique_lock<std::mutex> lock(*waiter->mutex);
+                    waiter->condition->wait(lock, [waiter] { return *waiter->ready; });
+                }
+                waiter->clock->removeThread();
+                Clock::setCurrent(nullptr);
+            },
+            &waiter));
+    while (clock.numBusyThreads() > 0) { Duration::milliSeconds(1).sleep(); }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready = true;
+        condition.notifyOne();
+        // Counted busy before it actually wakes up.
+        EXPECT_EQ(1, clock.numBusyThreads());
+    }
+    thread.waitForTermination();
+    EXPECT_EQ(0, clock.numBusyThreads());
+}
+
+TEST(ClockTest, TimedConditionWaitJumpsToTheDeadline) {
+    VirtualClock clock(Timestamp::microSecondsSince1970(1000));
+    ClockScope scope(&clock);
+    std::mutex mutex;
+    ClockCondition condition;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    const Timestamp deadline = Timestamp::now() + Duration::seconds(10);
+    EXPECT_FALSE(condition.waitUntil(lock, deadline));
+    EXPECT_EQ(deadline, Timestamp::now());
+    EXPECT_EQ(1, clock.numBusyThreads());
+    EXPECT_EQ(0, clock.numSleepingThreads());
+}
+
+TEST(ClockTest, TimedConditionWaitWakesOnNotify) {
+    VirtualClock clock(Timestamp::microSecondsSince1970(1000));
+    std::mutex mutex;
+    ClockCondition condition;
+    bool notified = false;
+
+    struct Waiter {
+        VirtualClock* clock;
+        std::mutex* mutex;
+        ClockCondition* condition;
+        bool* notified;
+    } waiter = {&clock, &mutex, &condition, &notified};
+
+    // This thread counts as busy: time can not jump to the deadline.
+    clock.addThread();
+    clock.addThread();
+    Thread thread;
+    ASSERT_TRUE(thread.start(
+            [](void* ptr) {
+                Waiter* waiter = static_cast<Waiter*>(ptr);
+                Clock::setCurrent(waiter->clock);
+                {
+                    std::unique_lock<std::mutex> lock(*waiter->mutex);
+                    *waiter->notified = waiter->condition->waitUntil(
+                            lock, Timestamp::now() + Duration::seconds(10));
+                }
+                waiter->clock->removeThread();
+                Clock::setCurrent(nullptr);
+            },
+            &waiter));
+    while (clock.numBusyThreads() > 1) { Duration::milliSeconds(1).sleep(); }
+    EXPECT_EQ(1, clock.numSleepingThreads());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notifyOne();
+    }
+    thread.waitForTermination();
+    EXPECT_TRUE(notified);
+    EXPECT_EQ(Timestamp::microSecondsSince1970(1000), clock.now());
+    EXPECT_EQ(1, clock.numBusyThreads());
+    EXPECT_EQ(0, clock.numSleepingThreads());
+    clock.removeThread();
+}
+
+TEST(ClockTest, TimedConditionWaitWakesWhenTimeMoves) {
+    VirtualClock clock(Timestamp::microSecondsSince1970(1000));
+    std::mutex mutex;
+    ClockCondition condition;
+    bool notified = true;
+
+    struct Waiter {
+        VirtualClock* clock;
+        std::mutex* mutex;
+        ClockCondition* condition;
+        bool* notified;
+    } waiter = {&clock, &mutex, &condition, &notified};
+
+    // Only advanceTo() moves time, from this thread.
+    clock.addThread();
+    clock.addThread();
+    Thread thread;
+    ASSERT_TRUE(thread.start(
+            [](void* ptr) {
+                Waiter* waiter = static_cast<Waiter*>(ptr);
+                Clock::setCurrent(waiter->clock);
+                {
+                    std::unique_lock<std::mutex> lock(*waiter->mutex);
+                    *waiter->notified = waiter->condition->waitUntil(
+                            lock, Timestamp::now() + Duration::seconds(10));
+                }
+                waiter->clock->removeThread();
+                Clock::setCurrent(nullptr);
+            },
+            &waiter));
+    while (clock.numSleepingThreads() < 1) { Duration::milliSeconds(1).sleep(); }
+
+    // Not reached yet: the waiter stays blocked.
+    clock.advanceTo(Timestamp::microSecondsSince1970(1000) + Duration::seconds(5));
+    EXPECT_EQ(1, clock.numSleepingThreads());
+    EXPECT_EQ(1, clock.numBusyThreads());
+
+    clock.advanceTo(Timestamp::microSecondsSince1970(1000) + Duration::seconds(10));
+    thread.waitForTermination();
+    EXPECT_FALSE(notified);
+    EXPECT_EQ(0, clock.numSleepingThreads());
+    EXPECT_EQ(1, clock.numBusyThreads());
+
+    // Nobody waits anymore: notifying does not touch the clock.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notifyAll();
+    }
+    EXPECT_EQ(1, clock.numBusyThreads());
+    clock.removeThread();
+}
+
+TEST(ClockTest, IdleMeterMeasuresBlockedTime) {
+    std::atomic<int64_t> idle(0);
+    Clock::setIdleMeter(&idle);
+    Duration::milliSeconds(5).sleep();
+    Clock::setIdleMeter(nullptr);
+    const int64_t measured = idle;
+    EXPECT_LE(Duration::milliSeconds(5).nanoSeconds(), measured);
+
+    Duration::milliSeconds(1).sleep();
+    EXPECT_EQ(measured, idle.load());
+}
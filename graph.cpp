@@ -26,17 +26,39 @@
 //
 #include "graph.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <string>
+#include <utility>
 
+#include "sdf_node.h"
+#include "sdf_scheduler.h"
 #include "stream.h"
 #include "stream_reader.h"
 
 using std::string;
 
 namespace media_graph {
-Graph::Graph() : started_(false), stopping_(false) {
-    addGetProperty("started", this, &Graph::isStarted);
+Graph::Graph()
+    : memory_budget_(std::make_shared<MemoryBudget>()),
+      batch_mode_(false),
+      started_(false),
+      stopping_(false) {
+    setPropertyTable(&properties(), this);
+}
+
+Graph::~Graph() { clear(); }
+
+const PropertyTable<Graph>& Graph::properties() {
+    static const PropertyTable<Graph> table = []() {
+        PropertyTable<Graph> t;
+        t.addGet("started", &Graph::isStarted);
+        t.addGetSet("MemoryBudget", &Graph::memoryBudgetLimit, &Graph::setMemoryBudgetLimit);
+        t.addGet("BytesHeld", &Graph::bytesHeld);
+        t.addGetSet("BatchMode", &Graph::batchMode, &Graph::setBatchMode);
+        return t;
+    }();
+    return table;
 }
 
 bool Graph::addNode(const std::string& name, std::shared_ptr<NodeBase> node) {
@@ -47,7 +69,16 @@ bool Graph::addNode(const std::string& name, std::shared_ptr<NodeBase> node) {
         return false;
     }
 
-    nodes_[name] = node;
+    int id = int(node_ids_.size());
+    if (free_node_ids_.empty()) {
+        node_ids_.push_back(node);
+    } else {
+        id = free_node_ids_.back();
+        free_node_ids_.pop_back();
+        node_ids_[id] = node;
+    }
+    node_id_by_name_[name] = id;
+    nodes_.push_back(node);
     node->setNameAndGraph(name, this);
     return true;
 }
@@ -55,10 +86,14 @@ bool Graph::addNode(const std::string& name, std::shared_ptr<NodeBase> node) {
 void Graph::removeNode(const std::string& name) {
     std::unique_lock<std::mutex> lock(mutex_);
 
-    auto it = nodes_.find(name);
-    if (it != nodes_.end()) {
-        auto node = it->second;
-        nodes_.erase(it);
+    auto it = node_id_by_name_.find(name);
+    if (it != node_id_by_name_.end()) {
+        const int id = it->second;
+        auto node = node_ids_[id];
+        node_id_by_name_.erase(it);
+        node_ids_[id].reset();
+        free_node_ids_.push_back(id);
+        nodes_.erase(std::find(nodes_.begin(), nodes_.end(), node));
 
         node->disconnectAllPins();
         node->disconnectAllStreams();
@@ -74,8 +109,8 @@ std::shared_ptr<NodeBase> Graph::getNodeByName(const std::string& name) {
 }
 
 std::shared_ptr<NodeBase> Graph::lockedGetNodeByName(const std::string& name) {
-    auto it = nodes_.find(name);
-    if (it != nodes_.end()) { return it->second; }
+    auto it = node_id_by_name_.find(name);
+    if (it != node_id_by_name_.end()) { return node_ids_[it->second]; }
     return std::shared_ptr<NodeBase>();
 }
 
@@ -83,26 +118,103 @@ bool Graph::start() {
     if (isStarted()) { return true; }
 
     std::lock_guard<std::mutex> lock(mutex_);
+    start_time_ = Timestamp::systemNow();
+
+    // Keeps a virtual clock still until all the nodes are started.
+    if (clock_) { clock_->addThread(); }
     for (auto it = nodes_.begin(); it != nodes_.end(); ++it) {
-        if (!it->second->start()) {
+        if (!(*it)->start()) {
+            if (clock_) { clock_->removeThread(); }
             // TODO: give a meaningful error.
             lockedStop();  // stop potentially started nodes.
             return false;
         }
     }
+    bool scheduled = SdfScheduler::build(nodes_, &sdf_schedulers_);
+    for (auto& scheduler : sdf_schedulers_) {
+        scheduled = scheduled && scheduler->start(clock_.get());
+    }
+    if (!scheduled) {
+        if (clock_) { clock_->removeThread(); }
+        lockedStop();
+        return false;
+    }
+    if (clock_) { clock_->removeThread(); }
     started_ = true;
     return true;
 }
 
+bool Graph::setClock(std::shared_ptr<Clock> clock) {
+    if (isStarted()) { return false; }
+    clock_ = std::move(clock);
+    return true;
+}
+
+bool Graph::setBatchMode(const bool& batch) {
+    if (isStarted()) { return false; }
+    batch_mode_ = batch;
+    return true;
+}
+
+BatchReport Graph::batchReport() const {
+    BatchReport report;
+    Timestamp end = start_time_;
+    for (auto& node : nodes()) {
+        if (node->numInputPin() == 0) {
+            for (int i = 0; i < node->numOutputStream(); ++i) {
+                report.num_frames += node->outputStream(i)->numUpdates();
+            }
+        }
+        if (auto threaded = dynamic_cast<const ThreadedNodeBase*>(node.get())) {
+            if (end < threaded->threadEndTime()) { end = threaded->threadEndTime(); }
+        }
+    }
+    if (isStarted()) { end = Timestamp::systemNow(); }
+    report.duration = end - start_time_;
+
+    const double seconds = report.duration.seconds();
+    if (seconds > 0) { report.frames_per_second = report.num_frames / seconds; }
+    for (auto& node : nodes()) {
+        if (auto threaded = dynamic_cast<const ThreadedNodeBase*>(node.get())) {
+            BatchReport::NodeLoad load;
+            load.name = node->name();
+            load.busy = threaded->threadBusyTime();
+            load.utilization = seconds > 0 ? load.busy.seconds() / seconds : 0;
+            report.nodes.push_back(load);
+        }
+    }
+    return report;
+}
+
+std::string BatchReport::toString() const {
+    std::ostringstream out;
+    out << num_frames << " frames in " << duration.seconds() << " s: " << frames_per_second
+        << " frames/s\n";
+    for (const NodeLoad& node : nodes) {
+        out << "  " << node.name << ": " << node.utilization * 100 << "% busy\n";
+    }
+    return out.str();
+}
+
 bool Graph::isStarted() const {
-    for (auto it : nodes_) {
-        if (it.second->isRunning()) { return true; }
+    for (auto& node : nodes()) {
+        if (node->isRunning()) { return true; }
     }
     return false;
 }
 
 void Graph::waitUntilStopped() const {
-    for (auto it : nodes_) { it.second->waitUntilStopped(); }
+    for (auto& node : nodes()) { node->waitUntilStopped(); }
+}
+
+void Graph::drain() {
+    for (auto& node : nodes()) {
+        if (dynamic_cast<ThreadedNodeBase*>(node.get()) ||
+            dynamic_cast<SdfNodeBase*>(node.get())) {
+            node->waitUntilStopped();
+        }
+    }
+    stop();
 }
 
 void Graph::stop() {
@@ -116,15 +228,24 @@ void Graph::stop() {
 }
 
 void Graph::lockedStop() {
-    for (auto it : nodes_) { it.second->closeConnectedPins(); }
-    for (auto it : nodes_) { it.second->stop(); }
+    for (auto& node : nodes_) { node->closeConnectedPins(); }
+    for (auto& node : nodes_) { node->stop(); }
+
+    for (auto& scheduler : sdf_schedulers_) {
+        stopped_sdf_schedulers_.push_back(std::move(scheduler));
+    }
+    sdf_schedulers_.clear();
+    auto others = std::partition(
+            stopped_sdf_schedulers_.begin(), stopped_sdf_schedulers_.end(),
+            [](const std::unique_ptr<SdfScheduler>& s) { return s->isSchedulingThread(); });
+    stopped_sdf_schedulers_.erase(others, stopped_sdf_schedulers_.end());
     started_ = false;
 }
 
 void Graph::clear() {
     stop();
 
-    while (nodes_.size()) { removeNode(nodes_.begin()->first); }
+    while (nodes_.size()) { removeNode(nodes_.back()->name()); }
 }
 
 bool Graph::connect(NamedStream* stream, NamedPin* pin) {
@@ -150,13 +271,26 @@ bool Graph::connect(const std::string& source_name, const std::string& streamNam
     return connect(getNodeByName(source_name), streamName, getNodeByName(dest_name), pinName);
 }
 
-std::shared_ptr<NodeBase> Graph::node(int num) const {
-    auto it = nodes_.begin();
-    for (int i = 0; i < num; ++i) {
-        if (it == nodes_.end()) { return nullptr; }
-        ++it;
-    }
-    return it->second;
+std::shared_ptr<NodeBase> Graph::node(int id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (unsigned(id) >= node_ids_.size()) { return nullptr; }
+    return node_ids_[id];
+}
+
+std::vector<std::shared_ptr<NodeBase>> Graph::nodes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return nodes_;
+}
+
+int Graph::nodeId(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = node_id_by_name_.find(name);
+    return it == node_id_by_name_.end() ? -1 : it->second;
+}
+
+int Graph::numNodeIds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return int(node_ids_.size());
 }
 
 }  // namespace media_graph
@@ -28,16 +28,45 @@
 #ifndef MEDIAGRAPH_GRAPH_H
 #define MEDIAGRAPH_GRAPH_H
 
+#include "clock.h"
+#include "memory_budget.h"
 #include "node.h"
 #include "property.h"
 #include "thread_primitives.h"
 
-#include <map>
+#include <atomic>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace media_graph {
+
+class SdfScheduler;
+
+/*! Throughput of a graph run in batch mode. \see Graph::setBatchMode
+ */
+struct BatchReport {
+    struct NodeLoad {
+        std::string name;
+        //! Time the node thread spent working, rather than blocked or sleeping.
+        Duration busy;
+        //! busy, relative to the duration of the run. Between 0 and 1.
+        double utilization;
+    };
+
+    //! System time from Graph::start() to the end of the last thread.
+    Duration duration;
+    //! Entries written by the source nodes: the nodes without input pins.
+    int64_t num_frames = 0;
+    double frames_per_second = 0;
+    //! One entry per threaded node, in node order.
+    std::vector<NodeLoad> nodes;
+
+    std::string toString() const;
+};
+
 /*! Represent a graph of media producers, filters, and consumers.
  *
  *  In the graph, nodes can produce and consume data. A timestamp is associated
@@ -68,7 +97,7 @@ namespace media_graph {
 class Graph : public PropertyList {
 public:
     Graph();
-    ~Graph() { clear(); }
+    ~Graph();
 
     /// Construct a new node, add it to the graph, and returns a shared_ptr.
     template <typename T, typename... Args>
@@ -112,6 +141,11 @@ public:
     /*! Start the graph: calls start() on every node.
      *  Returns true if all nodes started properly. If a node refuses to start,
      *  all already started nodes are stopped and start() returns false.
+     *
+     *  SdfNodeBase nodes connected by SDF streams are then scheduled together,
+     *  in a single thread per subgraph. start() also fails if the rates of
+     *  such a subgraph are inconsistent, or if it has a cycle.
+     *  \see SdfScheduler
      */
     bool start();
 
@@ -125,14 +159,86 @@ public:
     //  nodes are already stopped.
     void waitUntilStopped() const;
 
+    /*! Waits for every threaded node and SDF subgraph to finish its data,
+     *  then stops the graph. Sources end by returning from threadMain(), and
+     *  the end of stream propagates downstream once readers consumed all the
+     *  entries, so that no trailing data is lost. Only meant for graphs fed
+     *  by finite sources: drain() blocks as long as a threaded node keeps
+     *  running. Nodes without a thread are not waited for: entries still
+     *  queued for their pins when stop() runs are dropped.
+     */
+    void drain();
+
     /*! Remove and delete all nodes in the graph. Stops the graph first if
      *  necessary.
      */
     void clear();
 
-    int numNodes() const { return nodes_.size(); }
+    int numNodes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return nodes_.size();
+    }
+
+    /*! Returns a copy of the node list, in node order. Unlike iterating with
+     *  node(), it stays valid while other threads add or remove nodes.
+     */
+    std::vector<std::shared_ptr<NodeBase>> nodes() const;
+
+    /*! Returns the node with the id <id>, or null if out of range or
+     *  removed. A node keeps its id until it is removed: ids of removed
+     *  nodes are given to the nodes added next.
+     */
+    std::shared_ptr<NodeBase> node(int id) const;
+
+    //! Returns the id of the node called <name>, or -1.
+    int nodeId(const std::string& name) const;
 
-    std::shared_ptr<NodeBase> node(int num) const;
+    //! Node ids are below numNodeIds(). Some might be free, \see node().
+    int numNodeIds() const;
+
+    /*! Limits the bytes held by all the stream queues of the graph. 0, the
+     *  default, means unlimited. When writing an entry would exceed the
+     *  budget, streams block or drop according to <policy>. Streams bind to
+     *  the budget when opened: changes apply to running graphs.
+     *  \see PayloadSize, Stream::setMaxQueueBytes
+     */
+    void setMemoryBudget(int64_t bytes, MemoryBudgetPolicy policy = BUDGET_BLOCK_PRODUCERS) {
+        memory_budget_->setLimit(bytes);
+        memory_budget_->setPolicy(policy);
+    }
+    const std::shared_ptr<MemoryBudget>& memoryBudget() const { return memory_budget_; }
+
+    int64_t memoryBudgetLimit() const { return memory_budget_->limit(); }
+    bool setMemoryBudgetLimit(const int64_t& bytes) {
+        memory_budget_->setLimit(bytes);
+        return true;
+    }
+    int64_t bytesHeld() const { return memory_budget_->bytesHeld(); }
+
+    /*! Sets the clock the node threads get their time from, and sleep on.
+     *  Null, the default, means the system time. Only possible while the
+     *  graph is stopped. \see VirtualClock
+     */
+    bool setClock(std::shared_ptr<Clock> clock);
+    Clock* clock() const { return clock_.get(); }
+
+    /*! Batch mode, for offline reprocessing. Streams open lossless: they
+     *  block their producer instead of dropping, whatever their
+     *  StreamDropPolicy. Sources skip their pacing, \see NodeBase::shouldPace,
+     *  and the graph runs as fast as its slowest node. Typically followed by
+     *  drain() and batchReport(). Only possible while the graph is stopped.
+     *
+     *  PolicyStream and LatestValueStream drop by construction, and are not
+     *  affected.
+     */
+    bool setBatchMode(const bool& batch);
+    bool batchMode() const { return batch_mode_; }
+
+    //! Throughput and node loads since the last start().
+    BatchReport batchReport() const;
+
+    //! The properties shared by all the Graph instances.
+    static const PropertyTable<Graph>& properties();
 
 private:
     // Stop the graph, assumes mutex_ is already aquired.
@@ -141,15 +247,34 @@ private:
 
     Graph(const Graph&) = delete;  // copy constructor is forbidden.
 
-    std::map<std::string, std::shared_ptr<NodeBase>> nodes_;
+    // Nodes in insertion order.
+    std::vector<std::shared_ptr<NodeBase>> nodes_;
+
+    // Nodes by id, null for free ids, and their id by name.
+    std::vector<std::shared_ptr<NodeBase>> node_ids_;
+    std::vector<int> free_node_ids_;
+    std::unordered_map<std::string, int> node_id_by_name_;
+
+    // One per SDF subgraph, while the graph is started.
+    std::vector<std::unique_ptr<SdfScheduler>> sdf_schedulers_;
+    // Stopped from their own thread, by a firing node: they can not wait
+    // for it, and are destroyed by the next stop from another thread.
+    std::vector<std::unique_ptr<SdfScheduler>> stopped_sdf_schedulers_;
+
+    // Shared with streams, that might outlive the graph.
+    std::shared_ptr<MemoryBudget> memory_budget_;
+
+    std::shared_ptr<Clock> clock_;
+    std::atomic<bool> batch_mode_;
+    Timestamp start_time_;
 
     // Protects nodes_ against node addition and removal from multiple threads.
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
 
-    bool started_;
+    std::atomic<bool> started_;
 
     // Flag used to avoid deadlocks when calling stop()
-    bool stopping_;
+    std::atomic<bool> stopping_;
 };
 
 template <typename T, typename... Args>
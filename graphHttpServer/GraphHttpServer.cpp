@@ -26,6 +26,7 @@
 //
 #include "GraphHttpServer.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <iomanip>
 #include <sstream>
@@ -33,9 +34,12 @@
 
 //#include <base/string.h>
 #include <civetweb.h>
+#include "../GraphSnapshot.h"
+#include "../PropertyRecorder.h"
 #include "../graph.h"
 #include "../stream.h"
 #include "../stream_reader.h"
+#include "../types/number_format.h"
 
 namespace media_graph {
 namespace {
@@ -66,46 +70,153 @@ namespace {
 
     class ToJsonValue : public TypeConstVisitor {
     public:
-        virtual bool process(const int& value) {
-            result_ = std::to_string(value);
+        virtual bool process(const int& value) { return appendNumber(value); }
+        virtual bool process(const int64_t& value) { return appendNumber(value); }
+        virtual bool process(const bool& value) {
+            result_ += (value ? "true" : "false");
             return true;
         }
-        virtual bool process(const int64_t& value) {
-            result_ = std::to_string(value);
+        virtual bool process(const float& value) { return appendNumber(value); }
+        virtual bool process(const double& value) { return appendNumber(value); }
+        virtual bool process(const std::string& value) {
+            result_ += EscapeJson(value);
             return true;
         }
-        virtual bool process(const bool& value) {
-            result_ = (value ? "true" : "false");
-            return true;
+
+        virtual bool processArray(const int* values, size_t count) {
+            return appendArray(values, count);
+        }
+        virtual bool processArray(const int64_t* values, size_t count) {
+            return appendArray(values, count);
+        }
+        virtual bool processArray(const float* values, size_t count) {
+            return appendArray(values, count);
+        }
+        virtual bool processArray(const double* values, size_t count) {
+            return appendArray(values, count);
         }
-        virtual bool process(const float& value) {
-            result_ = std::to_string(value);
+
+        virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) {
+            result_ += '{';
+            num_fields_.push_back(0);
             return true;
         }
-        virtual bool process(const double& value) {
-            result_ = std::to_string(value);
+        virtual bool beginField(const char* name) {
+            if (num_fields_.back()++ > 0) { result_ += ','; }
+            result_ += std::string(name) + ':';
             return true;
         }
-        virtual bool process(const std::string& value) {
-            result_ = EscapeJson(value);
+        virtual bool endStruct() {
+            num_fields_.pop_back();
+            result_ += '}';
             return true;
         }
 
         std::string json() const { return result_; }
 
     private:
+        template <typename T> bool appendNumber(T value) {
+            // JSON has no infinity or NaN.
+            if (value != value || value - value != 0) {
+                result_ += "null";
+                return true;
+            }
+            char buffer[kMaxNumberLength];
+            result_.append(buffer, formatNumber(value, buffer));
+            return true;
+        }
+
+        template <typename T> bool appendArray(const T* values, size_t count) {
+            result_ += '[';
+            for (size_t i = 0; i < count; ++i) {
+                if (i > 0) { result_ += ','; }
+                process(values[i]);
+            }
+            result_ += ']';
+            return true;
+        }
+
         std::string result_;
+        std::vector<int> num_fields_;
     };
 
     void ListNodes(Graph* graph, HttpReply* reply) {
+        const std::vector<std::shared_ptr<NodeBase>> nodes = graph->nodes();
         reply->text += '[';
-        for (int i = 0; i < graph->numNodes(); ++i) {
-            reply->text += '"' + graph->node(i)->name() + '"';
-            if (i + 1 < graph->numNodes()) { reply->text += ","; }
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            reply->text += '"' + nodes[i]->name() + '"';
+            if (i + 1 < nodes.size()) { reply->text += ","; }
         }
         reply->text += ']';
     }
 
+    // Serves every property of the graph, read in a single pass.
+    void ServeSnapshot(Graph* graph, HttpReply* reply) {
+        std::shared_ptr<const GraphSnapshot> snapshot = GraphSnapshot::take(graph);
+
+        std::ostringstream ss;
+        ss << "{time:" << snapshot->time().microSecondsSince1970() << ",properties:[";
+        for (int i = 0; i < snapshot->size(); ++i) {
+            const GraphSnapshot::Entry& entry = snapshot->entry(i);
+            ToJsonValue converter;
+            entry.property->apply(&converter);
+            ss << "{node:" << EscapeJson(entry.node) << ",stream:" << EscapeJson(entry.stream)
+               << ",pin:" << EscapeJson(entry.pin) << ",name:" << EscapeJson(entry.property->name())
+               << ",type:" << EscapeJson(entry.property->typeName())
+               << ",value:" << converter.json() << "}";
+            if (i + 1 < snapshot->size()) { ss << ","; }
+        }
+        ss << "]}";
+        reply->text += ss.str();
+    }
+
+    // Serves /history?key=<key>&span=<seconds>&resolution=<seconds>.
+    void ServeHistory(PropertyRecorder* recorder, HttpReply* reply) {
+        if (!recorder) {
+            reply->text = "No recorder\r\n";
+            reply->setNotFound();
+            return;
+        }
+
+        std::ostringstream ss;
+        ss << "[";
+        const std::string key = reply->getQSvar("key");
+        if (key.empty()) {
+            const std::vector<std::string> keys = recorder->keys();
+            for (size_t i = 0; i < keys.size(); ++i) {
+                ss << EscapeJson(keys[i]);
+                if (i + 1 < keys.size()) { ss << ","; }
+            }
+        } else {
+            const double span = atof(reply->getQSvar("span").c_str());
+            const double resolution = atof(reply->getQSvar("resolution").c_str());
+            const std::vector<PropertyRecorder::Sample> samples =
+                recorder->query(key, Duration::seconds(span > 0 ? span : 60),
+                                Duration::seconds(resolution));
+            for (size_t i = 0; i < samples.size(); ++i) {
+                ToJsonValue value;
+                value.process(samples[i].value);
+                ss << "[" << samples[i].time.microSecondsSince1970() << "," << value.json() << "]";
+                if (i + 1 < samples.size()) { ss << ","; }
+            }
+        }
+        ss << "]";
+        reply->text += ss.str();
+    }
+
+    void ListTypes(HttpReply* reply) {
+        std::ostringstream ss;
+        ss << "[";
+        const std::vector<std::pair<TypeId, std::string>> types = registeredTypes();
+        for (size_t i = 0; i < types.size(); ++i) {
+            ss << "{name:" << EscapeJson(types[i].second) << ",id:\"" << std::hex
+               << types[i].first << std::dec << "\"}";
+            if (i + 1 < types.size()) { ss << ","; }
+        }
+        ss << "]";
+        reply->text += ss.str();
+    }
+
     void ListProperties(PropertyList* list, HttpReply* reply) {
         if (list == 0) {
             reply->setNotFound();
@@ -226,7 +337,7 @@ namespace {
 }  // namespace
 
 GraphHttpServer::GraphHttpServer(Graph* graph, int port, const std::string& public_directory)
-    : HttpServer(port, public_directory), graph_(graph) {
+    : HttpServer(port, public_directory), graph_(graph), recorder_(nullptr) {
     setHandler(HttpServer::GET, "/props", [this](std::unique_ptr<HttpReply> reply) {
         ListProperties(graph_, reply.get());
         Finalize(reply.get());
@@ -244,6 +355,24 @@ GraphHttpServer::GraphHttpServer(Graph* graph, int port, const std::string& publ
         Finalize(reply.get());
         return true;
     });
+
+    setHandler(HttpServer::GET, "/snapshot", [this](std::unique_ptr<HttpReply> reply) {
+        ServeSnapshot(graph_, reply.get());
+        Finalize(reply.get());
+        return true;
+    });
+
+    setHandler(HttpServer::GET, "/history", [this](std::unique_ptr<HttpReply> reply) {
+        ServeHistory(recorder_, reply.get());
+        Finalize(reply.get());
+        return true;
+    });
+
+    setHandler(HttpServer::GET, "/types", [](std::unique_ptr<HttpReply> reply) {
+        ListTypes(reply.get());
+        Finalize(reply.get());
+        return true;
+    });
 }
 
 }  // namespace media_graph
@@ -27,10 +27,13 @@
 #ifndef GRAPH_HTTP_SERVER_H
 #define GRAPH_HTTP_SERVER_H
 
+#include <atomic>
+
 #include "http_server.h"
 
 namespace media_graph {
 class Graph;
+class PropertyRecorder;
 
 /*! This class opens a web server that gives access to a media_graph::Graph object.
  * The constructors starts the server, the destructor stops it.
@@ -44,7 +47,15 @@ public:
     //! of the constructed object.
     GraphHttpServer(Graph* graph, int port, const std::string& public_directory = ".");
 
+    /*! Serves the history kept by <recorder> at /history. Without arguments,
+     *  lists the recorded keys. With ?key=<key>&span=<seconds>[&resolution=<seconds>],
+     *  returns [[<microseconds since 1970>,<value>],...]. <recorder> has to
+     *  remain valid during the life of the server, or until replaced.
+     */
+    void setRecorder(PropertyRecorder* recorder) { recorder_ = recorder; }
+
     Graph* graph_;
+    std::atomic<PropertyRecorder*> recorder_;
 };
 
 }  // namespace media_graph
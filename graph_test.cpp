@@ -29,6 +29,7 @@
 
 #include "graph.h"
 #include "node.h"
+#include "packet_stream.h"
 #include "stream.h"
 #include "stream_reader.h"
 #include "types/type_definition.h"
@@ -463,4 +464,334 @@ TEST(GraphTest, shouldAddAndRemoveNodesWhileRunning) {
     EXPECT_GT(totalConsumed, 1000);
 }
 
+TEST(GraphTest, NodeIdsAreStable) {
+    Graph graph;
+    auto c = graph.newNode<IntProducerNode>("c");
+    auto a = graph.newNode<IntProducerNode>("a");
+    auto b = graph.newNode<IntConsumerNode>("b");
+
+    EXPECT_EQ(3, graph.numNodes());
+    EXPECT_EQ(c, graph.node(0));
+    EXPECT_EQ(a, graph.node(1));
+    EXPECT_EQ(b, graph.node(2));
+    EXPECT_EQ(nullptr, graph.node(3));
+    EXPECT_EQ(1, graph.nodeId("a"));
+    EXPECT_EQ(-1, graph.nodeId("d"));
+
+    EXPECT_EQ(0, b->inputPinIndex("int"));
+    EXPECT_EQ(-1, b->inputPinIndex("out"));
+    EXPECT_EQ(0, a->outputStreamIndex("Timestamp incrementer"));
+
+    // Removing a node does not renumber the others, and frees its id.
+    graph.removeNode("c");
+    EXPECT_EQ(2, graph.numNodes());
+    EXPECT_EQ(3, graph.numNodeIds());
+    EXPECT_EQ(nullptr, graph.node(0));
+    EXPECT_EQ(a, graph.node(1));
+    EXPECT_EQ(2, graph.nodeId("b"));
+    EXPECT_EQ(b, graph.getNodeByName("b"));
+    EXPECT_EQ(nullptr, graph.getNodeByName("c"));
+
+    auto d = graph.newNode<IntConsumerNode>("d");
+    EXPECT_EQ(0, graph.nodeId("d"));
+    EXPECT_EQ(d, graph.node(0));
+    EXPECT_EQ(3, graph.numNodeIds());
+    EXPECT_EQ(d, graph.nodes().back());
+}
+
+class HourlyProducer : public ThreadedNodeBase {
+public:
+    HourlyProducer(int count) : output_("out", this), count_(count) {}
+
+    virtual void threadMain() {
+        for (int i = 0; i < count_ && !threadMustQuit(); ++i) {
+            Duration::seconds(3600).sleep();
+            Timestamp now = Timestamp::now();
+            if (!output_.update(now, i)) { break; }
+            sent_.push_back(now);
+        }
+    }
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+    const std::vector<Timestamp>& sent() const { return sent_; }
+
+private:
+    Stream<int> output_;
+    int count_;
+    std::vector<Timestamp> sent_;
+};
+
+TEST(GraphTest, RunsOnVirtualClock) {
+    Graph graph;
+    auto clock = std::make_shared<VirtualClock>();
+    EXPECT_TRUE(graph.setClock(clock));
+
+    auto producer = graph.newNode<HourlyProducer>("producer", 5);
+    auto consumer = graph.newNode<ThreadedIntConsumer>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "out", consumer, "in"));
+
+    Timestamp start = Timestamp::now();
+    EXPECT_TRUE(graph.start());
+    graph.waitUntilStopped();
+
+    // Five hours of simulated time, much faster.
+    EXPECT_LT((Timestamp::now() - start).seconds(), 2.0);
+    ASSERT_EQ(5u, producer->sent().size());
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(Timestamp::microSecondsSince1970(int64_t(i + 1) * 3600 * 1000000),
+                  producer->sent()[i]);
+    }
+    EXPECT_EQ(0, clock->numBusyThreads());
+}
+
+class HourlyPacketProducer : public ThreadedNodeBase {
+public:
+    HourlyPacketProducer(int count) : output_("out", this), count_(count) {}
+
+    virtual void threadMain() {
+        for (int i = 0; i < count_ && !threadMustQuit(); ++i) {
+            Duration::seconds(3600).sleep();
+            if (!output_.update(Timestamp::now(), &i, sizeof(i))) { break; }
+        }
+        // PacketStream has no end of stream: stopping would drop the last
+        // packet. Leaves time to the consumer instead.
+        Duration::seconds(3600).sleep();
+    }
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+private:
+    PacketStream output_;
+    int count_;
+};
+
+class PacketConsumer : public ThreadedNodeBase {
+public:
+    PacketConsumer(int count) : input_("in", this), count_(count), consumed_(0) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+
+    void threadMain() {
+        PacketSpan packet;
+        while (consumed_ < count_ && !threadMustQuit() && input_.read(&packet)) { ++consumed_; }
+    }
+
+    int consumed() const { return consumed_; }
+
+private:
+    PacketReader input_;
+    int count_;
+    std::atomic<int> consumed_;
+};
+
+// Readers blocked elsewhere than in a Stream<T> must be idle too, or time
+// would never move.
+TEST(GraphTest, PacketReaderIsIdleOnVirtualClock) {
+    Graph graph;
+    auto clock = std::make_shared<VirtualClock>();
+    EXPECT_TRUE(graph.setClock(clock));
+
+    auto producer = graph.newNode<HourlyPacketProducer>("producer", 5);
+    auto consumer = graph.newNode<PacketConsumer>("consumer", 5);
+    EXPECT_TRUE(graph.connect(producer, "out", consumer, "in"));
+
+    Timestamp start = Timestamp::now();
+    EXPECT_TRUE(graph.start());
+    graph.waitUntilStopped();
+
+    EXPECT_LT((Timestamp::now() - start).seconds(), 2.0);
+    EXPECT_EQ(5, consumer->consumed());
+    EXPECT_EQ(0, clock->numBusyThreads());
+}
+
+class CountingProducer : public ThreadedNodeBase {
+public:
+    CountingProducer(int count, StreamDropPolicy policy = WAIT_FOR_CONSUMPTION_NEVER_DROP)
+        : output_("out", this, policy), count_(count) {}
+
+    virtual void threadMain() {
+        for (int i = 0; i < count_ && !threadMustQuit(); ++i) {
+            if (!output_.update(Timestamp::microSecondsSince1970(1000 + i), i)) { break; }
+        }
+    }
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+private:
+    Stream<int> output_;
+    int count_;
+};
+
+class CollectingConsumer : public ThreadedNodeBase {
+public:
+    CollectingConsumer() : input_("in", this), reached_end_(false) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+
+    void threadMain() {
+        while (!threadMustQuit()) {
+            int value;
+            if (!input_.read(&value, nullptr)) { break; }
+            received_.push_back(value);
+        }
+        reached_end_ = input_.endOfStream();
+    }
+
+    const std::vector<int>& received() const { return received_; }
+    bool reachedEnd() const { return reached_end_; }
+
+private:
+    StreamReader<int> input_;
+    std::vector<int> received_;
+    bool reached_end_;
+};
+
+// Reads two inputs, whichever has data, with waitForPinActivity().
+class TwoInputCollector : public ThreadedNodeBase {
+public:
+    TwoInputCollector() : a_("a", this), b_("b", this), consumed_(0) {}
+
+    virtual int numInputPin() const { return 2; }
+    virtual const NamedPin* constInputPin(int i) const {
+        return (i == 0 ? &a_ : (i == 1 ? &b_ : nullptr));
+    }
+
+    void threadMain() {
+        while (!threadMustQuit()) {
+            waitForPinActivity();
+            int value;
+            while (a_.tryRead(&value, nullptr)) { ++consumed_; }
+            while (b_.tryRead(&value, nullptr)) { ++consumed_; }
+        }
+    }
+
+    int consumed() const { return consumed_; }
+
+private:
+    StreamReader<int> a_;
+    StreamReader<int> b_;
+    std::atomic<int> consumed_;
+};
+
+// producer -> filter -> consumer, with a finite producer.
+TEST(GraphTest, DrainDeliversEveryEntry) {
+    Graph graph;
+    auto producer = graph.newNode<CountingProducer>("producer", 1000);
+    auto filter = graph.newNode<ThreadedPassThrough>("filter");
+    auto consumer = graph.newNode<CollectingConsumer>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "out", filter, "in"));
+    EXPECT_TRUE(graph.connect(filter, "out", consumer, "in"));
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+
+    EXPECT_FALSE(graph.isStarted());
+    EXPECT_TRUE(consumer->reachedEnd());
+    ASSERT_EQ(1000u, consumer->received().size());
+    for (int i = 0; i < 1000; ++i) { EXPECT_EQ(i, consumer->received()[i]); }
+}
+
+// The shorter input ending does not stop the node: the longer one is read
+// to its end.
+TEST(GraphTest, DrainWaitsForTheLongestInput) {
+    Graph graph;
+    auto short_producer = graph.newNode<CountingProducer>("short", 10);
+    auto long_producer = graph.newNode<CountingProducer>("long", 1000);
+    auto consumer = graph.newNode<TwoInputCollector>("consumer");
+    EXPECT_TRUE(graph.connect(short_producer, "out", consumer, "a"));
+    EXPECT_TRUE(graph.connect(long_producer, "out", consumer, "b"));
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+    EXPECT_EQ(1010, consumer->consumed());
+}
+
+// Blocked in waitForPinActivity(), the node is idle: time moves.
+TEST(GraphTest, PinActivityWaitIsIdleOnVirtualClock) {
+    Graph graph;
+    auto clock = std::make_shared<VirtualClock>();
+    EXPECT_TRUE(graph.setClock(clock));
+
+    auto a = graph.newNode<HourlyProducer>("a", 2);
+    auto b = graph.newNode<HourlyProducer>("b", 3);
+    auto consumer = graph.newNode<TwoInputCollector>("consumer");
+    EXPECT_TRUE(graph.connect(a, "out", consumer, "a"));
+    EXPECT_TRUE(graph.connect(b, "out", consumer, "b"));
+
+    Timestamp start = Timestamp::now();
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+
+    EXPECT_LT((Timestamp::now() - start).seconds(), 2.0);
+    EXPECT_EQ(5, consumer->consumed());
+}
+
+TEST(GraphTest, BatchModeIsLossless) {
+    Graph graph;
+    EXPECT_TRUE(graph.getPropertyByName("BatchMode")->ValueFromString("1"));
+    EXPECT_TRUE(graph.batchMode());
+
+    // Would drop most entries outside of batch mode.
+    auto producer = graph.newNode<CountingProducer>("producer", 1000, NEVER_BLOCK_DROP_OLDEST);
+    auto filter = graph.newNode<ThreadedPassThrough>("filter");
+    auto consumer = graph.newNode<CollectingConsumer>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "out", filter, "in"));
+    EXPECT_TRUE(graph.connect(filter, "out", consumer, "in"));
+
+    EXPECT_TRUE(graph.start());
+    EXPECT_FALSE(graph.setBatchMode(false));
+    graph.drain();
+
+    ASSERT_EQ(1000u, consumer->received().size());
+    for (int i = 0; i < 1000; ++i) { EXPECT_EQ(i, consumer->received()[i]); }
+
+    BatchReport report = graph.batchReport();
+    EXPECT_EQ(1000, report.num_frames);
+    EXPECT_LT(Duration(), report.duration);
+    EXPECT_LT(0, report.frames_per_second);
+    ASSERT_EQ(3u, report.nodes.size());
+    EXPECT_EQ("producer", report.nodes[0].name);
+    for (const BatchReport::NodeLoad& load : report.nodes) {
+        EXPECT_LE(0, load.utilization);
+        EXPECT_GE(1.01, load.utilization);
+    }
+    EXPECT_NE(std::string::npos, report.toString().find("1000 frames"));
+
+    EXPECT_TRUE(graph.setBatchMode(false));
+}
+
+TEST(GraphTest, StopIsNotEndOfStream) {
+    Graph graph;
+    auto producer = graph.newNode<ThreadedIntProducer>("producer");
+    auto consumer = graph.newNode<CollectingConsumer>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "out", consumer, "in"));
+
+    EXPECT_TRUE(graph.start());
+    Duration::milliSeconds(10).sleep();
+    graph.stop();
+    graph.waitUntilStopped();
+    EXPECT_FALSE(consumer->reachedEnd());
+}
+
+TEST(GraphTest, ClockChangesOnlyWhenStopped) {
+    Graph graph;
+    graph.newNode<IntProducerNode>("producer");
+    EXPECT_TRUE(graph.start());
+    EXPECT_FALSE(graph.setClock(std::make_shared<VirtualClock>()));
+    EXPECT_EQ(nullptr, graph.clock());
+
+    graph.stop();
+    EXPECT_TRUE(graph.setClock(std::make_shared<VirtualClock>()));
+    EXPECT_NE(nullptr, graph.clock());
+}
+
 }  // namespace media_graph
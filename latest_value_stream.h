@@ -0,0 +1,271 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_LATEST_VALUE_STREAM_H
+#define MEDIAGRAPH_LATEST_VALUE_STREAM_H
+
+#include "stream.h"
+#include "stream_reader.h"
+
+#include <assert.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace media_graph {
+
+/*! A stream that only keeps the most recent value.
+ *
+ * Consumers such as renderers, status publishers or control loops do not
+ * want a history: they want the freshest complete value. LatestValueStream
+ * implements a lock-free triple buffer: update() never waits for readers,
+ * and readers copy the latest value without taking the stream mutex and
+ * without any queue. As with Stream<T>, each reader only gets a value once:
+ * read() blocks until a value newer than the last one it read is published,
+ * and canRead() tells if such a value is available.
+ *
+ * The stream keeps 2 + max_concurrent_readers slots. With a single reader,
+ * this is a classic triple buffer. If more readers than expected copy a
+ * value at the same time, update() yields until a slot is released.
+ *
+ * The mutex is only used to register readers and to wake up sleeping ones.
+ */
+template <class T> class LatestValueStream : public StreamBase<T> {
+public:
+    LatestValueStream(const std::string& name, NodeBase* node, int max_concurrent_readers = 1);
+
+    ~LatestValueStream();
+
+    //! Publishes a new value. Never blocks on readers.
+    bool update(Timestamp timestamp, T data);
+
+    virtual std::string typeName() const { return media_graph::typeName<T>(); }
+
+    virtual void close();
+    virtual void open();
+    virtual bool isOpen() const override { return !closed_; }
+
+    virtual bool unregisterReader(NamedPin* reader);
+
+    Timestamp lastWrittenTimestamp() const { return last_written_timestamp_; }
+
+    int64_t getNumUpdateCalls() const { return next_sequence_id_; }
+
+protected:
+    virtual bool read(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq);
+    virtual bool tryRead(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq);
+    virtual bool canRead(SequenceId consumed_until, Timestamp fresher_than) const;
+
+private:
+    struct Slot {
+        Slot() : sequence_id(-1), num_pins(0) {}
+
+        Timestamp timestamp;
+        SequenceId sequence_id;
+        T data;
+
+        // Number of readers currently copying this slot.
+        std::atomic<int> num_pins;
+    };
+
+    // Pins the slot holding the latest value and returns its index, or -1 if
+    // nothing has been published yet.
+    int pinLatest() const;
+    void unpin(int slot) const { slots_[slot].num_pins.fetch_sub(1); }
+
+    // Returns a slot that is neither published nor pinned by a reader.
+    int findFreeSlot() const;
+
+    bool readLatest(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq);
+
+    const int num_slots_;
+    std::unique_ptr<Slot[]> slots_;
+
+    // Index of the slot holding the latest value, -1 if none.
+    std::atomic<int> latest_;
+    std::atomic<bool> closed_;
+    std::atomic<int64_t> next_sequence_id_;
+
+    // Number of readers sleeping in read(). Protected by mutex_.
+    int num_waiting_;
+    ClockCondition data_available_;
+
+    // Only accessed by the writer.
+    Timestamp last_written_timestamp_;
+};
+
+template <class T>
+LatestValueStream<T>::LatestValueStream(const std::string& name, NodeBase* node,
+                                        int max_concurrent_readers)
+    : StreamBase<T>(name, node),
+      num_slots_(2 + (max_concurrent_readers > 1 ? max_concurrent_readers : 1)),
+      slots_(new Slot[num_slots_]),
+      latest_(-1),
+      closed_(false),
+      next_sequence_id_(0),
+      num_waiting_(0),
+      last_written_timestamp_(Timestamp::microSecondsSince1970(0)) {
+    this->addGetProperty("NumUpdates", this, &LatestValueStream<T>::getNumUpdateCalls);
+}
+
+template <class T> LatestValueStream<T>::~LatestValueStream() { close(); }
+
+template <class T> int LatestValueStream<T>::pinLatest() const {
+    while (true) {
+        const int index = latest_.load();
+        if (index < 0) { return -1; }
+        slots_[index].num_pins.fetch_add(1);
+
+        // The writer never recycles the published slot, nor a pinned one. If
+        // the slot is still the latest after pinning it, it is safe to read.
+        if (latest_.load() == index) { return index; }
+        unpin(index);
+    }
+}
+
+template <class T> int LatestValueStream<T>::findFreeSlot() const {
+    while (true) {
+        const int latest = latest_.load();
+        for (int i = 0; i < num_slots_; ++i) {
+            if (i != latest && slots_[i].num_pins.load() == 0) { return i; }
+        }
+        // More concurrent readers than slots: wait for one to finish copying.
+        std::this_thread::yield();
+    }
+}
+
+template <class T> bool LatestValueStream<T>::update(Timestamp timestamp, T data) {
+    // Make sure we do not go back in time.
+    assert(!(timestamp < last_written_timestamp_));
+    if (timestamp < last_written_timestamp_ || closed_) { return false; }
+    last_written_timestamp_ = timestamp;
+
+    const int index = findFreeSlot();
+    Slot& slot = slots_[index];
+    slot.timestamp = timestamp;
+    slot.sequence_id = next_sequence_id_.fetch_add(1);
+    slot.data = std::move(data);
+    latest_.store(index);
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (num_waiting_ > 0) { data_available_.notifyAll(); }
+    for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->signalActivity(); }
+    return true;
+}
+
+template <class T>
+bool LatestValueStream<T>::readLatest(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                                      SequenceId* seq) {
+    const int index = pinLatest();
+    if (index < 0) { return false; }
+
+    const Slot& slot = slots_[index];
+    SequenceId* consumed_until = reader->lastReadSequenceIdPtr();
+    bool found = false;
+    if (*consumed_until < slot.sequence_id) {
+        *consumed_until = slot.sequence_id;
+        if (reader->seekPosition() < slot.timestamp &&
+            reader->acceptsEntry(slot.timestamp, slot.sequence_id)) {
+            reader->markAccepted(slot.timestamp, slot.sequence_id);
+            if (data) { *data = slot.data; }
+            if (timestamp) { *timestamp = slot.timestamp; }
+            if (seq) { *seq = slot.sequence_id; }
+            found = true;
+        }
+    }
+    unpin(index);
+    return found;
+}
+
+template <class T>
+bool LatestValueStream<T>::read(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                                SequenceId* seq) {
+    if (closed_ || !reader->isConnected()) { return false; }
+
+    // Fast path: a new value is already there.
+    if (readLatest(reader, data, timestamp, seq)) { return true; }
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    ++num_waiting_;
+    while (!closed_ && reader->isConnected() && !readLatest(reader, data, timestamp, seq)) {
+#ifdef MEDIAGRAPH_USE_EASY_PROFILER
+        const StackString<128> blockName{"waitRead ", reader->name().c_str(), "<",
+                                         TypeTraits<T>::name(), ">"};
+        EASY_BLOCK(blockName, profiler::colors::BlueGrey50);
+#endif
+        data_available_.wait(lock);
+    }
+    --num_waiting_;
+
+    return !closed_ && reader->isConnected();
+}
+
+template <class T>
+bool LatestValueStream<T>::tryRead(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                                   SequenceId* seq) {
+    return !closed_ && reader->isConnected() && readLatest(reader, data, timestamp, seq);
+}
+
+template <class T>
+bool LatestValueStream<T>::canRead(SequenceId consumed_until, Timestamp fresher_than) const {
+    if (closed_) { return false; }
+
+    const int index = pinLatest();
+    if (index < 0) { return false; }
+    const bool result = consumed_until < slots_[index].sequence_id &&
+                        fresher_than < slots_[index].timestamp;
+    unpin(index);
+    return result;
+}
+
+template <class T> void LatestValueStream<T>::close() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+
+    closed_ = true;
+    latest_ = -1;
+
+    // Let's tell everybody it is no use to wait for us, we're closed.
+    data_available_.notifyAll();
+    for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->signalActivity(); }
+}
+
+template <class T> void LatestValueStream<T>::open() { closed_ = false; }
+
+template <class T> bool LatestValueStream<T>::unregisterReader(NamedPin* reader) {
+    if (NamedStream::unregisterReader(reader)) {
+        // The disconnected reader might be waiting.
+        // Let's wake it.
+        reader->signalActivity();
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        data_available_.notifyAll();
+        return true;
+    }
+    return false;
+}
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_LATEST_VALUE_STREAM_H
@@ -0,0 +1,221 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <gtest/gtest.h>
+
+#include "graph.h"
+#include "latest_value_stream.h"
+#include "node.h"
+#include "stream_reader.h"
+#include "types/type_definition.h"
+
+#include <vector>
+
+namespace media_graph {
+
+namespace {
+
+    class LatestIntProducer : public NodeBase {
+    public:
+        LatestIntProducer(int max_readers = 1) : output("latest", this, max_readers) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        LatestValueStream<int> output;
+    };
+
+    class IntReaderNode : public NodeBase {
+    public:
+        IntReaderNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<int> input;
+    };
+
+}  // namespace
+
+TEST(LatestValueStreamTest, ReadsOnlyTheLatestValue) {
+    Graph graph;
+    auto producer = graph.newNode<LatestIntProducer>("producer");
+    auto consumer = graph.newNode<IntReaderNode>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "latest", consumer, "in"));
+    EXPECT_TRUE(graph.start());
+
+    int value;
+    Timestamp timestamp;
+    EXPECT_FALSE(consumer->input.canRead());
+    EXPECT_FALSE(consumer->input.tryRead(&value, &timestamp));
+
+    Timestamp now = Timestamp::now();
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(producer->output.update(now + Duration::microSeconds(i), i));
+    }
+
+    EXPECT_TRUE(consumer->input.canRead());
+    SequenceId seq;
+    EXPECT_TRUE(consumer->input.read(&value, &timestamp, &seq));
+    EXPECT_EQ(9, value);
+    EXPECT_EQ(9, seq);
+    EXPECT_EQ(now + Duration::microSeconds(9), timestamp);
+
+    // Nothing new since the last read.
+    EXPECT_FALSE(consumer->input.canRead());
+    EXPECT_FALSE(consumer->input.tryRead(&value, &timestamp));
+
+    EXPECT_TRUE(producer->output.update(now + Duration::microSeconds(10), 10));
+    EXPECT_TRUE(consumer->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(10, value);
+
+    graph.stop();
+    EXPECT_FALSE(consumer->input.read(&value, &timestamp));
+}
+
+TEST(LatestValueStreamTest, EachReaderHasItsOwnNewFlag) {
+    Graph graph;
+    auto producer = graph.newNode<LatestIntProducer>("producer", 2);
+    auto a = graph.newNode<IntReaderNode>("a");
+    auto b = graph.newNode<IntReaderNode>("b");
+    EXPECT_TRUE(graph.connect(producer, "latest", a, "in"));
+    EXPECT_TRUE(graph.connect(producer, "latest", b, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(producer->output.update(Timestamp::now(), 42));
+
+    int value = 0;
+    Timestamp timestamp;
+    EXPECT_TRUE(a->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(42, value);
+    EXPECT_FALSE(a->input.canRead());
+
+    EXPECT_TRUE(b->input.canRead());
+    EXPECT_TRUE(b->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(42, value);
+    graph.stop();
+}
+
+TEST(LatestValueStreamTest, SeekSkipsOlderValues) {
+    Graph graph;
+    auto producer = graph.newNode<LatestIntProducer>("producer");
+    auto consumer = graph.newNode<IntReaderNode>("consumer");
+    EXPECT_TRUE(graph.connect(producer, "latest", consumer, "in"));
+    EXPECT_TRUE(graph.start());
+
+    Timestamp now = Timestamp::now();
+    EXPECT_TRUE(producer->output.update(now, 1));
+    EXPECT_TRUE(consumer->input.seek(now));
+
+    int value;
+    Timestamp timestamp;
+    EXPECT_FALSE(consumer->input.tryRead(&value, &timestamp));
+    EXPECT_TRUE(producer->output.update(now + Duration::milliSeconds(1), 2));
+    EXPECT_TRUE(consumer->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(2, value);
+    graph.stop();
+}
+
+namespace {
+    struct Pair {
+        int64_t a;
+        int64_t b;
+    };
+
+    template <> std::string typeName<Pair>() { return "Pair"; }
+
+    class PairProducer : public ThreadedNodeBase {
+    public:
+        PairProducer(int num_values) : output("out", this, 3), num_values_(num_values) {}
+
+        virtual void threadMain() {
+            for (int64_t i = 0; i < num_values_ && !threadMustQuit(); ++i) {
+                Pair pair = {i, -i};
+                output.update(Timestamp::now(), pair);
+            }
+        }
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+    private:
+        LatestValueStream<Pair> output;
+        int num_values_;
+    };
+
+    class PairChecker : public ThreadedNodeBase {
+    public:
+        PairChecker() : input("in", this), num_reads(0), num_errors(0) {}
+
+        virtual void threadMain() {
+            int64_t last = -1;
+            while (!threadMustQuit()) {
+                Pair pair;
+                Timestamp timestamp;
+                if (!input.read(&pair, &timestamp)) { break; }
+                if (pair.a != -pair.b || pair.a <= last) { ++num_errors; }
+                last = pair.a;
+                ++num_reads;
+            }
+        }
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<Pair> input;
+        std::atomic<int> num_reads;
+        std::atomic<int> num_errors;
+    };
+}  // namespace
+
+TEST(LatestValueStreamTest, ConcurrentReadersSeeConsistentValues) {
+    Graph graph;
+    auto producer = graph.newNode<PairProducer>("producer", 200000);
+    std::vector<std::shared_ptr<PairChecker>> checkers;
+    for (int i = 0; i < 3; ++i) {
+        checkers.push_back(graph.newNode<PairChecker>("checker"));
+        EXPECT_TRUE(graph.connect(producer, "out", checkers.back(), "in"));
+    }
+    EXPECT_TRUE(graph.start());
+    producer->waitUntilStopped();
+    graph.stop();
+
+    for (auto checker : checkers) {
+        EXPECT_EQ(0, checker->num_errors);
+        EXPECT_LT(0, checker->num_reads);
+    }
+}
+
+}  // namespace media_graph
@@ -0,0 +1,117 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_MEMORY_BUDGET_H
+#define MEDIAGRAPH_MEMORY_BUDGET_H
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+#include "clock.h"
+
+namespace media_graph {
+
+/*! What a stream does when writing an entry would exceed the memory budget
+ *  of its graph. Streams with the DROP_ANY policy never block: they always
+ *  drop their oldest entries.
+ */
+enum MemoryBudgetPolicy {
+    //! Wait until other streams release memory.
+    BUDGET_BLOCK_PRODUCERS,
+
+    //! Drop the oldest entries of the stream being written.
+    BUDGET_DROP_OLDEST
+};
+
+/*! Graph-wide limit on the bytes held by stream queues. Shared by all the
+ *  streams of a graph, see Graph::setMemoryBudget(). Thread safe.
+ */
+class MemoryBudget {
+public:
+    MemoryBudget()
+        : limit_(0), bytes_held_(0), policy_(BUDGET_BLOCK_PRODUCERS), num_waiting_(0) {}
+
+    //! Maximum number of bytes held by all streams. 0 means unlimited.
+    int64_t limit() const { return limit_; }
+    void setLimit(int64_t bytes) {
+        limit_ = bytes;
+        wakeWaiting();
+    }
+
+    MemoryBudgetPolicy policy() const { return policy_; }
+    void setPolicy(MemoryBudgetPolicy policy) {
+        policy_ = policy;
+        wakeWaiting();
+    }
+
+    int64_t bytesHeld() const { return bytes_held_; }
+
+    //! True if <bytes> more bytes fit in the budget.
+    bool allows(int64_t bytes) const {
+        const int64_t limit = limit_;
+        return limit <= 0 || bytes_held_ + bytes <= limit;
+    }
+
+    void acquire(int64_t bytes) { bytes_held_ += bytes; }
+
+    //! Wakes the producers waiting for memory, if any.
+    void release(int64_t bytes) {
+        bytes_held_ -= bytes;
+        if (num_waiting_ > 0) { wakeWaiting(); }
+    }
+
+    /*! Blocks until <bytes> more bytes fit in the budget, or until <stop>
+     *  returns true. Whoever makes <stop> true calls wakeWaiting() next.
+     *  The waiting thread is idle for its clock.
+     */
+    template <typename Predicate> void waitFor(int64_t bytes, Predicate stop) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ++num_waiting_;
+        released_.wait(lock, [&]() { return allows(bytes) || stop(); });
+        --num_waiting_;
+    }
+
+    void wakeWaiting() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        released_.notifyAll();
+    }
+
+private:
+    std::atomic<int64_t> limit_;
+    std::atomic<int64_t> bytes_held_;
+    std::atomic<MemoryBudgetPolicy> policy_;
+
+    // Counted under mutex_, read without it: release() only takes mutex_
+    // when somebody waits.
+    std::atomic<int> num_waiting_;
+    std::mutex mutex_;
+    ClockCondition released_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_MEMORY_BUDGET_H
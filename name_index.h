@@ -0,0 +1,121 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_NAME_INDEX_H
+#define MEDIAGRAPH_NAME_INDEX_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace media_graph {
+
+/*! Hashed lookup of items exposed by index, such as properties, streams or
+ *  pins. Items are described by their count and a function returning the
+ *  name of item <i>: the index does not own them, and rebuilds itself when
+ *  the count changes or when a hit turns out to be stale. A miss with an
+ *  unchanged count costs a single hash lookup: an item renamed in place is
+ *  only found under its new name once its old name has been looked up, or
+ *  the count changed. Short lists are scanned linearly, which is cheaper
+ *  than hashing.
+ *
+ *  The index is allocated on the first lookup in a long list:
+ *
+ *  \code
+ *  int i = NameIndex::find(&index_, name, numProperty(), [this](int i) {
+ *      return property(i) ? &property(i)->name() : nullptr;
+ *  });
+ *  \endcode
+ *
+ *  Thread safe.
+ */
+class NameIndex {
+public:
+    //! Lists with up to this many items are not indexed.
+    static const int kLinearScanMax = 8;
+
+    /*! Returns the index of the item called <name>, or -1. <index> points to
+     *  the index owned by the caller, initially null, to delete with
+     *  release(). <name_at> returns the name of item i, or null.
+     */
+    template <class NameAt>
+    static int find(std::atomic<NameIndex*>* index, const std::string& name, int count,
+                    NameAt name_at) {
+        if (count <= kLinearScanMax) {
+            for (int i = 0; i < count; ++i) {
+                const std::string* item = name_at(i);
+                if (item && *item == name) { return i; }
+            }
+            return -1;
+        }
+
+        NameIndex* existing = index->load(std::memory_order_acquire);
+        if (!existing) {
+            NameIndex* created = new NameIndex();
+            if (index->compare_exchange_strong(existing, created)) {
+                existing = created;
+            } else {
+                delete created;
+            }
+        }
+        return existing->lookup(name, count, name_at);
+    }
+
+    static void release(std::atomic<NameIndex*>* index) { delete index->exchange(nullptr); }
+
+private:
+    NameIndex() : count_(-1) {}
+
+    template <class NameAt> int lookup(const std::string& name, int count, NameAt name_at) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count_ == count) {
+            auto it = indices_.find(name);
+            if (it == indices_.end()) { return -1; }
+            const std::string* item = name_at(it->second);
+            if (item && *item == name) { return it->second; }
+        }
+
+        // Items changed since the last lookup, or an item got renamed.
+        indices_.clear();
+        for (int i = 0; i < count; ++i) {
+            const std::string* item = name_at(i);
+            // Like a linear scan, the first item with a given name wins.
+            if (item) { indices_.insert(std::make_pair(*item, i)); }
+        }
+        count_ = count;
+        auto it = indices_.find(name);
+        return it == indices_.end() ? -1 : it->second;
+    }
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, int> indices_;
+    int count_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_NAME_INDEX_H
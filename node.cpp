@@ -31,6 +31,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "clock.h"
 #include "graph.h"
 #include "stream.h"
 #include "stream_reader.h"
@@ -40,15 +41,31 @@
 #endif
 
 namespace media_graph {
-NodeBase::NodeBase() : graph_(nullptr), running_(false), stopping_(false) {}
-
-NodeBase::~NodeBase() { detach(); }
+NodeBase::NodeBase()
+    : pin_activity_count_(0),
+      stream_index_(nullptr),
+      pin_index_(nullptr),
+      graph_(nullptr),
+      running_(false),
+      stopping_(false) {}
+
+NodeBase::~NodeBase() {
+    detach();
+    NameIndex::release(&stream_index_);
+    NameIndex::release(&pin_index_);
+}
 
 bool NodeBase::start() {
     std::unique_lock<std::mutex> lock(stop_event_mutex_);
     if (running_) { return true; }
 
     if (!allPinsConnected()) { return false; }
+
+    // A new run: streams finished by the previous one start over.
+    int num_streams = numOutputStream();
+    for (int i = 0; i < num_streams; ++i) {
+        if (outputStream(i)->isFinished()) { outputStream(i)->close(); }
+    }
     openAllStreams();
     openConnectedPins();
     running_ = true;
@@ -64,9 +81,13 @@ void NodeBase::stop() {
         running_ = false;
         // lock.unlock();
 
-        closeAllStreams();
+        // Finished streams stay readable until their readers reach the end.
+        int num_streams = numOutputStream();
+        for (int i = 0; i < num_streams; ++i) {
+            if (!outputStream(i)->isFinished()) { outputStream(i)->close(); }
+        }
 
-        pin_activity_.notify_all();
+        signalActivity();
         stop_event_.notify_all();
     }
     stopping_ = false;
@@ -74,17 +95,28 @@ void NodeBase::stop() {
 
 bool NodeBase::isRunning() const { return running_; }
 
+void NodeBase::signalActivity() {
+    std::lock_guard<std::mutex> lock(pin_activity_mutex_);
+    ++pin_activity_count_;
+    pin_activity_.notifyAll();
+}
+
 void NodeBase::waitForPinActivity() const {
-    std::unique_lock<std::mutex> lock(pin_activity_mutex_);
+    // Streams signal activity while holding their lock: checking the pins
+    // under pin_activity_mutex_ would invert the locking order. Pins at
+    // their end of stream have nothing more to signal.
+    const uint64_t count = pin_activity_count_;
     for (int i = 0; i < numInputPin(); ++i) {
         const auto pin = inputPin(i);
         if (pin->canRead() || !pin->connectedAndOpen()) { return; }
     }
+    if (allPinsAtEndOfStream()) { return; }
 
 #ifdef MEDIAGRAPH_USE_EASY_PROFILER
     EASY_BLOCK("waitForPinActivity()", profiler::colors::BlueGrey50);
 #endif
-    pin_activity_.wait(lock);
+    std::unique_lock<std::mutex> lock(pin_activity_mutex_);
+    pin_activity_.wait(lock, [this, count] { return pin_activity_count_ != count; });
 }
 
 void NodeBase::waitUntilStopped() {
@@ -93,6 +125,8 @@ void NodeBase::waitUntilStopped() {
     stop_event_.wait(lock, [this] { return !this->running_; });
 }
 
+bool NodeBase::shouldPace() const { return !(graph_ && graph_->batchMode()); }
+
 bool NodeBase::allPinsConnected() const {
     int num_pins = numInputPin();
     for (int i = 0; i < num_pins; ++i) {
@@ -101,6 +135,14 @@ bool NodeBase::allPinsConnected() const {
     return true;
 }
 
+bool NodeBase::allPinsAtEndOfStream() const {
+    int num_pins = numInputPin();
+    for (int i = 0; i < num_pins; ++i) {
+        if (!constInputPin(i)->endOfStream()) { return false; }
+    }
+    return num_pins > 0;
+}
+
 bool NodeBase::allPinsConnectedAndOpen() const {
     int num_pins = numInputPin();
     for (int i = 0; i < num_pins; ++i) {
@@ -146,6 +188,11 @@ void NodeBase::closeAllStreams() {
     for (int i = 0; i < num_streams; ++i) { outputStream(i)->close(); }
 }
 
+void NodeBase::finishAllStreams() {
+    int num_streams = numOutputStream();
+    for (int i = 0; i < num_streams; ++i) { outputStream(i)->finish(); }
+}
+
 bool NodeBase::setNameAndGraph(const std::string& new_name, Graph* new_graph) {
     if (this->graph_) {
         // already added.
@@ -165,23 +212,29 @@ void NodeBase::detach() {
 }
 
 NamedStream* NodeBase::getOutputStreamByName(const std::string& name) {
-    int num_streams = numOutputStream();
-    for (int i = 0; i < num_streams; ++i) {
-        NamedStream* stream = outputStream(i);
+    const int index = outputStreamIndex(name);
+    return index >= 0 ? outputStream(index) : 0;
+}
+
+int NodeBase::outputStreamIndex(const std::string& name) const {
+    return NameIndex::find(&stream_index_, name, numOutputStream(), [this](int i) {
+        const NamedStream* stream = constOutputStream(i);
         assert(stream != 0);
-        if (stream && (name == stream->streamName())) { return stream; }
-    }
-    return 0;
+        return stream ? &stream->streamName() : nullptr;
+    });
 }
 
 NamedPin* NodeBase::getInputPinByName(const std::string& name) {
-    int num_pins = numInputPin();
-    for (int i = 0; i < num_pins; ++i) {
-        NamedPin* pin = inputPin(i);
+    const int index = inputPinIndex(name);
+    return index >= 0 ? inputPin(index) : 0;
+}
+
+int NodeBase::inputPinIndex(const std::string& name) const {
+    return NameIndex::find(&pin_index_, name, numInputPin(), [this](int i) {
+        const NamedPin* pin = constInputPin(i);
         assert(pin != 0);
-        if (pin && (name == pin->name())) { return pin; }
-    }
-    return 0;
+        return pin ? &pin->name() : nullptr;
+    });
 }
 
 ThreadedNodeBase::~ThreadedNodeBase() {
@@ -203,8 +256,16 @@ bool ThreadedNodeBase::start() {
 
 bool ThreadedNodeBase::startThread() {
     thread_must_quit_ = false;
+    thread_start_ns_ = Timestamp::systemNow().nanoSecondsSince1970();
+    thread_end_ns_ = 0;
+    thread_idle_ns_ = 0;
     creating_thread_id_ = std::this_thread::get_id();
+    // The thread counts as busy from now on, so that a virtual clock does
+    // not move before it had a chance to run.
+    thread_clock_ = graph() ? graph()->clock() : nullptr;
+    if (thread_clock_) { thread_clock_->addThread(); }
     if (thread_.start(threadEntryPoint, this)) { return true; }
+    if (thread_clock_) { thread_clock_->removeThread(); }
     return false;
 }
 
@@ -214,6 +275,12 @@ void ThreadedNodeBase::stop() {
     if (creating_thread_id_ == std::this_thread::get_id()) { thread_.waitForTermination(); }
 }
 
+Duration ThreadedNodeBase::threadBusyTime() const {
+    int64_t end = thread_end_ns_;
+    if (end == 0) { end = Timestamp::systemNow().nanoSecondsSince1970(); }
+    return Duration::nanoSeconds(end - thread_start_ns_ - thread_idle_ns_);
+}
+
 bool ThreadedNodeBase::isRunning() const { return NodeBase::isRunning() && thread_.isRunning(); }
 
 void ThreadedNodeBase::waitUntilStopped() {
@@ -223,6 +290,9 @@ void ThreadedNodeBase::waitUntilStopped() {
 
 void ThreadedNodeBase::threadEntryPoint(void* ptr) {
     ThreadedNodeBase* instance = static_cast<ThreadedNodeBase*>(ptr);
+    Clock* clock = instance->thread_clock_;
+    Clock::setCurrent(clock);
+    Clock::setIdleMeter(&instance->thread_idle_ns_);
 
 #ifdef MEDIAGRAPH_USE_EASY_PROFILER
     EASY_THREAD(instance->name().c_str());
@@ -236,8 +306,19 @@ void ThreadedNodeBase::threadEntryPoint(void* ptr) {
     }
 
     NodeBase* base = static_cast<NodeBase*>(instance);
+
+    // Unless asked to stop or cut from its inputs, the node reached the end
+    // of its data: let readers drain what it wrote.
+    if (!instance->thread_must_quit_ && instance->allPinsConnectedAndOpen()) {
+        base->finishAllStreams();
+    }
     instance->thread_must_quit_ = true;
     base->stop();
+
+    instance->thread_end_ns_ = Timestamp::systemNow().nanoSecondsSince1970();
+    Clock::setIdleMeter(nullptr);
+    if (clock) { clock->removeThread(); }
+    Clock::setCurrent(nullptr);
 }
 
 }  // namespace media_graph
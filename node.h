@@ -27,10 +27,13 @@
 #ifndef MEDIAGRAPH_NODE_H
 #define MEDIAGRAPH_NODE_H
 
+#include <atomic>
 #include <string>
 
+#include "clock.h"
 #include "property.h"
 #include "thread_primitives.h"
+#include "timestamp.h"
 
 namespace media_graph {
 class Graph;
@@ -80,6 +83,9 @@ public:
     /// Gets a stream by its name. Returns null if no stream has this name.
     virtual NamedStream* getOutputStreamByName(const std::string& name);
 
+    /// Returns the index of the output stream called <name>, or -1.
+    int outputStreamIndex(const std::string& name) const;
+
     /// Returns the number of input pins. Any node with at least one input pins
     /// must overload this method.
     virtual int numInputPin() const { return 0; }
@@ -94,6 +100,9 @@ public:
     /// Returns the pin named <name>, or null if there is no such pin.
     virtual NamedPin* getInputPinByName(const std::string& name);
 
+    /// Returns the index of the input pin called <name>, or -1.
+    int inputPinIndex(const std::string& name) const;
+
     /// Wait for any input pin to receive new data. To know which one, iterate
     /// call tryRead on all input pins.
     void waitForPinActivity() const;
@@ -107,11 +116,24 @@ public:
     void openAllStreams();
     void closeAllStreams();
 
-    void signalActivity() { pin_activity_.notify_all(); }
+    /// Marks the end of the data on all output streams. Readers get the
+    /// entries already written, then end of stream. \see NamedStream::finish
+    void finishAllStreams();
+
+    /// True if the node has input pins, and they all read everything from a
+    /// finished stream.
+    bool allPinsAtEndOfStream() const;
+
+    void signalActivity();
 
     const std::string& name() const { return name_; }
     Graph* graph() const { return graph_; }
 
+    /// False when the graph runs in batch mode: sources should then produce
+    /// as fast as their readers consume, instead of sleeping to follow a
+    /// rate or recorded timestamps. \see Graph::setBatchMode
+    bool shouldPace() const;
+
     /// Sets the node membership to a graph. Called by Graph::addNode() only.
     /// Fails if if the node is already part of a graph.
     bool setNameAndGraph(const std::string& name, Graph* graph);
@@ -120,16 +142,23 @@ public:
     void detach();
 
 private:
-    mutable std::condition_variable pin_activity_;
+    // Counts signalActivity() calls, so that waitForPinActivity() can check
+    // the pins without holding pin_activity_mutex_, and still not miss one.
+    std::atomic<uint64_t> pin_activity_count_;
+    mutable ClockCondition pin_activity_;
     mutable std::mutex pin_activity_mutex_;
 
     mutable std::condition_variable stop_event_;
     mutable std::mutex stop_event_mutex_;
 
+    // Built on the first lookup by name, for nodes with many streams or pins.
+    mutable std::atomic<NameIndex*> stream_index_;
+    mutable std::atomic<NameIndex*> pin_index_;
+
     Graph* graph_;
     std::string name_;
-    bool running_;
-    bool stopping_;
+    std::atomic<bool> running_;
+    std::atomic<bool> stopping_;
 };
 
 /*! Convenience class for nodes that need their own thread.
@@ -151,19 +180,39 @@ public:
 
     bool startThread();
 
+    /// System time the thread spent working since it started, excluding the
+    /// time blocked on streams, pins, or sleeping. \see IdleTimer
+    Duration threadBusyTime() const;
+
+    /// When the thread last exited, or the epoch if it is running.
+    Timestamp threadEndTime() const { return Timestamp::nanoSecondsSince1970(thread_end_ns_); }
+
 protected:
     /*! Inheriting classes must implement a thread loop, in the form:
      *  while (!threadMustQuit()) { }
+     *  When threadMain() returns on its own, or because all the inputs reached
+     *  their end of stream, the output streams are finished rather than
+     *  closed: readers get the trailing entries, and the end propagates
+     *  downstream. A node with several inputs keeps running while one of
+     *  them is at its end: reads on that pin fail, with endOfStream() set.
      */
     virtual void threadMain() = 0;
 
-    bool threadMustQuit() const { return thread_must_quit_ || !allPinsConnectedAndOpen(); }
+    bool threadMustQuit() const {
+        return thread_must_quit_ || !allPinsConnectedAndOpen() || allPinsAtEndOfStream();
+    }
 
 private:
     static void threadEntryPoint(void* ptr);
     Thread thread_;
     std::thread::id creating_thread_id_;
-    bool thread_must_quit_;
+    std::atomic<bool> thread_must_quit_;
+    Clock* thread_clock_ = nullptr;
+
+    // System times, in nanoseconds, for threadBusyTime().
+    std::atomic<int64_t> thread_start_ns_{0};
+    std::atomic<int64_t> thread_end_ns_{0};
+    std::atomic<int64_t> thread_idle_ns_{0};
 };
 
 }  // namespace media_graph
@@ -0,0 +1,396 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "packet_stream.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace media_graph {
+
+namespace {
+    const size_t kAlignment = 8;
+    const uint32_t kWrapMarker = 1;
+
+    size_t align(size_t size) { return (size + kAlignment - 1) & ~(kAlignment - 1); }
+}  // namespace
+
+// Precedes each packet in the arena. A header flagged kWrapMarker tells
+// readers that the next record starts at offset 0.
+struct PacketStream::Header {
+    int64_t timestamp;
+    SequenceId sequence_id;
+    uint32_t size;
+    uint32_t flags;
+};
+
+const char kPacketTypeName[] = "packet";
+
+TypeId packetTypeId() {
+    static const TypeId id = registerType(typeIdFromName(kPacketTypeName), kPacketTypeName);
+    return id;
+}
+
+size_t PacketStream::recordSize(size_t packet_size) {
+    return align(sizeof(Header) + packet_size);
+}
+
+PacketStream::PacketStream(const std::string& name, NodeBase* node, StreamDropPolicy drop_policy,
+                           size_t arena_bytes)
+    : NamedStream(name, node),
+      arena_(align(arena_bytes < 2 * sizeof(Header) ? 2 * sizeof(Header) : arena_bytes)),
+      head_(0),
+      tail_(0),
+      num_packets_(0),
+      bytes_in_queue_(0),
+      oldest_sequence_id_(0),
+      closed_(false),
+      next_sequence_id_(0),
+      drop_policy_(drop_policy),
+      lossless_(false),
+      last_written_timestamp_(Timestamp::microSecondsSince1970(0)) {
+    addGetProperty("NumUpdates", this, &PacketStream::getNumUpdateCalls);
+    addGetProperty("NumPacketsInQueue", this, &PacketStream::numPacketsInQueue);
+    addGetProperty("BytesInQueue", this, &PacketStream::bytesInQueue);
+    addGetProperty("ArenaSize", this, &PacketStream::arenaSize);
+}
+
+PacketStream::~PacketStream() {
+    close();
+
+    // Our unregisterReader() is not reachable anymore from ~NamedStream().
+    disconnectReaders();
+}
+
+size_t PacketStream::maxPacketSize() const {
+    return (arena_.size() - sizeof(Header)) & ~(kAlignment - 1);
+}
+
+PacketStream::Header* PacketStream::headerAt(size_t offset) {
+    return reinterpret_cast<Header*>(&arena_[offset]);
+}
+
+const PacketStream::Header* PacketStream::headerAt(size_t offset) const {
+    return reinterpret_cast<const Header*>(&arena_[offset]);
+}
+
+size_t PacketStream::normalize(size_t offset) const {
+    if (arena_.size() - offset < sizeof(Header) || (headerAt(offset)->flags & kWrapMarker) != 0) {
+        return 0;
+    }
+    return offset;
+}
+
+size_t PacketStream::reserve(size_t record_size) const {
+    const size_t capacity = arena_.size();
+    const size_t no_room = capacity;
+
+    if (num_packets_ == 0) {
+        // head_ and tail_ are reset to 0 when the arena gets empty.
+        return record_size <= capacity ? 0 : no_room;
+    }
+    if (head_ > tail_) {
+        if (capacity - head_ >= record_size) { return head_; }
+        return tail_ >= record_size ? 0 : no_room;
+    }
+    if (head_ < tail_ && tail_ - head_ >= record_size) { return head_; }
+
+    // head_ == tail_ on a non-empty arena means it is full.
+    return no_room;
+}
+
+bool PacketStream::canDropOldest(bool unread) const {
+    if (num_packets_ == 0) { return false; }
+
+    const Header* oldest = headerAt(tail_);
+    for (int i = 0; i < numReaders(); ++i) {
+        const PacketReader* reader = static_cast<const PacketReader*>(this->reader(i));
+        if (reader->held_sequence_id_ == oldest_sequence_id_) { return false; }
+        if (!unread && reader->last_read_sequence_id_ < oldest_sequence_id_ &&
+            reader->seek_ < Timestamp::nanoSecondsSince1970(oldest->timestamp)) {
+            // Not read yet.
+            return false;
+        }
+    }
+    return true;
+}
+
+void PacketStream::dropOldest() {
+    assert(num_packets_ > 0);
+    const size_t record_size = recordSize(headerAt(tail_)->size);
+
+    {
+        SeqLockWriter write(&counters_lock_);
+        --num_packets_;
+        bytes_in_queue_ -= record_size;
+    }
+    ++oldest_sequence_id_;
+    if (num_packets_ == 0) {
+        head_ = 0;
+        tail_ = 0;
+    } else {
+        tail_ = normalize(tail_ + record_size);
+    }
+}
+
+bool PacketStream::update(Timestamp timestamp, const void* data, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Make sure we do not go back in time.
+    assert(!(timestamp < last_written_timestamp_));
+    if (timestamp < last_written_timestamp_) { return false; }
+    last_written_timestamp_ = timestamp;
+
+    if (closed_ || size > maxPacketSize()) { return false; }
+
+    const SequenceId sequence_id = next_sequence_id_;
+    if (numReaders() == 0) {
+        // Nobody would read it: do not store it.
+        {
+            SeqLockWriter write(&counters_lock_);
+            ++next_sequence_id_;
+        }
+        ++oldest_sequence_id_;
+        return true;
+    }
+
+    const size_t record_size = recordSize(size);
+    size_t offset = reserve(record_size);
+    while (!closed_ && offset == arena_.size()) {
+        if (canDropOldest(!lossless_ && (drop_policy_ & DROP_ANY) != 0)) {
+            dropOldest();
+        } else {
+#ifdef MEDIAGRAPH_USE_EASY_PROFILER
+            const StackString<128> blockName{"waitUpdate ", streamName().c_str(), "<packet>"};
+            EASY_BLOCK(blockName, profiler::colors::LightGreen50);
+#endif
+            slot_available_.wait(lock);
+        }
+        offset = reserve(record_size);
+    }
+    if (closed_) { return false; }
+
+    if (offset != head_ && arena_.size() - head_ >= sizeof(Header)) {
+        headerAt(head_)->flags = kWrapMarker;
+    }
+
+    Header* header = headerAt(offset);
+    header->timestamp = timestamp.nanoSecondsSince1970();
+    header->sequence_id = sequence_id;
+    header->size = static_cast<uint32_t>(size);
+    header->flags = 0;
+    if (size > 0) { memcpy(&arena_[offset + sizeof(Header)], data, size); }
+
+    if (num_packets_ == 0) { tail_ = offset; }
+    head_ = offset + record_size;
+    {
+        SeqLockWriter write(&counters_lock_);
+        ++num_packets_;
+        ++next_sequence_id_;
+        bytes_in_queue_ += record_size;
+    }
+
+    data_available_.notifyAll();
+    for (int i = 0; i < numReaders(); ++i) { reader(i)->signalActivity(); }
+    return true;
+}
+
+bool PacketStream::hasPacketFor(const PacketReader* reader) const {
+    const SequenceId next = reader->last_read_sequence_id_ + 1;
+    return (next < next_sequence_id_ && num_packets_ > 0 &&
+            reader->seek_ < last_written_timestamp_);
+}
+
+bool PacketStream::findAndReadPacket(PacketReader* reader, PacketSpan* packet) {
+    reader->held_sequence_id_ = -1;
+
+    bool found = false;
+    SequenceId next = reader->last_read_sequence_id_ + 1;
+    while (!found) {
+        if (next < oldest_sequence_id_) { next = oldest_sequence_id_; }
+        if (next >= next_sequence_id_) { break; }
+
+        // The packet follows the one last read, unless that one was dropped.
+        const size_t offset = (next == oldest_sequence_id_ ? tail_
+                                                          : normalize(reader->next_offset_));
+        const Header* header = headerAt(offset);
+        assert(header->sequence_id == next);
+
+        reader->last_read_sequence_id_ = next;
+        reader->next_offset_ = offset + recordSize(header->size);
+
+        const Timestamp timestamp = Timestamp::nanoSecondsSince1970(header->timestamp);
+        if (reader->seek_ < timestamp) {
+            packet->data = &arena_[offset + sizeof(Header)];
+            packet->size = header->size;
+            packet->timestamp = timestamp;
+            packet->sequence_id = next;
+            reader->held_sequence_id_ = next;
+            found = true;
+        }
+        ++next;
+    }
+
+    // Reclaim the packets read by everybody.
+    while (canDropOldest(false)) { dropOldest(); }
+    slot_available_.notifyOne();
+    return found;
+}
+
+bool PacketStream::read(PacketReader* reader, PacketSpan* packet) {
+    if (closed_ || !reader->isConnected()) { return false; }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!closed_ && reader->isConnected() && !findAndReadPacket(reader, packet)) {
+#ifdef MEDIAGRAPH_USE_EASY_PROFILER
+        const StackString<128> blockName{"waitRead ", reader->name().c_str(), "<packet>"};
+        EASY_BLOCK(blockName, profiler::colors::BlueGrey50);
+#endif
+        data_available_.wait(lock);
+    }
+    return !closed_ && reader->isConnected();
+}
+
+bool PacketStream::tryRead(PacketReader* reader, PacketSpan* packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !closed_ && reader->isConnected() && findAndReadPacket(reader, packet);
+}
+
+bool PacketStream::canRead(const PacketReader* reader) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !closed_ && hasPacketFor(reader);
+}
+
+void PacketStream::release(PacketReader* reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reader->held_sequence_id_ = -1;
+    while (canDropOldest(false)) { dropOldest(); }
+    slot_available_.notifyOne();
+}
+
+void PacketStream::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+
+    // Let's tell everybody it is no use to wait for us, we're closed.
+    data_available_.notifyAll();
+    slot_available_.notifyAll();
+    for (int i = 0; i < numReaders(); ++i) { reader(i)->signalActivity(); }
+}
+
+void PacketStream::open() {
+    const bool lossless = graphBatchMode();
+    std::lock_guard<std::mutex> lock(mutex_);
+    lossless_ = lossless;
+    if (closed_) {
+        head_ = 0;
+        tail_ = 0;
+        oldest_sequence_id_ = 0;
+        {
+            SeqLockWriter write(&counters_lock_);
+            num_packets_ = 0;
+            bytes_in_queue_ = 0;
+            next_sequence_id_ = 0;
+        }
+        for (int i = 0; i < numReaders(); ++i) {
+            PacketReader* packet_reader = static_cast<PacketReader*>(reader(i));
+            packet_reader->last_read_sequence_id_ = -1;
+            packet_reader->held_sequence_id_ = -1;
+        }
+    }
+    closed_ = false;
+}
+
+bool PacketStream::unregisterReader(NamedPin* reader) {
+    if (!NamedStream::unregisterReader(reader)) { return false; }
+
+    // The disconnected reader might be waiting. Let's wake it.
+    reader->signalActivity();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    static_cast<PacketReader*>(reader)->held_sequence_id_ = -1;
+    while (canDropOldest(false)) { dropOldest(); }
+    data_available_.notifyAll();
+    slot_available_.notifyAll();
+    return true;
+}
+
+PacketReader::PacketReader(const std::string& name, NodeBase* node)
+    : NamedPin(name, node),
+      stream_(nullptr),
+      seek_(Timestamp::microSecondsSince1970(0)),
+      next_offset_(0),
+      held_sequence_id_(-1) {
+    last_read_sequence_id_ = -1;
+}
+
+PacketReader::~PacketReader() { disconnect(); }
+
+bool PacketReader::read(PacketSpan* packet) { return stream_ && stream_->read(this, packet); }
+
+bool PacketReader::tryRead(PacketSpan* packet) {
+    return stream_ && stream_->tryRead(this, packet);
+}
+
+bool PacketReader::canRead() const { return stream_ && stream_->canRead(this); }
+
+void PacketReader::release() {
+    if (stream_) { stream_->release(this); }
+}
+
+bool PacketReader::seek(Timestamp timestamp) {
+    if (!(timestamp < seek_)) {
+        seek_ = timestamp;
+        return true;
+    }
+    return false;
+}
+
+bool PacketReader::connect(NamedStream* stream) {
+    disconnect();
+    if (typeId() == stream->typeId()) {
+        stream_ = dynamic_cast<PacketStream*>(stream);
+        if (stream_) {
+            last_read_sequence_id_ = -1;
+            held_sequence_id_ = -1;
+            next_offset_ = 0;
+            stream_->registerReader(this);
+        }
+    }
+    return stream_ != nullptr;
+}
+
+void PacketReader::disconnect() {
+    if (stream_) {
+        // We make sure isConnected() reports false before unregistering.
+        PacketStream* stream_copy = stream_;
+        stream_ = nullptr;
+        stream_copy->unregisterReader(this);
+        if (node()) { node()->stop(); }
+    }
+}
+
+}  // namespace media_graph
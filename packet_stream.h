@@ -0,0 +1,212 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_PACKET_STREAM_H
+#define MEDIAGRAPH_PACKET_STREAM_H
+
+#include "stream.h"
+#include "stream_reader.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace media_graph {
+
+class PacketReader;
+
+//! Type name of PacketStream and PacketReader.
+extern const char kPacketTypeName[];
+
+//! Type id of PacketStream and PacketReader. Registers it on first call.
+TypeId packetTypeId();
+
+//! A packet read from a PacketStream. Points into the stream arena.
+struct PacketSpan {
+    PacketSpan() : data(nullptr), size(0), timestamp(Timestamp::microSecondsSince1970(0)),
+                   sequence_id(-1) {}
+
+    const uint8_t* data;
+    size_t size;
+    Timestamp timestamp;
+    SequenceId sequence_id;
+};
+
+/*! A stream of variable-size binary packets, such as encoded video or audio.
+ *
+ *  Packets are copied back to back into a circular arena allocated once, at
+ *  construction. Each packet is preceded by a small header holding its
+ *  timestamp and size. Readers get a PacketSpan pointing into the arena:
+ *  there is no allocation, and no copy on read.
+ *
+ *  A span remains valid until the next read on the same PacketReader, or
+ *  until PacketReader::release(). The stream never overwrites a packet held
+ *  by a reader: with NEVER_BLOCK_DROP_OLDEST, update() drops the oldest
+ *  packets to make room, but waits if one of them is held. Other policies
+ *  wait until all connected readers have read the oldest packet.
+ *
+ *  The typeName() is "packet". Connect it to a PacketReader.
+ */
+class PacketStream : public NamedStream {
+public:
+    PacketStream(const std::string& name, NodeBase* node,
+                 StreamDropPolicy drop_policy = WAIT_FOR_CONSUMPTION_NEVER_DROP,
+                 size_t arena_bytes = 1 << 20);
+    ~PacketStream();
+
+    std::string typeName() const override { return kPacketTypeName; }
+    TypeId typeId() const override { return packetTypeId(); }
+
+    /*! Copies a packet into the arena, potentially blocking, depending on
+     *  the drop policy. Returns false if the stream is closed, or if the
+     *  packet can not fit in the arena.
+     */
+    bool update(Timestamp timestamp, const void* data, size_t size);
+
+    void close() override;
+    void open() override;
+    bool isOpen() const override { return !closed_; }
+    bool unregisterReader(NamedPin* reader) override;
+
+    StreamDropPolicy drop_policy() const { return drop_policy_; }
+    Timestamp lastWrittenTimestamp() const { return last_written_timestamp_; }
+
+    int64_t getNumUpdateCalls() const { return next_sequence_id_; }
+    int64_t numUpdates() const override { return next_sequence_id_; }
+    int numPacketsInQueue() const { return num_packets_; }
+    int64_t bytesInQueue() const { return bytes_in_queue_; }
+    int64_t arenaSize() const { return int64_t(arena_.size()); }
+
+    //! Largest packet the arena can hold.
+    size_t maxPacketSize() const;
+
+private:
+    struct Header;
+
+    // Bytes used in the arena by a packet of <packet_size> bytes.
+    static size_t recordSize(size_t packet_size);
+
+    bool read(PacketReader* reader, PacketSpan* packet);
+    bool tryRead(PacketReader* reader, PacketSpan* packet);
+    bool canRead(const PacketReader* reader) const;
+    void release(PacketReader* reader);
+
+    // Assumes mutex_ is held.
+    bool findAndReadPacket(PacketReader* reader, PacketSpan* packet);
+    bool hasPacketFor(const PacketReader* reader) const;
+    size_t reserve(size_t record_size) const;
+    // True if no reader holds the oldest packet, and, unless <unread>, if
+    // all readers have read it.
+    bool canDropOldest(bool unread) const;
+    void dropOldest();
+
+    Header* headerAt(size_t offset);
+    const Header* headerAt(size_t offset) const;
+
+    // Offset of the record starting at <offset>, following wrap markers.
+    size_t normalize(size_t offset) const;
+
+    std::vector<uint8_t> arena_;
+
+    // Write position, and position of the oldest packet.
+    size_t head_;
+    size_t tail_;
+
+    // Atomic, for properties read without mutex_.
+    std::atomic<int> num_packets_;
+    std::atomic<int64_t> bytes_in_queue_;
+    SequenceId oldest_sequence_id_;
+
+    bool closed_;
+    // Report blocked threads to their clock. \see VirtualClock
+    ClockCondition data_available_;
+    ClockCondition slot_available_;
+    std::atomic<int64_t> next_sequence_id_;
+    StreamDropPolicy drop_policy_;
+    // Set when opening in batch mode: never drop. Protected by mutex_.
+    bool lossless_;
+    Timestamp last_written_timestamp_;
+
+    friend class PacketReader;
+};
+
+/*! Reads packets from a PacketStream, without copying them.
+ *  \see PacketStream
+ */
+class PacketReader : public NamedPin {
+public:
+    PacketReader(const std::string& name, NodeBase* node);
+    virtual ~PacketReader();
+
+    /*! Reads the next packet, blocking until one is available. The packet
+     *  previously read is released first: its span becomes invalid.
+     */
+    bool read(PacketSpan* packet);
+
+    //! Same as read(), but returns false instead of waiting.
+    bool tryRead(PacketSpan* packet);
+    virtual bool canRead() const;
+
+    //! Lets the stream reuse the memory of the packet last read.
+    void release();
+
+    //! Skips packets with a timestamp equal or lower than <timestamp>.
+    bool seek(Timestamp timestamp);
+    Timestamp seekPosition() const { return seek_; }
+
+    virtual std::string typeName() const { return kPacketTypeName; }
+    TypeId typeId() const override { return packetTypeId(); }
+    virtual bool connect(NamedStream* stream);
+    virtual void disconnect();
+    virtual bool isConnected() const { return stream_ != nullptr; }
+    virtual NamedStream* connectedStream() const { return stream_; }
+
+    virtual void openConnectedStream() {
+        if (isConnected()) stream_->open();
+    }
+    virtual void closeConnectedStream() {
+        if (isConnected()) stream_->close();
+    }
+
+private:
+    PacketStream* stream_;
+    Timestamp seek_;
+
+    // Arena offset of the packet following last_read_sequence_id_. Only
+    // meaningful if that packet is newer than the oldest one in the arena.
+    size_t next_offset_;
+
+    // Packet held by the reader, or -1.
+    SequenceId held_sequence_id_;
+
+    friend class PacketStream;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_PACKET_STREAM_H
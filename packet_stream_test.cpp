@@ -0,0 +1,193 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <gtest/gtest.h>
+
+#include "graph.h"
+#include "node.h"
+#include "packet_stream.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace media_graph {
+
+namespace {
+
+    class PacketSourceNode : public NodeBase {
+    public:
+        PacketSourceNode(StreamDropPolicy policy, size_t arena_bytes)
+            : output("out", this, policy, arena_bytes) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        bool write(int64_t microseconds, const std::string& packet) {
+            return output.update(Timestamp::microSecondsSince1970(microseconds), packet.data(),
+                                 packet.size());
+        }
+
+        PacketStream output;
+    };
+
+    class PacketSinkNode : public NodeBase {
+    public:
+        PacketSinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        std::string readString() {
+            PacketSpan packet;
+            if (!input.tryRead(&packet)) { return "<none>"; }
+            return std::string(reinterpret_cast<const char*>(packet.data), packet.size);
+        }
+
+        PacketReader input;
+    };
+
+    std::string makePacket(int index, int size) {
+        std::string packet(size, 'a' + char(index % 26));
+        if (size > 0) { packet[0] = char(index); }
+        return packet;
+    }
+
+}  // namespace
+
+TEST(PacketStreamTest, ReadsSpansIntoTheArena) {
+    Graph graph;
+    auto source =
+        graph.newNode<PacketSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 1024);
+    auto sink = graph.newNode<PacketSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source->write(1000, "hello"));
+    EXPECT_TRUE(source->write(2000, ""));
+    EXPECT_TRUE(source->write(3000, "world!"));
+    EXPECT_EQ(3, source->output.numPacketsInQueue());
+
+    PacketSpan packet;
+    EXPECT_TRUE(sink->input.read(&packet));
+    EXPECT_EQ("hello", std::string(reinterpret_cast<const char*>(packet.data), packet.size));
+    EXPECT_EQ(Timestamp::microSecondsSince1970(1000), packet.timestamp);
+    EXPECT_EQ(0, packet.sequence_id);
+
+    EXPECT_TRUE(sink->input.read(&packet));
+    EXPECT_EQ(0u, packet.size);
+    EXPECT_TRUE(sink->input.canRead());
+    EXPECT_EQ("world!", sink->readString());
+    EXPECT_FALSE(sink->input.canRead());
+
+    // Only the packet held by the reader remains.
+    EXPECT_EQ(1, source->output.numPacketsInQueue());
+    sink->input.release();
+    EXPECT_EQ(0, source->output.numPacketsInQueue());
+    EXPECT_EQ(0, source->output.bytesInQueue());
+
+    EXPECT_FALSE(source->write(4000, std::string(2000, 'x')));
+    graph.stop();
+}
+
+TEST(PacketStreamTest, WrapsAround) {
+    Graph graph;
+    auto source =
+        graph.newNode<PacketSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 512);
+    auto sink = graph.newNode<PacketSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    // Keep two packets in flight, with sizes that do not divide the arena.
+    int num_read = 0;
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_TRUE(source->write(1000 + i, makePacket(i, (i * 7) % 50)));
+        if (i >= 1) {
+            EXPECT_EQ(makePacket(num_read, (num_read * 7) % 50), sink->readString());
+            ++num_read;
+        }
+    }
+    EXPECT_EQ(makePacket(199, (199 * 7) % 50), sink->readString());
+    graph.stop();
+}
+
+TEST(PacketStreamTest, DropsOldest) {
+    Graph graph;
+    auto source = graph.newNode<PacketSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 256);
+    auto sink = graph.newNode<PacketSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 20; ++i) { EXPECT_TRUE(source->write(1000 + i, makePacket(i, 40))); }
+    EXPECT_GT(20, source->output.numPacketsInQueue());
+    EXPECT_LE(source->output.bytesInQueue(), source->output.arenaSize());
+
+    PacketSpan packet;
+    SequenceId previous = -1;
+    int num_read = 0;
+    while (sink->input.tryRead(&packet)) {
+        EXPECT_LT(previous, packet.sequence_id);
+        EXPECT_EQ(makePacket(int(packet.sequence_id), 40),
+                  std::string(reinterpret_cast<const char*>(packet.data), packet.size));
+        previous = packet.sequence_id;
+        ++num_read;
+    }
+    EXPECT_EQ(19, previous);
+    EXPECT_EQ(0, source->output.numPacketsInQueue());
+    EXPECT_LT(1, num_read);
+    graph.stop();
+}
+
+TEST(PacketStreamTest, WaitsForReaders) {
+    Graph graph;
+    auto source =
+        graph.newNode<PacketSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 256);
+    auto sink = graph.newNode<PacketSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    int num_written = 0;
+    while (source->output.bytesInQueue() + 64 <= source->output.arenaSize()) {
+        EXPECT_TRUE(source->write(1000 + num_written, makePacket(num_written, 40)));
+        ++num_written;
+    }
+
+    std::thread producer([&]() { EXPECT_TRUE(source->write(5000, makePacket(99, 40))); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(num_written, source->output.numPacketsInQueue());
+
+    for (int i = 0; i < num_written; ++i) { EXPECT_EQ(makePacket(i, 40), sink->readString()); }
+    producer.join();
+    EXPECT_EQ(makePacket(99, 40), sink->readString());
+    graph.stop();
+}
+
+}  // namespace media_graph
@@ -0,0 +1,87 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "periodic_timer.h"
+
+#include <assert.h>
+
+PeriodicTimer::PeriodicTimer(Duration period, Duration spin)
+    : period_(period),
+      spin_(spin),
+      started_(false),
+      tick_index_(-1),
+      num_ticks_(0),
+      num_overruns_(0),
+      lateness_ns_(0) {
+    assert(period > Duration());
+}
+
+void PeriodicTimer::start(Timestamp first) {
+    started_ = true;
+    next_tick_ = first;
+}
+
+Timestamp PeriodicTimer::wait() {
+    if (!started_) { start(Timestamp::now()); }
+
+    Timestamp tick = next_tick_;
+    Timestamp now = Timestamp::now();
+    if (now < tick) {
+        Timestamp::sleepUntil(tick, spin_);
+        now = Timestamp::now();
+    } else if (now - tick >= period_) {
+        const int64_t missed = (now - tick).nanoSeconds() / period_.nanoSeconds();
+        tick += period_ * missed;
+        tick_index_ += missed;
+        num_overruns_ += missed;
+    }
+
+    last_tick_ = tick;
+    next_tick_ = tick + period_;
+    ++tick_index_;
+    ++num_ticks_;
+    lateness_ns_ = (now - tick).nanoSeconds();
+    return tick;
+}
+
+Timestamp PeriodicTimer::advance() {
+    if (!started_) { start(Timestamp::now()); }
+
+    const Timestamp tick = next_tick_;
+    last_tick_ = tick;
+    next_tick_ = tick + period_;
+    ++tick_index_;
+    ++num_ticks_;
+    lateness_ns_ = 0;
+    return tick;
+}
+
+bool PeriodicTimer::setPeriod(Duration period) {
+    if (!(period > Duration())) { return false; }
+    period_ = period;
+    if (num_ticks_ > 0) { next_tick_ = last_tick_ + period; }
+    return true;
+}
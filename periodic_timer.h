@@ -0,0 +1,102 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef BASE_PERIODIC_TIMER_H
+#define BASE_PERIODIC_TIMER_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "timestamp.h"
+
+/*! Wakes a thread at a fixed rate, without drift.
+ *
+ *  Tick <n> is scheduled at first + n * period, and wait() sleeps until that
+ *  absolute deadline: a late wake up delays one tick, not the following
+ *  ones. When the caller is late by more than a period, the missed ticks
+ *  are skipped and counted as overruns.
+ *
+ *  Example, producing frames at 90 Hz:
+ *  \code
+ *  PeriodicTimer timer(Duration::seconds(1.0 / 90), Duration::microSeconds(200));
+ *  while (!threadMustQuit()) {
+ *      Timestamp tick = timer.wait();
+ *      output.update(tick, render());
+ *  }
+ *  \endcode
+ *
+ *  A timer is used by a single thread. The counters can be read from any
+ *  thread.
+ */
+class PeriodicTimer {
+public:
+    //! Ticks every <period>, busy waiting the last <spin> before each tick.
+    explicit PeriodicTimer(Duration period, Duration spin = Duration());
+
+    //! Schedules the next tick at <first>. By default, the first call to
+    //! wait() schedules it immediately.
+    void start(Timestamp first);
+
+    //! Blocks until the next tick, and returns its scheduled time.
+    Timestamp wait();
+
+    //! Returns the next tick at once, without sleeping nor skipping ticks.
+    //! For unpaced runs, that follow the tick times as fast as they can.
+    Timestamp advance();
+
+    Duration period() const { return period_; }
+    //! Applies from the tick following the last one. Must be positive.
+    bool setPeriod(Duration period);
+
+    Duration spin() const { return spin_; }
+    void setSpin(Duration spin) { spin_ = spin; }
+
+    //! Number of the last tick returned by wait(), missed ticks included.
+    int64_t tickIndex() const { return tick_index_; }
+
+    //! Ticks returned by wait().
+    int64_t numTicks() const { return num_ticks_; }
+
+    //! Ticks skipped because wait() was called too late.
+    int64_t numOverruns() const { return num_overruns_; }
+
+    //! How late the last tick was delivered, after its scheduled time.
+    Duration lateness() const { return Duration::nanoSeconds(lateness_ns_); }
+
+private:
+    Duration period_;
+    Duration spin_;
+    bool started_;
+    Timestamp last_tick_;
+    Timestamp next_tick_;
+
+    std::atomic<int64_t> tick_index_;
+    std::atomic<int64_t> num_ticks_;
+    std::atomic<int64_t> num_overruns_;
+    std::atomic<int64_t> lateness_ns_;
+};
+
+#endif  // BASE_PERIODIC_TIMER_H
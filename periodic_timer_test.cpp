@@ -0,0 +1,110 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include "clock.h"
+#include "periodic_timer.h"
+
+namespace {
+
+Timestamp ms(int64_t milliseconds) { return Timestamp::microSecondsSince1970(milliseconds * 1000); }
+
+}  // namespace
+
+TEST(PeriodicTimerTest, TicksWithoutDrift) {
+    VirtualClock clock(ms(1000));
+    ClockScope scope(&clock);
+
+    PeriodicTimer timer(Duration::milliSeconds(10));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(ms(1000 + 10 * i), timer.wait());
+        EXPECT_EQ(i, timer.tickIndex());
+
+        // Work taking less than a period does not shift the next ticks.
+        Duration::milliSeconds(3).sleep();
+    }
+    EXPECT_EQ(100, timer.numTicks());
+    EXPECT_EQ(0, timer.numOverruns());
+    EXPECT_EQ(Duration(), timer.lateness());
+}
+
+TEST(PeriodicTimerTest, AdvanceDoesNotSleep) {
+    const Timestamp start = Timestamp::now();
+    PeriodicTimer timer(Duration::seconds(1));
+    timer.start(start);
+    for (int i = 0; i < 10; ++i) { EXPECT_EQ(start + Duration::seconds(i), timer.advance()); }
+    EXPECT_LT(Timestamp::now() - start, Duration::seconds(1));
+    EXPECT_EQ(9, timer.tickIndex());
+    EXPECT_EQ(0, timer.numOverruns());
+}
+
+TEST(PeriodicTimerTest, SkipsAndCountsOverruns) {
+    VirtualClock clock;
+    ClockScope scope(&clock);
+
+    PeriodicTimer timer(Duration::milliSeconds(10));
+    timer.start(ms(100));
+    EXPECT_EQ(ms(100), timer.wait());
+
+    // Busy for 3.5 periods: the ticks at 110 and 120 are missed, and the
+    // one at 130 is late.
+    Duration::milliSeconds(35).sleep();
+    EXPECT_EQ(ms(130), timer.wait());
+    EXPECT_EQ(3, timer.tickIndex());
+    EXPECT_EQ(2, timer.numOverruns());
+    EXPECT_EQ(Duration::milliSeconds(5), timer.lateness());
+
+    EXPECT_EQ(ms(140), timer.wait());
+    EXPECT_EQ(3, timer.numTicks());
+}
+
+TEST(PeriodicTimerTest, ChangesPeriodFromTheLastTick) {
+    VirtualClock clock;
+    ClockScope scope(&clock);
+
+    PeriodicTimer timer(Duration::milliSeconds(10));
+    timer.start(ms(0));
+    EXPECT_EQ(ms(0), timer.wait());
+    EXPECT_EQ(ms(10), timer.wait());
+    EXPECT_FALSE(timer.setPeriod(Duration()));
+    EXPECT_TRUE(timer.setPeriod(Duration::milliSeconds(25)));
+    EXPECT_EQ(ms(35), timer.wait());
+    EXPECT_EQ(ms(60), timer.wait());
+}
+
+TEST(PeriodicTimerTest, SleepsUntilAbsoluteDeadlines) {
+    const Timestamp deadline = Timestamp::now() + Duration::milliSeconds(5);
+    Timestamp::sleepUntil(deadline, Duration::microSeconds(500));
+    const Timestamp after = Timestamp::now();
+    EXPECT_LE(deadline, after);
+    // The thread can be preempted after waking up, for example while other
+    // tests run in parallel, hence the loose upper bound.
+    EXPECT_GT(50e-3, (after - deadline).seconds());
+
+    // Deadlines in the past return at once.
+    Timestamp::sleepUntil(deadline - Duration::seconds(1));
+}
@@ -0,0 +1,478 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_POLICY_STREAM_H
+#define MEDIAGRAPH_POLICY_STREAM_H
+
+#include "stream.h"
+#include "stream_reader.h"
+
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace media_graph {
+
+//! PolicyStream drop policy: update() never blocks, it drops the oldest entry.
+struct DropOldestPolicy {
+    static constexpr bool kDropOldest = true;
+};
+
+//! PolicyStream drop policy: entries are kept until all readers read them.
+struct WaitForConsumptionPolicy {
+    static constexpr bool kDropOldest = false;
+};
+
+//! PolicyStream lock policy: a std::mutex. Required by BlockingWaitPolicy.
+struct MutexLockPolicy {
+    typedef std::mutex Mutex;
+    static constexpr bool kThreadSafe = true;
+};
+
+//! PolicyStream lock policy: a spin lock, for very short critical sections.
+struct SpinLockPolicy {
+    class Mutex {
+    public:
+        Mutex() { flag_.clear(); }
+        void lock() {
+            while (flag_.test_and_set(std::memory_order_acquire)) { std::this_thread::yield(); }
+        }
+        void unlock() { flag_.clear(std::memory_order_release); }
+
+    private:
+        std::atomic_flag flag_;
+    };
+    static constexpr bool kThreadSafe = true;
+};
+
+/*! PolicyStream lock policy: no locking at all. Only valid if the producer
+ *  and all the readers run in the same thread. Requires NoWaitPolicy.
+ */
+struct NoLockPolicy {
+    struct Mutex {
+        void lock() {}
+        void unlock() {}
+    };
+    static constexpr bool kThreadSafe = false;
+};
+
+/*! PolicyStream wait policy: sleep on a condition variable. Waiting
+ *  threads are reported idle to their clock. Requires a std::mutex.
+ */
+struct BlockingWaitPolicy {
+    class Waiter {
+    public:
+        template <class Lock, class Predicate> bool wait(Lock& lock, Predicate ready) {
+            condition_.wait(lock, ready);
+            return true;
+        }
+        void notifyAll() { condition_.notifyAll(); }
+
+    private:
+        ClockCondition condition_;
+    };
+    static constexpr bool kCanWait = true;
+};
+
+/*! PolicyStream wait policy: yield until the condition holds. Nobody to
+ *  notify. A spinning thread counts as busy: a VirtualClock does not move
+ *  while it waits, so graphs on a virtual clock should not use it.
+ */
+struct SpinWaitPolicy {
+    class Waiter {
+    public:
+        template <class Lock, class Predicate> bool wait(Lock& lock, Predicate ready) {
+            while (!ready()) {
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+            }
+            return true;
+        }
+        void notifyAll() {}
+    };
+    static constexpr bool kCanWait = true;
+};
+
+/*! PolicyStream wait policy: never wait. read() behaves as tryRead(), and
+ *  update() refuses entries instead of waiting for readers.
+ */
+struct NoWaitPolicy {
+    class Waiter {
+    public:
+        template <class Lock, class Predicate> bool wait(Lock&, Predicate ready) {
+            return ready();
+        }
+        void notifyAll() {}
+    };
+    static constexpr bool kCanWait = false;
+};
+
+/*! A Stream<T> variant with its behavior chosen at compile time.
+ *
+ *  Stream<T> supports every drop policy, reader windows and byte budgets,
+ *  and pays for the corresponding branches on every entry. PolicyStream
+ *  only implements a bounded FIFO, specialized by:
+ *   - DropPolicy: DropOldestPolicy or WaitForConsumptionPolicy,
+ *   - LockPolicy: MutexLockPolicy, SpinLockPolicy or NoLockPolicy,
+ *   - WaitPolicy: BlockingWaitPolicy, SpinWaitPolicy or NoWaitPolicy.
+ *  The class is final: calls made on a PolicyStream are resolved at compile
+ *  time and inlined. It is read with a regular StreamReader<T>, or with a
+ *  PolicyReader to also inline the reads, and appears as any other stream
+ *  for reflection and the http server.
+ *
+ *  Rate limits and decimation of readers are applied when reading. Reader
+ *  windows are not supported.
+ *
+ *  Example, for an edge between two nodes sharing the same thread:
+ *  \code
+ *  PolicyStream<int, DropOldestPolicy, NoLockPolicy, NoWaitPolicy> output;
+ *  \endcode
+ */
+template <class T, class DropPolicy = WaitForConsumptionPolicy,
+          class LockPolicy = MutexLockPolicy, class WaitPolicy = BlockingWaitPolicy>
+class PolicyStream final : public StreamBase<T> {
+public:
+    static_assert(LockPolicy::kThreadSafe || !WaitPolicy::kCanWait,
+                  "Waiting requires a thread safe lock policy.");
+    static_assert(!std::is_same<WaitPolicy, BlockingWaitPolicy>::value ||
+                      std::is_same<LockPolicy, MutexLockPolicy>::value,
+                  "BlockingWaitPolicy requires MutexLockPolicy.");
+
+    PolicyStream(const std::string& name, NodeBase* node, int max_queue_size = 4);
+    ~PolicyStream();
+
+    /*! Pushes an entry. With WaitForConsumptionPolicy, waits for readers if
+     *  the queue is full, or returns false with NoWaitPolicy.
+     */
+    bool update(Timestamp timestamp, T data);
+
+    std::string typeName() const override { return media_graph::typeName<T>(); }
+
+    void close() override;
+    void open() override;
+    bool isOpen() const override { return !closed_; }
+
+    void registerReader(NamedPin* reader) override;
+    bool unregisterReader(NamedPin* reader) override;
+
+    Timestamp lastWrittenTimestamp() const { return last_written_timestamp_; }
+    int64_t getNumUpdateCalls() const { return next_sequence_id_; }
+    int numItemsInQueue() const { return num_items_; }
+    int maxQueueSize() const { return queue_limit_; }
+
+protected:
+    bool read(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq) override;
+    bool tryRead(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                 SequenceId* seq) override;
+    bool canRead(SequenceId consumed_until, Timestamp fresher_than) const override;
+
+    // Called by NamedStream::unregisterReader(), data_mutex_ held.
+    void decreaseReadCountUntil(SequenceId seq) override;
+
+private:
+    template <class, class> friend class PolicyReader;
+
+    typedef typename LockPolicy::Mutex Mutex;
+    typedef std::unique_lock<Mutex> Lock;
+
+    struct Entry {
+        Entry(Timestamp timestamp, SequenceId sequence_id, T data)
+            : timestamp(timestamp), sequence_id(sequence_id), data(data), num_reads(0) {}
+
+        Timestamp timestamp;
+        SequenceId sequence_id;
+        T data;
+        int num_reads;
+    };
+
+    // All the following functions assume data_mutex_ is held.
+    bool findAndReadEntry(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                          SequenceId* seq);
+    bool hasEntryFor(SequenceId consumed_until, Timestamp fresher_than) const;
+    bool isFull() const { return buffer_.size() >= static_cast<size_t>(queue_limit_); }
+    void dropReadEntries();
+    void updateNumItems() { num_items_ = int(buffer_.size()); }
+
+    // Protects buffer_ and the reader list. Taken before NamedStream::mutex_.
+    mutable Mutex data_mutex_;
+    typename WaitPolicy::Waiter data_available_;
+    typename WaitPolicy::Waiter slot_available_;
+
+    // Sequence ids are contiguous in buffer_: entries are found by index.
+    std::deque<Entry> buffer_;
+    const int queue_limit_;
+    std::atomic<int> num_items_;
+    std::atomic<bool> closed_;
+    std::atomic<int64_t> next_sequence_id_;
+    Timestamp last_written_timestamp_;
+};
+
+/*! A StreamReader<T> that only connects to a <Stream_t> PolicyStream. Its
+ *  read(), tryRead() and canRead() call the stream without going through
+ *  the virtual StreamBase<T> interface, so that they can be inlined too.
+ *  Other calls, and the graph, use it as any StreamReader<T>.
+ *
+ *  Example:
+ *  \code
+ *  typedef PolicyStream<int, DropOldestPolicy, NoLockPolicy, NoWaitPolicy> Edge;
+ *  PolicyReader<int, Edge> input;
+ *  \endcode
+ */
+template <class T, class Stream_t> class PolicyReader final : public StreamReader<T> {
+public:
+    static_assert(std::is_base_of<StreamBase<T>, Stream_t>::value,
+                  "Stream_t must be a PolicyStream<T, ...>.");
+
+    PolicyReader(const std::string& name, NodeBase* node)
+        : StreamReader<T>(name, node), stream_(nullptr) {}
+
+    bool read(T* data, Timestamp* timestamp, SequenceId* seq = 0) {
+        return stream_ && stream_->read(this, data, timestamp, seq);
+    }
+    bool tryRead(T* data, Timestamp* timestamp, SequenceId* seq = 0) {
+        return stream_ && stream_->tryRead(this, data, timestamp, seq);
+    }
+    bool canRead() const override {
+        return stream_ && stream_->canRead(this->lastReadSequenceId(), this->seekPosition());
+    }
+
+    //! Fails if <stream> is not a <Stream_t>.
+    bool connect(NamedStream* stream) override {
+        Stream_t* typed = dynamic_cast<Stream_t*>(stream);
+        if (!typed) {
+            disconnect();
+            return false;
+        }
+        if (!StreamReader<T>::connect(stream)) { return false; }
+        stream_ = typed;
+        return true;
+    }
+    void disconnect() override {
+        stream_ = nullptr;
+        StreamReader<T>::disconnect();
+    }
+
+private:
+    Stream_t* stream_;
+};
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::PolicyStream(const std::string& name,
+                                                                  NodeBase* node,
+                                                                  int max_queue_size)
+    : StreamBase<T>(name, node),
+      queue_limit_(max_queue_size > 0 ? max_queue_size : 1),
+      num_items_(0),
+      closed_(false),
+      next_sequence_id_(0),
+      last_written_timestamp_(Timestamp::microSecondsSince1970(0)) {
+    this->addGetProperty("NumUpdates", this, &PolicyStream::getNumUpdateCalls);
+    this->addGetProperty("NumItemsInQueue", this, &PolicyStream::numItemsInQueue);
+    this->addGetProperty("MaxQueueSize", this, &PolicyStream::maxQueueSize);
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::~PolicyStream() {
+    close();
+
+    // Our unregisterReader() is not reachable anymore from ~NamedStream().
+    this->disconnectReaders();
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+inline bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::update(Timestamp timestamp,
+                                                                        T data) {
+    Lock lock(data_mutex_);
+
+    // Make sure we do not go back in time.
+    assert(!(timestamp < last_written_timestamp_));
+    if (timestamp < last_written_timestamp_ || closed_) { return false; }
+    last_written_timestamp_ = timestamp;
+
+    if (this->numReaders() == 0) {
+        // Nobody would read it: do not store it.
+        buffer_.clear();
+        SeqLockWriter write(&this->counters_lock_);
+        ++next_sequence_id_;
+        updateNumItems();
+        return true;
+    }
+
+    if (DropPolicy::kDropOldest) {
+        while (isFull()) { buffer_.pop_front(); }
+    } else if (isFull() &&
+               (!slot_available_.wait(lock, [this]() { return closed_ || !isFull(); }) ||
+                closed_)) {
+        // Refused. The sequence id is not consumed: ids in buffer_ stay contiguous.
+        return false;
+    }
+
+    buffer_.push_back(Entry(timestamp, next_sequence_id_, data));
+    {
+        SeqLockWriter write(&this->counters_lock_);
+        ++next_sequence_id_;
+        updateNumItems();
+    }
+    data_available_.notifyAll();
+    for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->signalActivity(); }
+    return true;
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+inline bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::findAndReadEntry(
+    StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq) {
+    if (buffer_.empty()) { return false; }
+
+    SequenceId* consumed_until = reader->lastReadSequenceIdPtr();
+    const SequenceId first = buffer_.front().sequence_id;
+    const Timestamp fresher_than = reader->seekPosition();
+
+    bool found = false;
+    for (size_t i = (*consumed_until < first ? 0 : size_t(*consumed_until + 1 - first));
+         !found && i < buffer_.size(); ++i) {
+        Entry& entry = buffer_[i];
+        *consumed_until = entry.sequence_id;
+        ++entry.num_reads;
+        if (fresher_than < entry.timestamp &&
+            reader->acceptsEntry(entry.timestamp, entry.sequence_id)) {
+            reader->markAccepted(entry.timestamp, entry.sequence_id);
+            if (data) { *data = entry.data; }
+            if (timestamp) { *timestamp = entry.timestamp; }
+            if (seq) { *seq = entry.sequence_id; }
+            found = true;
+        }
+    }
+    if (!DropPolicy::kDropOldest) { dropReadEntries(); }
+    return found;
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+inline void PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::dropReadEntries() {
+    const int num_readers = this->numReaders();
+    bool dropped = false;
+    while (!buffer_.empty() && buffer_.front().num_reads >= num_readers) {
+        buffer_.pop_front();
+        dropped = true;
+    }
+    if (dropped) {
+        updateNumItems();
+        slot_available_.notifyAll();
+    }
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::hasEntryFor(
+    SequenceId consumed_until, Timestamp fresher_than) const {
+    return !buffer_.empty() && consumed_until < buffer_.back().sequence_id &&
+           fresher_than < buffer_.back().timestamp;
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::read(StreamReader<T>* reader, T* data,
+                                                               Timestamp* timestamp,
+                                                               SequenceId* seq) {
+    Lock lock(data_mutex_);
+    bool found = false;
+    data_available_.wait(lock, [&]() {
+        if (closed_ || !reader->isConnected()) { return true; }
+        found = findAndReadEntry(reader, data, timestamp, seq);
+        return found;
+    });
+    return found && !closed_ && reader->isConnected();
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::tryRead(StreamReader<T>* reader,
+                                                                  T* data, Timestamp* timestamp,
+                                                                  SequenceId* seq) {
+    Lock lock(data_mutex_);
+    return !closed_ && reader->isConnected() && findAndReadEntry(reader, data, timestamp, seq);
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::canRead(SequenceId consumed_until,
+                                                                  Timestamp fresher_than) const {
+    Lock lock(data_mutex_);
+    return !closed_ && hasEntryFor(consumed_until, fresher_than);
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+void PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::decreaseReadCountUntil(
+    SequenceId seq) {
+    for (Entry& entry : buffer_) {
+        if (entry.sequence_id <= seq) { --entry.num_reads; }
+    }
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+void PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::registerReader(NamedPin* reader) {
+    Lock lock(data_mutex_);
+    StreamBase<T>::registerReader(reader);
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+bool PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::unregisterReader(NamedPin* reader) {
+    Lock lock(data_mutex_);
+    if (!StreamBase<T>::unregisterReader(reader)) { return false; }
+
+    // The disconnected reader might be waiting. Let's wake it.
+    reader->signalActivity();
+    data_available_.notifyAll();
+    if (!DropPolicy::kDropOldest) { dropReadEntries(); }
+    slot_available_.notifyAll();
+    return true;
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+void PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::close() {
+    Lock lock(data_mutex_);
+    buffer_.clear();
+    updateNumItems();
+    closed_ = true;
+
+    // Let's tell everybody it is no use to wait for us, we're closed.
+    data_available_.notifyAll();
+    slot_available_.notifyAll();
+    for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->signalActivity(); }
+}
+
+template <class T, class DropPolicy, class LockPolicy, class WaitPolicy>
+void PolicyStream<T, DropPolicy, LockPolicy, WaitPolicy>::open() {
+    Lock lock(data_mutex_);
+    if (closed_) {
+        SeqLockWriter write(&this->counters_lock_);
+        next_sequence_id_ = 0;
+    }
+    closed_ = false;
+}
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_POLICY_STREAM_H
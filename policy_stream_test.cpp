@@ -0,0 +1,238 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <gtest/gtest.h>
+
+#include "graph.h"
+#include "node.h"
+#include "policy_stream.h"
+#include "stream_reader.h"
+#include "types/type_definition.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace media_graph {
+
+namespace {
+
+    template <class Output> class SourceNode : public NodeBase {
+    public:
+        SourceNode(int max_queue_size = 4) : output("out", this, max_queue_size) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        Output output;
+    };
+
+    class IntSinkNode : public NodeBase {
+    public:
+        IntSinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<int> input;
+    };
+
+    template <class Stream_t> class PolicySinkNode : public NodeBase {
+    public:
+        PolicySinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        PolicyReader<int, Stream_t> input;
+    };
+
+    Timestamp at(int64_t microseconds) { return Timestamp::microSecondsSince1970(microseconds); }
+
+}  // namespace
+
+TEST(PolicyStreamTest, DropOldest) {
+    typedef SourceNode<PolicyStream<int, DropOldestPolicy>> Source;
+    Graph graph;
+    auto source = graph.newNode<Source>("source", 3);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 10; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), i)); }
+    EXPECT_EQ(3, source->output.numItemsInQueue());
+
+    std::vector<int> values;
+    int value;
+    Timestamp timestamp;
+    SequenceId seq;
+    while (sink->input.tryRead(&value, &timestamp, &seq)) { values.push_back(value); }
+    EXPECT_EQ(std::vector<int>({7, 8, 9}), values);
+    EXPECT_EQ(9, seq);
+    EXPECT_EQ(at(1009), timestamp);
+    graph.stop();
+}
+
+TEST(PolicyStreamTest, WaitForConsumption) {
+    typedef SourceNode<PolicyStream<int>> Source;
+    Graph graph;
+    auto source = graph.newNode<Source>("source", 2);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source->output.update(at(1000), 0));
+    EXPECT_TRUE(source->output.update(at(2000), 1));
+    std::thread producer([&]() { EXPECT_TRUE(source->output.update(at(3000), 2)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+
+    for (int i = 0; i < 3; ++i) {
+        int value;
+        Timestamp timestamp;
+        EXPECT_TRUE(sink->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+    }
+    producer.join();
+    EXPECT_EQ(0, source->output.numItemsInQueue());
+    graph.stop();
+}
+
+TEST(PolicyStreamTest, SingleThreadNoLockNoWait) {
+    typedef SourceNode<PolicyStream<int, WaitForConsumptionPolicy, NoLockPolicy, NoWaitPolicy>>
+        Source;
+    Graph graph;
+    auto source = graph.newNode<Source>("source", 2);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source->output.update(at(1000), 0));
+    EXPECT_TRUE(source->output.update(at(2000), 1));
+
+    // Full: refused instead of waiting.
+    EXPECT_FALSE(source->output.update(at(3000), 2));
+
+    int value;
+    Timestamp timestamp;
+    EXPECT_TRUE(sink->input.read(&value, &timestamp));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(source->output.update(at(4000), 3));
+    EXPECT_TRUE(sink->input.read(&value, &timestamp));
+    EXPECT_EQ(1, value);
+    EXPECT_TRUE(sink->input.read(&value, &timestamp));
+    EXPECT_EQ(3, value);
+
+    // Nothing to read: read() does not wait.
+    EXPECT_FALSE(sink->input.canRead());
+    EXPECT_FALSE(sink->input.read(&value, &timestamp));
+    graph.stop();
+}
+
+TEST(PolicyStreamTest, SpinLockAcrossThreads) {
+    typedef SourceNode<PolicyStream<int, WaitForConsumptionPolicy, SpinLockPolicy, SpinWaitPolicy>>
+        Source;
+    Graph graph;
+    auto source = graph.newNode<Source>("source", 8);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    const int num_values = 10000;
+    std::thread producer([&]() {
+        for (int i = 0; i < num_values; ++i) { source->output.update(at(1000 + i), i); }
+    });
+
+    int num_read = 0;
+    for (int i = 0; i < num_values; ++i) {
+        int value;
+        Timestamp timestamp;
+        ASSERT_TRUE(sink->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+        ++num_read;
+    }
+    producer.join();
+    EXPECT_EQ(num_values, num_read);
+    graph.stop();
+}
+
+TEST(PolicyStreamTest, ReadersCanDecimate) {
+    typedef SourceNode<PolicyStream<int, DropOldestPolicy, MutexLockPolicy, NoWaitPolicy>> Source;
+    Graph graph;
+    auto source = graph.newNode<Source>("source", 16);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+    EXPECT_TRUE(sink->input.setDecimation(2));
+
+    for (int i = 0; i < 6; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), i)); }
+    std::vector<int> values;
+    int value;
+    Timestamp timestamp;
+    while (sink->input.tryRead(&value, &timestamp)) { values.push_back(value); }
+    EXPECT_EQ(std::vector<int>({0, 2, 4}), values);
+
+    // Visible as any other stream.
+    NamedStream* stream = source->outputStream(0);
+    EXPECT_EQ("int", stream->typeName());
+    EXPECT_EQ(3, stream->numProperty());
+    graph.stop();
+}
+
+TEST(PolicyStreamTest, PolicyReaderOnlyConnectsToItsStream) {
+    typedef PolicyStream<int, WaitForConsumptionPolicy, NoLockPolicy, NoWaitPolicy> Edge;
+    Graph graph;
+    auto source = graph.newNode<SourceNode<Edge>>("source", 2);
+    auto other = graph.newNode<SourceNode<PolicyStream<int>>>("other");
+    auto sink = graph.newNode<PolicySinkNode<Edge>>("sink");
+    EXPECT_FALSE(graph.connect(other, "out", sink, "in"));
+    EXPECT_FALSE(sink->input.isConnected());
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source->output.update(at(1000), 5));
+    EXPECT_TRUE(sink->input.canRead());
+    int value;
+    Timestamp timestamp;
+    EXPECT_TRUE(sink->input.read(&value, &timestamp));
+    EXPECT_EQ(5, value);
+    EXPECT_EQ(at(1000), timestamp);
+    EXPECT_FALSE(sink->input.tryRead(&value, &timestamp));
+
+    sink->input.disconnect();
+    EXPECT_FALSE(sink->input.canRead());
+    EXPECT_FALSE(sink->input.read(&value, &timestamp));
+    graph.stop();
+}
+
+}  // namespace media_graph
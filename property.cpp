@@ -28,7 +28,48 @@
 #include <assert.h>
 
 namespace media_graph {
+namespace {
+    // A property of a PropertyTable, bound to an instance.
+    class BoundProperty : public NamedProperty {
+    public:
+        BoundProperty(const PropertyDescriptor* descriptor, void* instance)
+            : NamedProperty(descriptor->name()), descriptor_(descriptor), instance_(instance) {}
+
+        virtual std::string typeName() const { return descriptor_->typeName(); }
+        virtual TypeId typeId() const { return descriptor_->typeId(); }
+        virtual bool isWritable() const { return descriptor_->isWritable(); }
+
+        virtual bool apply(TypeConstVisitor* operation) const {
+            return descriptor_->apply(instance_, operation);
+        }
+        virtual bool apply(TypeVisitor* operation) {
+            bool changed = false;
+            const bool result = descriptor_->apply(instance_, operation, &changed);
+            if (changed) { markChanged(); }
+            return result;
+        }
+
+    private:
+        const PropertyDescriptor* descriptor_;
+        void* instance_;
+    };
+}  // namespace
+
+struct PropertyList::BoundProperties {
+    BoundProperties(int size) : properties(new std::atomic<NamedProperty*>[size]), size(size) {
+        for (int i = 0; i < size; ++i) { properties[i] = nullptr; }
+    }
+    ~BoundProperties() {
+        for (int i = 0; i < size; ++i) { delete properties[i].load(); }
+    }
+
+    std::unique_ptr<std::atomic<NamedProperty*>[]> properties;
+    int size;
+};
+
 PropertyList::~PropertyList() {
+    NameIndex::release(&name_index_);
+    delete bound_.exchange(nullptr);
     while (!properties_.empty()) {
         delete properties_.back();
         properties_.pop_back();
@@ -36,18 +77,49 @@ PropertyList::~PropertyList() {
 }
 
 NamedProperty* PropertyList::property(int id) {
-    if (unsigned(id) < properties_.size()) { return properties_[id]; }
+    const int table_size = tableSize();
+    if (id >= 0 && id < table_size) { return boundProperty(id); }
+    if (unsigned(id - table_size) < properties_.size()) { return properties_[id - table_size]; }
     return 0;
 }
 
+NamedProperty* PropertyList::boundProperty(int id) {
+    // Objects are created on first access, possibly by concurrent threads:
+    // the first one to publish its object wins.
+    BoundProperties* bound = bound_.load(std::memory_order_acquire);
+    if (!bound) {
+        BoundProperties* created = new BoundProperties(table_->size());
+        if (bound_.compare_exchange_strong(bound, created)) {
+            bound = created;
+        } else {
+            delete created;
+        }
+    }
+
+    std::atomic<NamedProperty*>& slot = bound->properties[id];
+    NamedProperty* property = slot.load(std::memory_order_acquire);
+    if (!property) {
+        NamedProperty* created = new BoundProperty(&(*table_)[id], host_);
+        if (slot.compare_exchange_strong(property, created)) {
+            property = created;
+        } else {
+            delete created;
+        }
+    }
+    return property;
+}
+
 NamedProperty* PropertyList::getPropertyByName(const std::string& name) {
-    int num_props = numProperty();
-    for (int i = 0; i < num_props; ++i) {
+    const int index = propertyIndex(name);
+    return index >= 0 ? property(index) : 0;
+}
+
+int PropertyList::propertyIndex(const std::string& name) {
+    return NameIndex::find(&name_index_, name, numProperty(), [this](int i) {
         NamedProperty* prop = property(i);
         assert(prop != 0);
-        if (prop && (name == prop->name())) { return prop; }
-    }
-    return 0;
+        return prop ? &prop->name() : nullptr;
+    });
 }
 
 }  // namespace media_graph
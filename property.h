@@ -27,9 +27,15 @@
 #ifndef MEDIAGRAPH_PROPERTY_H
 #define MEDIAGRAPH_PROPERTY_H
 
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "name_index.h"
 #include "types/binary_serializer.h"
 #include "types/string_serializer.h"
 #include "types/type_definition.h"
@@ -72,17 +78,41 @@ namespace media_graph {
 //!     };
 class NamedProperty {
 public:
-    NamedProperty(const std::string& name) : name_(name) {}
+    NamedProperty(const std::string& name) : name_(name), change_count_(0) {}
+    NamedProperty(const NamedProperty& other) : name_(other.name_), change_count_(0) {}
+    NamedProperty& operator=(const NamedProperty& other) {
+        name_ = other.name_;
+        markChanged();
+        return *this;
+    }
     virtual ~NamedProperty() {}
 
     //! Returns the property name.
     const std::string& name() const { return name_; }
 
+    /*! Tells subscribers that the value changed. Cheap enough for hot paths:
+     *  it only increments a counter, subscribers are notified later by a
+     *  PropertyDispatcher thread. Setters call it automatically.
+     */
+    void markChanged() { change_count_.fetch_add(1, std::memory_order_release); }
+
+    //! Number of markChanged() calls, used by PropertyDispatcher.
+    uint32_t changeCount() const { return change_count_.load(std::memory_order_acquire); }
+
     //! Returns a string describing the property type.
     virtual std::string typeName() const = 0;
 
+    //! Identifies typeName() without allocating.
+    virtual TypeId typeId() const { return typeIdFromName(typeName()); }
+
     virtual bool isWritable() const { return true; }
 
+    /*! True if every change of the value calls markChanged(), as for
+     *  Property<T>. Others, such as properties backed by get and set
+     *  methods, can change without being marked.
+     */
+    virtual bool marksChanges() const { return false; }
+
     //! Apply a read-only visitor.
     virtual bool apply(TypeConstVisitor* operation) const = 0;
 
@@ -90,7 +120,7 @@ public:
     virtual bool apply(TypeVisitor* operation) = 0;
 
     //! Returns the value as string
-    std::string ValueToString() {
+    std::string ValueToString() const {
         StringSerializer serializer;
         apply(&serializer);
         return serializer.value();
@@ -120,6 +150,7 @@ public:
 
 private:
     std::string name_;
+    std::atomic<uint32_t> change_count_;
 };
 
 //! Common interface for a typed property. Inherited by \see Property and
@@ -129,16 +160,17 @@ public:
     PropertyInterface(const std::string& name) : NamedProperty(name) {}
 
     virtual std::string typeName() const { return media_graph::typeName<T>(); }
+    virtual TypeId typeId() const { return TypeTraits<T>::id(); }
 
     virtual T get() const = 0;
     virtual bool set(const T& value) = 0;
 
-    virtual bool apply(TypeConstVisitor* operation) const { return operation->process(get()); }
+    virtual bool apply(TypeConstVisitor* operation) const { return visitValue(operation, get()); }
 
     virtual bool apply(TypeVisitor* operation) {
         T temporary = get();
-        bool result = operation->process(&temporary);
-        if (get() != temporary) { set(temporary); }
+        bool result = visitValue(operation, &temporary);
+        if (result && !(get() == temporary) && set(temporary)) { this->markChanged(); }
         return result;
     }
 };
@@ -153,12 +185,24 @@ public:
     virtual T get() const { return value_; }
     virtual bool set(const T& value) {
         value_ = value;
+        this->markChanged();
         return true;
     }
 
+    virtual bool marksChanges() const { return true; }
+
+    //! Call markChanged() after modifying the value, to notify subscribers.
     T& getMutable() { return value_; }
 
-    virtual bool apply(TypeVisitor* operation) { return operation->process(&value_); }
+    virtual bool apply(TypeVisitor* operation) {
+        // Visit a copy, so that a struct or array that fails half way
+        // through leaves the value untouched.
+        T temporary = value_;
+        if (!visitValue(operation, &temporary)) { return false; }
+        value_ = std::move(temporary);
+        this->markChanged();
+        return true;
+    }
 
     Property<T>& operator=(const T& value) {
         set(value);
@@ -236,20 +280,120 @@ private:
     SetMethod_t setMethod_;
 };
 
+//! Class-level description of a property, shared by all the instances of
+//! a class. Accessors take the instance as argument.
+//! \see PropertyTable
+class PropertyDescriptor {
+public:
+    PropertyDescriptor(const char* name) : name_(name) {}
+    virtual ~PropertyDescriptor() {}
+
+    const std::string& name() const { return name_; }
+    virtual std::string typeName() const = 0;
+    virtual TypeId typeId() const = 0;
+    virtual bool isWritable() const = 0;
+
+    virtual bool apply(const void* instance, TypeConstVisitor* operation) const = 0;
+
+    //! Sets <*changed> when the visitor modified the value.
+    virtual bool apply(void* instance, TypeVisitor* operation, bool* changed) const = 0;
+
+private:
+    std::string name_;
+};
+
+//! Describes a property accessed through get and, optionally, set methods.
+//! Do not instanciate this class directly. Instead, \see PropertyTable.
+template <class Property_t, class Host_t> class AccessorDescriptor : public PropertyDescriptor {
+public:
+    typedef Property_t (Host_t::*GetMethod_t)() const;
+    typedef bool (Host_t::*SetMethod_t)(const Property_t&);
+
+    AccessorDescriptor(const char* name, GetMethod_t get, SetMethod_t set)
+        : PropertyDescriptor(name), getMethod_(get), setMethod_(set) {}
+
+    virtual std::string typeName() const { return media_graph::typeName<Property_t>(); }
+    virtual TypeId typeId() const { return TypeTraits<Property_t>::id(); }
+    virtual bool isWritable() const { return setMethod_ != nullptr; }
+
+    virtual bool apply(const void* instance, TypeConstVisitor* operation) const {
+        return visitValue(operation, (host(instance)->*getMethod_)());
+    }
+
+    virtual bool apply(void* instance, TypeVisitor* operation, bool* changed) const {
+        const Host_t* object = host(instance);
+        Property_t temporary = (object->*getMethod_)();
+        bool result = visitValue(operation, &temporary);
+
+        // A visitor failing half way through leaves the value untouched.
+        if (result && setMethod_ && !((object->*getMethod_)() == temporary)) {
+            *changed = (const_cast<Host_t*>(object)->*setMethod_)(temporary);
+        }
+        return result;
+    }
+
+private:
+    static const Host_t* host(const void* instance) { return static_cast<const Host_t*>(instance); }
+
+    GetMethod_t getMethod_;
+    SetMethod_t setMethod_;
+};
+
+//! The properties of a class, declared once and shared by all its
+//! instances. Compared to PropertyList::addGetProperty(), it saves a heap
+//! allocation per property and per instance. Example:
+//!        class Foo : public PropertyList {
+//!          public:
+//!            Foo() { setPropertyTable(&properties(), this); }
+//!
+//!            static const PropertyTable<Foo>& properties() {
+//!                static const PropertyTable<Foo> table = []() {
+//!                    PropertyTable<Foo> t;
+//!                    t.addGetSet("bar", &Foo::getBar, &Foo::setBar);
+//!                    t.addGet("foobar", &Foo::getFooBar);
+//!                    return t;
+//!                }();
+//!                return table;
+//!            }
+//!        };
+class PropertyTableBase {
+public:
+    int size() const { return int(descriptors_.size()); }
+    const PropertyDescriptor& operator[](int index) const { return *descriptors_[index]; }
+
+protected:
+    std::vector<std::unique_ptr<const PropertyDescriptor>> descriptors_;
+};
+
+template <class Host_t> class PropertyTable : public PropertyTableBase {
+public:
+    template <class Property_t>
+    void addGet(const char* name, Property_t (Host_t::*get)() const) {
+        descriptors_.emplace_back(new AccessorDescriptor<Property_t, Host_t>(name, get, nullptr));
+    }
+
+    template <class Property_t>
+    void addGetSet(const char* name, Property_t (Host_t::*get)() const,
+                   bool (Host_t::*set)(const Property_t&)) {
+        descriptors_.emplace_back(new AccessorDescriptor<Property_t, Host_t>(name, get, set));
+    }
+};
+
 //! Base class for classes exposing properties.
 //! \see NamedProperty for examples.
 class PropertyList {
 public:
     virtual ~PropertyList();
-    PropertyList() {}
+    PropertyList() : table_(nullptr), host_(nullptr), bound_(nullptr), name_index_(nullptr) {}
 
     //! The copy constructor does not copy properties, because properties are
     //! instance related anyway.
-    PropertyList(const PropertyList& /*a*/) {}
+    PropertyList(const PropertyList& /*a*/)
+        : table_(nullptr), host_(nullptr), bound_(nullptr), name_index_(nullptr) {}
 
     //! Returns the number of properties exposed by the object.
     //! Deriving classes must re-implement this method to expose properties.
-    virtual int numProperty() const { return properties_.size(); }
+    virtual int numProperty() const { return tableSize() + int(properties_.size()); }
 
     //! Get a pointer to a property. Returns 0 if the property id is not valid.
     //! Deriving classes must re-implement this method to expose properties.
@@ -263,6 +407,9 @@ public:
     //! Get a pointer to a property by its name. Returns null if no property has this name.
     virtual NamedProperty* getPropertyByName(const std::string& name);
 
+    //! Returns the id of the property called <name>, or -1. Hashed for long lists.
+    int propertyIndex(const std::string& name);
+
     //! Declares a new property with a get and a set method.
     //! \param name the property name.
     //! \param instance a pointer to the instance on which get/set should be
@@ -282,8 +429,34 @@ public:
         properties_.push_back(new GetProperty<Property_t, Host_t>(name, instance, get));
     }
 
+    //! Exposes the properties of a static table, bound to <instance>. They
+    //! come before properties added with addGetProperty and
+    //! addGetSetProperty. The NamedProperty objects returned by property()
+    //! are only allocated when first requested. An object has at most one
+    //! table: a class deriving from a class with a table can not add its own.
+    template <class Host_t>
+    void setPropertyTable(const PropertyTable<Host_t>* table, Host_t* instance) {
+        assert(!table_ /* the object already has a property table */);
+        table_ = table;
+        host_ = instance;
+    }
+
 private:
+    struct BoundProperties;
+
+    int tableSize() const { return table_ ? table_->size() : 0; }
+    NamedProperty* boundProperty(int id);
+
     std::vector<NamedProperty*> properties_;
+
+    const PropertyTableBase* table_;
+    void* host_;
+
+    // NamedProperty objects for table_, allocated on first access.
+    std::atomic<BoundProperties*> bound_;
+
+    // Built on the first lookup by name in a long property list.
+    std::atomic<NameIndex*> name_index_;
 };
 
 }  // namespace media_graph
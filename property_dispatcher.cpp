@@ -0,0 +1,155 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "property_dispatcher.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "types/string_serializer.h"
+
+namespace media_graph {
+
+PropertyDispatcher::PropertyDispatcher(double max_rate)
+    : next_id_(0), max_rate_(max_rate > 0 ? max_rate : 10), must_quit_(false) {}
+
+PropertyDispatcher::~PropertyDispatcher() { stop(); }
+
+PropertyDispatcher::Subscription PropertyDispatcher::subscribe(NamedProperty* property,
+                                                               Callback callback) {
+    if (!property) { return -1; }
+    return add(std::vector<Watched>(1, Watched(property)), callback);
+}
+
+PropertyDispatcher::Subscription PropertyDispatcher::subscribe(PropertyList* list,
+                                                               Callback callback) {
+    if (!list) { return -1; }
+    std::vector<Watched> watched;
+    for (int i = 0; i < list->numProperty(); ++i) {
+        if (NamedProperty* property = list->property(i)) { watched.push_back(Watched(property)); }
+    }
+    return add(watched, callback);
+}
+
+PropertyDispatcher::Subscription PropertyDispatcher::add(std::vector<Watched> watched,
+                                                         Callback callback) {
+    std::shared_ptr<Subscriber> subscriber = std::make_shared<Subscriber>();
+    subscriber->callback = callback;
+    subscriber->watched.swap(watched);
+    subscriber->active = true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriber->id = next_id_++;
+    subscribers_.push_back(subscriber);
+    return subscriber->id;
+}
+
+void PropertyDispatcher::unsubscribe(Subscription subscription) {
+    std::lock_guard<std::recursive_mutex> dispatching(dispatch_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+        if ((*it)->id == subscription) {
+            (*it)->active = false;
+            subscribers_.erase(it);
+            return;
+        }
+    }
+}
+
+bool PropertyDispatcher::setMaxRate(const double& hz) {
+    if (hz <= 0) { return false; }
+    max_rate_ = hz;
+    return true;
+}
+
+void PropertyDispatcher::dispatch() {
+    std::lock_guard<std::recursive_mutex> dispatching(dispatch_mutex_);
+
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers = subscribers_;
+    }
+
+    const Timestamp now = Timestamp::now();
+    std::vector<PropertyChange> changes;
+    for (const std::shared_ptr<Subscriber>& subscriber : subscribers) {
+        if (!subscriber->active) { continue; }
+
+        changes.clear();
+        for (Watched& watched : subscriber->watched) {
+            const uint32_t change_count = watched.property->changeCount();
+            const bool marked = !watched.seen || change_count != watched.change_count;
+
+            // Values that are always marked are only read once marked. Get
+            // methods can change without being marked: compare values.
+            if (!marked && watched.property->marksChanges()) { continue; }
+            std::string value = watched.property->ValueToString();
+            if (!marked && value == watched.value) { continue; }
+            watched.seen = true;
+            watched.change_count = change_count;
+            watched.value = value;
+            changes.push_back(PropertyChange{watched.property, value, now});
+        }
+        if (!changes.empty()) { subscriber->callback(changes); }
+    }
+}
+
+bool PropertyDispatcher::start() {
+    if (isRunning()) { return true; }
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        must_quit_ = false;
+    }
+    return thread_.start(threadEntryPoint, this);
+}
+
+void PropertyDispatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        must_quit_ = true;
+    }
+    stop_event_.notify_all();
+    thread_.waitForTermination();
+}
+
+void PropertyDispatcher::threadEntryPoint(void* ptr) {
+    static_cast<PropertyDispatcher*>(ptr)->threadMain();
+}
+
+void PropertyDispatcher::threadMain() {
+    std::unique_lock<std::mutex> lock(stop_mutex_);
+    while (!must_quit_) {
+        lock.unlock();
+        dispatch();
+        lock.lock();
+
+        const auto period = std::chrono::microseconds(int64_t(1e6 / max_rate_));
+        stop_event_.wait_for(lock, period, [this] { return must_quit_; });
+    }
+}
+
+}  // namespace media_graph
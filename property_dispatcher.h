@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_PROPERTY_DISPATCHER_H
+#define MEDIAGRAPH_PROPERTY_DISPATCHER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "property.h"
+#include "thread_primitives.h"
+#include "timestamp.h"
+
+namespace media_graph {
+
+//! A property value delivered by PropertyDispatcher.
+struct PropertyChange {
+    //! The changed property. Valid while the subscription exists.
+    NamedProperty* property;
+
+    //! The value, formatted by StringSerializer.
+    std::string value;
+
+    //! When the change was detected.
+    Timestamp time;
+};
+
+/*! Notifies subscribers of property changes, from a dedicated thread.
+ *
+ *  Changes of Property<T> values are detected with
+ *  NamedProperty::markChanged(), which their setters call: the dispatcher
+ *  only reads them once marked. Code modifying a value through
+ *  Property<T>::getMutable() must call markChanged(). Properties backed by
+ *  get and set methods, such as stream counters or queue sizes, can change
+ *  without being marked: they are compared with the value previously
+ *  delivered instead. Changes are coalesced: a subscriber
+ *  gets at most one batch per period, with the latest value of each
+ *  changed property. The first batch holds all the subscribed values.
+ *
+ *  Subscriber callbacks only run on the dispatcher thread, or in the thread
+ *  calling dispatch(): writers never run subscriber code.
+ *
+ *  Example:
+ *  \code
+ *  PropertyDispatcher dispatcher(5);  // at most 5 batches per second.
+ *  dispatcher.subscribe(node->outputStream(0), [](const std::vector<PropertyChange>& changes) {
+ *      for (const PropertyChange& change : changes) { ... }
+ *  });
+ *  dispatcher.start();
+ *  \endcode
+ *  Properties must outlive their subscription.
+ */
+class PropertyDispatcher {
+public:
+    typedef int Subscription;
+    typedef std::function<void(const std::vector<PropertyChange>& changes)> Callback;
+
+    explicit PropertyDispatcher(double max_rate = 10);
+    ~PropertyDispatcher();
+
+    //! Watches a single property. Returns an id for unsubscribe().
+    Subscription subscribe(NamedProperty* property, Callback callback);
+
+    //! Watches all the properties <list> has when subscribing.
+    Subscription subscribe(PropertyList* list, Callback callback);
+
+    //! Once it returns, the callback is not running and will not be called
+    //! again. Can be called from a callback.
+    void unsubscribe(Subscription subscription);
+
+    //! Maximum number of batches per second and per subscriber.
+    bool setMaxRate(const double& hz);
+    double maxRate() const { return max_rate_; }
+
+    //! Starts the dispatcher thread.
+    bool start();
+
+    //! Stops the dispatcher thread. Does nothing if not started.
+    void stop();
+
+    bool isRunning() const { return thread_.isRunning(); }
+
+    //! Detects changes and delivers them in the calling thread. Called
+    //! periodically by the dispatcher thread.
+    void dispatch();
+
+private:
+    struct Watched {
+        Watched(NamedProperty* property) : property(property), change_count(0), seen(false) {}
+
+        NamedProperty* property;
+        uint32_t change_count;
+        std::string value;
+        bool seen;
+    };
+
+    struct Subscriber {
+        Subscription id;
+        Callback callback;
+        std::vector<Watched> watched;
+        bool active;
+    };
+
+    Subscription add(std::vector<Watched> watched, Callback callback);
+
+    static void threadEntryPoint(void* ptr);
+    void threadMain();
+
+    // Protects subscribers_ and next_id_.
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<Subscriber>> subscribers_;
+    Subscription next_id_;
+
+    // Held while calling subscribers, so that unsubscribe() can wait for
+    // them. Recursive, for callbacks that unsubscribe.
+    std::recursive_mutex dispatch_mutex_;
+
+    std::atomic<double> max_rate_;
+
+    Thread thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_event_;
+    bool must_quit_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_PROPERTY_DISPATCHER_H
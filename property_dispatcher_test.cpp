@@ -0,0 +1,220 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "property_dispatcher.h"
+
+namespace media_graph {
+namespace {
+    class Counter : public PropertyList {
+    public:
+        Counter() : count_(0) {
+            addGetProperty("count", this, &Counter::count);
+            addGetSetProperty("limit", this, &Counter::limit, &Counter::setLimit);
+        }
+
+        int count() const { return count_; }
+        void increment() { ++count_; }
+
+        int limit() const { return limit_; }
+        bool setLimit(const int& limit) {
+            limit_ = limit;
+            return true;
+        }
+
+    private:
+        std::atomic<int> count_;
+        int limit_ = 0;
+    };
+
+    // A writable property backed by get and set methods.
+    class Setting : public PropertyList {
+    public:
+        Setting() { setPropertyTable(&properties(), this); }
+
+        static const PropertyTable<Setting>& properties() {
+            static const PropertyTable<Setting> table = []() {
+                PropertyTable<Setting> t;
+                t.addGetSet("value", &Setting::value, &Setting::setValue);
+                return t;
+            }();
+            return table;
+        }
+
+        int value() const { return value_; }
+        bool setValue(const int& value) {
+            value_ = value;
+            return true;
+        }
+
+    private:
+        int value_ = 0;
+    };
+
+    // Counts its reads.
+    class CountedProperty : public Property<int> {
+    public:
+        CountedProperty(const std::string& name) : Property<int>(name, 0) {}
+
+        virtual int get() const {
+            ++num_reads;
+            return Property<int>::get();
+        }
+
+        mutable int num_reads = 0;
+    };
+
+    struct Recorder {
+        void operator()(const std::vector<PropertyChange>& changes) {
+            ++num_batches;
+            for (const PropertyChange& change : changes) {
+                values.push_back(change.property->name() + "=" + change.value);
+            }
+        }
+
+        int num_batches = 0;
+        std::vector<std::string> values;
+    };
+
+    TEST(PropertyDispatcherTest, DeliversInitialValuesThenChanges) {
+        Counter counter;
+        Recorder recorder;
+        PropertyDispatcher dispatcher;
+        dispatcher.subscribe(&counter, std::ref(recorder));
+
+        dispatcher.dispatch();
+        ASSERT_EQ(1, recorder.num_batches);
+        EXPECT_EQ((std::vector<std::string>{"count=0", "limit=0"}), recorder.values);
+
+        // Nothing changed: nothing is delivered.
+        dispatcher.dispatch();
+        EXPECT_EQ(1, recorder.num_batches);
+
+        // Changes are coalesced: only the last value is delivered.
+        counter.increment();
+        counter.increment();
+        dispatcher.dispatch();
+        EXPECT_EQ(2, recorder.num_batches);
+        EXPECT_EQ("count=2", recorder.values.back());
+        EXPECT_EQ(3, int(recorder.values.size()));
+    }
+
+    TEST(PropertyDispatcherTest, MarkChangedForcesDelivery) {
+        Property<int> property("p", 1);
+        Recorder recorder;
+        PropertyDispatcher dispatcher;
+        dispatcher.subscribe(&property, std::ref(recorder));
+        dispatcher.dispatch();
+
+        // Set to the same value: writers still signal the write.
+        property.set(1);
+        dispatcher.dispatch();
+        EXPECT_EQ(2, recorder.num_batches);
+        EXPECT_EQ("p=1", recorder.values.back());
+    }
+
+    TEST(PropertyDispatcherTest, OnlyReadsValuesOnceMarked) {
+        CountedProperty property("p");
+        Recorder recorder;
+        PropertyDispatcher dispatcher;
+        dispatcher.subscribe(&property, std::ref(recorder));
+        dispatcher.dispatch();
+        EXPECT_EQ(1, recorder.num_batches);
+
+        const int num_reads = property.num_reads;
+        dispatcher.dispatch();
+        dispatcher.dispatch();
+        EXPECT_EQ(num_reads, property.num_reads);
+
+        property.set(3);
+        dispatcher.dispatch();
+        EXPECT_EQ(2, recorder.num_batches);
+        EXPECT_EQ("p=3", recorder.values.back());
+    }
+
+    TEST(PropertyDispatcherTest, SeesSetMethodsCalledDirectly) {
+        Setting setting;
+        NamedProperty* property = setting.getPropertyByName("value");
+        Recorder recorder;
+        PropertyDispatcher dispatcher;
+        dispatcher.subscribe(&setting, std::ref(recorder));
+        dispatcher.dispatch();
+        EXPECT_EQ(1, recorder.num_batches);
+
+        // Writing the same value does not mark the property.
+        const uint32_t change_count = property->changeCount();
+        EXPECT_TRUE(property->ValueFromString("0"));
+        EXPECT_EQ(change_count, property->changeCount());
+        dispatcher.dispatch();
+        EXPECT_EQ(1, recorder.num_batches);
+
+        // Setters called from C++ do not mark it either.
+        setting.setValue(3);
+        EXPECT_EQ(change_count, property->changeCount());
+        dispatcher.dispatch();
+        EXPECT_EQ(2, recorder.num_batches);
+        EXPECT_EQ("value=3", recorder.values.back());
+    }
+
+    TEST(PropertyDispatcherTest, UnsubscribeStopsDelivery) {
+        Counter counter;
+        Recorder recorder;
+        PropertyDispatcher dispatcher;
+        PropertyDispatcher::Subscription subscription =
+            dispatcher.subscribe(counter.getPropertyByName("count"), std::ref(recorder));
+        dispatcher.dispatch();
+        dispatcher.unsubscribe(subscription);
+
+        counter.increment();
+        dispatcher.dispatch();
+        EXPECT_EQ(1, recorder.num_batches);
+    }
+
+    TEST(PropertyDispatcherTest, ThreadLimitsTheBatchRate) {
+        Counter counter;
+        std::atomic<int> num_batches(0);
+        PropertyDispatcher dispatcher(20);
+        dispatcher.subscribe(&counter, [&num_batches](const std::vector<PropertyChange>&) {
+            ++num_batches;
+        });
+        ASSERT_TRUE(dispatcher.start());
+
+        // The counter changes much faster than the dispatcher rate.
+        const Timestamp end = Timestamp::now() + Duration::milliSeconds(200);
+        while (Timestamp::now() < end) { counter.increment(); }
+        dispatcher.stop();
+        EXPECT_FALSE(dispatcher.isRunning());
+
+        EXPECT_GE(num_batches, 1);
+        EXPECT_LE(num_batches, 6);
+    }
+
+}  // namespace
+}  // namespace media_graph
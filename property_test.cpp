@@ -26,6 +26,11 @@
 //
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "name_index.h"
 #include "property.h"
 #include "types/type_definition.h"
 
@@ -62,6 +67,88 @@ namespace {
         }
     };
 
+    class ManyProperties : public PropertyList {
+    public:
+        ManyProperties() {
+            for (int i = 0; i < 20; ++i) { addProperty(i); }
+        }
+
+        void addProperty(int i) {
+            addGetProperty("p" + std::to_string(i), this, &ManyProperties::getValue);
+        }
+
+        int getValue() const { return 42; }
+    };
+
+    class WithTable : public PropertyList {
+    public:
+        WithTable() : d_(0) {
+            setPropertyTable(&properties(), this);
+            addGetProperty("dynamic", this, &WithTable::getD);
+        }
+
+        static const PropertyTable<WithTable>& properties() {
+            static const PropertyTable<WithTable> table = []() {
+                PropertyTable<WithTable> t;
+                t.addGet("pi", &WithTable::getPi);
+                t.addGetSet("d", &WithTable::getD, &WithTable::setD);
+                return t;
+            }();
+            return table;
+        }
+
+        double getPi() const { return 3.1415; }
+
+        int getD() const { return d_; }
+        bool setD(const int& value) {
+            if (value < 0) { return false; }
+            d_ = value;
+            return true;
+        }
+
+    private:
+        int d_;
+    };
+
+    struct Range {
+        double min;
+        double max;
+        MEDIAGRAPH_FIELDS(Range, min, max)
+        bool operator==(const Range& other) const {
+            return min == other.min && max == other.max;
+        }
+    };
+
+    class WithRange : public PropertyList {
+    public:
+        WithRange() : num_sets(0) {
+            range_.min = 0;
+            range_.max = 1;
+            setPropertyTable(&properties(), this);
+        }
+
+        static const PropertyTable<WithRange>& properties() {
+            static const PropertyTable<WithRange> table = []() {
+                PropertyTable<WithRange> t;
+                t.addGetSet("range", &WithRange::range, &WithRange::setRange);
+                return t;
+            }();
+            return table;
+        }
+
+        Range range() const { return range_; }
+        bool setRange(const Range& range) {
+            ++num_sets;
+            range_ = range;
+            return true;
+        }
+
+        int num_sets;
+
+    private:
+        Range range_;
+    };
+
 }  // namespace
 
 TEST(PropertyTest, BasicEnumeration) {
@@ -99,6 +186,30 @@ TEST(PropertyTest, IntGetSet) {
     EXPECT_EQ(0xDEADBEAF, b.get());
 }
 
+TEST(PropertyTest, CompositeProperties) {
+    Property<std::vector<float>> weights("weights", {0.5f, 1.5f});
+    EXPECT_EQ("vector<float>", weights.typeName());
+    EXPECT_EQ("[0.5,1.5]", weights.ValueToString());
+    EXPECT_TRUE(weights.ValueFromString("[1,2,3]"));
+    EXPECT_EQ((std::vector<float>{1, 2, 3}), weights.get());
+
+    Range initial;
+    initial.min = 0;
+    initial.max = 1;
+    Property<Range> range("range", initial);
+    EXPECT_EQ("Range", range.typeName());
+    EXPECT_EQ("{min:0,max:1}", range.ValueToString());
+    EXPECT_TRUE(range.ValueFromString("{min:-2,max:2}"));
+    EXPECT_EQ(-2, range.get().min);
+    EXPECT_EQ(2, range.get().max);
+    EXPECT_FALSE(range.ValueFromString("{min:5,max:"));
+    EXPECT_EQ(-2, range.get().min);
+
+    Property<Range> copy("copy", initial);
+    EXPECT_TRUE(copy.setSerialized(range.getSerialized()));
+    EXPECT_EQ(range.get(), copy.get());
+}
+
 TEST(PropertyTest, ReadOnlyTest) {
     ReadOnlyProperty<int> a("a");
     ReadOnlyProperty<int> b("b", 0);
@@ -114,4 +225,91 @@ TEST(PropertyTest, SimpleGetSet) {
     EXPECT_EQ("d", object.property(4)->name());
 }
 
+TEST(PropertyTest, LookupByNameInLongLists) {
+    ManyProperties object;
+    EXPECT_EQ(13, object.propertyIndex("p13"));
+    EXPECT_EQ("p13", object.getPropertyByName("p13")->name());
+    EXPECT_EQ(-1, object.propertyIndex("p20"));
+    EXPECT_EQ(nullptr, object.getPropertyByName("unknown"));
+
+    // The index follows new properties.
+    object.addProperty(20);
+    EXPECT_EQ(20, object.propertyIndex("p20"));
+    EXPECT_EQ(0, object.propertyIndex("p0"));
+
+    ABC short_list;
+    EXPECT_EQ(4, short_list.propertyIndex("d"));
+}
+
+TEST(PropertyTest, NameIndexRebuildsOnStaleHits) {
+    std::vector<std::string> names;
+    for (int i = 0; i < 2 * NameIndex::kLinearScanMax; ++i) {
+        names.push_back("n" + std::to_string(i));
+    }
+    auto name_at = [&names](int i) { return &names[i]; };
+    std::atomic<NameIndex*> index(nullptr);
+
+    EXPECT_EQ(3, NameIndex::find(&index, "n3", int(names.size()), name_at));
+
+    // Same count: a miss does not rebuild the index, a stale hit does.
+    names[5] = "renamed";
+    EXPECT_EQ(-1, NameIndex::find(&index, "unknown", int(names.size()), name_at));
+    EXPECT_EQ(-1, NameIndex::find(&index, "n5", int(names.size()), name_at));
+    EXPECT_EQ(5, NameIndex::find(&index, "renamed", int(names.size()), name_at));
+    EXPECT_EQ(3, NameIndex::find(&index, "n3", int(names.size()), name_at));
+
+    // A new count rebuilds the index.
+    names[6] = "moved";
+    names.push_back("n6");
+    EXPECT_EQ(6, NameIndex::find(&index, "moved", int(names.size()), name_at));
+    EXPECT_EQ(int(names.size()) - 1,
+              NameIndex::find(&index, "n6", int(names.size()), name_at));
+
+    NameIndex::release(&index);
+}
+
+TEST(PropertyTest, PropertyTable) {
+    WithTable a;
+    WithTable b;
+
+    ASSERT_EQ(3, a.numProperty());
+    EXPECT_EQ(nullptr, a.property(3));
+    EXPECT_EQ("pi", a.property(0)->name());
+    EXPECT_EQ("d", a.property(1)->name());
+    EXPECT_EQ("dynamic", a.property(2)->name());
+    EXPECT_FALSE(a.property(0)->isWritable());
+    EXPECT_TRUE(a.property(1)->isWritable());
+    EXPECT_EQ(typeId<int>(), a.property(1)->typeId());
+    EXPECT_EQ(a.property(1), a.getPropertyByName("d"));
+
+    // Each instance gets its own bound property.
+    EXPECT_TRUE(a.property(1)->ValueFromString("3"));
+    EXPECT_EQ(3, a.getD());
+    EXPECT_EQ(0, b.getD());
+    EXPECT_NE(a.property(1), b.property(1));
+    EXPECT_EQ("3", a.getPropertyByName("dynamic")->ValueToString());
+
+    // The setter still validates values.
+    a.property(1)->ValueFromString("-1");
+    EXPECT_EQ(3, a.getD());
+}
+
+TEST(PropertyTest, PropertyTableStruct) {
+    WithRange object;
+    NamedProperty* range = object.getPropertyByName("range");
+    ASSERT_NE(nullptr, range);
+    EXPECT_TRUE(range->ValueFromString("{min:-2,max:2}"));
+    EXPECT_EQ(1, object.num_sets);
+    EXPECT_EQ(-2, object.range().min);
+
+    // Parsing fails half way through: the setter is not called.
+    EXPECT_FALSE(range->ValueFromString("{min:5,max:"));
+    EXPECT_EQ(1, object.num_sets);
+    EXPECT_EQ(-2, object.range().min);
+
+    // Same value: nothing to set.
+    EXPECT_TRUE(range->ValueFromString("{min:-2,max:2}"));
+    EXPECT_EQ(1, object.num_sets);
+}
+
 }  // namespace media_graph
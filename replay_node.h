@@ -0,0 +1,278 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_REPLAY_NODE_H
+#define MEDIAGRAPH_REPLAY_NODE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include "clock.h"
+#include "node.h"
+#include "stream.h"
+#include "stream_log.h"
+#include "types/type_definition.h"
+
+namespace media_graph {
+
+/*! Publishes the entries of a log recorded by StreamRecorder on its "out"
+ *  stream.
+ *
+ *  The "Speed" property controls the pacing: 1 replays with the recorded
+ *  timing, 2 twice as fast, and 0 as fast as the readers consume. Setting
+ *  "Position" seeks to a timestamp, in microseconds.
+ *
+ *  Entries keep their recorded timestamps. After seeking backwards, they
+ *  are shifted so that the stream time never goes back. At the end of the
+ *  log, the node waits for a seek or for stop(), unless "FinishAtEnd" is
+ *  set: the output stream then ends, which lets Graph::drain() return once
+ *  the whole log went through the graph. In batch mode, the replay ignores
+ *  "Speed" and always finishes at the end. \see Graph::setBatchMode
+ *
+ *  Example:
+ *  \code
+ *  auto replay = graph.newNode<ReplayNode<Image>>("camera", "/data/camera");
+ *  replay->setSpeed(0);  // Re-feed the algorithms as fast as they go.
+ *  graph.connect("camera", "out", "detector", "image");
+ *  \endcode
+ */
+template <typename T> class ReplayNode : public ThreadedNodeBase {
+public:
+    explicit ReplayNode(const std::string& base_path = "", double speed = 1.0)
+        : output_("out", this),
+          base_path_(base_path),
+          speed_(speed),
+          position_us_(0),
+          num_replayed_(0),
+          finished_(false),
+          finish_at_end_(false),
+          quit_(false),
+          seek_pending_(false),
+          seek_target_(Timestamp::microSecondsSince1970(0)),
+          repace_(true) {
+        setPropertyTable(&properties(), this);
+    }
+
+    ~ReplayNode() { stop(); }
+
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return index == 0 ? &output_ : nullptr;
+    }
+
+    Stream<T>* output() { return &output_; }
+
+    virtual bool start() override {
+        if (isRunning()) { return true; }
+        if (!reader_.open(base_path_) || reader_.typeName() != typeName<T>()) {
+            reader_.close();
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = false;
+            repace_ = true;
+        }
+        finished_ = false;
+        return ThreadedNodeBase::start();
+    }
+
+    virtual void stop() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+            command_.notifyAll();
+        }
+        ThreadedNodeBase::stop();
+    }
+
+    std::string path() const { return base_path_; }
+    bool setPath(const std::string& path) {
+        if (isRunning()) { return false; }
+        base_path_ = path;
+        return true;
+    }
+
+    double speed() const { return speed_; }
+    bool setSpeed(const double& speed) {
+        if (!(speed >= 0)) { return false; }
+        std::lock_guard<std::mutex> lock(mutex_);
+        speed_ = speed;
+        repace_ = true;
+        command_.notifyAll();
+        return true;
+    }
+
+    //! Moves the replay to the first entry recorded at or after <time>.
+    bool seek(Timestamp time) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seek_pending_ = true;
+        seek_target_ = time;
+        command_.notifyAll();
+        return true;
+    }
+
+    //! Recorded timestamp of the last published entry, in microseconds.
+    int64_t position() const { return position_us_; }
+    bool setPosition(const int64_t& microseconds) {
+        return seek(Timestamp::microSecondsSince1970(microseconds));
+    }
+
+    int64_t numReplayed() const { return num_replayed_; }
+    bool finished() const { return finished_; }
+
+    //! If true, the replay ends with the log instead of waiting for a seek.
+    bool finishAtEnd() const { return finish_at_end_; }
+    bool setFinishAtEnd(const bool& finish) {
+        finish_at_end_ = finish;
+        return true;
+    }
+    int64_t beginTime() const { return reader_.beginTime().microSecondsSince1970(); }
+    int64_t endTime() const { return reader_.endTime().microSecondsSince1970(); }
+
+    static const PropertyTable<ReplayNode<T>>& properties() {
+        static const PropertyTable<ReplayNode<T>> table = []() {
+            PropertyTable<ReplayNode<T>> t;
+            t.addGetSet("Path", &ReplayNode<T>::path, &ReplayNode<T>::setPath);
+            t.addGetSet("Speed", &ReplayNode<T>::speed, &ReplayNode<T>::setSpeed);
+            t.addGetSet("Position", &ReplayNode<T>::position, &ReplayNode<T>::setPosition);
+            t.addGet("NumReplayed", &ReplayNode<T>::numReplayed);
+            t.addGet("Finished", &ReplayNode<T>::finished);
+            t.addGetSet("FinishAtEnd", &ReplayNode<T>::finishAtEnd,
+                        &ReplayNode<T>::setFinishAtEnd);
+            t.addGet("BeginTime", &ReplayNode<T>::beginTime);
+            t.addGet("EndTime", &ReplayNode<T>::endTime);
+            return t;
+        }();
+        return table;
+    }
+
+protected:
+    virtual void threadMain() {
+        // Maps recorded time to wall time, for pacing.
+        Timestamp start_wall = Timestamp::now();
+        Timestamp start_recorded = Timestamp::now();
+        // Added to recorded timestamps, to keep the stream time increasing.
+        Duration shift;
+        Timestamp last_published = Timestamp::microSecondsSince1970(0);
+        bool published = false;
+
+        T data;
+        Timestamp timestamp;
+        SequenceId sequence_id;
+        bool have_entry = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!quit_ && !threadMustQuit()) {
+            if (seek_pending_) {
+                seek_pending_ = false;
+                const Timestamp target = seek_target_;
+                lock.unlock();
+                finished_ = !reader_.seek(target);
+                lock.lock();
+                have_entry = false;
+                repace_ = true;
+                continue;
+            }
+
+            if (!have_entry) {
+                lock.unlock();
+                have_entry = reader_.read(&data, &timestamp, &sequence_id);
+                lock.lock();
+                if (!have_entry) {
+                    // End of the log: wait for a seek.
+                    finished_ = true;
+                    if (finish_at_end_ || !shouldPace()) { return; }
+                    command_.wait(lock, [this] { return quit_ || seek_pending_; });
+                    continue;
+                }
+            }
+
+            if (repace_) {
+                repace_ = false;
+                start_wall = Timestamp::now();
+                start_recorded = timestamp;
+            }
+
+            if (speed_ > 0 && shouldPace()) {
+                const Timestamp due =
+                    start_wall + Duration::seconds((timestamp - start_recorded).seconds() / speed_);
+                const Duration wait = due - Timestamp::now();
+                if (wait > Duration()) {
+                    if (Clock* clock = Clock::current()) {
+                        // Simulated time: commands are handled once awake.
+                        clock->sleepUntil(due, &lock);
+                        continue;
+                    }
+                    // Wakes up early on seek, speed change or stop.
+                    command_.waitFor(lock, std::chrono::nanoseconds(wait.nanoSeconds()),
+                                     [this] { return quit_ || seek_pending_ || repace_; });
+                    continue;
+                }
+            }
+
+            lock.unlock();
+            Timestamp out = timestamp + shift;
+            if (published && out < last_published) {
+                shift = shift + (last_published - out);
+                out = last_published;
+            }
+            have_entry = false;
+            if (output_.update(out, data)) {
+                published = true;
+                last_published = out;
+                position_us_ = timestamp.microSecondsSince1970();
+                ++num_replayed_;
+            }
+            lock.lock();
+        }
+    }
+
+private:
+    Stream<T> output_;
+    StreamLogReader reader_;
+    std::string base_path_;
+
+    std::atomic<double> speed_;
+    std::atomic<int64_t> position_us_;
+    std::atomic<int64_t> num_replayed_;
+    std::atomic<bool> finished_;
+    std::atomic<bool> finish_at_end_;
+
+    // Commands for the replay thread, protected by mutex_.
+    std::mutex mutex_;
+    ClockCondition command_;
+    bool quit_;
+    bool seek_pending_;
+    Timestamp seek_target_;
+    // Set when the pacing must restart from the next entry.
+    bool repace_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_REPLAY_NODE_H
@@ -0,0 +1,162 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string>
+
+#include "replay_node.h"
+
+#include "graph.h"
+#include "node.h"
+#include "stream_log.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+namespace {
+    class SinkNode : public NodeBase {
+    public:
+        SinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<int> input;
+    };
+
+    class ReplayNodeTest : public ::testing::Test {
+    protected:
+        // Records 100 entries, 1 ms apart.
+        virtual void SetUp() {
+            char path[] = "/tmp/replay_node_test.XXXXXX";
+            directory_ = mkdtemp(path);
+            base_ = directory_ + "/log";
+
+            StreamLogWriter writer;
+            ASSERT_TRUE(writer.open(base_, "int", 1024, Duration::milliSeconds(10)));
+            for (int i = 0; i < 100; ++i) {
+                writer.write(Timestamp::microSecondsSince1970(1000000 + i * 1000), i, i, true);
+            }
+        }
+
+        virtual void TearDown() {
+            std::string command = "rm -rf " + directory_;
+            if (system(command.c_str()) != 0) {}
+        }
+
+        std::shared_ptr<ReplayNode<int>> startGraph(double speed) {
+            replay_ = graph_.newNode<ReplayNode<int>>("replay", base_, speed);
+            sink_ = graph_.newNode<SinkNode>("sink");
+            EXPECT_TRUE(graph_.connect("replay", "out", "sink", "in"));
+            EXPECT_TRUE(graph_.start());
+            return replay_;
+        }
+
+        std::string directory_;
+        std::string base_;
+        Graph graph_;
+        std::shared_ptr<ReplayNode<int>> replay_;
+        std::shared_ptr<SinkNode> sink_;
+    };
+
+}  // namespace
+
+TEST_F(ReplayNodeTest, AsFastAsConsumed) {
+    startGraph(0);
+    EXPECT_EQ(1000000, replay_->beginTime());
+    EXPECT_EQ(1099000, replay_->endTime());
+
+    int value;
+    Timestamp timestamp;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(sink_->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+        EXPECT_EQ(1000000 + i * 1000, timestamp.microSecondsSince1970());
+    }
+    for (int i = 0; i < 1000 && !replay_->finished(); ++i) { Duration::milliSeconds(1).sleep(); }
+    EXPECT_TRUE(replay_->finished());
+    EXPECT_EQ(100, replay_->numReplayed());
+    EXPECT_EQ("1099000", replay_->getPropertyByName("Position")->ValueToString());
+    graph_.stop();
+}
+
+TEST_F(ReplayNodeTest, FinishesAtTheEndOfTheLog) {
+    replay_ = graph_.newNode<ReplayNode<int>>("replay", base_, 0);
+    sink_ = graph_.newNode<SinkNode>("sink");
+    EXPECT_TRUE(graph_.connect("replay", "out", "sink", "in"));
+    EXPECT_TRUE(replay_->getPropertyByName("FinishAtEnd")->ValueFromString("1"));
+    EXPECT_TRUE(graph_.start());
+
+    int value;
+    Timestamp timestamp;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(sink_->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(sink_->input.read(&value, &timestamp));
+    EXPECT_TRUE(sink_->input.endOfStream());
+    graph_.stop();
+}
+
+TEST_F(ReplayNodeTest, FollowsRecordedPace) {
+    const Timestamp start = Timestamp::now();
+    startGraph(2);
+    int value;
+    Timestamp timestamp;
+    for (int i = 0; i < 100; ++i) { ASSERT_TRUE(sink_->input.read(&value, &timestamp)); }
+
+    // 99 ms recorded, replayed twice as fast.
+    EXPECT_LE(Duration::milliSeconds(49), Timestamp::now() - start);
+    graph_.stop();
+}
+
+TEST_F(ReplayNodeTest, SeeksBackwardsWithIncreasingTimestamps) {
+    startGraph(0);
+    int value;
+    Timestamp timestamp;
+    for (int i = 0; i < 100; ++i) { ASSERT_TRUE(sink_->input.read(&value, &timestamp)); }
+
+    EXPECT_TRUE(replay_->getPropertyByName("Position")->ValueFromString("1050000"));
+    Timestamp previous = timestamp;
+    ASSERT_TRUE(sink_->input.read(&value, &timestamp));
+    EXPECT_EQ(50, value);
+    EXPECT_FALSE(timestamp < previous);
+    ASSERT_TRUE(sink_->input.read(&value, &timestamp));
+    EXPECT_EQ(51, value);
+    EXPECT_EQ(Duration::milliSeconds(1), timestamp - previous);
+    graph_.stop();
+}
+
+TEST_F(ReplayNodeTest, RefusesOtherTypes) {
+    Graph graph;
+    auto replay = graph.newNode<ReplayNode<double>>("replay", base_);
+    EXPECT_FALSE(replay->start());
+}
+
+}  // namespace media_graph
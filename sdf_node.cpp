@@ -0,0 +1,102 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "sdf_node.h"
+
+#include "sdf_scheduler.h"
+
+namespace media_graph {
+
+SdfStreamBase::SdfStreamBase(const std::string& name, NodeBase* node, int rate)
+    : NamedStream(name, node), rate_(rate), capacity_(0), written_(0), closed_(false) {
+    assert(rate > 0);
+    setPropertyTable(&properties(), this);
+}
+
+const PropertyTable<SdfStreamBase>& SdfStreamBase::properties() {
+    static const PropertyTable<SdfStreamBase> table = []() {
+        PropertyTable<SdfStreamBase> t;
+        t.addGet("NumUpdates", &SdfStreamBase::numUpdates);
+        t.addGet("Rate", &SdfStreamBase::rate);
+        t.addGet("Capacity", &SdfStreamBase::capacity);
+        return t;
+    }();
+    return table;
+}
+
+void SdfStreamBase::open() {
+    if (closed_) {
+        written_ = 0;
+        for (int i = 0; i < numReaders(); ++i) { static_cast<SdfPin*>(reader(i))->rewind(); }
+    }
+    closed_ = false;
+}
+
+SdfPin::SdfPin(const std::string& name, NodeBase* node, int rate)
+    : NamedPin(name, node), rate_(rate), stream_(nullptr), read_(0) {
+    assert(rate > 0);
+    last_read_sequence_id_ = -1;
+    setPropertyTable(&properties(), this);
+}
+
+const PropertyTable<SdfPin>& SdfPin::properties() {
+    static const PropertyTable<SdfPin> table = []() {
+        PropertyTable<SdfPin> t;
+        t.addGet("Rate", &SdfPin::rate);
+        return t;
+    }();
+    return table;
+}
+
+bool SdfPin::connectTo(SdfStreamBase* stream) {
+    if (!stream) { return false; }
+    stream_ = stream;
+    stream_->registerReader(this);
+    rewind();
+    return true;
+}
+
+void SdfPin::disconnect() {
+    if (stream_) {
+        // Like StreamReader: isConnected() reports false before unregistering.
+        SdfStreamBase* stream = stream_;
+        stream_ = nullptr;
+        stream->unregisterReader(this);
+        if (node()) { node()->stop(); }
+    }
+}
+
+bool SdfPin::canRead() const {
+    SdfStreamBase* stream = stream_;
+    return stream && stream->isOpen() && stream->numUpdates() - read_ >= rate_;
+}
+
+void SdfNodeBase::stop() {
+    if (SdfScheduler* scheduler = scheduler_) { scheduler->stop(); }
+    NodeBase::stop();
+}
+
+}  // namespace media_graph
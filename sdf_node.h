@@ -0,0 +1,255 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_SDF_NODE_H
+#define MEDIAGRAPH_SDF_NODE_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "node.h"
+#include "stream.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+
+class SdfScheduler;
+
+/*! Type independent part of SdfStream<T>, used by the scheduler.
+ *
+ *  Tokens live in a ring of slots, preallocated by the scheduler from the
+ *  largest number of tokens the stream holds during a period. Positions
+ *  count tokens since the stream was opened.
+ */
+class SdfStreamBase : public NamedStream {
+public:
+    //! <rate>: number of tokens written per firing of the node.
+    SdfStreamBase(const std::string& name, NodeBase* node, int rate);
+
+    int rate() const { return rate_; }
+    int capacity() const { return capacity_; }
+    int64_t numUpdates() const override { return written_; }
+
+    void open() override;
+    void close() override { closed_ = true; }
+    bool isOpen() const override { return !closed_; }
+
+    //! The properties shared by all the SdfStream<T> instances.
+    static const PropertyTable<SdfStreamBase>& properties();
+
+    // Public, but should only be called by the scheduler, while the
+    // subgraph is not running.
+    virtual void setCapacity(int tokens) = 0;
+
+    // Public, but should only be called by the scheduler, once the node
+    // wrote the tokens of a firing.
+    void commit() { written_.store(written_ + rate_, std::memory_order_release); }
+
+protected:
+    // Slot of the token at <position>.
+    int slotIndex(int64_t position) const { return int(position % capacity_); }
+
+    const int rate_;
+    std::atomic<int> capacity_;
+    std::atomic<int64_t> written_;
+    std::atomic<bool> closed_;
+};
+
+/*! Type independent part of SdfReader<T>, used by the scheduler.
+ */
+class SdfPin : public NamedPin {
+public:
+    //! <rate>: number of tokens read per firing of the node.
+    SdfPin(const std::string& name, NodeBase* node, int rate);
+
+    int rate() const { return rate_; }
+    SdfStreamBase* sdfStream() const { return stream_; }
+
+    NamedStream* connectedStream() const override { return stream_; }
+    bool isConnected() const override { return stream_ != nullptr; }
+    void disconnect() override;
+    bool canRead() const override;
+
+    void openConnectedStream() override {
+        if (stream_) { stream_->open(); }
+    }
+    void closeConnectedStream() override {
+        if (stream_) { stream_->close(); }
+    }
+
+    //! The properties shared by all the SdfReader<T> instances.
+    static const PropertyTable<SdfPin>& properties();
+
+    // Public, but should only be called by the scheduler, once the node
+    // read the tokens of a firing.
+    void consume() {
+        read_.store(read_ + rate_, std::memory_order_relaxed);
+        last_read_sequence_id_ = read_ - 1;
+    }
+
+    // Public, but should only be called by the connected stream.
+    void rewind() {
+        read_ = 0;
+        last_read_sequence_id_ = -1;
+    }
+
+protected:
+    bool connectTo(SdfStreamBase* stream);
+
+    const int rate_;
+    SdfStreamBase* stream_;
+    // Atomic: canRead() can be called from monitoring threads.
+    std::atomic<int64_t> read_;
+};
+
+/*! Output of an SdfNodeBase: a fixed number of tokens per firing, in
+ *  buffers preallocated by the scheduler. Unlike Stream<T>, there is no
+ *  locking nor waiting: the scheduler fires the producer only when the
+ *  readers made room, and the readers only once the tokens are written.
+ *  Only SdfReader<T> pins can connect to it.
+ */
+template <typename T> class SdfStream : public SdfStreamBase {
+public:
+    SdfStream(const std::string& name, NodeBase* node, int rate = 1)
+        : SdfStreamBase(name, node, rate) {}
+
+    std::string typeName() const override { return media_graph::typeName<T>(); }
+    TypeId typeId() const override { return TypeTraits<T>::id(); }
+
+    /*! Token <index> of the current firing, stamped with <timestamp>, to be
+     *  filled in place. Slots are reused from period to period: data types
+     *  such as std::vector keep their allocation. Only valid in fire().
+     */
+    T& write(Timestamp timestamp, int index = 0) {
+        assert(index >= 0 && index < rate_);
+        Slot& slot = slots_[slotIndex(written_ + index)];
+        slot.timestamp = timestamp;
+        return slot.data;
+    }
+
+    void setCapacity(int tokens) override {
+        slots_.resize(tokens);
+        capacity_ = tokens;
+    }
+
+    // Public, but should only be called by SdfReader<T>.
+    const T& token(int64_t position, Timestamp* timestamp) const {
+        const Slot& slot = slots_[slotIndex(position)];
+        if (timestamp) { *timestamp = slot.timestamp; }
+        return slot.data;
+    }
+
+private:
+    struct Slot {
+        Timestamp timestamp;
+        T data;
+    };
+    std::vector<Slot> slots_;
+};
+
+/*! Input of an SdfNodeBase, reading a fixed number of tokens per firing
+ *  from an SdfStream<T>.
+ */
+template <typename T> class SdfReader : public SdfPin {
+public:
+    SdfReader(const std::string& name, NodeBase* node, int rate = 1)
+        : SdfPin(name, node, rate) {}
+    ~SdfReader() { disconnect(); }
+
+    std::string typeName() const override { return media_graph::typeName<T>(); }
+    TypeId typeId() const override { return TypeTraits<T>::id(); }
+
+    bool connect(NamedStream* stream) override {
+        disconnect();
+        if (typeId() != stream->typeId()) { return false; }
+        return connectTo(dynamic_cast<SdfStream<T>*>(stream));
+    }
+
+    //! Token <index> of the current firing. Only valid in fire().
+    const T& get(int index = 0, Timestamp* timestamp = nullptr) const {
+        assert(stream_ && index >= 0 && index < rate_);
+        return static_cast<const SdfStream<T>*>(stream_)->token(read_ + index, timestamp);
+    }
+};
+
+/*! A node of a synchronous dataflow subgraph.
+ *
+ *  SDF nodes connected by SdfStream<T> form a subgraph with fixed rates:
+ *  each firing reads rate() tokens from every SdfReader<T> and writes
+ *  rate() tokens to every SdfStream<T>. At Graph::start(), an SdfScheduler
+ *  computes a periodic firing order for each subgraph, and runs it in a
+ *  single thread, without the queues, locks and wake ups of Stream<T>.
+ *
+ *  The nodes of a subgraph can also have regular pins and streams, to
+ *  exchange data with the rest of the graph from fire(). Returning false
+ *  from fire() ends the subgraph: its regular output streams are finished,
+ *  as when ThreadedNodeBase::threadMain() returns.
+ *
+ *  Example, a gain on blocks of 64 samples:
+ *  \code
+ *  class Gain : public SdfNodeBase {
+ *  public:
+ *      Gain() : in_("in", this), out_("out", this) {}
+ *      bool fire() override {
+ *          Timestamp timestamp;
+ *          const std::vector<float>& in = in_.get(0, &timestamp);
+ *          std::vector<float>& out = out_.write(timestamp);
+ *          out.resize(in.size());
+ *          for (size_t i = 0; i < in.size(); ++i) { out[i] = in[i] * 0.5f; }
+ *          return true;
+ *      }
+ *      ...
+ *  };
+ *  \endcode
+ */
+class SdfNodeBase : public NodeBase {
+public:
+    SdfNodeBase() : scheduler_(nullptr), num_firings_(0) {}
+
+    //! Stops the whole subgraph the node belongs to.
+    void stop() override;
+
+    //! Number of calls to fire() since the graph started.
+    int64_t numFirings() const { return num_firings_; }
+
+protected:
+    //! Reads and writes the tokens of one firing. Returns false to end the
+    //! subgraph.
+    virtual bool fire() = 0;
+
+private:
+    friend class SdfScheduler;
+
+    std::atomic<SdfScheduler*> scheduler_;
+    std::atomic<int64_t> num_firings_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_SDF_NODE_H
@@ -0,0 +1,318 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "sdf_scheduler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+#include "clock.h"
+#include "node.h"
+#include "sdf_node.h"
+
+namespace media_graph {
+namespace {
+
+int64_t gcd(int64_t a, int64_t b) {
+    while (b != 0) {
+        const int64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// Firings per period, as a fraction, while solving the balance equations.
+struct Rational {
+    int64_t num = 0;
+    int64_t den = 0;  // 0: not solved yet.
+
+    bool known() const { return den != 0; }
+    Rational times(int64_t n, int64_t d) const {
+        Rational r;
+        r.num = num * n;
+        r.den = den * d;
+        const int64_t g = gcd(r.num, r.den);
+        r.num /= g;
+        r.den /= g;
+        return r;
+    }
+    bool operator==(const Rational& other) const {
+        return num * other.den == other.num * den;
+    }
+};
+
+// A stream of the subgraph, read by <consumer> through <pin>.
+struct Edge {
+    int producer;
+    int consumer;
+    SdfPin* pin;
+};
+
+}  // namespace
+
+SdfScheduler::~SdfScheduler() {
+    stop();
+    for (Node& node : nodes_) {
+        SdfScheduler* self = this;
+        node.sdf->scheduler_.compare_exchange_strong(self, nullptr);
+    }
+}
+
+bool SdfScheduler::build(const std::vector<std::shared_ptr<NodeBase>>& nodes,
+                         std::vector<std::unique_ptr<SdfScheduler>>* schedulers) {
+    std::vector<Node> sdf_nodes;
+    std::unordered_map<const NodeBase*, int> index;
+    for (const std::shared_ptr<NodeBase>& node : nodes) {
+        SdfNodeBase* sdf = dynamic_cast<SdfNodeBase*>(node.get());
+        if (!sdf) {
+            for (int i = 0; i < node->numInputPin(); ++i) {
+                if (dynamic_cast<SdfPin*>(node->inputPin(i))) {
+                    std::cerr << "SDF pin " << node->name() << "." << node->inputPin(i)->name()
+                              << " belongs to a node that is not an SdfNodeBase.\n";
+                    return false;
+                }
+            }
+            continue;
+        }
+        Node entry;
+        entry.node = node;
+        entry.sdf = sdf;
+        for (int i = 0; i < node->numOutputStream(); ++i) {
+            if (SdfStreamBase* stream = dynamic_cast<SdfStreamBase*>(node->outputStream(i))) {
+                entry.outputs.push_back(stream);
+            }
+        }
+        index[node.get()] = int(sdf_nodes.size());
+        sdf_nodes.push_back(entry);
+    }
+
+    // Connected subgraphs, with a union-find over the SDF streams.
+    std::vector<int> parent(sdf_nodes.size());
+    for (size_t i = 0; i < parent.size(); ++i) { parent[i] = int(i); }
+    auto root = [&parent](int i) {
+        while (parent[i] != i) { i = parent[i] = parent[parent[i]]; }
+        return i;
+    };
+
+    std::vector<Edge> edges;
+    for (size_t c = 0; c < sdf_nodes.size(); ++c) {
+        NodeBase* consumer = sdf_nodes[c].node.get();
+        for (int i = 0; i < consumer->numInputPin(); ++i) {
+            SdfPin* pin = dynamic_cast<SdfPin*>(consumer->inputPin(i));
+            if (!pin || !pin->sdfStream()) { continue; }
+            auto producer = index.find(pin->sdfStream()->node());
+            if (producer == index.end()) {
+                std::cerr << "SDF stream " << pin->sdfStream()->streamName()
+                          << " belongs to a node that is not an SdfNodeBase.\n";
+                return false;
+            }
+            sdf_nodes[c].inputs.push_back(pin);
+            edges.push_back(Edge{producer->second, int(c), pin});
+            parent[root(producer->second)] = root(int(c));
+        }
+    }
+
+    // Subgraphs, in node order.
+    std::map<int, std::vector<int>> subgraphs;
+    std::vector<int> roots;
+    for (size_t i = 0; i < sdf_nodes.size(); ++i) {
+        const int r = root(int(i));
+        if (subgraphs.find(r) == subgraphs.end()) { roots.push_back(r); }
+        subgraphs[r].push_back(int(i));
+    }
+
+    for (int r : roots) {
+        const std::vector<int>& members = subgraphs[r];
+        std::unique_ptr<SdfScheduler> scheduler(new SdfScheduler());
+        std::unordered_map<int, int> local;
+        for (int member : members) {
+            local[member] = int(scheduler->nodes_.size());
+            scheduler->nodes_.push_back(sdf_nodes[member]);
+        }
+        std::vector<Edge> local_edges;
+        for (const Edge& edge : edges) {
+            if (root(edge.consumer) == r) {
+                local_edges.push_back(Edge{local[edge.producer], local[edge.consumer], edge.pin});
+            }
+        }
+        const std::string& name = scheduler->nodes_[0].node->name();
+
+        // Balance equations: producer firings * rate written = consumer
+        // firings * rate read, on every stream.
+        std::vector<Rational> firings(members.size());
+        firings[0].num = firings[0].den = 1;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (const Edge& edge : local_edges) {
+                Rational& producer = firings[edge.producer];
+                Rational& consumer = firings[edge.consumer];
+                const int written = edge.pin->sdfStream()->rate();
+                const int read = edge.pin->rate();
+                if (producer.known() && !consumer.known()) {
+                    consumer = producer.times(written, read);
+                    changed = true;
+                } else if (consumer.known() && !producer.known()) {
+                    producer = consumer.times(read, written);
+                    changed = true;
+                } else if (!producer.known()) {
+                    // Neither end solved yet: a later pass reaches it.
+                    continue;
+                } else if (!(producer.times(written, 1) == consumer.times(read, 1))) {
+                    std::cerr << "Inconsistent SDF rates in the subgraph of " << name << ", at "
+                              << edge.pin->node()->name() << "." << edge.pin->name() << ".\n";
+                    return false;
+                }
+            }
+        }
+        int64_t common_den = 1;
+        for (const Rational& f : firings) {
+            common_den = common_den / gcd(common_den, f.den) * f.den;
+        }
+        std::vector<int64_t> repetitions;
+        int64_t common = 0;
+        for (const Rational& f : firings) {
+            repetitions.push_back(f.num * (common_den / f.den));
+            common = gcd(common, repetitions.back());
+        }
+        for (int64_t& q : repetitions) { q /= common; }
+
+        // Simulates a period: fires the first node that has its tokens,
+        // and records the largest number of tokens held by each stream.
+        std::unordered_map<const SdfStreamBase*, int64_t> written;
+        std::unordered_map<const SdfPin*, int64_t> read;
+        std::unordered_map<SdfStreamBase*, int64_t> capacity;
+        std::vector<int64_t> fired(members.size(), 0);
+        int64_t total = 0;
+        for (int64_t q : repetitions) { total += q; }
+        while (int64_t(scheduler->order_.size()) < total) {
+            int next = -1;
+            for (size_t i = 0; i < scheduler->nodes_.size() && next < 0; ++i) {
+                if (fired[i] >= repetitions[i]) { continue; }
+                bool ready = true;
+                for (SdfPin* pin : scheduler->nodes_[i].inputs) {
+                    ready = ready && written[pin->sdfStream()] - read[pin] >= pin->rate();
+                }
+                if (ready) { next = int(i); }
+            }
+            if (next < 0) {
+                std::cerr << "The SDF subgraph of " << name
+                          << " has a cycle: it can not complete a period.\n";
+                return false;
+            }
+
+            const Node& node = scheduler->nodes_[next];
+            for (SdfPin* pin : node.inputs) { read[pin] += pin->rate(); }
+            for (SdfStreamBase* stream : node.outputs) {
+                const int64_t end = (written[stream] += stream->rate());
+                int64_t oldest = end - stream->rate();
+                for (int i = 0; i < stream->numReaders(); ++i) {
+                    oldest = std::min(oldest, read[static_cast<SdfPin*>(stream->reader(i))]);
+                }
+                capacity[stream] = std::max(capacity[stream], end - oldest);
+            }
+            ++fired[next];
+            scheduler->order_.push_back(next);
+        }
+
+        for (Node& node : scheduler->nodes_) {
+            for (SdfStreamBase* stream : node.outputs) {
+                stream->setCapacity(int(std::max<int64_t>(capacity[stream], stream->rate())));
+            }
+            node.sdf->scheduler_ = scheduler.get();
+            node.sdf->num_firings_ = 0;
+        }
+        schedulers->push_back(std::move(scheduler));
+    }
+    return true;
+}
+
+bool SdfScheduler::start(Clock* clock) {
+    quit_ = false;
+    num_periods_ = 0;
+    clock_ = clock;
+    if (clock_) { clock_->addThread(); }
+    if (thread_.start(threadEntryPoint, this)) { return true; }
+    if (clock_) { clock_->removeThread(); }
+    return false;
+}
+
+void SdfScheduler::stop() {
+    quit_ = true;
+    if (!isSchedulingThread()) { thread_.waitForTermination(); }
+}
+
+std::vector<SdfNodeBase*> SdfScheduler::firingOrder() const {
+    std::vector<SdfNodeBase*> order;
+    for (int index : order_) { order.push_back(nodes_[index].sdf); }
+    return order;
+}
+
+bool SdfScheduler::runPeriod() {
+    for (int index : order_) {
+        if (quit_.load(std::memory_order_relaxed)) { return false; }
+        Node& node = nodes_[index];
+        if (!node.sdf->fire()) { return false; }
+        for (SdfPin* pin : node.inputs) { pin->consume(); }
+        for (SdfStreamBase* stream : node.outputs) { stream->commit(); }
+        node.sdf->num_firings_.store(node.sdf->num_firings_ + 1, std::memory_order_relaxed);
+    }
+    num_periods_.store(num_periods_ + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void SdfScheduler::threadEntryPoint(void* ptr) {
+    SdfScheduler* scheduler = static_cast<SdfScheduler*>(ptr);
+    scheduler->thread_id_ = std::this_thread::get_id();
+    Clock* clock = scheduler->clock_;
+    Clock::setCurrent(clock);
+
+    try {
+        while (scheduler->runPeriod()) {
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Uncaught top-level exception in SDF scheduler, node: "
+                  << scheduler->nodes_[0].node->name() << ": exception: " << e.what()
+                  << std::endl;
+    }
+
+    // Unless asked to stop, the subgraph reached the end of its data.
+    if (!scheduler->quit_) {
+        for (Node& node : scheduler->nodes_) {
+            if (node.node->allPinsConnectedAndOpen()) { node.node->finishAllStreams(); }
+        }
+    }
+    scheduler->quit_ = true;
+    for (Node& node : scheduler->nodes_) { node.node->stop(); }
+
+    if (clock) { clock->removeThread(); }
+    Clock::setCurrent(nullptr);
+    scheduler->thread_id_ = std::thread::id();
+}
+
+}  // namespace media_graph
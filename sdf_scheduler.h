@@ -0,0 +1,119 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_SDF_SCHEDULER_H
+#define MEDIAGRAPH_SDF_SCHEDULER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread_primitives.h"
+
+class Clock;
+
+namespace media_graph {
+
+class NodeBase;
+class SdfNodeBase;
+class SdfPin;
+class SdfStreamBase;
+
+/*! Runs a synchronous dataflow subgraph in a single thread.
+ *  \see SdfNodeBase
+ *
+ *  The scheduler solves the balance equations of the subgraph: how many
+ *  times each node fires per period, so that every stream gets as many
+ *  tokens as its readers consume. It then simulates a period to find a
+ *  firing order and the largest number of tokens each stream holds, and
+ *  preallocates the streams accordingly. Running the subgraph repeats the
+ *  period, with no synchronization between firings.
+ *
+ *  Graph::start() creates the schedulers of the graph, and Graph::stop()
+ *  destroys them. Destroying a scheduler waits for its thread, unless
+ *  called from that thread.
+ */
+class SdfScheduler {
+public:
+    ~SdfScheduler();
+
+    /*! Groups the SdfNodeBase nodes of <nodes> into connected subgraphs,
+     *  and schedules each of them. Fails if a subgraph has inconsistent
+     *  rates, or a cycle, or a stream written by a node that is not an
+     *  SdfNodeBase. The reason is written to std::cerr.
+     */
+    static bool build(const std::vector<std::shared_ptr<NodeBase>>& nodes,
+                      std::vector<std::unique_ptr<SdfScheduler>>* schedulers);
+
+    //! Starts the scheduling thread, running on <clock> if not null.
+    bool start(Clock* clock);
+
+    //! Stops the thread. Waits for it, unless called from the thread itself.
+    void stop();
+
+    bool isRunning() const { return thread_.isRunning(); }
+
+    //! True when called from the scheduling thread, by a firing node.
+    bool isSchedulingThread() const { return thread_id_ == std::this_thread::get_id(); }
+
+    //! The firing order of one period. A node appears as many times as it
+    //! fires per period.
+    std::vector<SdfNodeBase*> firingOrder() const;
+
+    //! Number of periods completed since start().
+    int64_t numPeriods() const { return num_periods_; }
+
+private:
+    struct Node {
+        std::shared_ptr<NodeBase> node;
+        SdfNodeBase* sdf;
+        std::vector<SdfPin*> inputs;
+        std::vector<SdfStreamBase*> outputs;
+    };
+
+    SdfScheduler() : clock_(nullptr), quit_(false), num_periods_(0) {}
+
+    // Returns false if the subgraph must end.
+    bool runPeriod();
+    static void threadEntryPoint(void* ptr);
+
+    std::vector<Node> nodes_;
+    // Indices in nodes_, in firing order.
+    std::vector<int> order_;
+
+    Thread thread_;
+    std::atomic<std::thread::id> thread_id_;
+    Clock* clock_;
+    std::atomic<bool> quit_;
+    std::atomic<int64_t> num_periods_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_SDF_SCHEDULER_H
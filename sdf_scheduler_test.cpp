@@ -0,0 +1,344 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "graph.h"
+#include "sdf_node.h"
+#include "sdf_scheduler.h"
+#include "stream.h"
+#include "stream_reader.h"
+#include "types/type_definition.h"
+
+namespace media_graph {
+
+namespace {
+
+// Writes 0, 1, 2, ... <rate> integers per firing, until <count>.
+class SdfCounter : public SdfNodeBase {
+public:
+    SdfCounter(int count, int rate = 1) : output_("out", this, rate), count_(count), next_(0) {}
+
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+protected:
+    bool fire() override {
+        if (next_ >= count_) { return false; }
+        for (int i = 0; i < output_.rate(); ++i, ++next_) {
+            output_.write(Timestamp::microSecondsSince1970(1000 + next_), i) = next_;
+        }
+        return true;
+    }
+
+private:
+    SdfStream<int> output_;
+    int count_;
+    int next_;
+};
+
+class SdfDoubler : public SdfNodeBase {
+public:
+    SdfDoubler() : input_("in", this), output_("out", this) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+protected:
+    bool fire() override {
+        Timestamp timestamp;
+        const int value = input_.get(0, &timestamp);
+        output_.write(timestamp) = 2 * value;
+        return true;
+    }
+
+private:
+    SdfReader<int> input_;
+    SdfStream<int> output_;
+};
+
+// Reads <rate> integers per firing.
+class SdfCollector : public SdfNodeBase {
+public:
+    SdfCollector(int rate = 1) : input_("in", this, rate) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+
+    const std::vector<int>& received() const { return received_; }
+
+protected:
+    bool fire() override {
+        for (int i = 0; i < input_.rate(); ++i) { received_.push_back(input_.get(i)); }
+        return true;
+    }
+
+private:
+    SdfReader<int> input_;
+    std::vector<int> received_;
+};
+
+// Passes integers on, with a rate that does not match the other stream.
+class SdfMismatch : public SdfNodeBase {
+public:
+    SdfMismatch() : a_("a", this, 1), b_("b", this, 2) {}
+
+    virtual int numInputPin() const { return 2; }
+    virtual const NamedPin* constInputPin(int i) const {
+        return (i == 0 ? &a_ : (i == 1 ? &b_ : nullptr));
+    }
+
+protected:
+    bool fire() override { return true; }
+
+private:
+    SdfReader<int> a_;
+    SdfReader<int> b_;
+};
+
+// Publishes an SDF stream to the rest of the graph.
+class SdfToStream : public SdfNodeBase {
+public:
+    SdfToStream() : input_("in", this), output_("out", this, WAIT_FOR_CONSUMPTION_NEVER_DROP) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return (index == 0 ? &output_ : nullptr);
+    }
+
+protected:
+    bool fire() override {
+        Timestamp timestamp;
+        const int value = input_.get(0, &timestamp);
+        return output_.update(timestamp, value);
+    }
+
+private:
+    SdfReader<int> input_;
+    Stream<int> output_;
+};
+
+// Stops the graph after <count> firings.
+class SdfStopper : public SdfNodeBase {
+public:
+    SdfStopper(int count) : input_("in", this), count_(count) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+
+protected:
+    bool fire() override {
+        input_.get(0);
+        if (--count_ == 0) { graph()->stop(); }
+        return true;
+    }
+
+private:
+    SdfReader<int> input_;
+    int count_;
+};
+
+class CollectingConsumer : public ThreadedNodeBase {
+public:
+    CollectingConsumer() : input_("in", this) {}
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int i) const { return (i == 0 ? &input_ : nullptr); }
+
+    void threadMain() {
+        int value;
+        while (!threadMustQuit() && input_.read(&value, nullptr)) { received_.push_back(value); }
+    }
+
+    const std::vector<int>& received() const { return received_; }
+
+private:
+    StreamReader<int> input_;
+    std::vector<int> received_;
+};
+
+}  // namespace
+
+TEST(SdfSchedulerTest, RunsAChainUntilTheSourceEnds) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", 1000);
+    auto doubler = graph.newNode<SdfDoubler>("doubler");
+    auto collector = graph.newNode<SdfCollector>("collector");
+    EXPECT_TRUE(graph.connect(counter, "out", doubler, "in"));
+    EXPECT_TRUE(graph.connect(doubler, "out", collector, "in"));
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+
+    EXPECT_FALSE(graph.isStarted());
+    ASSERT_EQ(1000u, collector->received().size());
+    for (int i = 0; i < 1000; ++i) { EXPECT_EQ(2 * i, collector->received()[i]); }
+    EXPECT_EQ(1000, doubler->numFirings());
+    NamedStream* out = doubler->getOutputStreamByName("out");
+    EXPECT_EQ("1000", out->getPropertyByName("NumUpdates")->ValueToString());
+}
+
+TEST(SdfSchedulerTest, NodeOrderDoesNotMatter) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", 100);
+    auto collector = graph.newNode<SdfCollector>("collector");
+    auto doubler = graph.newNode<SdfDoubler>("doubler");
+    EXPECT_TRUE(graph.connect(counter, "out", doubler, "in"));
+    EXPECT_TRUE(graph.connect(doubler, "out", collector, "in"));
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+
+    ASSERT_EQ(100u, collector->received().size());
+    for (int i = 0; i < 100; ++i) { EXPECT_EQ(2 * i, collector->received()[i]); }
+}
+
+TEST(SdfSchedulerTest, BalancesMultirateStreams) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", 12, 2);
+    auto collector = graph.newNode<SdfCollector>("collector", 3);
+    EXPECT_TRUE(graph.connect(counter, "out", collector, "in"));
+
+    {
+        std::vector<std::unique_ptr<SdfScheduler>> schedulers;
+        ASSERT_TRUE(SdfScheduler::build(graph.nodes(), &schedulers));
+        ASSERT_EQ(1u, schedulers.size());
+
+        // 3 firings writing 2 tokens, for 2 firings reading 3 tokens.
+        std::vector<SdfNodeBase*> order = schedulers[0]->firingOrder();
+        ASSERT_EQ(5u, order.size());
+        EXPECT_EQ(3, std::count(order.begin(), order.end(), counter.get()));
+        EXPECT_EQ(2, std::count(order.begin(), order.end(), collector.get()));
+        EXPECT_EQ(counter.get(), order[0]);
+
+        NamedStream* out = counter->getOutputStreamByName("out");
+        EXPECT_EQ("2", out->getPropertyByName("Rate")->ValueToString());
+        EXPECT_LE(3, std::stoi(out->getPropertyByName("Capacity")->ValueToString()));
+        EXPECT_GE(6, std::stoi(out->getPropertyByName("Capacity")->ValueToString()));
+    }
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+    ASSERT_EQ(12u, collector->received().size());
+    for (int i = 0; i < 12; ++i) { EXPECT_EQ(i, collector->received()[i]); }
+}
+
+TEST(SdfSchedulerTest, RefusesInconsistentRates) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", 10);
+    auto mismatch = graph.newNode<SdfMismatch>("mismatch");
+    EXPECT_TRUE(graph.connect(counter, "out", mismatch, "a"));
+    EXPECT_TRUE(graph.connect(counter, "out", mismatch, "b"));
+
+    EXPECT_FALSE(graph.start());
+    EXPECT_FALSE(graph.isStarted());
+}
+
+TEST(SdfSchedulerTest, RefusesCycles) {
+    Graph graph;
+    auto a = graph.newNode<SdfDoubler>("a");
+    auto b = graph.newNode<SdfDoubler>("b");
+    EXPECT_TRUE(graph.connect(a, "out", b, "in"));
+    EXPECT_TRUE(graph.connect(b, "out", a, "in"));
+
+    EXPECT_FALSE(graph.start());
+    EXPECT_FALSE(graph.isStarted());
+}
+
+TEST(SdfSchedulerTest, FeedsThreadedNodes) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", 500);
+    auto publisher = graph.newNode<SdfToStream>("publisher");
+    auto consumer = graph.newNode<CollectingConsumer>("consumer");
+    EXPECT_TRUE(graph.connect(counter, "out", publisher, "in"));
+    EXPECT_TRUE(graph.connect(publisher, "out", consumer, "in"));
+
+    EXPECT_TRUE(graph.start());
+    graph.drain();
+
+    ASSERT_EQ(500u, consumer->received().size());
+    for (int i = 0; i < 500; ++i) { EXPECT_EQ(i, consumer->received()[i]); }
+}
+
+TEST(SdfSchedulerTest, StopInterruptsTheSubgraph) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", std::numeric_limits<int>::max());
+    auto collector = graph.newNode<SdfCollector>("collector");
+    EXPECT_TRUE(graph.connect(counter, "out", collector, "in"));
+
+    EXPECT_TRUE(graph.start());
+    Duration::milliSeconds(10).sleep();
+    EXPECT_TRUE(graph.isStarted());
+    graph.stop();
+    EXPECT_FALSE(graph.isStarted());
+    EXPECT_LT(0, collector->numFirings());
+    EXPECT_LE(collector->numFirings(), counter->numFirings());
+}
+
+TEST(SdfSchedulerTest, StopsFromAnotherThread) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", std::numeric_limits<int>::max());
+    auto collector = graph.newNode<SdfCollector>("collector");
+    EXPECT_TRUE(graph.connect(counter, "out", collector, "in"));
+    EXPECT_TRUE(graph.start());
+
+    // Destroying the scheduler waits for its thread.
+    Thread thread;
+    ASSERT_TRUE(thread.start([](void* ptr) { static_cast<Graph*>(ptr)->stop(); }, &graph));
+    thread.waitForTermination();
+    EXPECT_FALSE(graph.isStarted());
+
+    const int64_t firings = collector->numFirings();
+    Duration::milliSeconds(10).sleep();
+    EXPECT_EQ(firings, collector->numFirings());
+}
+
+TEST(SdfSchedulerTest, AFiringNodeStopsTheGraph) {
+    Graph graph;
+    auto counter = graph.newNode<SdfCounter>("counter", std::numeric_limits<int>::max());
+    auto stopper = graph.newNode<SdfStopper>("stopper", 100);
+    EXPECT_TRUE(graph.connect(counter, "out", stopper, "in"));
+    EXPECT_TRUE(graph.start());
+
+    while (graph.isStarted()) { Duration::milliSeconds(1).sleep(); }
+
+    // Stopping from this thread destroys the scheduler, once its thread is done.
+    graph.stop();
+    EXPECT_EQ(100, stopper->numFirings());
+}
+
+}  // namespace media_graph
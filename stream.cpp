@@ -25,6 +25,8 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 #include "stream.h"
+#include "graph.h"
+#include "node.h"
 #include "stream_reader.h"
 
 #include <assert.h>
@@ -70,6 +72,15 @@ bool NamedStream::isReaderRegistered(NamedPin* reader) const {
     return result;
 }
 
+std::shared_ptr<MemoryBudget> NamedStream::graphMemoryBudget() const {
+    if (!node_ || !node_->graph()) { return std::shared_ptr<MemoryBudget>(); }
+    return node_->graph()->memoryBudget();
+}
+
+bool NamedStream::graphBatchMode() const {
+    return node_ && node_->graph() && node_->graph()->batchMode();
+}
+
 void NamedStream::disconnectReaders() {
     while (readers_.size() > 0) { readers_[readers_.size() - 1]->disconnect(); }
 }
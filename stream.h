@@ -32,14 +32,18 @@
 #ifndef _STREAM_H
 #define _STREAM_H
 
+#include "clock.h"
+#include "memory_budget.h"
 #include "property.h"
 #include "thread_primitives.h"
 #include "timestamp.h"
+#include "types/payload_size.h"
 
 #include "StackString.h"
 
 #include <assert.h>
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -63,11 +67,23 @@ public:
 
     virtual ~NamedStream() { disconnectReaders(); }
     virtual std::string typeName() const = 0;
+
+    //! Identifies typeName() without allocating. Used to check connections.
+    virtual TypeId typeId() const { return typeIdFromName(typeName()); }
     const std::string& streamName() const { return name_; };
     virtual void open() {}
     virtual void close() {}
     virtual bool isOpen() const { return true; }
 
+    /*! Marks the end of the data: readers still get the entries written
+     *  before, then their reads fail with NamedPin::endOfStream() set.
+     *  Further updates fail until the stream is closed and opened again, as
+     *  when its node restarts. Streams that do not support it are simply
+     *  closed when their node stops.
+     */
+    virtual void finish() {}
+    virtual bool isFinished() const { return false; }
+
     virtual void registerReader(NamedPin* reader);
     virtual bool unregisterReader(NamedPin* reader);
     bool isReaderRegistered(NamedPin* reader) const;
@@ -78,7 +94,24 @@ public:
     void disconnectReaders();
     NodeBase* node() const { return node_; }
 
+    //! Memory budget of the graph owning node(), or null if there is none.
+    std::shared_ptr<MemoryBudget> graphMemoryBudget() const;
+
+    //! True if the graph owning node() runs in batch mode. \see Graph::setBatchMode
+    bool graphBatchMode() const;
+
+    //! Number of entries written since the stream was opened, if known.
+    virtual int64_t numUpdates() const { return 0; }
+
+    /*! Guards the counters read by the properties of the stream: copying
+     *  them in a read section gives values taken at a single instant.
+     *  Writers changing several counters at once do it in a write section.
+     *  \see GraphSnapshot
+     */
+    const SeqLock& countersLock() const { return counters_lock_; }
+
 protected:
+    SeqLock counters_lock_;
     mutable std::mutex mutex_;
     void lock() const { mutex_.lock(); }
     void unlock() const { mutex_.unlock(); }
@@ -95,6 +128,69 @@ namespace {
     template <typename T> std::string typeName();
 }
 
+/*! An entry of a stream, as exposed to readers through a StreamWindow<T>.
+ */
+template <typename T> struct StreamEntry {
+    StreamEntry(Timestamp timestamp, SequenceId sequence_id, T data)
+        : timestamp(timestamp), sequence_id(sequence_id), data(data) {}
+
+    Timestamp timestamp;
+    SequenceId sequence_id;
+    T data;
+};
+
+/*! Read-only view on the last entries read through a StreamReader<T>.
+ *  Entries stay pinned in the stream as long as they are in the window: no
+ *  copy is made, and the stream does not release them until the reader moves
+ *  forward. Entries are sorted from the oldest (index 0) to the newest.
+ *  \see StreamReader::setWindow
+ */
+template <typename T> class StreamWindow {
+public:
+    int size() const { return int(entries_.size()); }
+    bool empty() const { return entries_.empty(); }
+
+    const StreamEntry<T>& operator[](int index) const { return *entries_[index]; }
+    const StreamEntry<T>& oldest() const { return *entries_.front(); }
+    const StreamEntry<T>& newest() const { return *entries_.back(); }
+
+    //! Time elapsed between the oldest and the newest entry.
+    Duration span() const {
+        return empty() ? Duration() : newest().timestamp - oldest().timestamp;
+    }
+
+    // Public, but should only be modified by classes inheriting StreamBase<T>.
+    std::deque<const StreamEntry<T>*>& entries() { return entries_; }
+
+private:
+    std::deque<const StreamEntry<T>*> entries_;
+};
+
+/*! Entries read at once by StreamReader<T>::readBatch(), from the oldest
+ *  (index 0) to the newest. The vectors keep their capacity from one batch
+ *  to the next.
+ */
+template <typename T> struct StreamBatch {
+    std::vector<T> data;
+    std::vector<Timestamp> timestamps;
+    std::vector<SequenceId> sequence_ids;
+
+    int size() const { return int(data.size()); }
+    bool empty() const { return data.empty(); }
+
+    void clear() {
+        data.clear();
+        timestamps.clear();
+        sequence_ids.clear();
+    }
+
+    void push_back(const T& value, Timestamp timestamp, SequenceId seq) {
+        data.push_back(value);
+        timestamps.push_back(timestamp);
+        sequence_ids.push_back(seq);
+    }
+};
+
 /*! Read interface for streams. Typically, nodes in the graph keep pointers to
  *  StreamBase<T> objects, through a StreamReader<T>.
  */
@@ -103,6 +199,8 @@ public:
     StreamBase(const std::string& name, NodeBase* node) : NamedStream(name, node) {}
     virtual ~StreamBase() {}
 
+    TypeId typeId() const override { return TypeTraits<T>::id(); }
+
 protected:
     /*! Reads an entry, potentially blocking if nothing is available yet.
      *  This method is intended to be called only from a StreamReader<T>
@@ -127,6 +225,26 @@ protected:
 
     virtual bool canRead(SequenceId consumed_until, Timestamp fresher_than) const = 0;
 
+    /*! Blocks until an entry is available, then reads up to <max_entries>
+     *  entries, waiting at most <max_wait> after the first one for the
+     *  others. Returns false if nothing could be read. The default
+     *  implementation does not wait for more than the first entry.
+     *  This method is intended to be called only from a StreamReader<T>
+     *  object.
+     */
+    virtual bool readBatch(StreamReader<T>* reader, StreamBatch<T>* batch, int max_entries,
+                           Duration /*max_wait*/) {
+        batch->clear();
+        T data;
+        Timestamp timestamp;
+        SequenceId seq;
+        if (max_entries < 1 || !read(reader, &data, &timestamp, &seq)) { return false; }
+        do {
+            batch->push_back(data, timestamp, seq);
+        } while (batch->size() < max_entries && tryRead(reader, &data, &timestamp, &seq));
+        return true;
+    }
+
     // StreamReader is the only one allowed to read data.
     friend class StreamReader<T>;
 };
@@ -166,11 +284,17 @@ public:
      */
     virtual void close();
 
-    //! Cancel close(): update, read, and tryRead will behave as normal.
+    /*! Cancel close(): update, read, and tryRead will behave as normal.
+     *  Opening a finished stream that is not closed does nothing: readers
+     *  first have to drain it.
+     */
     virtual void open();
 
     virtual bool isOpen() const override { return !closed_; }
 
+    void finish() override;
+    bool isFinished() const override { return finished_; }
+
     StreamDropPolicy drop_policy() const { return drop_policy_; }
 
     virtual bool unregisterReader(NamedPin* reader);
@@ -178,51 +302,151 @@ public:
     Timestamp lastWrittenTimestamp() const { return last_written_timestamp_; }
 
     int64_t getNumUpdateCalls() const { return next_sequence_id_; }
+    int64_t numUpdates() const override { return next_sequence_id_; }
 
-    int numItemsInQueue() const { return int(buffer_.size()); }
+    int numItemsInQueue() const { return num_items_in_queue_; }
     int maxQueueSize() const { return queue_limit_; }
     bool setMaxQueueSize(const int& size) {
+        std::lock_guard<std::mutex> lock(this->mutex_);
         queue_limit_ = size;
+        slot_available_.notifyAll();
         return true;
     }
 
+    /*! Bytes held by the entries of the queue, as estimated by PayloadSize<T>.
+     *  Includes entries dropped from the queue but still held by a reader
+     *  window.
+     */
+    int64_t bytesInQueue() const { return bytes_in_queue_; }
+
+    /*! Limits the bytes held by the queue, in addition to maxQueueSize().
+     *  0 means no limit. An empty queue always accepts an entry, whatever
+     *  its size.
+     */
+    int64_t maxQueueBytes() const { return max_queue_bytes_; }
+    bool setMaxQueueBytes(const int64_t& bytes) {
+        // 0 lifts the limit: blocked producers might fit now.
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        max_queue_bytes_ = bytes;
+        slot_available_.notifyAll();
+        return true;
+    }
+
+    //! Bytes written per second of data timestamps, measured over ~1 second.
+    double bytesPerSecond() const { return bytes_per_second_; }
+
+    //! The properties shared by all the Stream<T> instances.
+    static const PropertyTable<Stream<T>>& properties();
+
 protected:
     virtual bool read(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq);
     virtual bool tryRead(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq);
     virtual bool canRead(SequenceId consumed_until, Timestamp fresher_than) const;
+    bool readBatch(StreamReader<T>* reader, StreamBatch<T>* batch, int max_entries,
+                   Duration max_wait) override;
 
     void markReadAfter(SequenceId seq) override;
     void decreaseReadCountUntil(SequenceId seq) override;
 
 private:
-    struct Entry {
-        Entry(Timestamp timestamp, SequenceId sequence_id, T data, int num_reads)
-            : timestamp(timestamp), sequence_id(sequence_id), data(data), num_reads(num_reads) {}
-
-        Timestamp timestamp;
-        SequenceId sequence_id;
-        T data;
+    struct Entry : public StreamEntry<T> {
+        Entry(Timestamp timestamp, SequenceId sequence_id, T data, int num_reads,
+              int64_t num_bytes)
+            : StreamEntry<T>(timestamp, sequence_id, data),
+              num_reads(num_reads),
+              num_pins(0),
+              num_bytes(num_bytes),
+              dropped(false) {}
 
         // Count the number of times the entry has been read.
         // When all readers read the entry, we can discard it.
         int num_reads;
+
+        // Number of reader windows holding the entry.
+        int num_pins;
+
+        // Size of the entry, as estimated by PayloadSize<T>.
+        int64_t num_bytes;
+
+        // Dropped from the queue, but kept in buffer_ while pinned.
+        bool dropped;
     };
+    typedef typename std::deque<Entry>::iterator EntryIterator;
 
-    bool findAndReadEntry(Timestamp fresher_than, SequenceId* consumed_until, T* data,
-                          Timestamp* timestamp, SequenceId* seq);
+    bool findAndReadEntry(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                          SequenceId* seq);
     bool findEntry(SequenceId consumed_until, Timestamp fresher_than) const;
-    void dropEntries();
 
+    // The drop policy in effect. Assumes mutex_ is held.
+    StreamDropPolicy policy() const {
+        return lossless_ ? WAIT_FOR_CONSUMPTION_NEVER_DROP : drop_policy_;
+    }
+
+    // Once finished, flags the reader when it has nothing left to read.
+    void updateEndOfStream(StreamReader<T>* reader);
+    void dropEntries(int64_t incoming_bytes = 0);
+
+    // Forgets the entries readers skipped that left the queue meanwhile.
+    void pruneSkippedEntries();
+
+    // True if an entry of <num_bytes> can be pushed without blocking.
+    bool hasRoomFor(int64_t num_bytes) const;
+
+    // True if a reader would accept the entry. mutex_ is held.
+    bool isWanted(Timestamp timestamp, SequenceId sequence_id);
+    bool exceedsMaxQueueBytes(int64_t incoming_bytes) const {
+        return max_queue_bytes_ > 0 && bytes_in_queue_ + incoming_bytes > max_queue_bytes_;
+    }
+    void holdBytes(int64_t num_bytes);
+    void releaseBytes(int64_t num_bytes);
+    void measureRate(Timestamp timestamp, int64_t num_bytes);
+
+    // Drops an entry from the queue. Returns the entry following it.
+    EntryIterator eraseEntry(EntryIterator it);
+
+    // The oldest entry still in the queue, or buffer_.end().
+    EntryIterator oldestEntry();
+
+    // Pops the dropped entries no window holds anymore from the front of
+    // buffer_. Returns how many were popped.
+    size_t popDroppedEntries();
+
+    // Adds an entry to the reader window and releases the ones falling out of it.
+    void pushToWindow(StreamReader<T>* reader, Entry* entry);
+    void unpin(const StreamEntry<T>* entry);
+    void releaseWindow(StreamReader<T>* reader);
+
+    // Reader windows point into buffer_: entries are only ever pushed at the
+    // back and popped from the front, so that they never move. An entry
+    // dropped while pinned stays in place, flagged as dropped, until the
+    // last window holding it releases it.
     std::deque<Entry> buffer_;
-    int queue_limit_;
-    bool closed_;
-    std::condition_variable data_available_;
-    std::condition_variable slot_available_;
+
+    // Counters and settings are atomic: properties read and write them from
+    // monitoring threads, without taking mutex_. \see GraphSnapshot
+    std::atomic<int> num_items_in_queue_;
+    std::atomic<int> queue_limit_;
+    std::atomic<int64_t> max_queue_bytes_;
+    std::atomic<int64_t> bytes_in_queue_;
+
+    // Shared with the other streams of the graph. Bound when opening.
+    std::shared_ptr<MemoryBudget> budget_;
+
+    Timestamp rate_window_start_;
+    int64_t rate_window_bytes_;
+    std::atomic<double> bytes_per_second_;
+    std::atomic<bool> closed_;
+    std::atomic<bool> finished_;
+    // Report blocked threads to their clock. \see VirtualClock
+    ClockCondition data_available_;
+    ClockCondition slot_available_;
 
     // Counts the number of calls to update() since last stream opening. Used
     // to assign a unique and monotonic sequence id to each frame.
-    int64_t next_sequence_id_;
+    std::atomic<int64_t> next_sequence_id_;
     StreamDropPolicy drop_policy_;
+    // Set when opening in batch mode: never drop. Protected by mutex_.
+    bool lossless_;
 
     // Remember when was the last update(), to avoid going back in time.
     Timestamp last_written_timestamp_;
@@ -232,50 +456,95 @@ template <class T>
 Stream<T>::Stream(const std::string& name, NodeBase* node, StreamDropPolicy drop_policy,
                   int max_queue_size)
     : StreamBase<T>(name, node),
+      num_items_in_queue_(0),
       queue_limit_(max_queue_size),
+      max_queue_bytes_(0),
+      bytes_in_queue_(0),
+      rate_window_start_(Timestamp::microSecondsSince1970(0)),
+      rate_window_bytes_(-1),
+      bytes_per_second_(0),
       closed_(false),
+      finished_(false),
       next_sequence_id_(0),
       drop_policy_(drop_policy),
+      lossless_(false),
       last_written_timestamp_(Timestamp::microSecondsSince1970(0)) {
-    this->addGetProperty("NumUpdates", this, &Stream<T>::getNumUpdateCalls);
-    this->addGetProperty("NumItemsInQueue", this, &Stream<T>::numItemsInQueue);
-    this->addGetSetProperty("MaxQueueSize", this, &Stream<T>::maxQueueSize,
-                            &Stream<T>::setMaxQueueSize);
+    this->setPropertyTable(&properties(), this);
 }
 
-template <class T> Stream<T>::~Stream() { close(); }
+template <class T> const PropertyTable<Stream<T>>& Stream<T>::properties() {
+    static const PropertyTable<Stream<T>> table = []() {
+        PropertyTable<Stream<T>> t;
+        t.addGet("NumUpdates", &Stream<T>::getNumUpdateCalls);
+        t.addGet("NumItemsInQueue", &Stream<T>::numItemsInQueue);
+        t.addGetSet("MaxQueueSize", &Stream<T>::maxQueueSize, &Stream<T>::setMaxQueueSize);
+        t.addGet("BytesInQueue", &Stream<T>::bytesInQueue);
+        t.addGetSet("MaxQueueBytes", &Stream<T>::maxQueueBytes, &Stream<T>::setMaxQueueBytes);
+        t.addGet("BytesPerSecond", &Stream<T>::bytesPerSecond);
+        return t;
+    }();
+    return table;
+}
+
+template <class T> Stream<T>::~Stream() {
+    close();
+
+    // Release reader windows while buffer_ still exists.
+    this->disconnectReaders();
+}
 
 template <class T>
 bool Stream<T>::findEntry(SequenceId consumed_until, Timestamp fresher_than) const {
     for (typename std::deque<Entry>::const_iterator it = buffer_.begin(); it != buffer_.end();
          ++it) {
-        if (consumed_until < it->sequence_id && fresher_than < it->timestamp) { return true; }
+        if (!it->dropped && consumed_until < it->sequence_id && fresher_than < it->timestamp) {
+            return true;
+        }
     }
     return false;
 }
 
+template <class T> void Stream<T>::updateEndOfStream(StreamReader<T>* reader) {
+    if (finished_ && !findEntry(*reader->lastReadSequenceIdPtr(), reader->seekPosition())) {
+        reader->setEndOfStream(true);
+    }
+}
+
 template <class T>
-bool Stream<T>::findAndReadEntry(Timestamp fresher_than, SequenceId* consumed_until, T* data,
-                                 Timestamp* timestamp, SequenceId* seq) {
+bool Stream<T>::findAndReadEntry(StreamReader<T>* reader, T* data, Timestamp* timestamp,
+                                 SequenceId* seq) {
+    const Timestamp fresher_than = reader->seekPosition();
+    SequenceId* consumed_until = reader->lastReadSequenceIdPtr();
     bool found = false;
 
-    for (typename std::deque<Entry>::iterator it = buffer_.begin();
-         !found && it != buffer_.end();) {
+    std::deque<SequenceId>* skipped = reader->skippedEntriesPtr();
+
+    for (EntryIterator it = buffer_.begin(); !found && it != buffer_.end();) {
+        if (it->dropped) {
+            ++it;
+            continue;
+        }
         bool incremented = false;
-        if (*consumed_until < it->sequence_id) {
+        while (!skipped->empty() && skipped->front() < it->sequence_id) { skipped->pop_front(); }
+        if (!skipped->empty() && skipped->front() == it->sequence_id) {
+            // Refused by the reader when written, and already counted as read.
+            skipped->pop_front();
+            if (*consumed_until < it->sequence_id) { *consumed_until = it->sequence_id; }
+        } else if (*consumed_until < it->sequence_id) {
             *consumed_until = it->sequence_id;
             ++(it->num_reads);
 
             if (fresher_than < it->timestamp) {
-                *data = it->data;
-                *timestamp = it->timestamp;
+                if (data) { *data = it->data; }
+                if (timestamp) { *timestamp = it->timestamp; }
                 if (seq) { *seq = it->sequence_id; }
+                if (reader->hasWindow()) { pushToWindow(reader, &(*it)); }
                 found = true;  // Exit loop.
-                if ((drop_policy_ & DROP_READ_BY_ALL_READERS) != 0 &&
+                if ((policy() & DROP_READ_BY_ALL_READERS) != 0 &&
                     it->num_reads >= this->numReaders()) {
-                    it = buffer_.erase(it);
+                    it = eraseEntry(it);
                     incremented = true;
-                    slot_available_.notify_one();
+                    slot_available_.notifyOne();
                 }
             }
         }
@@ -285,6 +554,75 @@ bool Stream<T>::findAndReadEntry(Timestamp fresher_than, SequenceId* consumed_un
     return found;
 }
 
+template <class T>
+typename Stream<T>::EntryIterator Stream<T>::eraseEntry(EntryIterator it) {
+    {
+        SeqLockWriter write(&this->counters_lock_);
+        // A pinned entry keeps its bytes until the last window releases it.
+        if (it->num_pins == 0) { releaseBytes(it->num_bytes); }
+        --num_items_in_queue_;
+    }
+    it->dropped = true;
+
+    // Behind a pinned entry, it might stay in buffer_ for long: free its
+    // data along with its bytes.
+    if (it->num_pins == 0) { it->data = T(); }
+
+    // Popping from the front only invalidates the popped entries: find the
+    // next entry by its index.
+    const size_t next = size_t(it - buffer_.begin()) + 1;
+    const size_t popped = popDroppedEntries();
+    return buffer_.begin() + (next > popped ? next - popped : 0);
+}
+
+template <class T> typename Stream<T>::EntryIterator Stream<T>::oldestEntry() {
+    EntryIterator it = buffer_.begin();
+    while (it != buffer_.end() && it->dropped) { ++it; }
+    return it;
+}
+
+template <class T> size_t Stream<T>::popDroppedEntries() {
+    size_t popped = 0;
+    while (!buffer_.empty() && buffer_.front().dropped && buffer_.front().num_pins == 0) {
+        buffer_.pop_front();
+        ++popped;
+    }
+    return popped;
+}
+
+template <class T> void Stream<T>::pushToWindow(StreamReader<T>* reader, Entry* entry) {
+    std::deque<const StreamEntry<T>*>& window = reader->windowPtr()->entries();
+    ++entry->num_pins;
+    window.push_back(entry);
+
+    const int max_entries = reader->windowMaxEntries();
+    const Duration max_age = reader->windowMaxAge();
+    while (!window.empty() &&
+           ((max_entries > 0 && window.size() > static_cast<unsigned>(max_entries)) ||
+            (max_age > Duration() && max_age < entry->timestamp - window.front()->timestamp))) {
+        unpin(window.front());
+        window.pop_front();
+    }
+}
+
+template <class T> void Stream<T>::unpin(const StreamEntry<T>* entry) {
+    Entry* pinned = const_cast<Entry*>(static_cast<const Entry*>(entry));
+    if (--pinned->num_pins > 0 || !pinned->dropped) { return; }
+
+    releaseBytes(pinned->num_bytes);
+    pinned->data = T();
+    popDroppedEntries();
+    slot_available_.notifyOne();
+}
+
+template <class T> void Stream<T>::releaseWindow(StreamReader<T>* reader) {
+    std::deque<const StreamEntry<T>*>& window = reader->windowPtr()->entries();
+    while (!window.empty()) {
+        unpin(window.front());
+        window.pop_front();
+    }
+}
+
 template <class T>
 bool Stream<T>::read(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq) {
     if (closed_ || !reader->isConnected()) { return false; }
@@ -292,19 +630,24 @@ bool Stream<T>::read(StreamReader<T>* reader, T* data, Timestamp* timestamp, Seq
     std::unique_lock<std::mutex> lock(this->mutex_);
 
     while (!closed_ && reader->isConnected() &&
-           !findAndReadEntry(reader->seekPosition(), reader->lastReadSequenceIdPtr(), data,
-                             timestamp, seq)) {
+           !findAndReadEntry(reader, data, timestamp, seq)) {
+        if (finished_) {
+            // Nothing more will come.
+            reader->setEndOfStream(true);
+            return false;
+        }
+
         // No data. We need to wait.
 #ifdef MEDIAGRAPH_USE_EASY_PROFILER
         const StackString<128> blockName{"waitRead ", reader->name().c_str(), "<",
-                                         reader->typeName().c_str(), ">"};
+                                         TypeTraits<T>::name(), ">"};
         EASY_BLOCK(blockName, profiler::colors::BlueGrey50);
 #endif
         data_available_.wait(lock);
     }
 
     bool success = !closed_ && reader->isConnected();
-
+    if (success) { updateEndOfStream(reader); }
     return success;
 }
 
@@ -312,11 +655,43 @@ template <class T>
 bool Stream<T>::tryRead(StreamReader<T>* reader, T* data, Timestamp* timestamp, SequenceId* seq) {
     std::lock_guard<std::mutex> lock(this->mutex_);
     bool success = !closed_ && reader->isConnected() &&
-                   findAndReadEntry(reader->seekPosition(), reader->lastReadSequenceIdPtr(), data,
-                                    timestamp, seq);
+                   findAndReadEntry(reader, data, timestamp, seq);
+    if (!closed_ && reader->isConnected()) { updateEndOfStream(reader); }
     return success;
 }
 
+template <class T>
+bool Stream<T>::readBatch(StreamReader<T>* reader, StreamBatch<T>* batch, int max_entries,
+                          Duration max_wait) {
+    batch->clear();
+    if (closed_ || !reader->isConnected() || max_entries < 1) { return false; }
+
+    std::unique_lock<std::mutex> lock(this->mutex_);
+
+    // A single lock and a single timed wait for the whole batch.
+    Timestamp deadline;
+    T data;
+    Timestamp timestamp;
+    SequenceId seq;
+    while (!closed_ && reader->isConnected() && batch->size() < max_entries) {
+        if (findAndReadEntry(reader, &data, &timestamp, &seq)) {
+            batch->push_back(data, timestamp, seq);
+            if (batch->size() == 1) { deadline = Timestamp::now() + max_wait; }
+        } else if (finished_) {
+            break;
+        } else if (batch->empty()) {
+            data_available_.wait(lock);
+        } else if (!data_available_.waitUntil(lock, deadline)) {
+            break;
+        }
+    }
+
+    // Entries already taken from the queue are delivered, even if the
+    // stream got closed in between.
+    if (!closed_ && reader->isConnected()) { updateEndOfStream(reader); }
+    return !batch->empty();
+}
+
 template <class T>
 bool Stream<T>::canRead(SequenceId consumed_until, Timestamp fresher_than) const {
     std::lock_guard<std::mutex> lock(this->mutex_);
@@ -326,42 +701,98 @@ bool Stream<T>::canRead(SequenceId consumed_until, Timestamp fresher_than) const
 }
 
 template <class T> void Stream<T>::markReadAfter(SequenceId seq) {
-    for (typename std::deque<Entry>::iterator it = buffer_.begin(); it != buffer_.end(); ++it) {
-        if (it->sequence_id > seq) { ++(it->num_reads); }
+    for (EntryIterator it = buffer_.begin(); it != buffer_.end(); ++it) {
+        if (!it->dropped && it->sequence_id > seq) { ++(it->num_reads); }
     }
     dropEntries();
 }
 
 template <class T> void Stream<T>::decreaseReadCountUntil(SequenceId seq) {
-    for (typename std::deque<Entry>::iterator it = buffer_.begin(); it != buffer_.end(); ++it) {
-        if (it->sequence_id <= seq) { --(it->num_reads); }
+    for (EntryIterator it = buffer_.begin(); it != buffer_.end(); ++it) {
+        if (!it->dropped && it->sequence_id <= seq) { --(it->num_reads); }
     }
     dropEntries();
 }
 
-template <class T> void Stream<T>::dropEntries() {
-    assert(drop_policy_ & (DROP_ANY | DROP_ZERO_READS | DROP_READ_BY_ALL_READERS));
-    if (buffer_.size() == 0) {
-        return;
-    } else if ((drop_policy_ & DROP_ANY) != 0) {
-        while (buffer_.size() >= static_cast<unsigned>(queue_limit_)) { buffer_.pop_front(); }
-    } else {
-        for (typename std::deque<Entry>::iterator it = buffer_.begin(); it != buffer_.end();) {
-            if (((drop_policy_ & DROP_ZERO_READS) != 0 && it->num_reads == 0) ||
-                ((drop_policy_ & DROP_READ_BY_ALL_READERS) != 0 &&
+template <class T> void Stream<T>::dropEntries(int64_t incoming_bytes) {
+    assert(policy() & (DROP_ANY | DROP_ZERO_READS | DROP_READ_BY_ALL_READERS));
+    if ((policy() & DROP_ANY) != 0) {
+        while (num_items_in_queue_ > 0 && (num_items_in_queue_ >= queue_limit_ ||
+                                           exceedsMaxQueueBytes(incoming_bytes))) {
+            eraseEntry(oldestEntry());
+        }
+    } else if (num_items_in_queue_ > 0) {
+        for (EntryIterator it = buffer_.begin(); it != buffer_.end();) {
+            if (it->dropped) {
+                ++it;
+            } else if (((policy() & DROP_ZERO_READS) != 0 && it->num_reads == 0) ||
+                ((policy() & DROP_READ_BY_ALL_READERS) != 0 &&
                  it->num_reads >= this->numReaders())) {
-                it = buffer_.erase(it);
-
-                if (buffer_.size() < static_cast<unsigned>(queue_limit_)) {
-                    slot_available_.notify_one();
-                }
-
+                it = eraseEntry(it);
+                slot_available_.notifyOne();
                 break;
             } else {
                 ++it;
             }
         }
     }
+    pruneSkippedEntries();
+}
+
+template <class T> void Stream<T>::pruneSkippedEntries() {
+    // Ids older than the oldest queued entry can never match one.
+    EntryIterator oldest = oldestEntry();
+    const SequenceId first =
+        (oldest == buffer_.end() ? next_sequence_id_.load() : oldest->sequence_id);
+    for (int i = 0; i < this->numReaders(); ++i) {
+        std::deque<SequenceId>* skipped =
+            static_cast<StreamReader<T>*>(this->reader(i))->skippedEntriesPtr();
+        while (!skipped->empty() && skipped->front() < first) { skipped->pop_front(); }
+    }
+}
+
+template <class T> bool Stream<T>::hasRoomFor(int64_t num_bytes) const {
+    if (num_items_in_queue_ >= queue_limit_) { return false; }
+
+    // Never block on an empty queue, or a single large entry could not pass.
+    if (num_items_in_queue_ == 0) { return true; }
+
+    return !exceedsMaxQueueBytes(num_bytes) && (!budget_ || budget_->allows(num_bytes));
+}
+
+template <class T> void Stream<T>::holdBytes(int64_t num_bytes) {
+    bytes_in_queue_ += num_bytes;
+    if (budget_) { budget_->acquire(num_bytes); }
+}
+
+template <class T> void Stream<T>::releaseBytes(int64_t num_bytes) {
+    bytes_in_queue_ -= num_bytes;
+    if (budget_) { budget_->release(num_bytes); }
+}
+
+template <class T> void Stream<T>::measureRate(Timestamp timestamp, int64_t num_bytes) {
+    if (rate_window_bytes_ < 0) {
+        rate_window_start_ = timestamp;
+        rate_window_bytes_ = 0;
+    }
+    rate_window_bytes_ += num_bytes;
+
+    const Duration elapsed = timestamp - rate_window_start_;
+    if (elapsed >= Duration::seconds(1)) {
+        bytes_per_second_ = double(rate_window_bytes_) / elapsed.seconds();
+        rate_window_start_ = timestamp;
+        rate_window_bytes_ = 0;
+    }
+}
+
+template <class T> bool Stream<T>::isWanted(Timestamp timestamp, SequenceId sequence_id) {
+    for (int i = 0; i < this->numReaders(); ++i) {
+        StreamReader<T>* reader = static_cast<StreamReader<T>*>(this->reader(i));
+        if (reader->seekPosition() < timestamp && reader->acceptsEntry(timestamp, sequence_id)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 template <class T> bool Stream<T>::update(Timestamp timestamp, T data) {
@@ -373,43 +804,87 @@ template <class T> bool Stream<T>::update(Timestamp timestamp, T data) {
     last_written_timestamp_ = timestamp;
 
     bool success = false;
-    if (!closed_) {
+    if (!closed_ && !finished_) {
         SequenceId sequence_id = next_sequence_id_;
-        ++next_sequence_id_;
+        {
+            // NumUpdates moves along with the queue counters.
+            SeqLockWriter write(&this->counters_lock_);
+            ++next_sequence_id_;
+        }
 
-        dropEntries();
-        while (!closed_ && buffer_.size() >= static_cast<unsigned>(queue_limit_)) {
-            assert(drop_policy_ != NEVER_BLOCK_DROP_OLDEST);
+        const int64_t num_bytes = static_cast<int64_t>(payloadSize(data));
+
+        // An entry no reader accepts is never queued: it must neither drop
+        // wanted entries nor block the producer.
+        const bool wanted = isWanted(timestamp, sequence_id);
+        if (wanted) { dropEntries(num_bytes); }
+        if (wanted && budget_ &&
+            ((policy() & DROP_ANY) != 0 ||
+             (!lossless_ && budget_->policy() == BUDGET_DROP_OLDEST))) {
+            // Over the graph memory budget: make room by dropping our oldest entries.
+            while (num_items_in_queue_ > 0 && !budget_->allows(num_bytes)) {
+                eraseEntry(oldestEntry());
+            }
+        }
+        while (wanted && !closed_ && !hasRoomFor(num_bytes)) {
+            assert(policy() != NEVER_BLOCK_DROP_OLDEST);
 
 #ifdef MEDIAGRAPH_USE_EASY_PROFILER
             const StackString<128> blockName{"waitUpdate ", this->streamName().c_str(), "<",
-                                             this->typeName().c_str(), ">"};
+                                             TypeTraits<T>::name(), ">"};
             EASY_BLOCK(blockName, profiler::colors::LightGreen50);
 #endif
-            slot_available_.wait(lock);
-            dropEntries();
+            if (budget_ && !budget_->allows(num_bytes)) {
+                // Memory is released by other streams: wait on the budget,
+                // without mutex_ so that our readers can release ours too.
+                std::shared_ptr<MemoryBudget> budget = budget_;
+                lock.unlock();
+                budget->waitFor(num_bytes, [this]() { return bool(closed_); });
+                lock.lock();
+            } else {
+                slot_available_.wait(lock);
+            }
+            dropEntries(num_bytes);
         }
         if (!closed_) {
-            assert(buffer_.size() < static_cast<unsigned>(queue_limit_));
-
-            // Count how many readers are interested in this entry.
+            // Count how many readers are interested in this entry. Readers
+            // might have changed while waiting for room.
             int interested = 0;
             for (int i = 0; i < this->numReaders(); ++i) {
                 StreamReader<T>* reader = static_cast<StreamReader<T>*>(this->reader(i));
-                if (reader->seekPosition() < timestamp) {
+                SequenceId* consumed_until = reader->lastReadSequenceIdPtr();
+                if (!(reader->seekPosition() < timestamp)) {
+                    *consumed_until = sequence_id;
+                } else if (reader->acceptsEntry(timestamp, sequence_id)) {
+                    // Rate limits and decimation are decided here, once, so
+                    // that refused entries are never retained for the reader.
+                    reader->markAccepted(timestamp, sequence_id);
                     interested++;
                     reader->signalActivity();
+                } else if (*consumed_until == sequence_id - 1) {
+                    // Rate limited or decimated, and nothing else pending:
+                    // mark as read, the entry is never retained for this reader.
+                    *consumed_until = sequence_id;
                 } else {
-                    *reader->lastReadSequenceIdPtr() = sequence_id;
+                    // The reader still has entries to read before this one.
+                    // Count the entry as read, and remember to skip it.
+                    reader->skippedEntriesPtr()->push_back(sequence_id);
                 }
             }
 
             if (interested > 0) {
                 // There is at least 1 reader that does not want to skip the
                 // entry: let's push it.
-                buffer_.push_back(
-                    Entry(timestamp, sequence_id, data, this->numReaders() - interested));
-                data_available_.notify_all();
+                assert(wanted && hasRoomFor(num_bytes));
+                buffer_.push_back(Entry(timestamp, sequence_id, data,
+                                        this->numReaders() - interested, num_bytes));
+                measureRate(timestamp, num_bytes);
+                {
+                    SeqLockWriter write(&this->counters_lock_);
+                    ++num_items_in_queue_;
+                    holdBytes(num_bytes);
+                }
+                data_available_.notifyAll();
             }
             success = true;
         }
@@ -420,17 +895,53 @@ template <class T> bool Stream<T>::update(Timestamp timestamp, T data) {
 template <class T> void Stream<T>::close() {
     std::lock_guard<std::mutex> lock(this->mutex_);
 
-    buffer_.clear();
+    for (EntryIterator it = buffer_.begin(); it != buffer_.end();) {
+        it = (it->dropped ? it + 1 : eraseEntry(it));
+    }
     closed_ = true;
 
     // Let's tell everybody it is no use to wait for us, we're closed.
-    data_available_.notify_all();
-    slot_available_.notify_all();
+    data_available_.notifyAll();
+    slot_available_.notifyAll();
+    if (budget_) { budget_->wakeWaiting(); }
     for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->signalActivity(); }
 }
 
+template <class T> void Stream<T>::finish() {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (closed_ || finished_) { return; }
+    finished_ = true;
+
+    // Wake readers waiting for data: they either read what is left, or
+    // learn that nothing more will come.
+    data_available_.notifyAll();
+    for (int i = 0; i < this->numReaders(); ++i) {
+        updateEndOfStream(static_cast<StreamReader<T>*>(this->reader(i)));
+        this->reader(i)->signalActivity();
+    }
+}
+
 template <class T> void Stream<T>::open() {
-    if (closed_) { next_sequence_id_ = 0; }
+    std::shared_ptr<MemoryBudget> budget = this->graphMemoryBudget();
+    const bool lossless = this->graphBatchMode();
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    lossless_ = lossless;
+    if (budget != budget_) {
+        // Transfer the bytes we hold to the new budget.
+        if (budget_) { budget_->release(bytes_in_queue_); }
+        if (budget) { budget->acquire(bytes_in_queue_); }
+        budget_ = budget;
+    }
+    if (closed_) {
+        {
+            SeqLockWriter write(&this->counters_lock_);
+            next_sequence_id_ = 0;
+        }
+        rate_window_bytes_ = -1;
+        finished_ = false;
+        for (int i = 0; i < this->numReaders(); ++i) { this->reader(i)->setEndOfStream(false); }
+    }
     closed_ = false;
 }
 
@@ -439,7 +950,34 @@ template <class T> bool Stream<T>::unregisterReader(NamedPin* reader) {
         // The disconnected reader might be waiting.
         // Let's wake it.
         static_cast<StreamReader<T>*>(reader)->signalActivity();
-        data_available_.notify_all();
+
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        data_available_.notifyAll();
+        StreamReader<T>* stream_reader = static_cast<StreamReader<T>*>(reader);
+        releaseWindow(stream_reader);
+
+        // Entries skipped ahead of time were counted as read.
+        std::deque<SequenceId>* skipped = stream_reader->skippedEntriesPtr();
+        for (EntryIterator it = buffer_.begin(); it != buffer_.end() && !skipped->empty();
+             ++it) {
+            if (it->dropped) { continue; }
+            while (!skipped->empty() && skipped->front() < it->sequence_id) {
+                skipped->pop_front();
+            }
+            if (!skipped->empty() && skipped->front() == it->sequence_id) {
+                --(it->num_reads);
+                skipped->pop_front();
+            }
+        }
+        skipped->clear();
+
+        // Nobody is left to drain a finished stream.
+        if (finished_ && this->numReaders() == 0) {
+            closed_ = true;
+            for (EntryIterator it = buffer_.begin(); it != buffer_.end();) {
+                it = (it->dropped ? it + 1 : eraseEntry(it));
+            }
+        }
         return true;
     }
     return false;
@@ -0,0 +1,555 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "stream_log.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "types/byte_order.h"
+
+namespace media_graph {
+namespace stream_log {
+    namespace {
+        std::string numberedPath(const std::string& base_path, int segment,
+                                 const char* extension) {
+            char number[16];
+            snprintf(number, sizeof(number), ".%06d.", segment);
+            return base_path + number + extension;
+        }
+    }  // namespace
+
+    std::string segmentPath(const std::string& base_path, int segment) {
+        return numberedPath(base_path, segment, "seg");
+    }
+
+    std::string indexPath(const std::string& base_path, int segment) {
+        return numberedPath(base_path, segment, "idx");
+    }
+}  // namespace stream_log
+
+namespace {
+    // How often the flush thread pushes written pages to disk.
+    const Duration kFlushPeriod = Duration::milliSeconds(100);
+
+    // How far ahead of the read position StreamLogReader asks the kernel to
+    // read, and how often it renews the request.
+    const size_t kReadAheadBytes = 8 << 20;
+
+}  // namespace
+
+using stream_log::IndexEntry;
+
+struct StreamLogWriter::Segment {
+    Segment() : index(0), fd(-1), index_file(nullptr), data(nullptr), capacity(0), size(0),
+                committed(0), flushed(0) {}
+
+    int index;
+    int fd;
+    FILE* index_file;
+    char* data;
+    size_t capacity;
+
+    // Bytes written. Only accessed by the writing thread.
+    size_t size;
+
+    // Bytes the flush thread can read: complete records only.
+    std::atomic<size_t> committed;
+
+    // Bytes pushed to disk. Only accessed by the flush thread.
+    size_t flushed;
+
+    // Index entries not written to index_file yet. Protected by mutex_.
+    std::vector<IndexEntry> pending_index;
+};
+
+StreamLogWriter::StreamLogWriter()
+    : segment_bytes_(0),
+      open_(false),
+      must_quit_(false),
+      failed_(false),
+      index_next_record_(true),
+      next_index_time_(Timestamp::microSecondsSince1970(0)),
+      next_segment_index_(0),
+      num_records_(0),
+      num_dropped_(0),
+      num_segments_(0),
+      bytes_written_(0),
+      bytes_flushed_(0),
+      bytes_per_second_(0),
+      rate_window_start_(Timestamp::microSecondsSince1970(0)),
+      rate_window_bytes_(-1) {}
+
+StreamLogWriter::~StreamLogWriter() { close(); }
+
+bool StreamLogWriter::open(const std::string& base_path, const std::string& type_name,
+                           size_t segment_bytes, Duration index_interval) {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    if (open_) { return false; }
+
+    base_path_ = base_path;
+    type_name_ = type_name;
+    segment_bytes_ = segment_bytes;
+    index_interval_ = index_interval;
+
+    current_ = createSegment(0);
+    if (!current_) { return false; }
+
+    next_segment_index_ = 1;
+    must_quit_ = false;
+    failed_ = false;
+    index_next_record_ = true;
+    num_records_ = 0;
+    num_dropped_ = 0;
+    num_segments_ = 1;
+    bytes_written_ = current_->size;
+    bytes_flushed_ = 0;
+    bytes_per_second_ = 0;
+    rate_window_bytes_ = -1;
+
+    if (!thread_.start(threadEntryPoint, this)) {
+        flushSegment(current_.get(), true);
+        current_.reset();
+        return false;
+    }
+    open_ = true;
+    return true;
+}
+
+void StreamLogWriter::close() {
+    std::lock_guard<std::mutex> write_lock(write_mutex_);
+    if (!open_) { return; }
+    open_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        must_quit_ = true;
+    }
+    work_available_.notify_all();
+    thread_.waitForTermination();
+}
+
+std::unique_ptr<StreamLogWriter::Segment> StreamLogWriter::createSegment(int index) {
+    const size_t header_size = sizeof(stream_log::kSegmentMagic) + 4 + type_name_.size();
+    if (segment_bytes_ <= header_size + stream_log::kRecordHeaderSize) { return nullptr; }
+
+    std::unique_ptr<Segment> segment(new Segment);
+    segment->index = index;
+    segment->capacity = segment_bytes_;
+
+    const std::string path = stream_log::segmentPath(base_path_, index);
+    segment->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (segment->fd < 0) { return nullptr; }
+
+    // Reserve the blocks now: running out of disk space while writing to
+    // the mapping would crash instead of failing.
+    bool allocated = false;
+#ifdef __linux__
+    allocated = (posix_fallocate(segment->fd, 0, segment_bytes_) == 0);
+#endif
+    if (!allocated && ftruncate(segment->fd, segment_bytes_) != 0) {
+        ::close(segment->fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    // Fault the pages in on this thread rather than on the writing one.
+    flags |= MAP_POPULATE;
+#endif
+    void* data = mmap(nullptr, segment_bytes_, PROT_READ | PROT_WRITE, flags, segment->fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(segment->fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+    segment->data = static_cast<char*>(data);
+
+    segment->index_file = fopen(stream_log::indexPath(base_path_, index).c_str(), "wb");
+    if (!segment->index_file ||
+        fwrite(stream_log::kIndexMagic, sizeof(stream_log::kIndexMagic), 1,
+               segment->index_file) != 1) {
+        if (segment->index_file) { fclose(segment->index_file); }
+        munmap(segment->data, segment_bytes_);
+        ::close(segment->fd);
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    unsigned char* header = reinterpret_cast<unsigned char*>(segment->data);
+    memcpy(header, stream_log::kSegmentMagic, sizeof(stream_log::kSegmentMagic));
+    storeBigEndian32(static_cast<uint32_t>(type_name_.size()),
+                     header + sizeof(stream_log::kSegmentMagic));
+    memcpy(header + sizeof(stream_log::kSegmentMagic) + 4, type_name_.data(), type_name_.size());
+    segment->size = header_size;
+    segment->committed = header_size;
+    return segment;
+}
+
+char* StreamLogWriter::beginRecord(Timestamp timestamp, SequenceId sequence_id,
+                                   size_t payload_size, bool lossless) {
+    const size_t record_size = stream_log::kRecordHeaderSize + payload_size;
+    if (!open_ || payload_size == 0 || payload_size > UINT32_MAX) {
+        ++num_dropped_;
+        return nullptr;
+    }
+
+    if (current_->size + record_size > current_->capacity) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (lossless) { segment_ready_.wait(lock, [this] { return next_ || failed_; }); }
+
+        // A record that does not fit in an empty segment never will.
+        if (!next_ || next_->size + record_size > next_->capacity) {
+            ++num_dropped_;
+            return nullptr;
+        }
+        bytes_written_ += next_->size;
+        retired_.push_back(std::move(current_));
+        current_ = std::move(next_);
+        ++num_segments_;
+        index_next_record_ = true;
+        work_available_.notify_all();
+    }
+
+    unsigned char* header = reinterpret_cast<unsigned char*>(current_->data + current_->size);
+    storeBigEndian32(static_cast<uint32_t>(payload_size), header);
+    storeBigEndian64(static_cast<uint64_t>(timestamp.nanoSecondsSince1970()), header + 4);
+    storeBigEndian64(static_cast<uint64_t>(sequence_id), header + 12);
+
+    if (index_next_record_ || !(timestamp < next_index_time_)) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_->pending_index.push_back(IndexEntry{timestamp, current_->size});
+        next_index_time_ = timestamp + index_interval_;
+        index_next_record_ = false;
+    }
+    return current_->data + current_->size + stream_log::kRecordHeaderSize;
+}
+
+void StreamLogWriter::endRecord(size_t record_size) {
+    current_->size += record_size;
+    current_->committed.store(current_->size, std::memory_order_release);
+    bytes_written_ += record_size;
+    ++num_records_;
+
+    const Timestamp now = Timestamp::now();
+    if (rate_window_bytes_ < 0) {
+        rate_window_start_ = now;
+        rate_window_bytes_ = 0;
+    }
+    rate_window_bytes_ += record_size;
+    const Duration elapsed = now - rate_window_start_;
+    if (elapsed >= Duration::seconds(1)) {
+        bytes_per_second_ = double(rate_window_bytes_) / elapsed.seconds();
+        rate_window_start_ = now;
+        rate_window_bytes_ = 0;
+    }
+}
+
+void StreamLogWriter::flushSegment(Segment* segment, bool retire) {
+    std::vector<IndexEntry> index;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index.swap(segment->pending_index);
+    }
+
+    const size_t committed = segment->committed.load(std::memory_order_acquire);
+    if (committed > segment->flushed) {
+        // msync needs a page aligned address.
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        const size_t start = segment->flushed / page * page;
+        msync(segment->data + start, committed - start, MS_SYNC);
+        bytes_flushed_ += committed - segment->flushed;
+        segment->flushed = committed;
+    }
+
+    for (const IndexEntry& entry : index) {
+        unsigned char bytes[stream_log::kIndexEntrySize];
+        storeBigEndian64(static_cast<uint64_t>(entry.timestamp.nanoSecondsSince1970()), bytes);
+        storeBigEndian64(entry.offset, bytes + 8);
+        fwrite(bytes, sizeof(bytes), 1, segment->index_file);
+    }
+    if (!index.empty()) { fflush(segment->index_file); }
+
+    if (retire) {
+        munmap(segment->data, segment->capacity);
+        segment->data = nullptr;
+        // Drop the preallocated space past the last record.
+        if (ftruncate(segment->fd, committed) != 0) {
+            // The zeros left at the end still terminate the segment.
+        }
+        ::close(segment->fd);
+        fclose(segment->index_file);
+    }
+}
+
+void StreamLogWriter::threadEntryPoint(void* ptr) {
+    static_cast<StreamLogWriter*>(ptr)->threadMain();
+}
+
+void StreamLogWriter::threadMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!must_quit_) {
+        // After a failure, retry at the next period: the disk may have
+        // been freed in between.
+        if (!next_) {
+            lock.unlock();
+            std::unique_ptr<Segment> segment = createSegment(next_segment_index_);
+            lock.lock();
+            if (segment) {
+                ++next_segment_index_;
+                next_ = std::move(segment);
+            }
+            failed_ = !next_;
+            segment_ready_.notify_all();
+        }
+
+        std::deque<std::unique_ptr<Segment>> retired;
+        retired.swap(retired_);
+        Segment* current = current_.get();
+        lock.unlock();
+
+        for (auto& segment : retired) { flushSegment(segment.get(), true); }
+        flushSegment(current, false);
+
+        lock.lock();
+        work_available_.wait_for(lock, std::chrono::microseconds(kFlushPeriod.microSeconds()),
+                                 [this] { return must_quit_ || !retired_.empty(); });
+    }
+
+    // The writing thread is done: close() holds write_mutex_.
+    std::deque<std::unique_ptr<Segment>> retired;
+    retired.swap(retired_);
+    lock.unlock();
+    for (auto& segment : retired) { flushSegment(segment.get(), true); }
+    flushSegment(current_.get(), true);
+    current_.reset();
+
+    // Remove the segment prepared in advance, but never written to.
+    if (next_) {
+        munmap(next_->data, next_->capacity);
+        ::close(next_->fd);
+        fclose(next_->index_file);
+        unlink(stream_log::segmentPath(base_path_, next_->index).c_str());
+        unlink(stream_log::indexPath(base_path_, next_->index).c_str());
+        next_.reset();
+    }
+}
+
+StreamLogReader::StreamLogReader()
+    : begin_time_(Timestamp::microSecondsSince1970(0)),
+      end_time_(Timestamp::microSecondsSince1970(0)),
+      segment_(0),
+      offset_(0),
+      read_ahead_end_(0) {}
+
+StreamLogReader::~StreamLogReader() { close(); }
+
+bool StreamLogReader::open(const std::string& base_path) {
+    close();
+
+    for (int index = 0;; ++index) {
+        const int fd = ::open(stream_log::segmentPath(base_path, index).c_str(), O_RDONLY);
+        if (fd < 0) { break; }
+
+        struct stat status;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd,
+                        0);
+        }
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            break;
+        }
+
+        Segment segment;
+        segment.fd = fd;
+        segment.data = static_cast<const char*>(data);
+        segment.size = static_cast<size_t>(status.st_size);
+        segment.begin_time = Timestamp::microSecondsSince1970(0);
+        segments_.push_back(segment);
+
+        // Check the header, and that all segments hold the same type.
+        const size_t magic_size = sizeof(stream_log::kSegmentMagic);
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(segment.data);
+        if (segment.size < magic_size + 4 ||
+            memcmp(header, stream_log::kSegmentMagic, magic_size) != 0) {
+            close();
+            return false;
+        }
+        const size_t name_size = loadBigEndian32(header + magic_size);
+        if (segment.size < magic_size + 4 + name_size) {
+            close();
+            return false;
+        }
+        const std::string type_name(segment.data + magic_size + 4, name_size);
+        if (index == 0) {
+            type_name_ = type_name;
+        } else if (type_name != type_name_) {
+            close();
+            return false;
+        }
+        segments_.back().header_size = magic_size + 4 + name_size;
+
+        Record first;
+        if (!parseRecord(segments_.back(), segments_.back().header_size, &first)) {
+            // A segment without records ends the log.
+            munmap(const_cast<char*>(segment.data), segment.size);
+            ::close(fd);
+            segments_.pop_back();
+            break;
+        }
+        segments_.back().begin_time = first.timestamp;
+
+        // The index is optional: it only speeds up seek().
+        FILE* index_file = fopen(stream_log::indexPath(base_path, index).c_str(), "rb");
+        if (index_file) {
+            char magic[sizeof(stream_log::kIndexMagic)];
+            unsigned char bytes[stream_log::kIndexEntrySize];
+            if (fread(magic, sizeof(magic), 1, index_file) == 1 &&
+                memcmp(magic, stream_log::kIndexMagic, sizeof(magic)) == 0) {
+                while (fread(bytes, sizeof(bytes), 1, index_file) == 1) {
+                    const IndexEntry entry = {
+                        Timestamp::nanoSecondsSince1970(int64_t(loadBigEndian64(bytes))),
+                        loadBigEndian64(bytes + 8)};
+                    if (entry.offset < segment.size) { segments_.back().index.push_back(entry); }
+                }
+            }
+            fclose(index_file);
+        }
+        posix_madvise(const_cast<char*>(segment.data), segment.size, POSIX_MADV_SEQUENTIAL);
+    }
+
+    if (segments_.empty()) { return false; }
+
+    // Find the last record, starting from the last indexed one.
+    const Segment& last = segments_.back();
+    size_t offset = (last.index.empty() ? last.header_size : last.index.back().offset);
+    Record record;
+    while (parseRecord(last, offset, &record)) {
+        end_time_ = record.timestamp;
+        offset = size_t(record.payload - last.data) + record.size;
+    }
+    begin_time_ = segments_.front().begin_time;
+
+    segment_ = 0;
+    offset_ = segments_.front().header_size;
+    read_ahead_end_ = 0;
+    return true;
+}
+
+void StreamLogReader::close() {
+    for (const Segment& segment : segments_) {
+        munmap(const_cast<char*>(segment.data), segment.size);
+        ::close(segment.fd);
+    }
+    segments_.clear();
+    type_name_.clear();
+    segment_ = 0;
+    offset_ = 0;
+}
+
+bool StreamLogReader::parseRecord(const Segment& segment, size_t offset, Record* record) {
+    if (offset + stream_log::kRecordHeaderSize > segment.size) { return false; }
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(segment.data + offset);
+    const size_t size = loadBigEndian32(header);
+    // Zeros follow the last record of a segment still being written.
+    if (size == 0 || size > segment.size - offset - stream_log::kRecordHeaderSize) {
+        return false;
+    }
+    record->timestamp = Timestamp::nanoSecondsSince1970(int64_t(loadBigEndian64(header + 4)));
+    record->sequence_id = SequenceId(loadBigEndian64(header + 12));
+    record->payload = segment.data + offset + stream_log::kRecordHeaderSize;
+    record->size = size;
+    return true;
+}
+
+bool StreamLogReader::next(Record* record) {
+    while (segment_ < segments_.size()) {
+        if (parseRecord(segments_[segment_], offset_, record)) {
+            offset_ += stream_log::kRecordHeaderSize + record->size;
+            if (offset_ > read_ahead_end_) { readAhead(); }
+            return true;
+        }
+        ++segment_;
+        if (segment_ < segments_.size()) {
+            offset_ = segments_[segment_].header_size;
+            read_ahead_end_ = 0;
+        }
+    }
+    return false;
+}
+
+void StreamLogReader::readAhead() {
+    const Segment& segment = segments_[segment_];
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start = offset_ / page * page;
+    const size_t end = std::min(segment.size, offset_ + kReadAheadBytes);
+    posix_madvise(const_cast<char*>(segment.data + start), end - start, POSIX_MADV_WILLNEED);
+    // Renew the request when half of it has been read.
+    read_ahead_end_ = offset_ + (end - offset_) / 2;
+}
+
+bool StreamLogReader::seek(Timestamp time) {
+    if (segments_.empty()) { return false; }
+
+    // The last segment starting before <time>. Records equal to <time> can
+    // be at the end of the previous segment.
+    auto segment = std::lower_bound(
+        segments_.begin(), segments_.end(), time,
+        [](const Segment& s, Timestamp t) { return s.begin_time < t; });
+    if (segment != segments_.begin()) { --segment; }
+
+    // The last index entry before <time>: all the records before it are too
+    // old.
+    auto entry = std::lower_bound(
+        segment->index.begin(), segment->index.end(), time,
+        [](const IndexEntry& e, Timestamp t) { return e.timestamp < t; });
+    segment_ = size_t(segment - segments_.begin());
+    offset_ = (entry == segment->index.begin() ? segment->header_size : (entry - 1)->offset);
+
+    // Scan the records of at most one index interval.
+    while (segment_ < segments_.size()) {
+        Record record;
+        if (parseRecord(segments_[segment_], offset_, &record)) {
+            if (!(record.timestamp < time)) {
+                readAhead();
+                return true;
+            }
+            offset_ += stream_log::kRecordHeaderSize + record.size;
+        } else if (++segment_ < segments_.size()) {
+            offset_ = segments_[segment_].header_size;
+        }
+    }
+    return false;
+}
+
+}  // namespace media_graph
@@ -0,0 +1,296 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_STREAM_LOG_H
+#define MEDIAGRAPH_STREAM_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stream.h"
+#include "thread_primitives.h"
+#include "timestamp.h"
+#include "types/binary_serializer.h"
+#include "types/type_visitor.h"
+
+namespace media_graph {
+
+/*! On-disk format of stream logs, shared by the writer and the reader.
+ *  All integers are big endian, like BinarySerializer.
+ *
+ *  A log is a sequence of segment files, "<base>.000000.seg",
+ *  "<base>.000001.seg"... Each segment starts with a header: kSegmentMagic,
+ *  followed by the stream type name as an int size and its bytes. Records
+ *  follow: uint32 payload size, int64 timestamp in nanoseconds, int64
+ *  sequence id, then the payload written by BinarySerializer. A payload
+ *  size of 0 ends the segment: files are preallocated with zeros.
+ *
+ *  Each segment has a sparse index, "<base>.000000.idx": kIndexMagic,
+ *  followed by (int64 timestamp, uint64 offset) pairs pointing to records.
+ *  The first record of a segment is always indexed.
+ */
+namespace stream_log {
+    const char kSegmentMagic[8] = {'M', 'G', 'L', 'O', 'G', '0', '0', '2'};
+    const char kIndexMagic[8] = {'M', 'G', 'I', 'D', 'X', '0', '0', '2'};
+    enum { kRecordHeaderSize = 4 + 8 + 8, kIndexEntrySize = 8 + 8 };
+
+    std::string segmentPath(const std::string& base_path, int segment);
+    std::string indexPath(const std::string& base_path, int segment);
+
+    struct IndexEntry {
+        Timestamp timestamp;
+        uint64_t offset;
+    };
+}  // namespace stream_log
+
+/*! Writes stream entries to a segmented log, without blocking on the disk.
+ *
+ *  Segments are preallocated and memory-mapped: writing a record is a copy
+ *  into memory. A background thread prepares the next segment in advance,
+ *  writes the index, flushes written pages to disk, and closes full
+ *  segments. Only that thread waits for the disk.
+ *
+ *  When the next segment is not ready in time, write() either waits for it
+ *  (lossless) or drops the entry (lossy), and counts it in numDropped().
+ *  Entries are also dropped when the next segment can not be created, for
+ *  example when the disk is full, and when they are larger than a segment.
+ *
+ *  write() must be called from a single thread. Statistics can be read
+ *  from any thread. POSIX only.
+ */
+class StreamLogWriter {
+public:
+    StreamLogWriter();
+    ~StreamLogWriter();
+
+    /*! Creates the first segment and starts the flush thread. Existing
+     *  segments with the same <base_path> are overwritten. Returns false if
+     *  the files can not be created.
+     *  \param segment_bytes Size of each segment file.
+     *  \param index_interval Minimum time between two index entries.
+     */
+    bool open(const std::string& base_path, const std::string& type_name,
+              size_t segment_bytes = 64 << 20, Duration index_interval = Duration::seconds(1));
+
+    //! Flushes everything, trims the last segment to its used size, and
+    //! stops the flush thread.
+    void close();
+
+    bool isOpen() const { return open_; }
+
+    //! Appends an entry. Returns false if the entry is dropped.
+    template <typename T>
+    bool write(Timestamp timestamp, SequenceId sequence_id, const T& data, bool lossless);
+
+    int64_t numRecords() const { return num_records_; }
+    int64_t numDropped() const { return num_dropped_; }
+    int numSegments() const { return num_segments_; }
+
+    //! Bytes written to segments so far, including headers.
+    int64_t bytesWritten() const { return bytes_written_; }
+
+    //! Bytes written but not flushed to disk yet.
+    int64_t backlogBytes() const { return bytes_written_ - bytes_flushed_; }
+
+    //! Bytes written per second of wall time, measured over ~1 second.
+    double bytesPerSecond() const { return bytes_per_second_; }
+
+private:
+    struct Segment;
+
+    // Returns room for a record of <payload_size> bytes, or null.
+    char* beginRecord(Timestamp timestamp, SequenceId sequence_id, size_t payload_size,
+                      bool lossless);
+    void endRecord(size_t record_size);
+
+    std::unique_ptr<Segment> createSegment(int index);
+    static void threadEntryPoint(void* ptr);
+    void threadMain();
+
+    // Flushes what is written in <segment>. Closes it if <retire>.
+    void flushSegment(Segment* segment, bool retire);
+
+    std::string base_path_;
+    std::string type_name_;
+    size_t segment_bytes_;
+    Duration index_interval_;
+
+    // Serializes write() and close(). Uncontended while recording.
+    std::mutex write_mutex_;
+    std::atomic<bool> open_;
+
+    // Protects the fields below, shared with the flush thread. The writing
+    // thread only takes it to switch segments or to add an index entry.
+    std::mutex mutex_;
+    std::condition_variable segment_ready_;
+    std::condition_variable work_available_;
+    // Only replaced by the writing thread. The flush thread reads the bytes
+    // committed to it, which do not change anymore.
+    std::unique_ptr<Segment> current_;
+    std::unique_ptr<Segment> next_;
+    std::deque<std::unique_ptr<Segment>> retired_;
+    bool must_quit_;
+    bool failed_;
+
+    // Writing thread only.
+    bool index_next_record_;
+    Timestamp next_index_time_;
+
+    // Flush thread only, once started.
+    int next_segment_index_;
+
+    Thread thread_;
+
+    std::atomic<int64_t> num_records_;
+    std::atomic<int64_t> num_dropped_;
+    std::atomic<int> num_segments_;
+    std::atomic<int64_t> bytes_written_;
+    std::atomic<int64_t> bytes_flushed_;
+    std::atomic<double> bytes_per_second_;
+    Timestamp rate_window_start_;
+    int64_t rate_window_bytes_;
+};
+
+/*! Reads a log written by StreamLogWriter, sequentially or from any time.
+ *
+ *  Segments are memory-mapped read-only. next() returns pointers into the
+ *  mapping instead of copies, and read() de-serializes directly from it.
+ *  While reading forward, the kernel is asked to read ahead (madvise).
+ *
+ *  seek() looks for the segment, then for the index entry, with binary
+ *  searches, and scans forward from there: at most one index interval.
+ *
+ *  A log still being written can be read, up to the records complete when
+ *  open() was called.
+ */
+class StreamLogReader {
+public:
+    struct Record {
+        Record() : timestamp(Timestamp::microSecondsSince1970(0)), sequence_id(0),
+                   payload(nullptr), size(0) {}
+
+        Timestamp timestamp;
+        SequenceId sequence_id;
+
+        //! Serialized entry, valid until the reader is closed.
+        const char* payload;
+        size_t size;
+    };
+
+    StreamLogReader();
+    ~StreamLogReader();
+
+    //! Maps all the segments of the log at <base_path>. Returns false if
+    //! there is none, or if they are not readable logs.
+    bool open(const std::string& base_path);
+    void close();
+    bool isOpen() const { return !segments_.empty(); }
+
+    //! Type name of the recorded stream.
+    const std::string& typeName() const { return type_name_; }
+
+    int numSegments() const { return int(segments_.size()); }
+
+    //! Timestamps of the first and of the last record.
+    Timestamp beginTime() const { return begin_time_; }
+    Timestamp endTime() const { return end_time_; }
+
+    //! Reads the next record. Returns false at the end of the log.
+    bool next(Record* record);
+
+    //! Reads and de-serializes the next record.
+    template <typename T> bool read(T* data, Timestamp* timestamp, SequenceId* sequence_id);
+
+    /*! Moves to the first record with a timestamp of at least <time>.
+     *  Returns false if there is no such record: reading then fails until
+     *  the next seek.
+     */
+    bool seek(Timestamp time);
+
+private:
+    struct Segment {
+        int fd;
+        const char* data;
+        size_t size;
+        size_t header_size;
+        Timestamp begin_time;
+        std::vector<stream_log::IndexEntry> index;
+    };
+
+    // Parses the record at <offset>. Returns false past the last one.
+    static bool parseRecord(const Segment& segment, size_t offset, Record* record);
+
+    // Asks the kernel to read the bytes following the read position.
+    void readAhead();
+
+    std::vector<Segment> segments_;
+    std::string type_name_;
+    Timestamp begin_time_;
+    Timestamp end_time_;
+
+    // Read position.
+    size_t segment_;
+    size_t offset_;
+
+    // End of the range already passed to madvise, in segment_.
+    size_t read_ahead_end_;
+};
+
+template <typename T>
+bool StreamLogReader::read(T* data, Timestamp* timestamp, SequenceId* sequence_id) {
+    Record record;
+    if (!next(&record)) { return false; }
+    BinaryDeSerializer deSerializer(record.payload, record.size);
+    if (!visitValue(&deSerializer, data)) { return false; }
+    if (timestamp) { *timestamp = record.timestamp; }
+    if (sequence_id) { *sequence_id = record.sequence_id; }
+    return true;
+}
+
+template <typename T>
+bool StreamLogWriter::write(Timestamp timestamp, SequenceId sequence_id, const T& data,
+                            bool lossless) {
+    BinarySizeCounter counter;
+    if (!visitValue(&counter, data)) { return false; }
+
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    char* payload = beginRecord(timestamp, sequence_id, counter.size(), lossless);
+    if (!payload) { return false; }
+
+    BinarySerializer serializer(payload, counter.size());
+    visitValue(&serializer, data);
+    endRecord(stream_log::kRecordHeaderSize + counter.size());
+    return true;
+}
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_STREAM_LOG_H
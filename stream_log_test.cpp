@@ -0,0 +1,262 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "stream_log.h"
+#include "stream_recorder.h"
+
+#include "graph.h"
+#include "node.h"
+#include "stream.h"
+#include "types/byte_order.h"
+
+namespace media_graph {
+namespace {
+    struct Record {
+        int64_t timestamp;
+        int64_t sequence_id;
+        std::string payload;
+    };
+
+    std::string readFile(const std::string& path) {
+        std::ifstream file(path.c_str(), std::ios::binary);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    bool fileExists(const std::string& path) { return access(path.c_str(), F_OK) == 0; }
+
+    const unsigned char* bytes(const std::string& data, size_t offset) {
+        return reinterpret_cast<const unsigned char*>(data.data() + offset);
+    }
+
+    // Parses a segment, checking its header.
+    std::vector<Record> readSegment(const std::string& path, const std::string& type_name,
+                                    size_t* header_size) {
+        std::vector<Record> records;
+        const std::string data = readFile(path);
+        EXPECT_EQ(0, data.compare(0, 8, stream_log::kSegmentMagic, 8));
+        EXPECT_EQ(type_name.size(), loadBigEndian32(bytes(data, 8)));
+        EXPECT_EQ(type_name, data.substr(12, type_name.size()));
+
+        size_t offset = 12 + type_name.size();
+        *header_size = offset;
+        while (offset + stream_log::kRecordHeaderSize <= data.size()) {
+            const uint32_t size = loadBigEndian32(bytes(data, offset));
+            if (size == 0) { break; }
+            Record record;
+            record.timestamp = int64_t(loadBigEndian64(bytes(data, offset + 4)));
+            record.sequence_id = int64_t(loadBigEndian64(bytes(data, offset + 12)));
+            record.payload = data.substr(offset + stream_log::kRecordHeaderSize, size);
+            records.push_back(record);
+            offset += stream_log::kRecordHeaderSize + size;
+        }
+        EXPECT_EQ(data.size(), offset) << "Segments are trimmed when closed.";
+        return records;
+    }
+
+    class TempDirectory {
+    public:
+        TempDirectory() {
+            char path[] = "/tmp/stream_log_test.XXXXXX";
+            path_ = mkdtemp(path);
+        }
+        ~TempDirectory() {
+            std::string command = "rm -rf " + path_;
+            if (system(command.c_str()) != 0) {}
+        }
+        std::string path(const std::string& name) const { return path_ + "/" + name; }
+
+    private:
+        std::string path_;
+    };
+
+    class SourceNode : public NodeBase {
+    public:
+        SourceNode() : output("out", this, WAIT_FOR_CONSUMPTION_NEVER_DROP, 4) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        Stream<int> output;
+    };
+
+}  // namespace
+
+TEST(StreamLogTest, WritesSegmentsAndIndex) {
+    TempDirectory directory;
+    const std::string base = directory.path("log");
+
+    StreamLogWriter writer;
+    // Room for ~40 int records per segment.
+    ASSERT_TRUE(writer.open(base, "int", 1024, Duration::microSeconds(10)));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(writer.write(Timestamp::microSecondsSince1970(i * 5), i, i, true));
+    }
+    EXPECT_EQ(100, writer.numRecords());
+    EXPECT_EQ(0, writer.numDropped());
+    writer.close();
+    EXPECT_EQ(0, writer.backlogBytes());
+    EXPECT_FALSE(writer.isOpen());
+
+    std::vector<Record> records;
+    for (int segment = 0; segment < writer.numSegments(); ++segment) {
+        size_t header_size;
+        std::vector<Record> segment_records =
+            readSegment(stream_log::segmentPath(base, segment), "int", &header_size);
+        ASSERT_FALSE(segment_records.empty());
+
+        // The index points to the first record, then to one every 10us.
+        const std::string index = readFile(stream_log::indexPath(base, segment));
+        ASSERT_EQ(0, index.compare(0, 8, stream_log::kIndexMagic, 8));
+        ASSERT_LT(8u, index.size());
+        EXPECT_EQ(0u, (index.size() - 8) % stream_log::kIndexEntrySize);
+        EXPECT_EQ(segment_records[0].timestamp, int64_t(loadBigEndian64(bytes(index, 8))));
+        EXPECT_EQ(header_size, loadBigEndian64(bytes(index, 16)));
+        const size_t num_index_entries = (index.size() - 8) / stream_log::kIndexEntrySize;
+        EXPECT_EQ((segment_records.size() + 1) / 2, num_index_entries);
+
+        records.insert(records.end(), segment_records.begin(), segment_records.end());
+    }
+    EXPECT_LT(1, writer.numSegments());
+    EXPECT_FALSE(fileExists(stream_log::segmentPath(base, writer.numSegments())));
+
+    ASSERT_EQ(100u, records.size());
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(i * 5000, records[i].timestamp);  // In nanoseconds.
+        EXPECT_EQ(i, records[i].sequence_id);
+        BinaryDeSerializer deSerializer(records[i].payload);
+        int value = -1;
+        EXPECT_TRUE(deSerializer.process(&value));
+        EXPECT_EQ(i, value);
+    }
+}
+
+TEST(StreamLogTest, DropsRecordsLargerThanASegment) {
+    TempDirectory directory;
+    StreamLogWriter writer;
+    ASSERT_TRUE(writer.open(directory.path("log"), "string", 256));
+    EXPECT_FALSE(writer.write(Timestamp::microSecondsSince1970(1), 0, std::string(300, 'x'),
+                              true));
+    EXPECT_TRUE(writer.write(Timestamp::microSecondsSince1970(2), 1, std::string("ok"), true));
+    EXPECT_EQ(1, writer.numDropped());
+    EXPECT_EQ(1, writer.numRecords());
+}
+
+TEST(StreamLogTest, ReadsAndSeeks) {
+    TempDirectory directory;
+    const std::string base = directory.path("log");
+    {
+        StreamLogWriter writer;
+        ASSERT_TRUE(writer.open(base, "int", 1024, Duration::microSeconds(50)));
+        // Two records per timestamp, to check seeking to the first one.
+        for (int i = 0; i < 200; ++i) {
+            writer.write(Timestamp::microSecondsSince1970(100 + (i / 2) * 10), i, i, true);
+        }
+    }
+
+    StreamLogReader reader;
+    EXPECT_FALSE(reader.open(directory.path("missing")));
+    ASSERT_TRUE(reader.open(base));
+    EXPECT_EQ("int", reader.typeName());
+    EXPECT_LT(1, reader.numSegments());
+    EXPECT_EQ(100, reader.beginTime().microSecondsSince1970());
+    EXPECT_EQ(1090, reader.endTime().microSecondsSince1970());
+
+    int value;
+    Timestamp timestamp;
+    SequenceId sequence_id;
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(reader.read(&value, &timestamp, &sequence_id));
+        EXPECT_EQ(i, value);
+        EXPECT_EQ(i, sequence_id);
+    }
+    EXPECT_FALSE(reader.read(&value, &timestamp, &sequence_id));
+
+    for (int target = 0; target <= 1090; target += 7) {
+        ASSERT_TRUE(reader.seek(Timestamp::microSecondsSince1970(target)));
+        ASSERT_TRUE(reader.read(&value, &timestamp, &sequence_id));
+        const int expected_time = std::max(100, (target + 9) / 10 * 10);
+        EXPECT_EQ(expected_time, timestamp.microSecondsSince1970());
+        EXPECT_EQ((expected_time - 100) / 10 * 2, value);
+    }
+
+    // Records are returned in place, without copy.
+    ASSERT_TRUE(reader.seek(Timestamp::microSecondsSince1970(1090)));
+    StreamLogReader::Record record;
+    ASSERT_TRUE(reader.next(&record));
+    EXPECT_EQ(198, record.sequence_id);
+    EXPECT_EQ(4u, record.size);
+    EXPECT_EQ(198u, loadBigEndian32(reinterpret_cast<const unsigned char*>(record.payload)));
+
+    EXPECT_FALSE(reader.seek(Timestamp::microSecondsSince1970(1091)));
+    EXPECT_FALSE(reader.next(&record));
+}
+
+TEST(StreamLogTest, RecorderNode) {
+    TempDirectory directory;
+    Graph graph;
+    std::shared_ptr<SourceNode> source = graph.newNode<SourceNode>("source");
+    std::shared_ptr<StreamRecorder<int>> recorder =
+        graph.newNode<StreamRecorder<int>>("recorder", directory.path("ints"));
+    ASSERT_TRUE(graph.connect("source", "out", "recorder", "input"));
+    ASSERT_TRUE(graph.start());
+    // The path can not change while recording.
+    recorder->getPropertyByName("Path")->ValueFromString("elsewhere");
+    EXPECT_EQ(directory.path("ints"), recorder->path());
+
+    for (int i = 1; i <= 1000; ++i) {
+        source->output.update(Timestamp::microSecondsSince1970(i), i);
+    }
+    for (int i = 0; i < 1000 && recorder->numRecorded() < 1000; ++i) {
+        Duration::milliSeconds(5).sleep();
+    }
+    graph.stop();
+
+    EXPECT_EQ(1000, recorder->numRecorded());
+    EXPECT_EQ("0", recorder->getPropertyByName("NumDropped")->ValueToString());
+    EXPECT_EQ("0", recorder->getPropertyByName("BacklogBytes")->ValueToString());
+
+    size_t header_size;
+    std::vector<Record> records =
+        readSegment(stream_log::segmentPath(directory.path("ints"), 0), "int", &header_size);
+    ASSERT_EQ(1000u, records.size());
+    EXPECT_EQ(1000 * 1000, records.back().timestamp);
+}
+
+}  // namespace media_graph
@@ -27,6 +27,8 @@
 #ifndef MEDIAGRAPH_STREAM_READER_H
 #define MEDIAGRAPH_STREAM_READER_H
 
+#include <atomic>
+#include <deque>
 #include <string>
 
 #include "node.h"
@@ -40,11 +42,16 @@ class NodeBase;
  */
 class NamedPin : public PropertyList {
 public:
-    NamedPin(const std::string& name, NodeBase* node) : name_(name), node_(node) {}
+    NamedPin(const std::string& name, NodeBase* node)
+        : end_of_stream_(false), name_(name), node_(node) {}
     virtual ~NamedPin() {}
     const std::string& name() const { return name_; }
 
     virtual std::string typeName() const = 0;
+
+    //! Identifies typeName() without allocating. Used to check connections.
+    virtual TypeId typeId() const { return typeIdFromName(typeName()); }
+
     virtual bool connect(NamedStream* stream) = 0;
     virtual void disconnect() = 0;
     virtual bool isConnected() const = 0;
@@ -68,8 +75,22 @@ public:
 
     SequenceId lastReadSequenceId() const { return last_read_sequence_id_; }
 
+    /*! True once the connected stream is finished and this pin read all the
+     *  entries written before. A read failing with endOfStream() set is the
+     *  normal end of a finite input, not an error. \see NamedStream::finish
+     */
+    bool endOfStream() const { return end_of_stream_; }
+
+    // Public, but should only be called by the connected stream.
+    void setEndOfStream(bool end) { end_of_stream_ = end; }
+
+    //! Like NamedStream::countersLock(), for the properties of the pin.
+    const SeqLock& countersLock() const { return counters_lock_; }
+
 protected:
+    SeqLock counters_lock_;
     SequenceId last_read_sequence_id_;
+    std::atomic<bool> end_of_stream_;
 
 private:
     std::string name_;
@@ -86,17 +107,95 @@ public:
     StreamReader(const std::string& name, NodeBase* node);
     virtual ~StreamReader();
 
+    /*! Reads the next entry. <data> and <timestamp> can be null, for example
+     *  to only move the window forward without copying the data.
+     */
     bool read(T* data, Timestamp* timestamp, SequenceId* seq = 0);
     bool tryRead(T* data, Timestamp* timestamp, SequenceId* seq = 0);
     virtual bool canRead() const;
 
+    /*! Reads up to <max_entries> entries at once, for nodes that process
+     *  several entries together. Blocks like read() until an entry is
+     *  available, then waits at most <max_wait> for the next ones: whatever
+     *  arrived by then makes the batch. Returns false if nothing was read,
+     *  for example at the end of the stream.
+     *
+     *  \code
+     *  StreamBatch<Image> batch;
+     *  while (!threadMustQuit() && input_.readBatch(&batch, 8, Duration::milliSeconds(20))) {
+     *      std::vector<Result> results = infer(batch.data);
+     *      for (int i = 0; i < batch.size(); ++i) {
+     *          output_.update(batch.timestamps[i], results[i]);
+     *      }
+     *  }
+     *  \endcode
+     */
+    bool readBatch(StreamBatch<T>* batch, int max_entries, Duration max_wait);
+
     /*! Skip frames until reaching <timestamp>. Frames with a timestamp
      *  equal or lower than <timestamp> are to be ignored.
      */
     bool seek(Timestamp timestamp);
     Timestamp seekPosition() const { return seek_; }
 
+    /*! Keeps a sliding window over the entries read: the last <max_entries>
+     *  ones, and/or the ones not older than <max_age> compared to the newest.
+     *  A value of 0 disables the corresponding limit. Entries in the window
+     *  are pinned in the stream retention instead of being copied, which
+     *  makes it possible to implement temporal filters without keeping a
+     *  history in the node. The new limits are applied at the next read.
+     *  Only Stream<T> supports windows.
+     */
+    void setWindow(int max_entries, Duration max_age = Duration()) {
+        window_max_entries_ = max_entries;
+        window_max_age_ = max_age;
+    }
+    bool hasWindow() const { return window_max_entries_ > 0 || window_max_age_ > Duration(); }
+    int windowMaxEntries() const { return window_max_entries_; }
+    Duration windowMaxAge() const { return window_max_age_; }
+
+    //! Entries read, from the oldest to the newest. Valid until the next read.
+    const StreamWindow<T>& window() const { return window_; }
+
+    /*! Limits the rate at which this reader gets entries, based on their
+     *  timestamps. Entries arriving faster are skipped. The stream does not
+     *  retain nor copy skipped entries for this reader. A rate of 0 means
+     *  unlimited.
+     */
+    bool setMaxRate(const double& hz) {
+        if (hz < 0) { return false; }
+        SeqLockWriter write(&counters_lock_);
+        max_rate_ = hz;
+        min_period_ns_ = (hz > 0 ? Duration::seconds(1.0 / hz) : Duration()).nanoSeconds();
+        return true;
+    }
+    double maxRate() const { return max_rate_; }
+
+    /*! Only keeps one entry every <keep_every_n> ones. Like with setMaxRate(),
+     *  skipped entries are neither retained nor copied for this reader.
+     */
+    bool setDecimation(const int& keep_every_n) {
+        if (keep_every_n < 1) { return false; }
+        decimation_ = keep_every_n;
+        return true;
+    }
+    int decimation() const { return decimation_; }
+
+    //! The properties shared by all the StreamReader<T> instances.
+    static const PropertyTable<StreamReader<T>>& properties();
+
+    /*! Tells if the rate limit and decimation let this entry through. Once
+     *  an entry has been refused, it is refused forever: the decision only
+     *  depends on the last accepted entry.
+     */
+    bool acceptsEntry(Timestamp timestamp, SequenceId seq) const {
+        if (last_accepted_sequence_id_ < 0) { return true; }
+        return (seq - last_accepted_sequence_id_ >= decimation_) &&
+               !(timestamp < next_accepted_timestamp_);
+    }
+
     virtual std::string typeName() const;
+    TypeId typeId() const override { return TypeTraits<T>::id(); }
 
     virtual bool connect(NamedStream* stream);
     virtual void disconnect();
@@ -122,16 +221,64 @@ public:
 
     // Public, but should only be accessed by classes inheriting StreamBase<T>.
     SequenceId* lastReadSequenceIdPtr() { return &last_read_sequence_id_; }
+    StreamWindow<T>* windowPtr() { return &window_; }
+
+    // Public, but should only be called by classes inheriting StreamBase<T>
+    // when an entry is accepted for the reader.
+    void markAccepted(Timestamp timestamp, SequenceId seq) {
+        // Follow a regular grid to avoid drifting below the maximum rate.
+        const Duration min_period = Duration::nanoSeconds(min_period_ns_);
+        if (timestamp - next_accepted_timestamp_ < min_period) {
+            next_accepted_timestamp_ += min_period;
+        } else {
+            next_accepted_timestamp_ = timestamp + min_period;
+        }
+        last_accepted_sequence_id_ = seq;
+    }
+
+    // Public, but should only be accessed by classes inheriting StreamBase<T>.
+    // Entries refused while older ones were still pending for this reader.
+    // The stream already counted them as read.
+    std::deque<SequenceId>* skippedEntriesPtr() { return &skipped_entries_; }
 
 private:
     StreamBase<T>* pointer_;
     Timestamp seek_;
+    StreamWindow<T> window_;
+    int window_max_entries_;
+    Duration window_max_age_;
+
+    // Atomic: set through properties from monitoring threads.
+    std::atomic<double> max_rate_;
+    std::atomic<int64_t> min_period_ns_;
+    std::atomic<int> decimation_;
+    Timestamp next_accepted_timestamp_;
+    SequenceId last_accepted_sequence_id_;
+    std::deque<SequenceId> skipped_entries_;
 };
 
 template <typename T>
-StreamReader<T>::StreamReader(const std::string& name, NodeBase* node) : NamedPin(name, node) {
+StreamReader<T>::StreamReader(const std::string& name, NodeBase* node)
+    : NamedPin(name, node),
+      window_max_entries_(0),
+      max_rate_(0),
+      min_period_ns_(0),
+      decimation_(1),
+      next_accepted_timestamp_(Timestamp::microSecondsSince1970(0)),
+      last_accepted_sequence_id_(-1) {
     pointer_ = 0;
     seek_ = Timestamp::microSecondsSince1970(0);
+    setPropertyTable(&properties(), this);
+}
+
+template <typename T> const PropertyTable<StreamReader<T>>& StreamReader<T>::properties() {
+    static const PropertyTable<StreamReader<T>> table = []() {
+        PropertyTable<StreamReader<T>> t;
+        t.addGetSet("MaxRate", &StreamReader<T>::maxRate, &StreamReader<T>::setMaxRate);
+        t.addGetSet("Decimation", &StreamReader<T>::decimation, &StreamReader<T>::setDecimation);
+        return t;
+    }();
+    return table;
 }
 
 template <typename T> StreamReader<T>::~StreamReader() { disconnect(); }
@@ -145,6 +292,15 @@ bool StreamReader<T>::tryRead(T* data, Timestamp* timestamp, SequenceId* seq) {
     return (pointer_ && pointer_->tryRead(this, data, timestamp, seq));
 }
 
+template <typename T>
+bool StreamReader<T>::readBatch(StreamBatch<T>* batch, int max_entries, Duration max_wait) {
+    if (!pointer_) {
+        batch->clear();
+        return false;
+    }
+    return pointer_->readBatch(this, batch, max_entries, max_wait);
+}
+
 template <typename T> bool StreamReader<T>::canRead() const {
     return pointer_ && pointer_->canRead(last_read_sequence_id_, seek_);
 }
@@ -167,11 +323,16 @@ template <typename T> void StreamReader<T>::disconnect() {
 template <typename T> bool StreamReader<T>::connect(NamedStream* stream) {
     // if (this == 0) return false;
     disconnect();
-    if (typeName() == stream->typeName()) {
+    if (typeId() == stream->typeId()) {
         pointer_ = dynamic_cast<StreamBase<T>*>(stream);
         if (pointer_) {
-            pointer_->registerReader(this);
+            // Reset before registering: once registered, the stream writer
+            // uses this state under the stream lock.
             last_read_sequence_id_ = -1;
+            last_accepted_sequence_id_ = -1;
+            end_of_stream_ = false;
+            skipped_entries_.clear();
+            pointer_->registerReader(this);
         }
     }
     return pointer_ != 0;
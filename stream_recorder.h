@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_STREAM_RECORDER_H
+#define MEDIAGRAPH_STREAM_RECORDER_H
+
+#include <string>
+
+#include "node.h"
+#include "stream_log.h"
+#include "stream_reader.h"
+#include "types/type_definition.h"
+
+namespace media_graph {
+
+/*! Records every entry of a stream to disk, in a log written by
+ *  StreamLogWriter. Connect its "input" pin to the stream to record.
+ *
+ *  The node thread serializes entries directly into memory-mapped segment
+ *  files, while a second thread talks to the disk. A slow disk only delays
+ *  the producer in lossless mode, and only when the stream waits for its
+ *  readers: in lossy mode, entries that can not be written in time are
+ *  dropped, and counted in the "NumDropped" property.
+ *
+ *  Example:
+ *  \code
+ *  graph.newNode<StreamRecorder<Image>>("recorder", "/data/camera");
+ *  graph.connect("camera", "out", "recorder", "input");
+ *  \endcode
+ */
+template <typename T> class StreamRecorder : public ThreadedNodeBase {
+public:
+    explicit StreamRecorder(const std::string& base_path = "", bool lossless = true)
+        : input_("input", this),
+          base_path_(base_path),
+          lossless_(lossless),
+          segment_bytes_(64 << 20) {
+        setPropertyTable(&properties(), this);
+    }
+
+    ~StreamRecorder() { stop(); }
+
+    virtual int numInputPin() const { return 1; }
+    virtual const NamedPin* constInputPin(int index) const {
+        return index == 0 ? &input_ : nullptr;
+    }
+
+    virtual bool start() override {
+        if (isRunning()) { return true; }
+        if (!writer_.open(base_path_, typeName<T>(), static_cast<size_t>(segment_bytes_))) {
+            return false;
+        }
+        return ThreadedNodeBase::start();
+    }
+
+    virtual void stop() override {
+        ThreadedNodeBase::stop();
+        writer_.close();
+    }
+
+    //! Segment files are named "<path>.000000.seg", "<path>.000001.seg"...
+    std::string path() const { return base_path_; }
+    bool setPath(const std::string& path) {
+        if (writer_.isOpen()) { return false; }
+        base_path_ = path;
+        return true;
+    }
+
+    //! If true, waits for the disk instead of dropping entries.
+    bool lossless() const { return lossless_; }
+    bool setLossless(const bool& lossless) {
+        lossless_ = lossless;
+        return true;
+    }
+
+    int64_t segmentBytes() const { return segment_bytes_; }
+    bool setSegmentBytes(const int64_t& bytes) {
+        if (writer_.isOpen() || bytes <= 0) { return false; }
+        segment_bytes_ = bytes;
+        return true;
+    }
+
+    int64_t numRecorded() const { return writer_.numRecords(); }
+    int64_t numDropped() const { return writer_.numDropped(); }
+    int numSegments() const { return writer_.numSegments(); }
+    int64_t backlogBytes() const { return writer_.backlogBytes(); }
+    double bytesPerSecond() const { return writer_.bytesPerSecond(); }
+
+    static const PropertyTable<StreamRecorder<T>>& properties() {
+        static const PropertyTable<StreamRecorder<T>> table = []() {
+            PropertyTable<StreamRecorder<T>> t;
+            t.addGetSet("Path", &StreamRecorder<T>::path, &StreamRecorder<T>::setPath);
+            t.addGetSet("Lossless", &StreamRecorder<T>::lossless,
+                        &StreamRecorder<T>::setLossless);
+            t.addGetSet("SegmentBytes", &StreamRecorder<T>::segmentBytes,
+                        &StreamRecorder<T>::setSegmentBytes);
+            t.addGet("NumRecorded", &StreamRecorder<T>::numRecorded);
+            t.addGet("NumDropped", &StreamRecorder<T>::numDropped);
+            t.addGet("NumSegments", &StreamRecorder<T>::numSegments);
+            t.addGet("BacklogBytes", &StreamRecorder<T>::backlogBytes);
+            t.addGet("BytesPerSecond", &StreamRecorder<T>::bytesPerSecond);
+            return t;
+        }();
+        return table;
+    }
+
+protected:
+    virtual void threadMain() {
+        T data;
+        Timestamp timestamp;
+        SequenceId sequence_id;
+        while (!threadMustQuit()) {
+            if (input_.read(&data, &timestamp, &sequence_id)) {
+                writer_.write(timestamp, sequence_id, data, lossless_);
+            }
+        }
+    }
+
+private:
+    // Declared first: disconnecting input_ stops the node, which closes
+    // the writer.
+    StreamLogWriter writer_;
+    StreamReader<T> input_;
+    std::string base_path_;
+    std::atomic<bool> lossless_;
+    std::atomic<int64_t> segment_bytes_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_STREAM_RECORDER_H
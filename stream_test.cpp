@@ -0,0 +1,630 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include <gtest/gtest.h>
+
+#include "graph.h"
+#include "node.h"
+#include "stream.h"
+#include "stream_reader.h"
+#include "types/type_definition.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace media_graph {
+
+namespace {
+
+    template <typename T> class SourceNode : public NodeBase {
+    public:
+        SourceNode(StreamDropPolicy policy = WAIT_FOR_CONSUMPTION_NEVER_DROP,
+                   int max_queue_size = 4)
+            : output("out", this, policy, max_queue_size) {}
+
+        virtual int numOutputStream() const { return 1; }
+        virtual const NamedStream* constOutputStream(int index) const {
+            return (index == 0 ? &output : nullptr);
+        }
+
+        Stream<T> output;
+    };
+
+    template <typename T> class SinkNode : public NodeBase {
+    public:
+        SinkNode() : input("in", this) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input : nullptr);
+        }
+
+        StreamReader<T> input;
+    };
+
+    typedef SourceNode<int> IntSourceNode;
+    typedef SinkNode<int> IntSinkNode;
+    typedef SourceNode<std::string> StringSourceNode;
+    typedef SinkNode<std::string> StringSinkNode;
+
+    // Its owner knows when all its copies are gone.
+    struct Tracked {
+        int value = 0;
+        std::shared_ptr<int> copies;
+        MEDIAGRAPH_FIELDS(Tracked, value)
+    };
+
+    Timestamp at(int64_t microseconds) { return Timestamp::microSecondsSince1970(microseconds); }
+
+}  // namespace
+
+TEST(StreamTest, WindowKeepsTheLastEntriesRead) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    sink->input.setWindow(3);
+    EXPECT_TRUE(sink->input.window().empty());
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i), i));
+        int value;
+        Timestamp timestamp;
+        EXPECT_TRUE(sink->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+    }
+
+    // Entries have been read by everyone: they are only retained for the window.
+    EXPECT_EQ(0, source->output.numItemsInQueue());
+
+    const StreamWindow<int>& window = sink->input.window();
+    ASSERT_EQ(3, window.size());
+    EXPECT_EQ(2, window.oldest().data);
+    EXPECT_EQ(3, window[1].data);
+    EXPECT_EQ(4, window.newest().data);
+    EXPECT_EQ(4, window.newest().sequence_id);
+    EXPECT_EQ(at(1004), window.newest().timestamp);
+    EXPECT_EQ(Duration::microSeconds(2), window.span());
+
+    // Moving forward without copying the data.
+    EXPECT_TRUE(source->output.update(at(1005), 5));
+    EXPECT_TRUE(sink->input.read(nullptr, nullptr));
+    EXPECT_EQ(3, window.oldest().data);
+    EXPECT_EQ(5, window.newest().data);
+
+    sink->input.disconnect();
+    EXPECT_TRUE(sink->input.window().empty());
+    graph.stop();
+}
+
+TEST(StreamTest, FinishedStreamDeliversTrailingEntries) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 3; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), i)); }
+    source->output.finish();
+    EXPECT_TRUE(source->output.isFinished());
+    EXPECT_TRUE(source->output.isOpen());
+    EXPECT_FALSE(source->output.update(at(1003), 3));
+
+    int value;
+    Timestamp timestamp;
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_FALSE(sink->input.endOfStream());
+        EXPECT_TRUE(sink->input.read(&value, &timestamp));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(sink->input.endOfStream());
+    EXPECT_FALSE(sink->input.read(&value, &timestamp));
+    EXPECT_FALSE(sink->input.tryRead(&value, &timestamp));
+
+    // Opening a finished stream does not discard it.
+    source->output.open();
+    EXPECT_TRUE(source->output.isFinished());
+    EXPECT_TRUE(sink->input.endOfStream());
+    graph.stop();
+}
+
+TEST(StreamTest, ClosedStreamIsNotEndOfStream) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source->output.update(at(1000), 1));
+    source->output.close();
+    EXPECT_FALSE(sink->input.tryRead(nullptr, nullptr));
+    EXPECT_FALSE(sink->input.endOfStream());
+    graph.stop();
+}
+
+TEST(StreamTest, ReadBatchStopsAtMaxEntries) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 10);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 6; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), i)); }
+
+    StreamBatch<int> batch;
+    EXPECT_TRUE(sink->input.readBatch(&batch, 4, Duration::seconds(10)));
+    ASSERT_EQ(4, batch.size());
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(i, batch.data[i]);
+        EXPECT_EQ(at(1000 + i), batch.timestamps[i]);
+        EXPECT_EQ(i, batch.sequence_ids[i]);
+    }
+
+    // Only 2 entries left: the batch closes at the deadline.
+    const Timestamp start = Timestamp::systemNow();
+    EXPECT_TRUE(sink->input.readBatch(&batch, 4, Duration::milliSeconds(10)));
+    EXPECT_LE(Duration::milliSeconds(10).nanoSeconds(),
+              (Timestamp::systemNow() - start).nanoSeconds());
+    ASSERT_EQ(2, batch.size());
+    EXPECT_EQ(4, batch.data[0]);
+    EXPECT_EQ(5, batch.data[1]);
+    graph.stop();
+}
+
+TEST(StreamTest, ReadBatchWaitsForLateEntries) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    std::thread producer([&source]() {
+        for (int i = 0; i < 3; ++i) {
+            source->output.update(at(1000 + i), i);
+            Duration::milliSeconds(2).sleep();
+        }
+    });
+
+    // Full before the deadline: does not wait for it.
+    StreamBatch<int> batch;
+    const Timestamp start = Timestamp::systemNow();
+    EXPECT_TRUE(sink->input.readBatch(&batch, 3, Duration::seconds(10)));
+    EXPECT_LT((Timestamp::systemNow() - start).nanoSeconds(), Duration::seconds(5).nanoSeconds());
+    ASSERT_EQ(3, batch.size());
+    for (int i = 0; i < 3; ++i) { EXPECT_EQ(i, batch.data[i]); }
+    producer.join();
+    graph.stop();
+}
+
+TEST(StreamTest, ReadBatchEndsAtEndOfStream) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 3; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), i)); }
+    source->output.finish();
+
+    StreamBatch<int> batch;
+    EXPECT_TRUE(sink->input.readBatch(&batch, 8, Duration::seconds(10)));
+    EXPECT_EQ(3, batch.size());
+    EXPECT_TRUE(sink->input.endOfStream());
+    EXPECT_FALSE(sink->input.readBatch(&batch, 8, Duration::seconds(10)));
+    EXPECT_TRUE(batch.empty());
+    graph.stop();
+}
+
+TEST(StreamTest, WindowByAge) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 2);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    sink->input.setWindow(0, Duration::milliSeconds(10));
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i * 1000), i));
+        EXPECT_TRUE(sink->input.tryRead(nullptr, nullptr));
+    }
+
+    const StreamWindow<int>& window = sink->input.window();
+    ASSERT_EQ(11, window.size());
+    EXPECT_EQ(9, window.oldest().data);
+    EXPECT_EQ(19, window.newest().data);
+    EXPECT_EQ(Duration::milliSeconds(10), window.span());
+    graph.stop();
+}
+
+TEST(StreamTest, WindowSurvivesDrops) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 2);
+    auto windowed = graph.newNode<IntSinkNode>("windowed");
+    auto other = graph.newNode<IntSinkNode>("other");
+    EXPECT_TRUE(graph.connect(source, "out", windowed, "in"));
+    EXPECT_TRUE(graph.connect(source, "out", other, "in"));
+    EXPECT_TRUE(graph.start());
+
+    windowed->input.setWindow(2);
+    EXPECT_TRUE(source->output.update(at(1), 1));
+    EXPECT_TRUE(source->output.update(at(2), 2));
+    EXPECT_TRUE(windowed->input.tryRead(nullptr, nullptr));
+    EXPECT_TRUE(windowed->input.tryRead(nullptr, nullptr));
+
+    // "other" never reads: the stream drops old entries to make room.
+    for (int i = 3; i < 10; ++i) { EXPECT_TRUE(source->output.update(at(i), i)); }
+
+    ASSERT_EQ(2, windowed->input.window().size());
+    EXPECT_EQ(1, windowed->input.window().oldest().data);
+    EXPECT_EQ(2, windowed->input.window().newest().data);
+    graph.stop();
+}
+
+TEST(StreamTest, WindowReleasesDroppedEntries) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 3);
+    auto windowed = graph.newNode<IntSinkNode>("windowed");
+    EXPECT_TRUE(graph.connect(source, "out", windowed, "in"));
+    EXPECT_TRUE(graph.start());
+
+    windowed->input.setWindow(2);
+    EXPECT_TRUE(source->output.update(at(1), 1));
+    const int64_t entry_bytes = source->output.bytesInQueue();
+    EXPECT_TRUE(source->output.update(at(2), 2));
+    EXPECT_TRUE(windowed->input.tryRead(nullptr, nullptr));
+    EXPECT_TRUE(windowed->input.tryRead(nullptr, nullptr));
+
+    // 1 and 2 are dropped while pinned, 3 and 4 while not.
+    for (int i = 3; i < 8; ++i) { EXPECT_TRUE(source->output.update(at(i), i)); }
+    EXPECT_EQ(3, source->output.numItemsInQueue());
+    EXPECT_EQ(5 * entry_bytes, source->output.bytesInQueue());
+
+    int value;
+    Timestamp timestamp;
+    EXPECT_TRUE(windowed->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(5, value);
+    EXPECT_TRUE(windowed->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(6, value);
+
+    // The window moved past 1 and 2: their bytes are released. Reading
+    // made room by dropping 5, now only held by the window.
+    const StreamWindow<int>& window = windowed->input.window();
+    ASSERT_EQ(2, window.size());
+    EXPECT_EQ(5, window.oldest().data);
+    EXPECT_EQ(6, window.newest().data);
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+    EXPECT_EQ(3 * entry_bytes, source->output.bytesInQueue());
+
+    EXPECT_TRUE(windowed->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(7, value);
+    EXPECT_EQ(6, window.oldest().data);
+    EXPECT_EQ(7, window.newest().data);
+    graph.stop();
+}
+
+TEST(StreamTest, DroppedEntriesFreeTheirData) {
+    Graph graph;
+    auto source = graph.newNode<SourceNode<Tracked>>("source", NEVER_BLOCK_DROP_OLDEST, 3);
+    auto sink = graph.newNode<SinkNode<Tracked>>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    // The window pins the first entry at the front of the queue.
+    sink->input.setWindow(1);
+    EXPECT_TRUE(source->output.update(at(1), Tracked()));
+    EXPECT_TRUE(sink->input.tryRead(nullptr, nullptr));
+
+    Tracked tracked;
+    tracked.copies = std::make_shared<int>(0);
+    std::weak_ptr<int> copies = tracked.copies;
+    EXPECT_TRUE(source->output.update(at(2), tracked));
+    tracked.copies.reset();
+    EXPECT_FALSE(copies.expired());
+
+    // Dropped behind the pinned entry: its data goes with its bytes.
+    for (int i = 3; i < 6; ++i) { EXPECT_TRUE(source->output.update(at(i), Tracked())); }
+    EXPECT_EQ(3, source->output.numItemsInQueue());
+    EXPECT_TRUE(copies.expired());
+    graph.stop();
+}
+
+TEST(StreamTest, DecimatedReaderSkipsEntries) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(sink->input.setDecimation(3));
+    EXPECT_FALSE(sink->input.setDecimation(0));
+
+    std::vector<int> values;
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i), i));
+        int value;
+        Timestamp timestamp;
+        if (sink->input.tryRead(&value, &timestamp)) { values.push_back(value); }
+
+        // Skipped entries are not kept in the queue.
+        EXPECT_EQ(0, source->output.numItemsInQueue());
+    }
+    EXPECT_EQ(std::vector<int>({0, 3, 6, 9}), values);
+    graph.stop();
+}
+
+TEST(StreamTest, SkippedEntriesAreForgottenOnceDropped) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 4);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+    EXPECT_TRUE(sink->input.setDecimation(2));
+
+    // The reader never reads: odd entries are skipped while even ones are
+    // pending, and the pending ones are eventually dropped.
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i), i));
+        EXPECT_GE(4, int(sink->input.skippedEntriesPtr()->size()));
+    }
+
+    std::vector<int> values;
+    int value;
+    Timestamp timestamp;
+    while (sink->input.tryRead(&value, &timestamp)) { values.push_back(value); }
+
+    // Refused entries do not make room.
+    EXPECT_EQ(std::vector<int>({992, 994, 996, 998}), values);
+    graph.stop();
+}
+
+TEST(StreamTest, RefusedEntriesDoNotBlockTheProducer) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 1);
+    auto sink = graph.newNode<IntSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+    EXPECT_TRUE(sink->input.setDecimation(2));
+
+    // The queue is full with 0: 1 is refused instead of waiting for room.
+    EXPECT_TRUE(source->output.update(at(1000), 0));
+    EXPECT_TRUE(source->output.update(at(1001), 1));
+    EXPECT_EQ(1, source->output.numItemsInQueue());
+
+    int value;
+    Timestamp timestamp;
+    EXPECT_TRUE(sink->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(source->output.update(at(1002), 2));
+    EXPECT_TRUE(sink->input.tryRead(&value, &timestamp));
+    EXPECT_EQ(2, value);
+    graph.stop();
+}
+
+TEST(StreamTest, RateLimitedReaderDoesNotBlockTheProducer) {
+    Graph graph;
+    auto source = graph.newNode<IntSourceNode>("source");
+    auto fast = graph.newNode<IntSinkNode>("fast");
+    auto slow = graph.newNode<IntSinkNode>("slow");
+    EXPECT_TRUE(graph.connect(source, "out", fast, "in"));
+    EXPECT_TRUE(graph.connect(source, "out", slow, "in"));
+    EXPECT_TRUE(graph.start());
+
+    // 60 entries per second, for a second, read by a 5 Hz reader.
+    EXPECT_TRUE(slow->input.setMaxRate(5));
+    int num_slow_reads = 0;
+    for (int i = 0; i < 60; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i * 1000000 / 60), i));
+        EXPECT_TRUE(fast->input.tryRead(nullptr, nullptr));
+        if (slow->input.tryRead(nullptr, nullptr)) { ++num_slow_reads; }
+    }
+    EXPECT_EQ(5, num_slow_reads);
+
+    // The slow reader does not hold entries it is not interested in: the
+    // producer can go on, even if the slow reader does not read anymore.
+    for (int i = 60; i < 72; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000 + i * 1000000 / 60), i));
+        EXPECT_TRUE(fast->input.tryRead(nullptr, nullptr));
+    }
+    EXPECT_GE(1, source->output.numItemsInQueue());
+    graph.stop();
+}
+
+TEST(StreamTest, MaxQueueBytesDropsOldest) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    const std::string payload(1000, 'x');
+    const int64_t entry_bytes = payloadSize(payload);
+    EXPECT_LT(1000, entry_bytes);
+    EXPECT_TRUE(source->output.setMaxQueueBytes(3 * entry_bytes));
+
+    // One entry every 500ms.
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000000 + i * 500000), payload));
+    }
+    EXPECT_EQ(3, source->output.numItemsInQueue());
+    EXPECT_EQ(3 * entry_bytes, source->output.bytesInQueue());
+    EXPECT_EQ(3 * entry_bytes, graph.bytesHeld());
+    EXPECT_DOUBLE_EQ(2.0 * entry_bytes, source->output.bytesPerSecond());
+
+    graph.stop();
+    EXPECT_EQ(0, source->output.bytesInQueue());
+    EXPECT_EQ(0, graph.bytesHeld());
+}
+
+TEST(StreamTest, MaxQueueBytesBlocksTheProducer) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    const std::string payload(1000, 'x');
+    source->output.setMaxQueueBytes(2 * payloadSize(payload));
+    EXPECT_TRUE(source->output.update(at(1000), payload));
+    EXPECT_TRUE(source->output.update(at(2000), payload));
+
+    std::thread producer([&]() { EXPECT_TRUE(source->output.update(at(3000), payload)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+
+    std::string value;
+    Timestamp timestamp;
+    EXPECT_TRUE(sink->input.read(&value, &timestamp));
+    EXPECT_EQ(at(1000), timestamp);
+    producer.join();
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+    graph.stop();
+}
+
+TEST(StreamTest, LiftingMaxQueueBytesWakesTheProducer) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+
+    const std::string payload(1000, 'x');
+    source->output.setMaxQueueBytes(2 * payloadSize(payload));
+    EXPECT_TRUE(source->output.update(at(1000), payload));
+    EXPECT_TRUE(source->output.update(at(2000), payload));
+
+    std::thread producer([&]() { EXPECT_TRUE(source->output.update(at(3000), payload)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+
+    EXPECT_TRUE(source->output.setMaxQueueBytes(0));
+    producer.join();
+    EXPECT_EQ(3, source->output.numItemsInQueue());
+    graph.stop();
+}
+
+TEST(StreamTest, BytesPerSecondOnlyCountsQueuedEntries) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", NEVER_BLOCK_DROP_OLDEST, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+    EXPECT_TRUE(graph.start());
+    EXPECT_TRUE(sink->input.setDecimation(2));
+
+    // One entry every 500ms, one in two is refused by the only reader.
+    const std::string payload(1000, 'x');
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(source->output.update(at(1000000 + i * 500000), payload));
+        EXPECT_TRUE(sink->input.tryRead(nullptr, nullptr) || i % 2 == 1);
+    }
+    EXPECT_DOUBLE_EQ(double(payloadSize(payload)), source->output.bytesPerSecond());
+    graph.stop();
+}
+
+TEST(StreamTest, GraphMemoryBudgetDropsOldest) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+
+    const std::string payload(1000, 'x');
+    graph.setMemoryBudget(2 * payloadSize(payload), BUDGET_DROP_OLDEST);
+    EXPECT_TRUE(graph.start());
+
+    for (int i = 0; i < 5; ++i) { EXPECT_TRUE(source->output.update(at(1000 + i), payload)); }
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+    EXPECT_EQ(2 * int64_t(payloadSize(payload)), graph.bytesHeld());
+
+    Timestamp timestamp;
+    EXPECT_TRUE(sink->input.read(nullptr, &timestamp));
+    EXPECT_EQ(at(1003), timestamp);
+    graph.stop();
+}
+
+TEST(StreamTest, GraphMemoryBudgetBlocksProducers) {
+    Graph graph;
+    auto source_a = graph.newNode<StringSourceNode>("a", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto source_b = graph.newNode<StringSourceNode>("b", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto sink_a = graph.newNode<StringSinkNode>("sink_a");
+    auto sink_b = graph.newNode<StringSinkNode>("sink_b");
+    EXPECT_TRUE(graph.connect(source_a, "out", sink_a, "in"));
+    EXPECT_TRUE(graph.connect(source_b, "out", sink_b, "in"));
+
+    const std::string payload(1000, 'x');
+    graph.setMemoryBudget(3 * payloadSize(payload));
+    EXPECT_TRUE(graph.start());
+
+    EXPECT_TRUE(source_a->output.update(at(1000), payload));
+    EXPECT_TRUE(source_a->output.update(at(2000), payload));
+    EXPECT_TRUE(source_a->output.update(at(3000), payload));
+
+    // An empty queue always accepts an entry.
+    EXPECT_TRUE(source_b->output.update(at(1000), payload));
+
+    // The budget is exhausted: b has to wait until a releases memory.
+    std::thread producer([&]() { EXPECT_TRUE(source_b->output.update(at(2000), payload)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(1, source_b->output.numItemsInQueue());
+
+    EXPECT_TRUE(sink_a->input.read(nullptr, nullptr));
+    EXPECT_TRUE(sink_a->input.read(nullptr, nullptr));
+    producer.join();
+    EXPECT_EQ(2, source_b->output.numItemsInQueue());
+    graph.stop();
+}
+
+TEST(StreamTest, GraphMemoryBudgetWakesProducers) {
+    Graph graph;
+    auto source = graph.newNode<StringSourceNode>("source", WAIT_FOR_CONSUMPTION_NEVER_DROP, 100);
+    auto sink = graph.newNode<StringSinkNode>("sink");
+    EXPECT_TRUE(graph.connect(source, "out", sink, "in"));
+
+    const std::string payload(1000, 'x');
+    graph.setMemoryBudget(payloadSize(payload));
+    EXPECT_TRUE(graph.start());
+    EXPECT_TRUE(source->output.update(at(1000), payload));
+
+    // Raising the limit lets the producer through.
+    std::thread producer([&]() { EXPECT_TRUE(source->output.update(at(2000), payload)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(1, source->output.numItemsInQueue());
+    EXPECT_TRUE(graph.setMemoryBudgetLimit(2 * payloadSize(payload)));
+    producer.join();
+    EXPECT_EQ(2, source->output.numItemsInQueue());
+
+    // Stopping the graph releases a blocked producer.
+    std::thread refused([&]() { EXPECT_FALSE(source->output.update(at(3000), payload)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    graph.stop();
+    refused.join();
+}
+
+}  // namespace media_graph
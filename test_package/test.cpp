@@ -43,7 +43,8 @@ public:
         data.str = "something in the way..";
 
         for (int i = 0; i < 100; ++i) {  // send 100 values
-            if (m_dataStream.canUpdate()) { m_dataStream.update(Timestamp::now(), data); }
+            // Blocks until the consumer makes room: nothing is dropped.
+            m_dataStream.update(Timestamp::now(), data);
 
             ++data.seq;
         }
@@ -65,11 +66,8 @@ public:
             Timestamp ts;
             SequenceId seqId;
 
-            // read will return false when the graph is stopped
-            if (!input.read(&data, &ts, &seqId)) {
-                if (lastSeq != 99) { throw std::runtime_error("lastSeq should be 99 by now!"); }
-                return;
-            }
+            // read returns false at the end of the stream, or when the graph is stopped.
+            if (!input.read(&data, &ts, &seqId)) { break; }
 
             if (lastSeq + 1 != data.seq) {
                 throw std::runtime_error("Sequence out of order!");  // will crash app and fail test
@@ -77,6 +75,8 @@ public:
 
             lastSeq = data.seq;
         }
+        if (!input.endOfStream()) { throw std::runtime_error("Stopped before end of stream!"); }
+        if (lastSeq != 99) { throw std::runtime_error("lastSeq should be 99 by now!"); }
     }
 
     virtual int numInputPin() const { return 1; }
@@ -104,11 +104,8 @@ int main() {
 
     EXPECT_TRUE(graph.start(), "start");
 
-    std::cout << "Waiting for producer to finish..." << std::endl;
-    while (producer->isRunning()) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
-
-    std::cout << "Stopping graph..." << std::endl;
-    graph.stop();
+    std::cout << "Draining graph..." << std::endl;
+    graph.drain();
     std::cout << "Done." << std::endl;
 
     return 0;
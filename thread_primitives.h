@@ -28,6 +28,8 @@
 #ifndef THREAD_PRIMITIVES_H
 #define THREAD_PRIMITIVES_H
 
+#include <stdint.h>
+#include <atomic>
 #include <future>
 #include <thread>
 
@@ -51,4 +53,78 @@ private:
     std::future<void> running_future_;  // used to signal thread has finished
 };
 
+/*! Sequence lock: lets a reader copy a group of values, and detect that a
+ *  writer changed them meanwhile, without ever blocking the writers for
+ *  long. The values themselves must be atomics: a seqlock only makes a group
+ *  of them consistent.
+ *
+ *  Writer:
+ *  \code
+ *  SeqLockWriter write(&lock);
+ *  count_ += 1;
+ *  bytes_ += size;
+ *  \endcode
+ *
+ *  Reader:
+ *  \code
+ *  uint64_t begin;
+ *  do {
+ *      begin = lock.readBegin();
+ *      count = count_;
+ *      bytes = bytes_;
+ *  } while (lock.readRetry(begin));
+ *  \endcode
+ */
+class SeqLock {
+public:
+    SeqLock() : sequence_(0) {}
+
+    //! Writers exclude each other, by spinning: write sections must be short.
+    void writeBegin() {
+        for (;;) {
+            uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+            if ((sequence & 1) == 0 &&
+                sequence_.compare_exchange_weak(sequence, sequence + 1,
+                                                std::memory_order_acquire)) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void writeEnd() { sequence_.fetch_add(1, std::memory_order_release); }
+
+    uint64_t readBegin() const {
+        uint64_t sequence;
+        while ((sequence = sequence_.load(std::memory_order_acquire)) & 1) {
+            std::this_thread::yield();
+        }
+        return sequence;
+    }
+    //! True if a writer changed the values since readBegin().
+    bool readRetry(uint64_t begin) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence_.load(std::memory_order_relaxed) != begin;
+    }
+
+private:
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    std::atomic<uint64_t> sequence_;
+};
+
+//! Write section of a SeqLock, for the lifetime of the scope.
+class SeqLockWriter {
+public:
+    explicit SeqLockWriter(SeqLock* lock) : lock_(lock) { lock_->writeBegin(); }
+    ~SeqLockWriter() { lock_->writeEnd(); }
+
+private:
+    SeqLockWriter(const SeqLockWriter&) = delete;
+    SeqLockWriter& operator=(const SeqLockWriter&) = delete;
+
+    SeqLock* lock_;
+};
+
 #endif  // THREAD_PRIMITIVES_H
@@ -27,6 +27,9 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <thread>
+
 #include "thread_primitives.h"
 #include "timestamp.h"
 
@@ -98,3 +101,35 @@ TEST(ThreadTest, IsRunning) {
     thread.waitForTermination();
     EXPECT_FALSE(thread.isRunning());
 }
+
+TEST(SeqLockTest, ReadersNeverSeeHalfAWrite) {
+    SeqLock lock;
+    std::atomic<int> count(0);
+    std::atomic<int64_t> bytes(0);
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 0; i < 20000; ++i) {
+            SeqLockWriter write(&lock);
+            count.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(16, std::memory_order_relaxed);
+        }
+        done = true;
+    });
+
+    int num_reads = 0;
+    do {
+        int read_count;
+        int64_t read_bytes;
+        uint64_t begin;
+        do {
+            begin = lock.readBegin();
+            read_count = count.load(std::memory_order_relaxed);
+            read_bytes = bytes.load(std::memory_order_relaxed);
+        } while (lock.readRetry(begin));
+        EXPECT_EQ(int64_t(read_count) * 16, read_bytes);
+        ++num_reads;
+    } while (!done);
+    writer.join();
+    EXPECT_LT(0, num_reads);
+}
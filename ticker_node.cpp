@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "ticker_node.h"
+
+#include "periodic_timer.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+
+TickerNode::TickerNode(double rate)
+    : output_("out", this, NEVER_BLOCK_DROP_OLDEST),
+      rate_(rate > 0 ? rate : 60.0),
+      spin_ns_(0),
+      num_ticks_(0),
+      num_overruns_(0),
+      lateness_ns_(0),
+      max_lateness_ns_(0) {
+    setPropertyTable(&properties(), this);
+}
+
+bool TickerNode::setRate(const double& hz) {
+    if (!(hz > 0)) { return false; }
+    rate_ = hz;
+    return true;
+}
+
+bool TickerNode::setSpin(const int64_t& nanoseconds) {
+    if (nanoseconds < 0) { return false; }
+    spin_ns_ = nanoseconds;
+    return true;
+}
+
+const PropertyTable<TickerNode>& TickerNode::properties() {
+    static const PropertyTable<TickerNode> table = []() {
+        PropertyTable<TickerNode> t;
+        t.addGetSet("Rate", &TickerNode::rate, &TickerNode::setRate);
+        t.addGetSet("Spin", &TickerNode::spin, &TickerNode::setSpin);
+        t.addGet("NumTicks", &TickerNode::numTicks);
+        t.addGet("NumOverruns", &TickerNode::numOverruns);
+        t.addGet("Lateness", &TickerNode::lateness);
+        t.addGet("MaxLateness", &TickerNode::maxLateness);
+        return t;
+    }();
+    return table;
+}
+
+void TickerNode::threadMain() {
+    double rate = rate_;
+    PeriodicTimer timer(Duration::seconds(1.0 / rate));
+    num_ticks_ = 0;
+    num_overruns_ = 0;
+    max_lateness_ns_ = 0;
+
+    while (!threadMustQuit()) {
+        if (rate != rate_) {
+            rate = rate_;
+            timer.setPeriod(Duration::seconds(1.0 / rate));
+        }
+        timer.setSpin(Duration::nanoSeconds(spin_ns_));
+
+        const Timestamp tick = shouldPace() ? timer.wait() : timer.advance();
+        if (!output_.update(tick, timer.tickIndex())) { break; }
+
+        num_ticks_ = timer.numTicks();
+        num_overruns_ = timer.numOverruns();
+        lateness_ns_ = timer.lateness().nanoSeconds();
+        if (lateness_ns_ > max_lateness_ns_) { max_lateness_ns_ = int64_t(lateness_ns_); }
+    }
+}
+
+}  // namespace media_graph
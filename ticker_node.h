@@ -0,0 +1,101 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_TICKER_NODE_H
+#define MEDIAGRAPH_TICKER_NODE_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "node.h"
+#include "stream.h"
+#include "types/type_definition.h"
+
+namespace media_graph {
+
+/*! A source of regular ticks, to pace producers and display outputs.
+ *
+ *  Every 1 / "Rate" seconds, the node publishes an entry on its "out"
+ *  stream: its timestamp is the scheduled time of the tick, and its data
+ *  the tick number. Ticks follow absolute deadlines, see PeriodicTimer:
+ *  their timestamps do not drift, and the "Lateness" property tells how
+ *  late the last one was actually published. "Spin" trades CPU time for
+ *  accuracy. Times are in nanoseconds.
+ *
+ *  Slow readers do not delay the ticks: the oldest ones are dropped. In
+ *  batch mode, ticks keep their scheduled timestamps but are published as
+ *  fast as the readers consume them, without sleeping nor dropping.
+ *
+ *  Example:
+ *  \code
+ *  graph.newNode<TickerNode>("vsync", 90.0);
+ *  graph.connect("vsync", "out", "renderer", "tick");
+ *  \endcode
+ */
+class TickerNode : public ThreadedNodeBase {
+public:
+    explicit TickerNode(double rate = 60.0);
+    ~TickerNode() { stop(); }
+
+    virtual int numOutputStream() const { return 1; }
+    virtual const NamedStream* constOutputStream(int index) const {
+        return index == 0 ? &output_ : nullptr;
+    }
+
+    Stream<int64_t>* output() { return &output_; }
+
+    double rate() const { return rate_; }
+    bool setRate(const double& hz);
+
+    int64_t spin() const { return spin_ns_; }
+    bool setSpin(const int64_t& nanoseconds);
+
+    int64_t numTicks() const { return num_ticks_; }
+    int64_t numOverruns() const { return num_overruns_; }
+    int64_t lateness() const { return lateness_ns_; }
+    int64_t maxLateness() const { return max_lateness_ns_; }
+
+    static const PropertyTable<TickerNode>& properties();
+
+protected:
+    virtual void threadMain();
+
+private:
+    Stream<int64_t> output_;
+
+    // Set through properties, applied by the thread before each tick.
+    std::atomic<double> rate_;
+    std::atomic<int64_t> spin_ns_;
+
+    std::atomic<int64_t> num_ticks_;
+    std::atomic<int64_t> num_overruns_;
+    std::atomic<int64_t> lateness_ns_;
+    std::atomic<int64_t> max_lateness_ns_;
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_TICKER_NODE_H
@@ -0,0 +1,133 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "ticker_node.h"
+
+#include "clock.h"
+#include "graph.h"
+#include "node.h"
+#include "stream_reader.h"
+
+namespace media_graph {
+namespace {
+    // Reads <count> ticks, then stops.
+    class TickRecorder : public ThreadedNodeBase {
+    public:
+        explicit TickRecorder(int count) : input_("tick", this), count_(count) {}
+
+        virtual int numInputPin() const { return 1; }
+        virtual const NamedPin* constInputPin(int index) const {
+            return (index == 0 ? &input_ : nullptr);
+        }
+
+        std::vector<Timestamp> timestamps;
+        std::vector<int64_t> ticks;
+
+    protected:
+        virtual void threadMain() {
+            while (!threadMustQuit() && int(ticks.size()) < count_) {
+                int64_t tick;
+                Timestamp timestamp;
+                if (!input_.read(&tick, &timestamp)) { break; }
+                timestamps.push_back(timestamp);
+                ticks.push_back(tick);
+            }
+        }
+
+    private:
+        StreamReader<int64_t> input_;
+        int count_;
+    };
+}  // namespace
+
+TEST(TickerNodeTest, TicksAtTheRate) {
+    Graph graph;
+    const Timestamp start = Timestamp::microSecondsSince1970(1000000);
+    auto clock = std::make_shared<VirtualClock>(start);
+    ASSERT_TRUE(graph.setClock(clock));
+    auto ticker = graph.newNode<TickerNode>("ticker", 100.0);
+    auto recorder = graph.newNode<TickRecorder>("recorder", 20);
+    ASSERT_TRUE(graph.connect("ticker", "out", "recorder", "tick"));
+
+    ASSERT_TRUE(graph.start());
+    recorder->waitUntilStopped();
+    graph.stop();
+
+    // On a virtual clock, the recorder gets every tick, on time.
+    ASSERT_EQ(20u, recorder->ticks.size());
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(i, recorder->ticks[i]);
+        EXPECT_EQ(start + Duration::milliSeconds(10) * int64_t(i), recorder->timestamps[i]);
+    }
+    EXPECT_EQ(0, ticker->numOverruns());
+    EXPECT_EQ(0, ticker->maxLateness());
+}
+
+TEST(TickerNodeTest, BatchModeSkipsPacing) {
+    Graph graph;
+    ASSERT_TRUE(graph.setBatchMode(true));
+    auto ticker = graph.newNode<TickerNode>("ticker", 1.0);
+    auto recorder = graph.newNode<TickRecorder>("recorder", 20);
+    ASSERT_TRUE(graph.connect("ticker", "out", "recorder", "tick"));
+
+    const Timestamp start = Timestamp::now();
+    ASSERT_TRUE(graph.start());
+    recorder->waitUntilStopped();
+    graph.stop();
+
+    // Twenty seconds of ticks, without waiting for them.
+    EXPECT_LT(Timestamp::now() - start, Duration::seconds(5));
+    ASSERT_EQ(20u, recorder->ticks.size());
+    for (int i = 1; i < 20; ++i) {
+        EXPECT_EQ(i, recorder->ticks[i]);
+        EXPECT_EQ(Duration::seconds(1), recorder->timestamps[i] - recorder->timestamps[i - 1]);
+    }
+}
+
+TEST(TickerNodeTest, Properties) {
+    Graph graph;
+    auto ticker = graph.newNode<TickerNode>("ticker");
+    EXPECT_TRUE(ticker->getPropertyByName("Rate")->ValueFromString("200"));
+    EXPECT_EQ(200.0, ticker->rate());
+    EXPECT_FALSE(ticker->setRate(0));
+    EXPECT_FALSE(ticker->setSpin(-1));
+    EXPECT_TRUE(ticker->setSpin(100000));
+
+    ASSERT_TRUE(graph.start());
+    Duration::milliSeconds(100).sleep();
+    graph.stop();
+
+    EXPECT_LT(5, ticker->numTicks());
+    EXPECT_EQ(std::to_string(ticker->numTicks()),
+              ticker->getPropertyByName("NumTicks")->ValueToString());
+    EXPECT_LE(ticker->lateness(), ticker->maxLateness());
+}
+
+}  // namespace media_graph
@@ -26,22 +26,169 @@
 //
 #include "timestamp.h"
 
+#include <errno.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
-void Duration::sleep() const {
-    if (duration_ > 0) { usleep(duration_); }
+#include <atomic>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TIMESTAMP_HAS_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+const int64_t kNanoSecondsPerSecond = 1000000000;
+
+std::atomic<int> time_source(TIME_SOURCE_MONOTONIC);
+
+int64_t readClock(clockid_t clock) {
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return int64_t(time.tv_sec) * kNanoSecondsPerSecond + int64_t(time.tv_nsec);
+}
+
+// Shifts the monotonic clock to the epoch of the wall clock.
+int64_t monotonicAnchor() {
+    static const int64_t anchor = readClock(CLOCK_REALTIME) - readClock(CLOCK_MONOTONIC);
+    return anchor;
+}
+
+int64_t monotonicNow() { return readClock(CLOCK_MONOTONIC) + monotonicAnchor(); }
+
+#ifdef TIMESTAMP_HAS_TSC
+// Converts counter ticks to monotonic time: nanoseconds per tick, in 32.32
+// fixed point, from a reference point.
+struct TscCalibration {
+    bool valid;
+    uint64_t base_ticks;
+    int64_t base_ns;
+    uint64_t ns_per_tick;
+};
+
+bool hasInvariantTsc() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) { return false; }
+    return (edx & (1u << 8)) != 0;
+}
+
+TscCalibration calibrateTsc() {
+    TscCalibration result = {false, 0, 0, 0};
+    if (!hasInvariantTsc()) { return result; }
+
+    // 10 ms give the rate with a precision of a few ppm.
+    const uint64_t start_ticks = __rdtsc();
+    const int64_t start_ns = monotonicNow();
+    int64_t end_ns;
+    do {
+        end_ns = monotonicNow();
+    } while (end_ns - start_ns < 10 * 1000000);
+    const uint64_t end_ticks = __rdtsc();
+    if (end_ticks <= start_ticks) { return result; }
+
+    result.ns_per_tick = (uint64_t(end_ns - start_ns) << 32) / (end_ticks - start_ticks);
+    result.base_ticks = end_ticks;
+    result.base_ns = end_ns;
+    result.valid = result.ns_per_tick > 0;
+    return result;
 }
 
-Timestamp Timestamp::now() {
-    struct timeval time;
-    gettimeofday(&time, 0);
-    return Timestamp(int64_t(time.tv_sec) * 1000000 + int64_t(time.tv_usec));
+const TscCalibration& tscCalibration() {
+    static const TscCalibration calibration = calibrateTsc();
+    return calibration;
+}
+
+int64_t tscNow() {
+    const TscCalibration& tsc = tscCalibration();
+    const unsigned __int128 elapsed = static_cast<unsigned __int128>(__rdtsc() - tsc.base_ticks);
+    return tsc.base_ns + static_cast<int64_t>((elapsed * tsc.ns_per_tick) >> 32);
+}
+#endif  // TIMESTAMP_HAS_TSC
+
+}  // namespace
+
+void Duration::systemSleep() const {
+    if (duration_ <= 0) { return; }
+
+    struct timespec remaining;
+    remaining.tv_sec = time_t(duration_ / kNanoSecondsPerSecond);
+    remaining.tv_nsec = long(duration_ % kNanoSecondsPerSecond);
+    while (nanosleep(&remaining, &remaining) != 0 && errno == EINTR) {}
+}
+
+Timestamp Timestamp::systemNow() {
+    switch (time_source.load(std::memory_order_relaxed)) {
+        case TIME_SOURCE_WALL: return wallNow();
+#ifdef TIMESTAMP_HAS_TSC
+        case TIME_SOURCE_TSC: return Timestamp(tscNow());
+#endif
+#ifdef CLOCK_MONOTONIC_COARSE
+        case TIME_SOURCE_COARSE:
+            return Timestamp(readClock(CLOCK_MONOTONIC_COARSE) + monotonicAnchor());
+#endif
+        default: return Timestamp(monotonicNow());
+    }
+}
+
+void Timestamp::systemSleepUntil(Timestamp deadline, Duration spin) {
+    const Timestamp wake_up = deadline - spin;
+    if (systemNow() < wake_up) {
+#ifdef TIMER_ABSTIME
+        // The TSC and coarse sources follow the monotonic clock: the final
+        // loop absorbs their small differences.
+        const bool wall = time_source.load(std::memory_order_relaxed) == TIME_SOURCE_WALL;
+        const int64_t target = wake_up.epoch_ - (wall ? 0 : monotonicAnchor());
+        struct timespec time;
+        time.tv_sec = time_t(target / kNanoSecondsPerSecond);
+        time.tv_nsec = long(target % kNanoSecondsPerSecond);
+        while (clock_nanosleep(wall ? CLOCK_REALTIME : CLOCK_MONOTONIC, TIMER_ABSTIME, &time,
+                               nullptr) == EINTR) {}
+#else
+        (wake_up - systemNow()).systemSleep();
+#endif
+    }
+    while (systemNow() < deadline) {
+        // spin..
+    }
+}
+
+Timestamp Timestamp::wallNow() { return Timestamp(readClock(CLOCK_REALTIME)); }
+
+bool Timestamp::setTimeSource(TimeSource source) {
+    switch (source) {
+        case TIME_SOURCE_WALL:
+        case TIME_SOURCE_MONOTONIC: break;
+        case TIME_SOURCE_TSC:
+#ifdef TIMESTAMP_HAS_TSC
+            if (tscCalibration().valid) { break; }
+#endif
+            return false;
+        case TIME_SOURCE_COARSE:
+#ifdef CLOCK_MONOTONIC_COARSE
+            break;
+#else
+            return false;
+#endif
+        default: return false;
+    }
+    time_source = source;
+    return true;
+}
+
+TimeSource Timestamp::timeSource() { return static_cast<TimeSource>(time_source.load()); }
+
+Duration Timestamp::wallClockOffset() {
+    if (time_source.load(std::memory_order_relaxed) == TIME_SOURCE_WALL) { return Duration(); }
+    const int64_t wall = readClock(CLOCK_REALTIME);
+    return Duration(wall - monotonicNow());
 }
 
 std::string Timestamp::asString(const char* strftime_format) const {
     struct tm t;
-    time_t seconds_since_epoch = epoch_ / 1000000;
+    time_t seconds_since_epoch = epoch_ / kNanoSecondsPerSecond;
 
     gmtime_r(&seconds_since_epoch, &t);
 
@@ -30,35 +30,107 @@
 #include <time.h>
 #include <windows.h>
 
+#include <atomic>
+
 namespace {
 // GetSystemTimeAsFileTime is based in 1601.
 // Our reference is 1970. This is the difference between both epochs.
 // Unit: 100 nanoseconds
-const int64_t kDeltaEpoch = 11644473600000000ULL;
+const int64_t kDeltaEpoch = 116444736000000000LL;
+
+const int64_t kNanoSecondsPerSecond = 1000000000;
+
+std::atomic<int> time_source(TIME_SOURCE_MONOTONIC);
+
+int64_t wallNanoSeconds() {
+    FILETIME time;
+    GetSystemTimeAsFileTime(&time);
+    return (int64_t(time.dwLowDateTime) + (int64_t(time.dwHighDateTime) << 32) - kDeltaEpoch) *
+           100;
+}
+
+int64_t performanceFrequency() {
+    static const int64_t frequency = [] {
+        LARGE_INTEGER value;
+        QueryPerformanceFrequency(&value);
+        return int64_t(value.QuadPart);
+    }();
+    return frequency;
+}
+
+int64_t performanceCounterNanoSeconds() {
+    LARGE_INTEGER value;
+    QueryPerformanceCounter(&value);
+    const int64_t frequency = performanceFrequency();
+    const int64_t seconds = value.QuadPart / frequency;
+    const int64_t remainder = value.QuadPart % frequency;
+    return seconds * kNanoSecondsPerSecond + remainder * kNanoSecondsPerSecond / frequency;
+}
+
+// Shifts the performance counter to the epoch of the wall clock.
+int64_t monotonicAnchor() {
+    static const int64_t anchor = wallNanoSeconds() - performanceCounterNanoSeconds();
+    return anchor;
+}
+
+int64_t monotonicNow() { return performanceCounterNanoSeconds() + monotonicAnchor(); }
 
 }  // namespace
 
-void Duration::sleep() const {
+void Duration::systemSleep() const {
     if (duration_ <= 0) { return; }
 
-    Timestamp deadline = Timestamp::now() + *this;
-    if (*this > Duration::microSeconds(2000)) { Sleep(DWORD(duration_ / 1000)); }
+    Timestamp deadline = Timestamp::systemNow() + *this;
+    if (*this > Duration::microSeconds(2000)) { Sleep(DWORD(duration_ / 1000000)); }
 
-    while (Timestamp::now() < deadline) {
+    while (Timestamp::systemNow() < deadline) {
         // wait..
     }
 }
 
-Timestamp Timestamp::now() {
-    FILETIME time;
-    GetSystemTimeAsFileTime(&time);
-    return Timestamp(
-        (int64_t(time.dwLowDateTime) + (int64_t(time.dwHighDateTime) << 32) - kDeltaEpoch) / 10);
+Timestamp Timestamp::systemNow() {
+    switch (time_source.load(std::memory_order_relaxed)) {
+        case TIME_SOURCE_WALL: return wallNow();
+        case TIME_SOURCE_COARSE:
+            return Timestamp(int64_t(GetTickCount64()) * 1000000 + monotonicAnchor());
+        default: return Timestamp(monotonicNow());
+    }
+}
+
+void Timestamp::systemSleepUntil(Timestamp deadline, Duration spin) {
+    const Duration remaining = (deadline - spin) - systemNow();
+    if (remaining > Duration::milliSeconds(1)) { Sleep(DWORD(remaining.milliSeconds())); }
+
+    while (systemNow() < deadline) {
+        // wait..
+    }
+}
+
+Timestamp Timestamp::wallNow() { return Timestamp(wallNanoSeconds()); }
+
+bool Timestamp::setTimeSource(TimeSource source) {
+    switch (source) {
+        case TIME_SOURCE_WALL:
+        case TIME_SOURCE_MONOTONIC:
+        case TIME_SOURCE_COARSE: break;
+        // QueryPerformanceCounter already reads the counter when it is invariant.
+        default: return false;
+    }
+    time_source = source;
+    return true;
+}
+
+TimeSource Timestamp::timeSource() { return static_cast<TimeSource>(time_source.load()); }
+
+Duration Timestamp::wallClockOffset() {
+    if (time_source.load(std::memory_order_relaxed) == TIME_SOURCE_WALL) { return Duration(); }
+    const int64_t wall = wallNanoSeconds();
+    return Duration(wall - monotonicNow());
 }
 
 std::string Timestamp::asString(const char* strftime_format) const {
     struct tm t;
-    time_t seconds_since_epoch = epoch_ / 1000000;
+    time_t seconds_since_epoch = epoch_ / kNanoSecondsPerSecond;
 
     gmtime_s(&t, &seconds_since_epoch);
 
@@ -32,6 +32,24 @@
 
 class Timestamp;
 
+//! Where Timestamp::systemNow() reads the time. \see Timestamp::setTimeSource
+enum TimeSource {
+    //! The wall clock of the system. Jumps when the system time is set.
+    TIME_SOURCE_WALL,
+
+    //! The monotonic clock of the system, anchored on the wall clock when
+    //! first read. Never jumps. The default.
+    TIME_SOURCE_MONOTONIC,
+
+    //! The time stamp counter of the CPU, calibrated against the monotonic
+    //! clock. The cheapest to read. Requires an invariant counter.
+    TIME_SOURCE_TSC,
+
+    //! The monotonic time of the last scheduler tick: cheap to read, with a
+    //! resolution of a few milliseconds.
+    TIME_SOURCE_COARSE
+};
+
 //! Represents a relative time period.
 //! A duration can be obtained by:
 //!  - specifying a constant duration in a specified unit;
@@ -42,21 +60,28 @@ class Duration {
 public:
     Duration() { duration_ = 0; }
 
-    static Duration seconds(double sec) { return Duration(int64_t(sec * 1e6)); }
-    static Duration milliSeconds(double msec) { return Duration(int64_t(msec * 1e3)); }
-    static Duration microSeconds(int64_t microsec) { return Duration(microsec); }
+    static Duration seconds(double sec) { return Duration(int64_t(sec * 1e9)); }
+    static Duration milliSeconds(double msec) { return Duration(int64_t(msec * 1e6)); }
+    static Duration microSeconds(int64_t microsec) { return Duration(microsec * 1000); }
+    static Duration nanoSeconds(int64_t nanosec) { return Duration(nanosec); }
 
-    int64_t microSeconds() const { return duration_; }
-    int64_t milliSeconds() const { return duration_ / 1000; }
-    double seconds() const { return double(duration_) * 1e-6; }
+    int64_t nanoSeconds() const { return duration_; }
+    int64_t microSeconds() const { return duration_ / 1000; }
+    int64_t milliSeconds() const { return duration_ / 1000000; }
+    double seconds() const { return double(duration_) * 1e-9; }
 
     //! Pause execution of the current thread for the specified duration.
     //! The caller is guaranteed to be stopped for at least the duration,
     //! but it could be more. Expect a few milliseconds.
     //! To wait for a short and more acurate time, call Timestamp::now()
-    //! until it reaches the time you want.
+    //! until it reaches the time you want. To pace a loop, prefer
+    //! Timestamp::sleepUntil() or a PeriodicTimer, which do not drift.
+    //! Threads running on a Clock wait for the clock instead.
     void sleep() const;
 
+    //! Same as sleep(), always waiting for the system time.
+    void systemSleep() const;
+
     Duration abs() const { return Duration(duration_ > 0 ? duration_ : -duration_); }
 
     Duration operator+(Duration a) { return Duration(duration_ + a.duration_); }
@@ -75,7 +100,7 @@ public:
     bool operator!=(Duration a) const { return duration_ != a.duration_; }
 
 private:
-    explicit Duration(int64_t microsec) : duration_(microsec) {}
+    explicit Duration(int64_t nanosec) : duration_(nanosec) {}
 
     int64_t duration_;
 
@@ -84,20 +109,61 @@ private:
 
 //! Represent the time and date at which an event occured.
 //!
-//! The internal accuracy varies from a system to another.
-//! The unit test checks that it is at least 100 micro-sec.
-//! The internal unit is microseconds.
+//! The internal unit is nanoseconds. The actual resolution depends on the
+//! time source: the unit test checks that it is at least 1 micro-sec.
+//!
+//! By default, time comes from a monotonic clock anchored on the wall clock
+//! when first read: timestamps do not jump when the system time is set, and
+//! slowly drift away from the wall clock. toWallTime() converts them.
 class Timestamp {
 public:
-    //! Create a timestamp containing the creation time.
-    Timestamp() { *this = now(); }
+    //! The epoch, Jan. 1st 1970. Does not read the clock: call now() for that.
+    Timestamp() : epoch_(0) {}
 
-    //! Returns a timestamp containing the current time.
+    //! Returns a timestamp containing the current time, as given by the
+    //! clock of the calling thread. \see Clock
     static Timestamp now();
 
-    static Timestamp microSecondsSince1970(int64_t epoch) { return Timestamp(epoch); }
+    //! Returns the current time of the time source, whatever the thread clock.
+    static Timestamp systemNow();
+
+    //! Returns the current time of the system wall clock.
+    static Timestamp wallNow();
+
+    //! Blocks until now() reaches <deadline>. Threads running on a Clock
+    //! wait for the clock, without spinning. \see systemSleepUntil
+    static void sleepUntil(Timestamp deadline, Duration spin = Duration());
+
+    /*! Blocks until systemNow() reaches <deadline>. The deadline is
+     *  absolute: unlike chained sleep() calls, wake up delays do not add up.
+     *  The last <spin> of the wait is a busy loop, trading CPU time for an
+     *  accuracy better than the scheduler latency.
+     */
+    static void systemSleepUntil(Timestamp deadline, Duration spin = Duration());
+
+    /*! Selects the time source of systemNow(), for the whole process.
+     *  Returns false, keeping the current source, if <source> is not
+     *  available on this system. Timestamps taken from different sources
+     *  should not be compared: select the source before starting graphs.
+     */
+    static bool setTimeSource(TimeSource source);
+    static TimeSource timeSource();
+
+    //! How far the wall clock is ahead of the time source. Zero with
+    //! TIME_SOURCE_WALL. Changes when the system time is set or adjusted.
+    static Duration wallClockOffset();
+
+    //! Converts a timestamp of the time source to wall clock time.
+    Timestamp toWallTime() const { return *this + wallClockOffset(); }
+
+    //! Converts a wall clock time to the domain of the time source.
+    static Timestamp fromWallTime(Timestamp wall) { return wall - wallClockOffset(); }
+
+    static Timestamp microSecondsSince1970(int64_t epoch) { return Timestamp(epoch * 1000); }
+    static Timestamp nanoSecondsSince1970(int64_t epoch) { return Timestamp(epoch); }
 
-    int64_t microSecondsSince1970() const { return epoch_; }
+    int64_t microSecondsSince1970() const { return epoch_ / 1000; }
+    int64_t nanoSecondsSince1970() const { return epoch_; }
 
     bool operator<(Timestamp b) const { return epoch_ < b.epoch_; }
     bool operator>(Timestamp b) const { return epoch_ > b.epoch_; }
@@ -128,7 +194,7 @@ public:
 private:
     explicit Timestamp(int64_t t) : epoch_(t) {}
 
-    // Unit: microseconds (1e-6 seconds) elapsed since Jan. 1st 1970, UTC.
+    // Unit: nanoseconds (1e-9 seconds) elapsed since Jan. 1st 1970, UTC.
     int64_t epoch_;
 };
 
@@ -28,26 +28,23 @@
 
 #include "timestamp.h"
 
-TEST(TimestampTest, ConstructNow) {
-    Timestamp timeAtStart(Timestamp::now());
-    Timestamp alsoTimeAtStart;
-
-    // We expect a timer accuracy of .1 millisecond.
-    double difference = (alsoTimeAtStart - timeAtStart).seconds();
-    EXPECT_LE(0, difference);
-    EXPECT_NEAR(0.0, difference, 1e-4);
+TEST(TimestampTest, DefaultIsEpoch) {
+    Timestamp epoch;
+    EXPECT_EQ(0, epoch.nanoSecondsSince1970());
+    EXPECT_EQ(Timestamp::microSecondsSince1970(0), epoch);
 }
 
 TEST(TimestampTest, CheckSmallestIncrement) {
     Timestamp timeAtStart(Timestamp::now());
 
-    Timestamp aBitLater;
+    Timestamp aBitLater(timeAtStart);
     while (!(timeAtStart < aBitLater)) { aBitLater = Timestamp::now(); }
 
-    // We expect a timer accuracy of .1 millisecond.
-    double difference = (aBitLater - timeAtStart).seconds();
-    EXPECT_LT(0, difference);
-    EXPECT_NEAR(0.0, difference, 1e-3);
+    // The resolution is nanoseconds, but reading the clock itself can take
+    // over a microsecond, for example in a virtual machine.
+    Duration difference = aBitLater - timeAtStart;
+    EXPECT_LT(Duration(), difference);
+    EXPECT_LT(difference, Duration::microSeconds(100));
 }
 
 TEST(TimestampTest, WaitLoop) {
@@ -55,13 +52,14 @@ TEST(TimestampTest, WaitLoop) {
     Timestamp later(Timestamp::now() + Duration::milliSeconds(30));
 
     while (Timestamp::now() < later) {}
-    Timestamp after;
+    Timestamp after(Timestamp::now());
 
     Duration waiting_time(after - timeAtStart);
 
-    // In theory, we should have waited for 30 milliseconds.
-    // This test expects an accuracy of .1 millisecond.
-    EXPECT_NEAR(30e-3, waiting_time.seconds(), 1e-4);
+    // In theory, we should have waited for 30 milliseconds. The thread can
+    // be preempted right after the loop, hence the loose upper bound.
+    EXPECT_LE(30e-3, waiting_time.seconds());
+    EXPECT_GT(80e-3, waiting_time.seconds());
 }
 
 TEST(TimestampTest, OneSecondConstructors) {
@@ -73,6 +71,43 @@ TEST(TimestampTest, OneSecondConstructors) {
     EXPECT_EQ(1000000, delta.microSeconds());
     EXPECT_EQ(1000000, delta2.microSeconds());
     EXPECT_EQ(1000000, delta3.microSeconds());
+    EXPECT_EQ(1000000, Duration::nanoSeconds(1000000999).microSeconds());
+}
+
+TEST(TimestampTest, KeepsNanoSeconds) {
+    Timestamp time(Timestamp::nanoSecondsSince1970(1500000000123456789LL));
+    EXPECT_EQ(1500000000123456LL, time.microSecondsSince1970());
+    EXPECT_EQ(1500000000123456790LL, (time + Duration::nanoSeconds(1)).nanoSecondsSince1970());
+    EXPECT_EQ(Duration::nanoSeconds(789),
+              time - Timestamp::microSecondsSince1970(1500000000123456LL));
+}
+
+TEST(TimestampTest, TimeSources) {
+    const TimeSource sources[] = {TIME_SOURCE_WALL, TIME_SOURCE_MONOTONIC, TIME_SOURCE_TSC,
+                                  TIME_SOURCE_COARSE};
+    for (TimeSource source : sources) {
+        if (!Timestamp::setTimeSource(source)) {
+            // The CPU or the system lacks it: the source stays the same.
+            EXPECT_NE(source, Timestamp::timeSource());
+            continue;
+        }
+        EXPECT_EQ(source, Timestamp::timeSource());
+
+        // All sources share the epoch of the wall clock.
+        Timestamp now(Timestamp::systemNow());
+        EXPECT_NEAR(0.0, (now.toWallTime() - Timestamp::wallNow()).seconds(), 0.02);
+        EXPECT_NEAR(0.0, (Timestamp::fromWallTime(now.toWallTime()) - now).seconds(), 1e-3);
+
+        // Never goes back.
+        Timestamp previous(now);
+        for (int i = 0; i < 1000; ++i) {
+            Timestamp next(Timestamp::systemNow());
+            EXPECT_LE(previous, next);
+            previous = next;
+        }
+    }
+    EXPECT_TRUE(Timestamp::setTimeSource(TIME_SOURCE_MONOTONIC));
+    EXPECT_EQ(TIME_SOURCE_MONOTONIC, Timestamp::timeSource());
 }
 
 TEST(TimestampTest, Arithmetic) {
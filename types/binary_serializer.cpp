@@ -26,115 +26,181 @@
 //
 #include "binary_serializer.h"
 
-#include <assert.h>
+#include <limits.h>
 #include <stdint.h>
+#include <string.h>
+
+#include "byte_order.h"
 
 namespace media_graph {
-bool BinarySerializer::process(const int& value) {
-    serialized_value_.push_back((value >> 24) & 0xFF);
-    serialized_value_.push_back((value >> 16) & 0xFF);
-    serialized_value_.push_back((value >> 8) & 0xFF);
-    serialized_value_.push_back((value >> 0) & 0xFF);
-    return true;
+unsigned char* BinarySerializer::grow(size_t num_bytes) {
+    if (buffer_) {
+        if (capacity_ - size_ < num_bytes) { return nullptr; }
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(buffer_ + size_);
+        size_ += num_bytes;
+        return bytes;
+    }
+    const size_t size = serialized_value_.size();
+    serialized_value_.resize(size + num_bytes);
+    return reinterpret_cast<unsigned char*>(&serialized_value_[size]);
 }
 
-bool BinaryDeSerializer::process(int* value) {
-    if (serialized_value_.size() < 4) { return false; }
+bool BinarySerializer::process(const int& value) { return writeArray(&value, 1); }
 
-    *value = ((static_cast<unsigned char>(serialized_value_[0])) << 24) +
-             ((static_cast<unsigned char>(serialized_value_[1])) << 16) +
-             ((static_cast<unsigned char>(serialized_value_[2])) << 8) +
-             ((static_cast<unsigned char>(serialized_value_[3])) << 0);
-    serialized_value_.erase(0, 4);
-    return true;
-}
-
-bool BinarySerializer::process(const int64_t& value) {
-    for (int i = 0; i < 8; ++i) { serialized_value_.push_back((value >> ((7 - i) * 8)) & 0xFF); }
-    return true;
-}
+bool BinaryDeSerializer::process(int* value) { return readArray(value, 1); }
 
-bool BinaryDeSerializer::process(int64_t* value) {
-    if (serialized_value_.size() < 8) { return false; }
+bool BinarySerializer::process(const int64_t& value) { return writeArray(&value, 1); }
 
-    *value = 0;
-    for (int i = 0; i < 8; ++i) {
-        *value += int64_t(static_cast<unsigned char>(serialized_value_[i])) << ((7 - i) * 8);
-    }
-    serialized_value_.erase(0, 8);
-    return true;
-}
+bool BinaryDeSerializer::process(int64_t* value) { return readArray(value, 1); }
 
 bool BinarySerializer::process(const bool& value) {
-    serialized_value_.push_back(value ? 0xFF : 0);
+    unsigned char* bytes = grow(1);
+    if (!bytes) { return false; }
+    bytes[0] = (value ? 0xFF : 0);
     return true;
 }
 
 bool BinaryDeSerializer::process(bool* value) {
-    if (serialized_value_.size() < 1) { return false; }
-
-    *value = (serialized_value_[0] != 0);
-    serialized_value_.erase(0, 1);
+    const unsigned char* bytes = consume(1);
+    if (!bytes) { return false; }
+    *value = (bytes[0] != 0);
     return true;
 }
 
-bool BinarySerializer::process(const float& value) {
-    union {
-        int as_int;
-        float as_float;
-    } mixedValue;
-    mixedValue.as_float = value;
-    return process(mixedValue.as_int);
-}
-
-bool BinaryDeSerializer::process(float* value) {
-    assert(sizeof(int) == sizeof(float));
-    union {
-        int as_int;
-        float as_float;
-    } mixedValue;
-    if (process(&mixedValue.as_int)) {
-        *value = mixedValue.as_float;
-        return true;
-    }
-    return false;
-}
-
-bool BinarySerializer::process(const double& value) {
-    union {
-        int64_t as_int64_t;
-        double as_double;
-    } mixedValue;
-    mixedValue.as_double = value;
-    return process(mixedValue.as_int64_t);
-}
-
-bool BinaryDeSerializer::process(double* value) {
-    assert(sizeof(int64_t) == sizeof(double));
-    union {
-        int64_t as_int64_t;
-        double as_double;
-    } mixedValue;
-    if (process(&mixedValue.as_int64_t)) {
-        *value = mixedValue.as_double;
-        return true;
-    }
-    return false;
-}
+bool BinarySerializer::process(const float& value) { return writeArray(&value, 1); }
+
+bool BinaryDeSerializer::process(float* value) { return readArray(value, 1); }
+
+bool BinarySerializer::process(const double& value) { return writeArray(&value, 1); }
+
+bool BinaryDeSerializer::process(double* value) { return readArray(value, 1); }
 
 bool BinarySerializer::process(const std::string& value) {
-    int length(value.size());
-    process(length);
-    serialized_value_.append(value);
+    if (value.size() > size_t(INT_MAX)) { return false; }
+    unsigned char* bytes = grow(4 + value.size());
+    if (!bytes) { return false; }
+    storeBigEndian32(uint32_t(value.size()), bytes);
+    memcpy(bytes + 4, value.data(), value.size());
     return true;
 }
 
 bool BinaryDeSerializer::process(std::string* value) {
+    const size_t start = position_;
     int length;
     if (!process(&length)) { return false; }
-    *value = serialized_value_.substr(0, length);
-    serialized_value_.erase(0, length);
+
+    const unsigned char* bytes = (length >= 0 ? consume(length) : nullptr);
+    if (!bytes) {
+        position_ = start;
+        return false;
+    }
+    value->assign(reinterpret_cast<const char*>(bytes), length);
     return true;
 }
 
+// int and float are written as 32 bits words, int64_t and double as 64 bits
+// words. The byte order conversion is the same for both directions.
+static_assert(sizeof(int) == 4 && sizeof(float) == 4, "4 bytes int and float expected");
+static_assert(sizeof(int64_t) == 8 && sizeof(double) == 8, "8 bytes int64_t and double expected");
+
+bool BinarySerializer::writeArray(const int* values, size_t count) {
+    unsigned char* bytes = grow(count * 4);
+    if (bytes) { copyBigEndian32(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::writeArray(const int64_t* values, size_t count) {
+    unsigned char* bytes = grow(count * 8);
+    if (bytes) { copyBigEndian64(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::writeArray(const float* values, size_t count) {
+    unsigned char* bytes = grow(count * 4);
+    if (bytes) { copyBigEndian32(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::writeArray(const double* values, size_t count) {
+    unsigned char* bytes = grow(count * 8);
+    if (bytes) { copyBigEndian64(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinaryDeSerializer::readArray(int* values, size_t count) {
+    const unsigned char* bytes = consume(count, 4);
+    if (bytes) { copyBigEndian32(bytes, count, values); }
+    return bytes != nullptr;
+}
+
+bool BinaryDeSerializer::readArray(int64_t* values, size_t count) {
+    const unsigned char* bytes = consume(count, 8);
+    if (bytes) { copyBigEndian64(bytes, count, values); }
+    return bytes != nullptr;
+}
+
+bool BinaryDeSerializer::readArray(float* values, size_t count) {
+    const unsigned char* bytes = consume(count, 4);
+    if (bytes) { copyBigEndian32(bytes, count, values); }
+    return bytes != nullptr;
+}
+
+bool BinaryDeSerializer::readArray(double* values, size_t count) {
+    const unsigned char* bytes = consume(count, 8);
+    if (bytes) { copyBigEndian64(bytes, count, values); }
+    return bytes != nullptr;
+}
+
+unsigned char* BinarySerializer::growArray(size_t count, size_t item_size) {
+    if (count > size_t(INT_MAX) || count > (SIZE_MAX - 4) / item_size) { return nullptr; }
+    unsigned char* bytes = grow(4 + count * item_size);
+    if (!bytes) { return nullptr; }
+    storeBigEndian32(uint32_t(count), bytes);
+    return bytes + 4;
+}
+
+bool BinarySerializer::processArray(const int* values, size_t count) {
+    unsigned char* bytes = growArray(count, 4);
+    if (bytes) { copyBigEndian32(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::processArray(const int64_t* values, size_t count) {
+    unsigned char* bytes = growArray(count, 8);
+    if (bytes) { copyBigEndian64(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::processArray(const float* values, size_t count) {
+    unsigned char* bytes = growArray(count, 4);
+    if (bytes) { copyBigEndian32(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+bool BinarySerializer::processArray(const double* values, size_t count) {
+    unsigned char* bytes = growArray(count, 8);
+    if (bytes) { copyBigEndian64(values, count, bytes); }
+    return bytes != nullptr;
+}
+
+template <typename T> bool BinaryDeSerializer::readVector(std::vector<T>* values) {
+    const size_t start = position_;
+    int count;
+    if (!process(&count)) { return false; }
+    if (count < 0 || remainingSize() / sizeof(T) < size_t(count)) {
+        position_ = start;
+        return false;
+    }
+    values->resize(count);
+    return readArray(values->data(), count);
+}
+
+bool BinaryDeSerializer::processArray(std::vector<int>* values) { return readVector(values); }
+
+bool BinaryDeSerializer::processArray(std::vector<int64_t>* values) { return readVector(values); }
+
+bool BinaryDeSerializer::processArray(std::vector<float>* values) { return readVector(values); }
+
+bool BinaryDeSerializer::processArray(std::vector<double>* values) { return readVector(values); }
+
 }  // namespace media_graph
@@ -27,15 +27,26 @@
 #ifndef MEDIAGRAPH_BINARY_SERIALIZER_H
 #define MEDIAGRAPH_BINARY_SERIALIZER_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "type_visitor.h"
 
 namespace media_graph {
-//! Serialize known types to binary.
+/*! Serialize known types to binary, in big endian order.
+ *  Writes either into value(), or into a buffer provided by the caller.
+ */
 class BinarySerializer : public TypeConstVisitor {
 public:
+    BinarySerializer() : buffer_(nullptr), capacity_(0), size_(0) {}
+
+    //! Writes into <buffer>, of <capacity> bytes. When the buffer is full,
+    //! process() fails without writing anything.
+    BinarySerializer(char* buffer, size_t capacity)
+        : buffer_(buffer), capacity_(capacity), size_(0) {}
+
     virtual bool process(const int& value);
     virtual bool process(const int64_t& value);
     virtual bool process(const bool& value);
@@ -45,16 +56,93 @@ public:
 
     virtual bool process(const std::string& value);
 
+    //! Arrays are written as their int size, followed by the values. Fails
+    //! on arrays, and strings, longer than INT_MAX.
+    virtual bool processArray(const int* values, size_t count);
+    virtual bool processArray(const int64_t* values, size_t count);
+    virtual bool processArray(const float* values, size_t count);
+    virtual bool processArray(const double* values, size_t count);
+
+    //! Struct fields are written in order, without names.
+    virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) { return true; }
+
+    //! Writes <count> consecutive values, as the same number of process()
+    //! calls would, at once. Unlike processArray(), does not write the size.
+    bool writeArray(const int* values, size_t count);
+    bool writeArray(const int64_t* values, size_t count);
+    bool writeArray(const float* values, size_t count);
+    bool writeArray(const double* values, size_t count);
+
+    //! Pre-allocates <num_bytes> more bytes. \see BinarySizeCounter
+    void reserve(size_t num_bytes) {
+        if (!buffer_) { serialized_value_.reserve(serialized_value_.size() + num_bytes); }
+    }
+
+    //! Number of bytes written.
+    size_t size() const { return buffer_ ? size_ : serialized_value_.size(); }
+
+    //! The bytes written. Empty when writing into a caller buffer.
     const std::string& value() const { return serialized_value_; }
 
 private:
+    // Writes <count> as an int, and returns room for <count> items of
+    // <item_size> bytes after it. Null if it does not fit: nothing is written.
+    unsigned char* growArray(size_t count, size_t item_size);
+
+    // Returns room for <num_bytes> more bytes, or null if the buffer is full.
+    unsigned char* grow(size_t num_bytes);
+
     std::string serialized_value_;
+    char* buffer_;
+    size_t capacity_;
+    size_t size_;
 };
 
-//! De-serialize known types from binary.
+//! Counts the bytes BinarySerializer writes, to reserve them at once.
+class BinarySizeCounter : public TypeConstVisitor {
+public:
+    BinarySizeCounter() : size_(0) {}
+
+    virtual bool process(const int&) { return add(4); }
+    virtual bool process(const int64_t&) { return add(8); }
+    virtual bool process(const bool&) { return add(1); }
+
+    virtual bool process(const float&) { return add(4); }
+    virtual bool process(const double&) { return add(8); }
+
+    virtual bool process(const std::string& value) { return add(4 + value.size()); }
+
+    virtual bool processArray(const int*, size_t count) { return add(4 + count * 4); }
+    virtual bool processArray(const int64_t*, size_t count) { return add(4 + count * 8); }
+    virtual bool processArray(const float*, size_t count) { return add(4 + count * 4); }
+    virtual bool processArray(const double*, size_t count) { return add(4 + count * 8); }
+
+    virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) { return true; }
+
+    size_t size() const { return size_; }
+
+private:
+    bool add(size_t num_bytes) {
+        size_ += num_bytes;
+        return true;
+    }
+
+    size_t size_;
+};
+
+/*! De-serialize known types from binary.
+ *  Reads through a cursor over bytes it does not own: the serialized data
+ *  must outlive the de-serializer. Reading past the end fails, and leaves
+ *  the cursor unchanged.
+ */
 class BinaryDeSerializer : public TypeVisitor {
 public:
-    BinaryDeSerializer(const std::string& serialized_value) : serialized_value_(serialized_value) {}
+    BinaryDeSerializer(const std::string& serialized_value)
+        : data_(serialized_value.data()), size_(serialized_value.size()), position_(0) {}
+    BinaryDeSerializer(const char* data, size_t size) : data_(data), size_(size), position_(0) {}
+
+    //! A temporary string would not outlive the de-serializer.
+    BinaryDeSerializer(std::string&&) = delete;
 
     virtual bool process(int* value);
     virtual bool process(int64_t* value);
@@ -65,10 +153,42 @@ public:
 
     virtual bool process(std::string* value);
 
-    const std::string& remaining() const { return serialized_value_; }
+    virtual bool processArray(std::vector<int>* values);
+    virtual bool processArray(std::vector<int64_t>* values);
+    virtual bool processArray(std::vector<float>* values);
+    virtual bool processArray(std::vector<double>* values);
+
+    virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) { return true; }
+
+    //! Reads <count> consecutive values, as written by the same number of
+    //! process() calls, at once.
+    bool readArray(int* values, size_t count);
+    bool readArray(int64_t* values, size_t count);
+    bool readArray(float* values, size_t count);
+    bool readArray(double* values, size_t count);
+
+    //! Bytes not read yet. Does not copy.
+    const char* remainingData() const { return data_ + position_; }
+    size_t remainingSize() const { return size_ - position_; }
+
+    //! Returns a copy of the bytes not read yet.
+    std::string remaining() const { return std::string(remainingData(), remainingSize()); }
 
 private:
-    std::string serialized_value_;
+    template <typename T> bool readVector(std::vector<T>* values);
+
+    // Returns the next <count> items of <item_size> bytes and moves past
+    // them, or null if too short.
+    const unsigned char* consume(size_t count, size_t item_size = 1) {
+        if (remainingSize() / item_size < count) { return nullptr; }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data_ + position_);
+        position_ += count * item_size;
+        return bytes;
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t position_;
 };
 
 }  // namespace media_graph
@@ -26,6 +26,12 @@
 //
 #include <gtest/gtest.h>
 
+#include <limits.h>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "binary_serializer.h"
 
 namespace media_graph {
@@ -39,6 +45,34 @@ namespace {
         EXPECT_EQ(result, value);
     }
 
+    template <typename T> void CompositeSerializationTest(const T& value) {
+        BinarySerializer serializer;
+        EXPECT_TRUE(visitValue(&serializer, value));
+        BinaryDeSerializer deSerializer(serializer.value());
+        T result;
+        EXPECT_TRUE(visitValue(&deSerializer, &result));
+        EXPECT_EQ(result, value);
+    }
+
+    struct Point {
+        float x;
+        float y;
+        MEDIAGRAPH_FIELDS(Point, x, y)
+        bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+    };
+
+    struct Detection {
+        std::string label;
+        int64_t id;
+        Point center;
+        std::vector<double> scores;
+        MEDIAGRAPH_FIELDS(Detection, label, id, center, scores)
+        bool operator==(const Detection& other) const {
+            return label == other.label && id == other.id && center == other.center
+                   && scores == other.scores;
+        }
+    };
+
 }  // namespace
 
 TEST(BinarySerializerTest, IntTest) {
@@ -91,4 +125,185 @@ TEST(BinarySerializerTest, StringTest) {
     GenericSerializationTest(value);
 }
 
+TEST(BinarySerializerTest, ReadsFieldsInSequence) {
+    BinarySerializer serializer;
+    serializer.process(42);
+    serializer.process(std::string("abc"));
+    serializer.process(2.5);
+    serializer.process(true);
+
+    BinaryDeSerializer deSerializer(serializer.value());
+    int i;
+    std::string s;
+    double d;
+    EXPECT_TRUE(deSerializer.process(&i));
+    EXPECT_TRUE(deSerializer.process(&s));
+    EXPECT_EQ(1 + 8, int(deSerializer.remainingSize()));
+    EXPECT_TRUE(deSerializer.process(&d));
+    EXPECT_EQ(std::string(1, char(0xFF)), deSerializer.remaining());
+
+    EXPECT_EQ(42, i);
+    EXPECT_EQ("abc", s);
+    EXPECT_EQ(2.5, d);
+}
+
+TEST(BinarySerializerTest, TruncatedInputFails) {
+    BinarySerializer serializer;
+    serializer.process(std::string("Hello"));
+    const std::string truncated = serializer.value().substr(0, 6);
+
+    BinaryDeSerializer deSerializer(truncated);
+    std::string s = "unchanged";
+    EXPECT_FALSE(deSerializer.process(&s));
+    EXPECT_EQ("unchanged", s);
+    EXPECT_EQ(truncated, deSerializer.remaining());
+
+    int64_t i;
+    EXPECT_FALSE(deSerializer.process(&i));
+    EXPECT_EQ(6, int(deSerializer.remainingSize()));
+}
+
+TEST(BinarySerializerTest, OversizedCountsFail) {
+    static_assert(!std::is_constructible<BinaryDeSerializer, std::string&&>::value,
+                  "de-serializing a temporary string would read freed memory");
+
+    // The count does not fit in the int size prefix: nothing is written.
+    // The values are not read either, so a short array is enough.
+    const int values[1] = {0};
+    const size_t too_many = size_t(INT_MAX) + 1;
+    BinarySerializer serializer;
+    EXPECT_FALSE(serializer.processArray(values, too_many));
+    EXPECT_EQ(0, int(serializer.value().size()));
+
+    // count * sizeof(double) overflows: reading fails instead of wrapping.
+    const std::string data(16, '\0');
+    BinaryDeSerializer deSerializer(data);
+    double d;
+    EXPECT_FALSE(deSerializer.readArray(&d, SIZE_MAX / 4));
+    EXPECT_EQ(16, int(deSerializer.remainingSize()));
+}
+
+TEST(BinarySerializerTest, ArrayTest) {
+    const int ints[] = {1, -2, 0x12345678};
+    const double doubles[] = {0.5, -1e300, 3.1415};
+    BinarySerializer serializer;
+    for (int v : ints) { serializer.process(v); }
+    for (double v : doubles) { serializer.process(v); }
+
+    BinaryDeSerializer deSerializer(serializer.value().data(), serializer.value().size());
+    int int_result[3];
+    double double_result[3];
+    EXPECT_TRUE(deSerializer.readArray(int_result, 3));
+    EXPECT_FALSE(deSerializer.readArray(double_result, 4));
+    EXPECT_TRUE(deSerializer.readArray(double_result, 3));
+    EXPECT_EQ(0, int(deSerializer.remainingSize()));
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(ints[i], int_result[i]);
+        EXPECT_EQ(doubles[i], double_result[i]);
+    }
+}
+
+TEST(BinarySerializerTest, BigEndianWireFormat) {
+    BinarySerializer serializer;
+    serializer.process(0x01020304);
+    serializer.process(int64_t(0x0102030405060708));
+    EXPECT_EQ(std::string("\x01\x02\x03\x04\x01\x02\x03\x04\x05\x06\x07\x08"),
+              serializer.value());
+}
+
+TEST(BinarySerializerTest, BulkArraysMatchSingleValues) {
+    // Odd sizes exercise both the vectorized loop and its tail.
+    std::vector<float> floats;
+    std::vector<int64_t> int64s;
+    for (int i = 0; i < 11; ++i) {
+        floats.push_back(i * 1.5f - 3);
+        int64s.push_back(int64_t(i) << 40 | i);
+    }
+
+    BinarySerializer one_by_one;
+    for (float v : floats) { one_by_one.process(v); }
+    for (int64_t v : int64s) { one_by_one.process(v); }
+
+    BinarySerializer bulk;
+    EXPECT_TRUE(bulk.writeArray(floats.data(), floats.size()));
+    EXPECT_TRUE(bulk.writeArray(int64s.data(), int64s.size()));
+    EXPECT_EQ(one_by_one.value(), bulk.value());
+
+    BinaryDeSerializer deSerializer(bulk.value());
+    std::vector<float> float_result(floats.size());
+    std::vector<int64_t> int64_result(int64s.size());
+    EXPECT_TRUE(deSerializer.readArray(float_result.data(), float_result.size()));
+    EXPECT_TRUE(deSerializer.readArray(int64_result.data(), int64_result.size()));
+    EXPECT_EQ(floats, float_result);
+    EXPECT_EQ(int64s, int64_result);
+}
+
+TEST(BinarySerializerTest, SizeCounter) {
+    BinarySizeCounter counter;
+    BinarySerializer serializer;
+    for (TypeConstVisitor* visitor : std::vector<TypeConstVisitor*>{&counter, &serializer}) {
+        visitor->process(1);
+        visitor->process(std::string("abc"));
+        visitor->process(true);
+        visitor->process(1.0);
+    }
+    EXPECT_EQ(serializer.size(), counter.size());
+    EXPECT_EQ(4u + 7u + 1u + 8u, counter.size());
+}
+
+TEST(BinarySerializerTest, CallerBuffer) {
+    char buffer[12];
+    BinarySerializer serializer(buffer, sizeof(buffer));
+    EXPECT_TRUE(serializer.process(42));
+    EXPECT_FALSE(serializer.process(std::string("too long")));
+    EXPECT_TRUE(serializer.process(int64_t(-1)));
+    EXPECT_FALSE(serializer.process(true));
+    EXPECT_EQ(sizeof(buffer), serializer.size());
+    EXPECT_TRUE(serializer.value().empty());
+
+    BinaryDeSerializer deSerializer(buffer, serializer.size());
+    int i;
+    int64_t j;
+    EXPECT_TRUE(deSerializer.process(&i));
+    EXPECT_TRUE(deSerializer.process(&j));
+    EXPECT_EQ(42, i);
+    EXPECT_EQ(-1, j);
+}
+
+TEST(BinarySerializerTest, CallerBufferTooShortForTheArray) {
+    // Room for the count, not for the values: nothing is written.
+    char buffer[8];
+    BinarySerializer serializer(buffer, sizeof(buffer));
+    const double values[1] = {1.5};
+    EXPECT_FALSE(serializer.processArray(values, 1));
+    EXPECT_EQ(0u, serializer.size());
+
+    const int ints[1] = {7};
+    EXPECT_TRUE(serializer.processArray(ints, 1));
+    EXPECT_EQ(8u, serializer.size());
+
+    BinaryDeSerializer deSerializer(buffer, serializer.size());
+    std::vector<int> read;
+    EXPECT_TRUE(deSerializer.processArray(&read));
+    EXPECT_EQ(std::vector<int>{7}, read);
+}
+
+TEST(BinarySerializerTest, VectorTest) {
+    CompositeSerializationTest(std::vector<int>{1, -2, 3});
+    CompositeSerializationTest(std::vector<int64_t>{0x123456789AB, -1});
+    CompositeSerializationTest(std::vector<float>{0.5f, -3.25e8f});
+    CompositeSerializationTest(std::vector<double>{3.1415, -1e-12, 0});
+    CompositeSerializationTest(std::vector<double>());
+}
+
+TEST(BinarySerializerTest, StructTest) {
+    Detection detection;
+    detection.label = "pedestrian, {walking}";
+    detection.id = 42;
+    detection.center.x = 1.5f;
+    detection.center.y = -2;
+    detection.scores = {0.25, 0.75};
+    CompositeSerializationTest(detection);
+}
+
 }  // namespace media_graph
@@ -0,0 +1,120 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_BYTE_ORDER_H
+#define MEDIAGRAPH_BYTE_ORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define MEDIAGRAPH_BIG_ENDIAN_HOST 1
+#endif
+
+namespace media_graph {
+
+//! Reads a big endian 32 bits word. <bytes> needs no alignment.
+inline uint32_t loadBigEndian32(const unsigned char* bytes) {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) |
+           uint32_t(bytes[3]);
+}
+
+//! Reads a big endian 64 bits word. <bytes> needs no alignment.
+inline uint64_t loadBigEndian64(const unsigned char* bytes) {
+    return (uint64_t(loadBigEndian32(bytes)) << 32) | loadBigEndian32(bytes + 4);
+}
+
+//! Writes a 32 bits word in big endian order. <bytes> needs no alignment.
+inline void storeBigEndian32(uint32_t value, unsigned char* bytes) {
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+}
+
+//! Writes a 64 bits word in big endian order. <bytes> needs no alignment.
+inline void storeBigEndian64(uint64_t value, unsigned char* bytes) {
+    storeBigEndian32(uint32_t(value >> 32), bytes);
+    storeBigEndian32(uint32_t(value), bytes + 4);
+}
+
+/*! Copies <count> 32 bits words from <in> to <out>, converting between
+ *  host and big endian order. The conversion is symmetric: it both encodes
+ *  and decodes. Neither pointer needs alignment.
+ */
+inline void copyBigEndian32(const void* in, size_t count, void* out) {
+#ifdef MEDIAGRAPH_BIG_ENDIAN_HOST
+    memcpy(out, in, count * 4);
+#else
+    const unsigned char* src = static_cast<const unsigned char*>(in);
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    size_t i = 0;
+#ifdef __SSSE3__
+    const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(words, swap));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint32_t word;
+        memcpy(&word, src + i * 4, 4);
+        storeBigEndian32(word, dst + i * 4);
+    }
+#endif
+}
+
+//! Like copyBigEndian32(), for 64 bits words.
+inline void copyBigEndian64(const void* in, size_t count, void* out) {
+#ifdef MEDIAGRAPH_BIG_ENDIAN_HOST
+    memcpy(out, in, count * 8);
+#else
+    const unsigned char* src = static_cast<const unsigned char*>(in);
+    unsigned char* dst = static_cast<unsigned char*>(out);
+    size_t i = 0;
+#ifdef __SSSE3__
+    const __m128i swap = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    for (; i + 2 <= count; i += 2) {
+        const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 8), _mm_shuffle_epi8(words, swap));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint64_t word;
+        memcpy(&word, src + i * 8, 8);
+        storeBigEndian64(word, dst + i * 8);
+    }
+#endif
+}
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_BYTE_ORDER_H
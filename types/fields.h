@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_FIELDS_H
+#define MEDIAGRAPH_FIELDS_H
+
+#include <type_traits>
+
+/*! Describes the fields of a struct, so that visitors, serializers and
+ *  properties can handle it like the built-in types. Fields can be of any
+ *  visitable type: numbers, strings, vectors of numbers, or other structs
+ *  with fields. Supports up to 16 fields. Example:
+ *
+ *  \code
+ *  struct Detection {
+ *      std::string label;
+ *      float score;
+ *      std::vector<float> box;
+ *      MEDIAGRAPH_FIELDS(Detection, label, score, box)
+ *  };
+ *  \endcode
+ *  The type name is "Detection". Properties of struct types also need
+ *  operator==.
+ */
+#define MEDIAGRAPH_FIELDS(Type, ...)                                                           \
+    static const char* mediaGraphTypeName() { return #Type; }                                  \
+    static constexpr int mediaGraphNumFields() {                                               \
+        return MEDIAGRAPH_NUM_ARGS(__VA_ARGS__);                                               \
+    }                                                                                          \
+    template <class Visitor> bool visitFields(const Visitor& visitor) {                        \
+        return true MEDIAGRAPH_FOR_EACH(MEDIAGRAPH_VISIT_FIELD, __VA_ARGS__);                  \
+    }                                                                                          \
+    template <class Visitor> bool visitFields(const Visitor& visitor) const {                  \
+        return true MEDIAGRAPH_FOR_EACH(MEDIAGRAPH_VISIT_FIELD, __VA_ARGS__);                  \
+    }
+
+#define MEDIAGRAPH_VISIT_FIELD(field) &&visitor(#field, field)
+
+// Preprocessor plumbing for MEDIAGRAPH_FIELDS. MEDIAGRAPH_EXPAND works
+// around the MSVC __VA_ARGS__ expansion.
+#define MEDIAGRAPH_EXPAND(x) x
+#define MEDIAGRAPH_NUM_ARGS(...)                                                            \
+    MEDIAGRAPH_EXPAND(MEDIAGRAPH_NTH_ARG(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, \
+                                         5, 4, 3, 2, 1))
+#define MEDIAGRAPH_NTH_ARG(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, \
+                           _16, N, ...)                                                     \
+    N
+#define MEDIAGRAPH_CONCAT(a, b) MEDIAGRAPH_CONCAT_(a, b)
+#define MEDIAGRAPH_CONCAT_(a, b) a##b
+#define MEDIAGRAPH_FOR_EACH(macro, ...) \
+    MEDIAGRAPH_EXPAND(                  \
+        MEDIAGRAPH_CONCAT(MEDIAGRAPH_EACH_, MEDIAGRAPH_NUM_ARGS(__VA_ARGS__))(macro, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_1(m, x) m(x)
+#define MEDIAGRAPH_EACH_2(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_1(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_3(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_2(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_4(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_3(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_5(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_4(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_6(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_5(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_7(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_6(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_8(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_7(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_9(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_8(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_10(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_9(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_11(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_10(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_12(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_11(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_13(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_12(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_14(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_13(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_15(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_14(m, __VA_ARGS__))
+#define MEDIAGRAPH_EACH_16(m, x, ...) m(x) MEDIAGRAPH_EXPAND(MEDIAGRAPH_EACH_15(m, __VA_ARGS__))
+
+namespace media_graph {
+
+//! True for structs described with MEDIAGRAPH_FIELDS.
+template <typename T> class HasFields {
+    template <typename U> static char test(decltype(&U::mediaGraphTypeName));
+    template <typename U> static long test(...);
+
+public:
+    static constexpr bool value = sizeof(test<T>(nullptr)) == sizeof(char);
+};
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_FIELDS_H
@@ -0,0 +1,177 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "number_format.h"
+
+#include <errno.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace media_graph {
+namespace {
+    // Writes the decimal digits of <value>, preceded by '-' if <negative>.
+    size_t formatUnsigned(uint64_t value, bool negative, char* buffer) {
+        char digits[20];
+        size_t num_digits = 0;
+        do {
+            digits[num_digits++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        size_t length = 0;
+        if (negative) { buffer[length++] = '-'; }
+        while (num_digits > 0) { buffer[length++] = digits[--num_digits]; }
+        return length;
+    }
+
+    size_t formatSigned(int64_t value, char* buffer) {
+        // Negate in unsigned arithmetic, so that the minimum value works.
+        const uint64_t magnitude =
+            (value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+        return formatUnsigned(magnitude, value < 0, buffer);
+    }
+
+    // Tries increasing precisions until the text reads back as <value>.
+    template <typename T>
+    size_t formatFloat(T value, int min_digits, int max_digits, char* buffer) {
+        if (value != value) {
+            memcpy(buffer, "nan", 3);
+            return 3;
+        }
+        int length = 0;
+        for (int digits = min_digits; digits <= max_digits; ++digits) {
+            length = snprintf(buffer, kMaxNumberLength, "%.*g", digits, static_cast<double>(value));
+            T read_back;
+            if (parseNumber(buffer, buffer + length, &read_back) && read_back == value) { break; }
+        }
+        return static_cast<size_t>(length);
+    }
+
+    // Parses a sign and decimal digits, up to <max_magnitude>.
+    bool parseInteger(const char* begin, const char* end, uint64_t max_magnitude,
+                      bool* negative, uint64_t* magnitude) {
+        *negative = false;
+        if (begin != end && (*begin == '-' || *begin == '+')) {
+            *negative = (*begin == '-');
+            ++begin;
+        }
+        if (begin == end) { return false; }
+
+        uint64_t result = 0;
+        for (const char* c = begin; c != end; ++c) {
+            if (*c < '0' || *c > '9') { return false; }
+            const unsigned digit = static_cast<unsigned>(*c - '0');
+            if (result > (max_magnitude - digit) / 10) { return false; }
+            result = result * 10 + digit;
+        }
+        *magnitude = result;
+        return true;
+    }
+
+    template <typename Int> bool parseSigned(const char* begin, const char* end, Int* value) {
+        // The most negative value has one more unit than the most positive.
+        const uint64_t max_positive = static_cast<uint64_t>(INT64_MAX) >> (64 - 8 * sizeof(Int));
+        bool negative;
+        uint64_t magnitude;
+        if (!parseInteger(begin, end, max_positive + 1, &negative, &magnitude)) { return false; }
+        if (!negative && magnitude > max_positive) { return false; }
+        *value = static_cast<Int>(negative ? 0 - magnitude : magnitude);
+        return true;
+    }
+
+    template <typename T>
+    bool parseFloat(const char* begin, const char* end, T (*convert)(const char*, char**),
+                    T* value) {
+        // strtod needs a terminated string. Longer inputs carry digits
+        // beyond what a double can hold, so the limit is generous.
+        char text[128];
+        const size_t length = static_cast<size_t>(end - begin);
+        if (length == 0 || length >= sizeof(text)) { return false; }
+        // strtod skips leading spaces, but the format does not allow them.
+        if (*begin == ' ' || (*begin >= '\t' && *begin <= '\r')) { return false; }
+        memcpy(text, begin, length);
+        text[length] = 0;
+
+        char* parsed_end;
+        errno = 0;
+        const T result = convert(text, &parsed_end);
+        if (parsed_end != text + length) { return false; }
+        // Overflow gives infinity. Underflow to a tiny value is accepted.
+        if (errno == ERANGE && (result > 1 || result < -1)) { return false; }
+        *value = result;
+        return true;
+    }
+}  // namespace
+
+size_t formatNumber(int value, char* buffer) { return formatSigned(value, buffer); }
+
+size_t formatNumber(int64_t value, char* buffer) { return formatSigned(value, buffer); }
+
+size_t formatNumber(bool value, char* buffer) {
+    buffer[0] = (value ? '1' : '0');
+    return 1;
+}
+
+size_t formatNumber(float value, char* buffer) {
+    return formatFloat(value, FLT_DIG, FLT_DIG + 3, buffer);
+}
+
+size_t formatNumber(double value, char* buffer) {
+    return formatFloat(value, DBL_DIG, DBL_DIG + 2, buffer);
+}
+
+bool parseNumber(const char* begin, const char* end, int* value) {
+    return parseSigned(begin, end, value);
+}
+
+bool parseNumber(const char* begin, const char* end, int64_t* value) {
+    return parseSigned(begin, end, value);
+}
+
+bool parseNumber(const char* begin, const char* end, bool* value) {
+    const size_t length = static_cast<size_t>(end - begin);
+    if ((length == 1 && *begin == '1') || (length == 4 && memcmp(begin, "true", 4) == 0)) {
+        *value = true;
+        return true;
+    }
+    if ((length == 1 && *begin == '0') || (length == 5 && memcmp(begin, "false", 5) == 0)) {
+        *value = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseNumber(const char* begin, const char* end, float* value) {
+    return parseFloat(begin, end, &strtof, value);
+}
+
+bool parseNumber(const char* begin, const char* end, double* value) {
+    return parseFloat(begin, end, &strtod, value);
+}
+
+}  // namespace media_graph
@@ -0,0 +1,65 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_NUMBER_FORMAT_H
+#define MEDIAGRAPH_NUMBER_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace media_graph {
+
+/*! Conversions between numbers and text, without heap allocation. Used by
+ *  StringSerializer and the HTTP server. Floating point conversions rely on
+ *  the C library and expect the default "C" locale.
+ *
+ *  Formatting writes into a caller buffer of at least kMaxNumberLength
+ *  bytes and returns the number of characters written, without a
+ *  terminating zero. Floating point values are written with the fewest
+ *  digits that read back to the same value. Booleans are written 0 or 1.
+ *
+ *  Parsing is strict: the whole range [begin, end) must hold the number,
+ *  without spaces. Out of range values are rejected. On failure, the
+ *  functions return false and leave *value untouched.
+ */
+enum { kMaxNumberLength = 32 };
+
+size_t formatNumber(int value, char* buffer);
+size_t formatNumber(int64_t value, char* buffer);
+size_t formatNumber(bool value, char* buffer);
+size_t formatNumber(float value, char* buffer);
+size_t formatNumber(double value, char* buffer);
+
+bool parseNumber(const char* begin, const char* end, int* value);
+bool parseNumber(const char* begin, const char* end, int64_t* value);
+//! Accepts 0, 1, true and false.
+bool parseNumber(const char* begin, const char* end, bool* value);
+bool parseNumber(const char* begin, const char* end, float* value);
+bool parseNumber(const char* begin, const char* end, double* value);
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_NUMBER_FORMAT_H
@@ -0,0 +1,127 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include <float.h>
+#include <limits>
+#include <string>
+
+#include "number_format.h"
+
+namespace media_graph {
+namespace {
+    template <typename T> std::string format(T value) {
+        char buffer[kMaxNumberLength];
+        return std::string(buffer, formatNumber(value, buffer));
+    }
+
+    template <typename T> bool parse(const std::string& text, T* value) {
+        return parseNumber(text.data(), text.data() + text.size(), value);
+    }
+
+    template <typename T> void RoundTripTest(T value) {
+        T result;
+        EXPECT_TRUE(parse(format(value), &result)) << format(value);
+        EXPECT_EQ(value, result) << format(value);
+    }
+
+}  // namespace
+
+TEST(NumberFormatTest, Integers) {
+    EXPECT_EQ("0", format(0));
+    EXPECT_EQ("-1234", format(-1234));
+    EXPECT_EQ("-2147483648", format(std::numeric_limits<int>::min()));
+    EXPECT_EQ("-9223372036854775808", format(std::numeric_limits<int64_t>::min()));
+
+    RoundTripTest(std::numeric_limits<int>::max());
+    RoundTripTest(std::numeric_limits<int>::min());
+    RoundTripTest(std::numeric_limits<int64_t>::max());
+    RoundTripTest(std::numeric_limits<int64_t>::min());
+}
+
+TEST(NumberFormatTest, ShortestFloats) {
+    EXPECT_EQ("0.1", format(0.1));
+    EXPECT_EQ("0.1", format(0.1f));
+    EXPECT_EQ("1e+100", format(1e100));
+    EXPECT_EQ("2.5", format(2.5f));
+
+    RoundTripTest(3.1415);
+    RoundTripTest(1.0 / 3.0);
+    RoundTripTest(1.0f / 3.0f);
+    RoundTripTest(-3.1234e8f);
+    RoundTripTest(DBL_MAX);
+    RoundTripTest(DBL_MIN);
+    RoundTripTest(FLT_MAX);
+    RoundTripTest(std::numeric_limits<double>::denorm_min());
+}
+
+TEST(NumberFormatTest, Booleans) {
+    EXPECT_EQ("1", format(true));
+    EXPECT_EQ("0", format(false));
+
+    bool value = false;
+    EXPECT_TRUE(parse("true", &value));
+    EXPECT_TRUE(value);
+    EXPECT_TRUE(parse("0", &value));
+    EXPECT_FALSE(value);
+    EXPECT_FALSE(parse("2", &value));
+    EXPECT_FALSE(parse("yes", &value));
+}
+
+TEST(NumberFormatTest, StrictParsing) {
+    int value = 7;
+    EXPECT_FALSE(parse("", &value));
+    EXPECT_FALSE(parse("-", &value));
+    EXPECT_FALSE(parse("12abc", &value));
+    EXPECT_FALSE(parse(" 12", &value));
+    EXPECT_FALSE(parse("1.5", &value));
+    EXPECT_FALSE(parse("2147483648", &value));
+    EXPECT_EQ(7, value);
+    EXPECT_TRUE(parse("-2147483648", &value));
+    EXPECT_TRUE(parse("+12", &value));
+    EXPECT_EQ(12, value);
+
+    int64_t big;
+    EXPECT_FALSE(parse("9223372036854775808", &big));
+    EXPECT_TRUE(parse("9223372036854775807", &big));
+
+    double real = 1;
+    EXPECT_FALSE(parse("", &real));
+    EXPECT_FALSE(parse("1.5x", &real));
+    EXPECT_FALSE(parse(" 1.5", &real));
+    EXPECT_FALSE(parse("1e999", &real));
+    EXPECT_EQ(1, real);
+    EXPECT_TRUE(parse("-2.5e-3", &real));
+    EXPECT_EQ(-2.5e-3, real);
+
+    float single;
+    EXPECT_FALSE(parse("1e39", &single));
+    EXPECT_TRUE(parse("1e-3", &single));
+    EXPECT_EQ(1e-3f, single);
+}
+
+}  // namespace media_graph
@@ -0,0 +1,69 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_TYPES_PAYLOAD_SIZE_H
+#define MEDIAGRAPH_TYPES_PAYLOAD_SIZE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace media_graph {
+
+/*! Estimates the memory held by a stream entry, in bytes. Streams use it to
+ *  enforce byte limits and memory budgets.
+ *
+ *  The default implementation returns sizeof(T). Types holding heap memory,
+ *  such as frames or encoded packets, should specialize it:
+ *
+ *  \code
+ *  template <> struct PayloadSize<FramePtr> {
+ *      static size_t of(const FramePtr& frame) {
+ *          return sizeof(frame) + (frame ? frame->numBytes() : 0);
+ *      }
+ *  };
+ *  \endcode
+ */
+template <typename T> struct PayloadSize {
+    static size_t of(const T&) { return sizeof(T); }
+};
+
+template <> struct PayloadSize<std::string> {
+    static size_t of(const std::string& value) { return sizeof(value) + value.capacity(); }
+};
+
+template <typename T> struct PayloadSize<std::vector<T>> {
+    static size_t of(const std::vector<T>& value) {
+        return sizeof(value) + value.capacity() * sizeof(T);
+    }
+};
+
+//! Shortcut for PayloadSize<T>::of(value).
+template <typename T> size_t payloadSize(const T& value) { return PayloadSize<T>::of(value); }
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_TYPES_PAYLOAD_SIZE_H
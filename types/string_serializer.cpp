@@ -28,85 +28,200 @@
 
 #include <assert.h>
 #include <stdint.h>
-#include <sstream>
+
+#include "number_format.h"
 
 namespace media_graph {
-template <typename T> std::string toString(T tmp) {
-    std::stringstream sstr;
-    sstr << tmp;
-    return sstr.str();
+namespace {
+    // Quotes strings written inside arrays and structs.
+    std::string quote(const std::string& value) {
+        std::string quoted = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') { quoted += '\\'; }
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+}  // namespace
+
+bool StringSerializer::process(const int& value) { return appendNumber(value); }
+
+bool StringDeSerializer::process(int* value) { return readNumber(value); }
+
+bool StringSerializer::process(const int64_t& value) { return appendNumber(value); }
+
+bool StringDeSerializer::process(int64_t* value) { return readNumber(value); }
+
+bool StringSerializer::process(const bool& value) { return appendNumber(value); }
+
+bool StringDeSerializer::process(bool* value) { return readNumber(value); }
+
+bool StringSerializer::process(const float& value) { return appendNumber(value); }
+
+bool StringDeSerializer::process(float* value) { return readNumber(value); }
+
+bool StringSerializer::process(const double& value) { return appendNumber(value); }
+
+bool StringDeSerializer::process(double* value) { return readNumber(value); }
+
+bool StringSerializer::process(const std::string& value) {
+    serialized_value_ += (num_fields_.empty() ? value : quote(value));
+    return true;
 }
 
-template <typename T> T fromString(std::string strValue) {
-    T tmp;
-    std::stringstream sstr;
-    sstr << strValue;
-    sstr >> tmp;
-    return tmp;
+bool StringDeSerializer::process(std::string* value) {
+    if (depth_ == 0) {
+        *value = serialized_value_.substr(position_);
+        position_ = serialized_value_.size();
+        return true;
+    }
+
+    if (!consume('"')) { return false; }
+    std::string result;
+    for (size_t i = position_; i < serialized_value_.size(); ++i) {
+        char c = serialized_value_[i];
+        if (c == '"') {
+            *value = result;
+            position_ = i + 1;
+            return true;
+        }
+        if (c == '\\' && i + 1 < serialized_value_.size()) { c = serialized_value_[++i]; }
+        result += c;
+    }
+    return false;
 }
 
-bool StringSerializer::process(const int& value) {
-    serialized_value_ = toString(value);
+template <typename T> bool StringSerializer::appendNumber(T value) {
+    char buffer[kMaxNumberLength];
+    serialized_value_.append(buffer, formatNumber(value, buffer));
     return true;
 }
 
-bool StringDeSerializer::process(int* value) {
-    if (serialized_value_.size() < 1) { return false; }
-    *value = fromString<int>(serialized_value_);
+template <typename T> bool StringSerializer::appendArray(const T* values, size_t count) {
+    serialized_value_ += '[';
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) { serialized_value_ += ','; }
+        appendNumber(values[i]);
+    }
+    serialized_value_ += ']';
     return true;
 }
 
-bool StringSerializer::process(const int64_t& value) {
-    serialized_value_ = toString(value);
-    return true;
+bool StringSerializer::processArray(const int* values, size_t count) {
+    return appendArray(values, count);
 }
 
-bool StringDeSerializer::process(int64_t* value) {
-    if (serialized_value_.size() < 1) { return false; }
-    *value = fromString<int64_t>(serialized_value_);
-    return true;
+bool StringSerializer::processArray(const int64_t* values, size_t count) {
+    return appendArray(values, count);
 }
 
-bool StringSerializer::process(const bool& value) {
-    serialized_value_ = toString(value);
-    return true;
+bool StringSerializer::processArray(const float* values, size_t count) {
+    return appendArray(values, count);
 }
 
-bool StringDeSerializer::process(bool* value) {
-    if (serialized_value_.size() < 1) { return false; }
-    *value = fromString<bool>(serialized_value_);
-    return true;
+bool StringSerializer::processArray(const double* values, size_t count) {
+    return appendArray(values, count);
 }
 
-bool StringSerializer::process(const float& value) {
-    serialized_value_ = toString(value);
+bool StringSerializer::beginStruct(const char* /*type_name*/, int /*num_fields*/) {
+    serialized_value_ += '{';
+    num_fields_.push_back(0);
     return true;
 }
 
-bool StringDeSerializer::process(float* value) {
-    if (serialized_value_.size() < 1) { return false; }
-    *value = fromString<float>(serialized_value_);
+bool StringSerializer::beginField(const char* name) {
+    if (num_fields_.empty()) { return false; }
+    if (num_fields_.back()++ > 0) { serialized_value_ += ','; }
+    serialized_value_ += name;
+    serialized_value_ += ':';
     return true;
 }
 
-bool StringSerializer::process(const double& value) {
-    serialized_value_ = toString(value);
+bool StringSerializer::endStruct() {
+    if (num_fields_.empty()) { return false; }
+    num_fields_.pop_back();
+    serialized_value_ += '}';
     return true;
 }
 
-bool StringDeSerializer::process(double* value) {
-    if (serialized_value_.size() < 1) { return false; }
-    *value = fromString<double>(serialized_value_);
+bool StringDeSerializer::consume(char c) {
+    while (position_ < serialized_value_.size() && serialized_value_[position_] == ' ') {
+        ++position_;
+    }
+    if (position_ < serialized_value_.size() && serialized_value_[position_] == c) {
+        ++position_;
+        return true;
+    }
+    return false;
+}
+
+void StringDeSerializer::nextToken(size_t* begin, size_t* end) {
+    size_t token_end = (depth_ == 0 ? serialized_value_.size()
+                                    : serialized_value_.find_first_of(",]}", position_));
+    if (token_end == std::string::npos) { token_end = serialized_value_.size(); }
+    *begin = position_;
+    *end = token_end;
+    position_ = token_end;
+
+    // Spaces around separators are allowed.
+    while (*begin < *end && serialized_value_[*begin] == ' ') { ++*begin; }
+    while (*end > *begin && serialized_value_[*end - 1] == ' ') { --*end; }
+}
+
+template <typename T> bool StringDeSerializer::readNumber(T* value) {
+    size_t begin, end;
+    nextToken(&begin, &end);
+    const char* data = serialized_value_.data();
+    return parseNumber(data + begin, data + end, value);
+}
+
+template <typename T> bool StringDeSerializer::readArray(std::vector<T>* values) {
+    if (!consume('[')) { return false; }
+    ++depth_;
+    std::vector<T> result;
+    bool success = true;
+    if (!consume(']')) {
+        do {
+            T value;
+            if (!readNumber(&value)) {
+                success = false;
+                break;
+            }
+            result.push_back(value);
+        } while (consume(','));
+        success = success && consume(']');
+    }
+    --depth_;
+    if (success) { values->swap(result); }
+    return success;
+}
+
+bool StringDeSerializer::processArray(std::vector<int>* values) { return readArray(values); }
+
+bool StringDeSerializer::processArray(std::vector<int64_t>* values) { return readArray(values); }
+
+bool StringDeSerializer::processArray(std::vector<float>* values) { return readArray(values); }
+
+bool StringDeSerializer::processArray(std::vector<double>* values) { return readArray(values); }
+
+bool StringDeSerializer::beginStruct(const char* /*type_name*/, int /*num_fields*/) {
+    if (!consume('{')) { return false; }
+    ++depth_;
     return true;
 }
 
-bool StringSerializer::process(const std::string& value) {
-    serialized_value_ = toString(value);
+bool StringDeSerializer::beginField(const char* name) {
+    // Fields are separated by commas, and must come in declaration order.
+    consume(',');
+    const std::string expected = std::string(name) + ':';
+    if (serialized_value_.compare(position_, expected.size(), expected) != 0) { return false; }
+    position_ += expected.size();
     return true;
 }
 
-bool StringDeSerializer::process(std::string* value) {
-    *value = serialized_value_;
+bool StringDeSerializer::endStruct() {
+    if (!consume('}')) { return false; }
+    --depth_;
     return true;
 }
 
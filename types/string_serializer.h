@@ -29,11 +29,17 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "type_visitor.h"
 
 namespace media_graph {
-//! Serialize known types to binary.
+/*! Serialize known types to a human readable string.
+ *  Numbers are written in decimal, with as many digits as needed to read
+ *  floating point values back exactly. Arrays are written as [1,2,3],
+ *  structs as {name:value,...}. Inside arrays and structs, strings are
+ *  quoted.
+ */
 class StringSerializer : public TypeConstVisitor {
 public:
     virtual bool process(const int& value);
@@ -45,16 +51,32 @@ public:
 
     virtual bool process(const std::string& value);
 
+    virtual bool processArray(const int* values, size_t count);
+    virtual bool processArray(const int64_t* values, size_t count);
+    virtual bool processArray(const float* values, size_t count);
+    virtual bool processArray(const double* values, size_t count);
+
+    virtual bool beginStruct(const char* type_name, int num_fields);
+    virtual bool beginField(const char* name);
+    virtual bool endStruct();
+
     const std::string& value() const { return serialized_value_; }
 
 private:
+    template <typename T> bool appendNumber(T value);
+    template <typename T> bool appendArray(const T* values, size_t count);
+
     std::string serialized_value_;
+
+    // Number of fields written so far, for each struct being written.
+    std::vector<int> num_fields_;
 };
 
-//! De-serialize known types from binary.
+//! De-serialize known types from a string written by StringSerializer.
 class StringDeSerializer : public TypeVisitor {
 public:
-    StringDeSerializer(const std::string& serialized_value) : serialized_value_(serialized_value) {}
+    StringDeSerializer(const std::string& serialized_value)
+        : serialized_value_(serialized_value), position_(0), depth_(0) {}
 
     virtual bool process(int* value);
     virtual bool process(int64_t* value);
@@ -65,10 +87,34 @@ public:
 
     virtual bool process(std::string* value);
 
-    const std::string& remaining() const { return serialized_value_; }
+    virtual bool processArray(std::vector<int>* values);
+    virtual bool processArray(std::vector<int64_t>* values);
+    virtual bool processArray(std::vector<float>* values);
+    virtual bool processArray(std::vector<double>* values);
+
+    virtual bool beginStruct(const char* type_name, int num_fields);
+    virtual bool beginField(const char* name);
+    virtual bool endStruct();
+
+    std::string remaining() const { return serialized_value_.substr(position_); }
 
 private:
+    // Finds the text of the next value, without surrounding spaces:
+    // everything at the top level, up to the next separator inside arrays
+    // and structs.
+    void nextToken(size_t* begin, size_t* end);
+
+    // Skips spaces, then <c> if it is the next character.
+    bool consume(char c);
+
+    template <typename T> bool readNumber(T* value);
+    template <typename T> bool readArray(std::vector<T>* values);
+
     std::string serialized_value_;
+    size_t position_;
+
+    // Number of arrays and structs being read.
+    int depth_;
 };
 
 }  // namespace media_graph
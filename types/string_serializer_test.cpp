@@ -26,6 +26,8 @@
 //
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "string_serializer.h"
 
 namespace media_graph {
@@ -39,6 +41,34 @@ namespace {
         EXPECT_EQ(result, value);
     }
 
+    template <typename T> void CompositeSerializationTest(const T& value) {
+        StringSerializer serializer;
+        EXPECT_TRUE(visitValue(&serializer, value));
+        StringDeSerializer deSerializer(serializer.value());
+        T result;
+        EXPECT_TRUE(visitValue(&deSerializer, &result));
+        EXPECT_EQ(result, value);
+    }
+
+    struct Point {
+        float x;
+        float y;
+        MEDIAGRAPH_FIELDS(Point, x, y)
+        bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+    };
+
+    struct Detection {
+        std::string label;
+        int64_t id;
+        Point center;
+        std::vector<double> scores;
+        MEDIAGRAPH_FIELDS(Detection, label, id, center, scores)
+        bool operator==(const Detection& other) const {
+            return label == other.label && id == other.id && center == other.center
+                   && scores == other.scores;
+        }
+    };
+
 }  // namespace
 
 TEST(StringSerializerTest, IntTest) {
@@ -78,6 +108,19 @@ TEST(StringSerializerTest, DoubleTest) {
     GenericSerializationTest(value);
 }
 
+TEST(StringSerializerTest, RejectsGarbage) {
+    int value = 3;
+    StringDeSerializer trailing("12abc");
+    EXPECT_FALSE(trailing.process(&value));
+    StringDeSerializer empty("");
+    EXPECT_FALSE(empty.process(&value));
+    EXPECT_EQ(3, value);
+
+    std::vector<double> values;
+    StringDeSerializer bad_element("[1,x,3]");
+    EXPECT_FALSE(visitValue(&bad_element, &values));
+}
+
 TEST(StringSerializerTest, StringTest) {
     std::string value("Hello, world");
     GenericSerializationTest(value);
@@ -91,4 +134,39 @@ TEST(StringSerializerTest, StringTest) {
     GenericSerializationTest(value);
 }
 
+TEST(StringSerializerTest, VectorTest) {
+    CompositeSerializationTest(std::vector<int>{1, -2, 3});
+    CompositeSerializationTest(std::vector<int64_t>{0x123456789AB, -1});
+    CompositeSerializationTest(std::vector<float>{0.5f, -3.25e8f});
+    CompositeSerializationTest(std::vector<double>{3.1415, -1e-12, 0});
+    CompositeSerializationTest(std::vector<double>());
+}
+
+TEST(StringSerializerTest, CompositeFormat) {
+    Point point;
+    point.x = 1;
+    point.y = 2.5f;
+    StringSerializer serializer;
+    EXPECT_TRUE(visitValue(&serializer, point));
+    EXPECT_EQ("{x:1,y:2.5}", serializer.value());
+
+    StringDeSerializer deSerializer("[1, 2,3]");
+    std::vector<int> values;
+    EXPECT_TRUE(visitValue(&deSerializer, &values));
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), values);
+
+    StringDeSerializer reordered("{y:2,x:1}");
+    EXPECT_FALSE(visitValue(&reordered, &point));
+}
+
+TEST(StringSerializerTest, StructTest) {
+    Detection detection;
+    detection.label = "pedestrian, {walking}";
+    detection.id = 42;
+    detection.center.x = 1.5f;
+    detection.center.y = -2;
+    detection.scores = {0.25, 0.75};
+    CompositeSerializationTest(detection);
+}
+
 }  // namespace media_graph
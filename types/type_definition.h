@@ -27,31 +27,84 @@
 #ifndef MEDIAGRAPH_TYPE_DEFINITION
 #define MEDIAGRAPH_TYPE_DEFINITION
 
+#include "fields.h"
+#include "type_id.h"
+
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace media_graph {
 namespace {
-    // General declaration, not actually implemented.
-    // types used in streams and properties must implement it.
+    // Names of composite types: vectors, and structs described with
+    // MEDIAGRAPH_FIELDS. Not implemented for other types.
+    template <typename T, typename Enable = void> struct CompositeTypeName;
+
+    // General declaration, only implemented for composite types.
+    // Other types used in streams and properties must implement it.
     // A good default implementation would be: typeid(T()).name()
     // However, the resulting string would not be reliably consistent
     // among compilers.
-    template <typename T> std::string typeName();
+    // Prefer MEDIAGRAPH_DECLARE_TYPE, which also gives a compile-time TypeId.
+    template <typename T> std::string typeName() { return CompositeTypeName<T>::name(); }
 
-    template <> inline std::string typeName<int>() { return "int"; }
+    template <typename T> struct CompositeTypeName<std::vector<T>> {
+        static std::string name() { return "vector<" + typeName<T>() + ">"; }
+    };
 
-    template <> inline std::string typeName<int64_t>() { return "int64"; }
+    template <typename T>
+    struct CompositeTypeName<T, typename std::enable_if<HasFields<T>::value>::type> {
+        static std::string name() { return T::mediaGraphTypeName(); }
+    };
 
-    template <> inline std::string typeName<bool>() { return "bool"; }
+    /*! Name and TypeId of a type, without allocation. Types declared with
+     *  MEDIAGRAPH_DECLARE_TYPE have a constexpr kId. For other types, the
+     *  name and id are computed from typeName<T>() once, on first use.
+     */
+    template <typename T> struct TypeTraits {
+        static const char* name() {
+            static const std::string name = typeName<T>();
+            return name.c_str();
+        }
+        static TypeId id() {
+            static const TypeId id = registerType(typeIdFromName(name()), name());
+            return id;
+        }
+    };
 
-    template <> inline std::string typeName<float>() { return "float"; }
+    //! Shortcut for TypeTraits<T>::id().
+    template <typename T> TypeId typeId() { return TypeTraits<T>::id(); }
 
-    template <> inline std::string typeName<double>() { return "double"; }
+}  // namespace
 
-    template <> inline std::string typeName<std::string>() { return "string"; }
+/*! Declares the name of a type used in streams or properties. Must be used
+ *  in the media_graph namespace:
+ *
+ *  \code
+ *  namespace media_graph {
+ *  MEDIAGRAPH_DECLARE_TYPE(MyFrame, "MyFrame")
+ *  }
+ *  \endcode
+ */
+#define MEDIAGRAPH_DECLARE_TYPE(Type, Name)                                        \
+    namespace {                                                                    \
+        template <> inline std::string typeName<Type>() { return Name; }           \
+        template <> struct TypeTraits<Type> {                                      \
+            static constexpr TypeId kId = typeIdFromName(Name);                    \
+            static const char* name() { return Name; }                             \
+            static TypeId id() {                                                   \
+                static const TypeId registered = registerType(kId, Name);          \
+                return registered;                                                 \
+            }                                                                      \
+        };                                                                         \
+    }
 
-}  // namespace
+MEDIAGRAPH_DECLARE_TYPE(int, "int")
+MEDIAGRAPH_DECLARE_TYPE(int64_t, "int64")
+MEDIAGRAPH_DECLARE_TYPE(bool, "bool")
+MEDIAGRAPH_DECLARE_TYPE(float, "float")
+MEDIAGRAPH_DECLARE_TYPE(double, "double")
+MEDIAGRAPH_DECLARE_TYPE(std::string, "string")
 
 }  // namespace media_graph
 
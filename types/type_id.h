@@ -0,0 +1,72 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef MEDIAGRAPH_TYPES_TYPE_ID_H
+#define MEDIAGRAPH_TYPES_TYPE_ID_H
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace media_graph {
+
+/*! Identifies a type exchanged through streams and properties. Computed at
+ *  compile time as the 64 bit FNV-1a hash of the type name, so that
+ *  comparing types does not involve any string.
+ *  \see TypeTraits, MEDIAGRAPH_DECLARE_TYPE
+ */
+typedef uint64_t TypeId;
+
+namespace type_id_detail {
+    constexpr TypeId fnv1a(const char* name, TypeId hash) {
+        return *name == 0 ? hash
+                          : fnv1a(name + 1, (hash ^ TypeId(uint8_t(*name))) * 1099511628211ull);
+    }
+}  // namespace type_id_detail
+
+//! Hashes a type name. Can be evaluated at compile time.
+constexpr TypeId typeIdFromName(const char* name) {
+    return type_id_detail::fnv1a(name, 14695981039346656037ull);
+}
+
+inline TypeId typeIdFromName(const std::string& name) { return typeIdFromName(name.c_str()); }
+
+/*! Records the name of a type id, for debugging and for the http server.
+ *  Registering the same type twice is harmless. Asserts if two different
+ *  names have the same id. Returns <id>. Thread safe.
+ */
+TypeId registerType(TypeId id, const char* name);
+
+//! Returns the name registered for <id>, or null if it is unknown.
+const char* registeredTypeName(TypeId id);
+
+//! Lists registered types, sorted by name.
+std::vector<std::pair<TypeId, std::string>> registeredTypes();
+
+}  // namespace media_graph
+
+#endif  // MEDIAGRAPH_TYPES_TYPE_ID_H
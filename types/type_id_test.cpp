@@ -0,0 +1,76 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include <gtest/gtest.h>
+
+#include "type_definition.h"
+
+namespace media_graph {
+
+namespace {
+    struct Declared {};
+    struct Legacy {};
+}  // namespace
+
+MEDIAGRAPH_DECLARE_TYPE(Declared, "Declared")
+
+namespace {
+    template <> std::string typeName<Legacy>() { return "Legacy"; }
+}  // namespace
+
+static_assert(TypeTraits<int>::kId == typeIdFromName("int"), "constexpr type id");
+static_assert(TypeTraits<int>::kId != TypeTraits<int64_t>::kId, "distinct type ids");
+
+TEST(TypeIdTest, DeclaredTypes) {
+    EXPECT_EQ(typeIdFromName("Declared"), typeId<Declared>());
+    EXPECT_STREQ("Declared", TypeTraits<Declared>::name());
+    EXPECT_EQ("Declared", typeName<Declared>());
+    EXPECT_STREQ("Declared", registeredTypeName(typeId<Declared>()));
+}
+
+TEST(TypeIdTest, TypesOnlyDefiningTypeName) {
+    EXPECT_EQ(typeIdFromName(std::string("Legacy")), typeId<Legacy>());
+    EXPECT_STREQ("Legacy", TypeTraits<Legacy>::name());
+    EXPECT_STREQ("Legacy", registeredTypeName(typeId<Legacy>()));
+}
+
+TEST(TypeIdTest, Registry) {
+    EXPECT_EQ(nullptr, registeredTypeName(typeIdFromName("never registered")));
+
+    typeId<double>();
+    typeId<std::string>();
+    bool found_double = false;
+    std::string previous;
+    for (const auto& type : registeredTypes()) {
+        EXPECT_LE(previous, type.second);
+        EXPECT_EQ(typeIdFromName(type.second), type.first);
+        found_double = found_double || type.second == "double";
+        previous = type.second;
+    }
+    EXPECT_TRUE(found_double);
+}
+
+}  // namespace media_graph
@@ -0,0 +1,81 @@
+// Copyright (c) 2012-2013, Aptarism SA.
+//
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of the University of California, Berkeley nor the
+//   names of its contributors may be used to endorse or promote products
+//   derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "type_id.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+namespace media_graph {
+
+namespace {
+    // Names are stored as std::string: registered pointers could come from
+    // a library that gets unloaded.
+    struct Registry {
+        std::mutex mutex;
+        std::map<TypeId, std::string> names;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    bool byName(const std::pair<TypeId, std::string>& a,
+                const std::pair<TypeId, std::string>& b) {
+        return a.second < b.second;
+    }
+}  // namespace
+
+TypeId registerType(TypeId id, const char* name) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto inserted = r.names.insert(std::make_pair(id, std::string(name)));
+
+    // Two type names with the same hash: rename one of them.
+    assert(inserted.first->second == name);
+    (void)inserted;
+    return id;
+}
+
+const char* registeredTypeName(TypeId id) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.names.find(id);
+    return it == r.names.end() ? nullptr : it->second.c_str();
+}
+
+std::vector<std::pair<TypeId, std::string>> registeredTypes() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::pair<TypeId, std::string>> result(r.names.begin(), r.names.end());
+    std::sort(result.begin(), result.end(), byName);
+    return result;
+}
+
+}  // namespace media_graph
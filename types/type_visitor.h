@@ -27,6 +27,13 @@
 #ifndef MEDIAGRAPH_TYPE_VISITOR_H
 #define MEDIAGRAPH_TYPE_VISITOR_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "fields.h"
+
 namespace media_graph {
 // A type visitor is used to express an operation that can be done on several
 // types. The invoker of a visitor does not need to know at compile time on what
@@ -36,6 +43,12 @@ namespace media_graph {
 // A NamedProperty can be of several type, not necessarily known at compile time.
 // With a serializer object that derives from TypeConstVisitor, it is still
 // possible to serialize the property.
+//
+// Vectors of numbers are visited as a whole, with processArray(). Structs
+// described with MEDIAGRAPH_FIELDS are visited field by field, between
+// beginStruct() and endStruct(), each field value following a beginField()
+// call. Visitors that do not handle arrays or structs fail on them.
+// Call visitValue() to visit a value of any of these types.
 class TypeConstVisitor {
 public:
     virtual ~TypeConstVisitor() {}
@@ -46,6 +59,15 @@ public:
     virtual bool process(const float& value) = 0;
     virtual bool process(const double& value) = 0;
     virtual bool process(const std::string& value) = 0;
+
+    virtual bool processArray(const int* /*values*/, size_t /*count*/) { return false; }
+    virtual bool processArray(const int64_t* /*values*/, size_t /*count*/) { return false; }
+    virtual bool processArray(const float* /*values*/, size_t /*count*/) { return false; }
+    virtual bool processArray(const double* /*values*/, size_t /*count*/) { return false; }
+
+    virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) { return false; }
+    virtual bool beginField(const char* /*name*/) { return true; }
+    virtual bool endStruct() { return true; }
 };
 
 class TypeVisitor {
@@ -58,8 +80,79 @@ public:
     virtual bool process(float* value) = 0;
     virtual bool process(double* value) = 0;
     virtual bool process(std::string* value) = 0;
+
+    virtual bool processArray(std::vector<int>* /*values*/) { return false; }
+    virtual bool processArray(std::vector<int64_t>* /*values*/) { return false; }
+    virtual bool processArray(std::vector<float>* /*values*/) { return false; }
+    virtual bool processArray(std::vector<double>* /*values*/) { return false; }
+
+    virtual bool beginStruct(const char* /*type_name*/, int /*num_fields*/) { return false; }
+    virtual bool beginField(const char* /*name*/) { return true; }
+    virtual bool endStruct() { return true; }
 };
 
+//! Visits a number or a string.
+template <typename T>
+typename std::enable_if<!HasFields<T>::value, bool>::type visitValue(TypeConstVisitor* visitor,
+                                                                      const T& value) {
+    return visitor->process(value);
+}
+
+template <typename T>
+typename std::enable_if<!HasFields<T>::value, bool>::type visitValue(TypeVisitor* visitor,
+                                                                      T* value) {
+    return visitor->process(value);
+}
+
+//! Visits a vector of numbers, as one contiguous array.
+template <typename T> bool visitValue(TypeConstVisitor* visitor, const std::vector<T>& values) {
+    return visitor->processArray(values.data(), values.size());
+}
+
+template <typename T> bool visitValue(TypeVisitor* visitor, std::vector<T>* values) {
+    return visitor->processArray(values);
+}
+
+//! Visits a struct described with MEDIAGRAPH_FIELDS.
+template <typename T>
+typename std::enable_if<HasFields<T>::value, bool>::type visitValue(TypeConstVisitor* visitor,
+                                                                     const T& value);
+template <typename T>
+typename std::enable_if<HasFields<T>::value, bool>::type visitValue(TypeVisitor* visitor,
+                                                                     T* value);
+
+namespace internal {
+    struct ConstFieldVisitor {
+        TypeConstVisitor* visitor;
+
+        template <typename F> bool operator()(const char* name, const F& field) const {
+            return visitor->beginField(name) && visitValue(visitor, field);
+        }
+    };
+
+    struct FieldVisitor {
+        TypeVisitor* visitor;
+
+        template <typename F> bool operator()(const char* name, F& field) const {
+            return visitor->beginField(name) && visitValue(visitor, &field);
+        }
+    };
+}  // namespace internal
+
+template <typename T>
+typename std::enable_if<HasFields<T>::value, bool>::type visitValue(TypeConstVisitor* visitor,
+                                                                     const T& value) {
+    return visitor->beginStruct(T::mediaGraphTypeName(), T::mediaGraphNumFields()) &&
+           value.visitFields(internal::ConstFieldVisitor{visitor}) && visitor->endStruct();
+}
+
+template <typename T>
+typename std::enable_if<HasFields<T>::value, bool>::type visitValue(TypeVisitor* visitor,
+                                                                     T* value) {
+    return visitor->beginStruct(T::mediaGraphTypeName(), T::mediaGraphNumFields()) &&
+           value->visitFields(internal::FieldVisitor{visitor}) && visitor->endStruct();
+}
+
 }  // namespace media_graph
 
 #endif  // MEDIAGRAPH_TYPE_VISITOR_H